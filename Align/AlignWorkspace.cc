@@ -0,0 +1,16 @@
+#include "AlignWorkspace.h"
+#include <cstddef>
+
+/** The workspace of each thread. It is allocated the first time that
+ * a thread aligns a pair of sequences, and is kept for the life of
+ * the thread. */
+static AlignWorkspace* s_workspace = NULL;
+#pragma omp threadprivate(s_workspace)
+
+/** Return the workspace of the calling thread. */
+AlignWorkspace& alignWorkspace()
+{
+	if (s_workspace == NULL)
+		s_workspace = new AlignWorkspace;
+	return *s_workspace;
+}
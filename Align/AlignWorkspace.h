@@ -0,0 +1,112 @@
+#ifndef ALIGNWORKSPACE_H
+#define ALIGNWORKSPACE_H 1
+
+#include <algorithm>
+#include <cassert>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * The score of each distinct character of one sequence against every
+ * character of another sequence. The score function is called once
+ * per pair of a distinct character of a and a position of b, rather
+ * than once per cell of the dynamic programming matrix.
+ */
+class ScoreProfile
+{
+  public:
+	/** Score each distinct character of a against the characters of
+	 * b. The row of a character is indexed from 1 to b.size(), like
+	 * the columns of the dynamic programming matrix.
+	 */
+	template <typename ScoreFn>
+	void build(const std::string& a, const std::string& b,
+			ScoreFn score)
+	{
+		std::fill(m_row, m_row + 256, -1);
+		m_scores.clear();
+		size_t n = b.size() + 1;
+		for (std::string::const_iterator it = a.begin();
+				it != a.end(); ++it) {
+			unsigned char c = *it;
+			if (m_row[c] >= 0)
+				continue;
+			m_row[c] = m_scores.size() / n;
+			m_scores.push_back(0);
+			for (std::string::const_iterator jt = b.begin();
+					jt != b.end(); ++jt)
+				m_scores.push_back(score(*it, *jt));
+		}
+		m_n = n;
+	}
+
+	/** Return the scores of the character c of a. */
+	const int* row(char c) const
+	{
+		int i = m_row[(unsigned char)c];
+		assert(i >= 0);
+		return &m_scores[i * m_n];
+	}
+
+	/** Return the number of bytes allocated. */
+	size_t capacity() const
+	{
+		return m_scores.capacity() * sizeof (int);
+	}
+
+	/** Release the memory. */
+	void release() { std::vector<int>().swap(m_scores); }
+
+  private:
+	std::vector<int> m_scores;
+	size_t m_n;
+	int m_row[256];
+};
+
+/**
+ * The buffers of a pairwise alignment. A workspace is reused from one
+ * alignment to the next, so that aligning many sequences allocates
+ * memory only when a workspace outgrows its largest previous
+ * alignment. Use one workspace per thread.
+ */
+struct AlignWorkspace
+{
+	/** The scores of the characters of one sequence against the
+	 * other sequence. */
+	ScoreProfile profile;
+
+	/** Two rows of each score matrix. */
+	std::vector<int> rows;
+
+	/** The traceback of each cell of the dynamic programming matrix,
+	 * one byte per cell. */
+	std::vector<uint8_t> trace;
+
+	/** The offset into trace of each row. */
+	std::vector<size_t> traceRow;
+
+	/** Release the buffers that are larger than maxBytes, so that
+	 * a thread does not hold the memory of an exceptionally large
+	 * alignment. */
+	void trim(size_t maxBytes)
+	{
+		if (profile.capacity() > maxBytes)
+			profile.release();
+		if (rows.capacity() * sizeof (int) > maxBytes)
+			std::vector<int>().swap(rows);
+		if (trace.capacity() > maxBytes)
+			std::vector<uint8_t>().swap(trace);
+		if (traceRow.capacity() * sizeof (size_t) > maxBytes)
+			std::vector<size_t>().swap(traceRow);
+	}
+};
+
+/** Return the workspace of the calling thread. */
+AlignWorkspace& alignWorkspace();
+
+/** The largest buffer of a workspace that is kept between alignments.
+ */
+static const size_t ALIGN_WORKSPACE_MAX_BYTES = 64 << 20;
+
+#endif
@@ -4,12 +4,14 @@
  */
 
 #include "alignGlobal.h"
+#include "AlignWorkspace.h"
 #include "Sequence.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <climits>
 #include <cstdlib> // for abort
+#include <stdint.h>
 
 using namespace std;
 
@@ -50,21 +52,203 @@ static int score(char a, char b)
 	return score(a, b, c);
 }
 
-/** Find the optimal alignment from the score matrices.
+/** A score that is smaller than the score of any alignment, and to
+ * which a penalty may be added without overflow. */
+static const int MINUS_INF = INT_MIN/2;
+
+/** The initial number of diagonals on either side of the band. */
+static const int BAND_MARGIN = 16;
+
+/** The traceback of one cell. The low two bits are the term of f that
+ * is chosen: the diagonal, a gap in B (g) or a gap in A (h). The high
+ * bits are set when g or h extend a gap rather than open one. */
+enum {
+	FROM_DIAG = 0,
+	FROM_G = 1,
+	FROM_H = 2,
+	FROM_MASK = 3,
+	G_EXTEND = 4,
+	H_EXTEND = 8
+};
+
+/** Return the score of a gap of the specified length. */
+static int gapScore(int n)
+{
+	return n == 0 ? 0 : GAP_OPEN + GAP_EXTEND * (n - 1);
+}
+
+/** The diagonals k = j - i, from lo to hi, of the score matrix that
+ * are calculated. */
+struct Band {
+	int lo, hi;
+	unsigned lenA, lenB;
+
+	/** Return the first column of row i. */
+	unsigned first(unsigned i) const
+	{
+		return std::max(1, (int)i + lo);
+	}
+
+	/** Return the last column of row i. */
+	unsigned last(unsigned i) const
+	{
+		return std::min((int)lenB, (int)i + hi);
+	}
+
+	/** Return whether the band covers the entire matrix. */
+	bool full() const
+	{
+		return lo <= -(int)lenA && hi >= (int)lenB;
+	}
+};
+
+/** Return an upper bound of the score of an alignment of sequences
+ * of lengths lenA and lenB whose path visits the diagonal k = j - i.
+ * The path has at least the gaps needed to reach the diagonal k
+ * from the diagonal 0 and then to reach the diagonal lenB - lenA,
+ * and every other column is a match.
+ */
+static long maxScoreThrough(long lenA, long lenB, long k)
+{
+	long d = lenB - lenA;
+	long gapsA, gapsB;
+	if (k >= max(0L, d)) {
+		gapsA = k;
+		gapsB = k - d;
+	} else if (k <= min(0L, d)) {
+		gapsA = d - k;
+		gapsB = -k;
+	} else {
+		gapsA = max(0L, d);
+		gapsB = max(0L, -d);
+	}
+	return MATCH * (lenA - gapsB)
+		+ GAP_EXTEND * (gapsA + gapsB)
+		+ (GAP_OPEN - GAP_EXTEND) * ((gapsA > 0) + (gapsB > 0));
+}
+
+/** Return whether every alignment whose path leaves the band scores
+ * less than the specified score. Since a path that leaves the band
+ * cannot tie with the best path within the band, the alignment
+ * within the band is the alignment of the entire matrix.
+ */
+static bool bandIsExact(const Band& band, int best)
+{
+	return (band.lo <= -(int)band.lenA
+			|| maxScoreThrough(band.lenA, band.lenB, band.lo - 1)
+				< best)
+		&& (band.hi >= (int)band.lenB
+			|| maxScoreThrough(band.lenA, band.lenB, band.hi + 1)
+				< best);
+}
+
+/** Calculate the score matrix within the band and store the
+ * traceback of each cell in the workspace.
+ * Each row is calculated in two passes. The first pass calculates
+ * the vertical gap (g) and the diagonal term, which depend only on
+ * the previous row, and so may be vectorized by the compiler. The
+ * second pass calculates the horizontal gap (h), which depends on
+ * the previous column.
+ * @return the score of the best alignment
+ */
+static int fillBand(const string& seqA, const string& seqB,
+		const Band& band, AlignWorkspace& ws)
+{
+	unsigned lenA = seqA.size();
+	unsigned lenB = seqB.size();
+	unsigned width = lenB + 2;
+	ws.rows.resize(4 * width);
+	int* f[2] = { &ws.rows[0], &ws.rows[width] };
+	int* g[2] = { &ws.rows[2 * width], &ws.rows[3 * width] };
+
+	ws.traceRow.resize(lenA + 1);
+	size_t cells = 0;
+	for (unsigned i = 1; i <= lenA; i++) {
+		ws.traceRow[i] = cells;
+		cells += band.last(i) + 1 - band.first(i);
+	}
+	// Reserve one more cell so that the trace of an empty row is valid.
+	ws.trace.resize(cells + 1);
+
+	// Initialize the first row.
+	for (unsigned j = 0; j <= lenB + 1; j++) {
+		f[0][j] = gapScore(j);
+		g[0][j] = MINUS_INF;
+	}
+
+	for (unsigned i = 1; i <= lenA; i++) {
+		const int* fPrev = f[(i - 1) & 1];
+		const int* gPrev = g[(i - 1) & 1];
+		int* fCur = f[i & 1];
+		int* gCur = g[i & 1];
+		const int* s = ws.profile.row(seqA[i-1]);
+		unsigned first = band.first(i), last = band.last(i);
+		uint8_t* trace = &ws.trace[ws.traceRow[i]];
+
+		fCur[0] = gCur[0] = gapScore(i);
+
+		for (unsigned j = first; j <= last; j++) {
+			int open = fPrev[j] + GAP_OPEN;
+			int extend = gPrev[j] + GAP_EXTEND;
+			gCur[j] = max(open, extend);
+			fCur[j] = fPrev[j-1] + s[j];
+			trace[j - first] = extend >= open ? G_EXTEND : 0;
+		}
+
+		int fj = first == 1 ? fCur[0] : MINUS_INF;
+		int hj = MINUS_INF;
+		for (unsigned j = first; j <= last; j++) {
+			int open = fj + GAP_OPEN;
+			int extend = hj + GAP_EXTEND;
+			hj = max(open, extend);
+			int diag = fCur[j], gj = gCur[j];
+			uint8_t t = trace[j - first]
+				| (extend >= open ? H_EXTEND : 0);
+			if (diag >= gj && diag >= hj) {
+				fj = diag;
+				t |= FROM_DIAG;
+			} else if (gj >= hj) {
+				fj = gj;
+				t |= FROM_G;
+			} else {
+				fj = hj;
+				t |= FROM_H;
+			}
+			fCur[j] = fj;
+			trace[j - first] = t;
+		}
+
+		// The cell to the right of the band is outside the band of
+		// the next row.
+		if (last < lenB)
+			fCur[last + 1] = gCur[last + 1] = MINUS_INF;
+	}
+	return f[lenA & 1][lenB];
+}
+
+/** Return the traceback of the cell (i, j). */
+static uint8_t traceback(const AlignWorkspace& ws, const Band& band,
+		unsigned i, unsigned j)
+{
+	assert(i > 0 && j >= band.first(i) && j <= band.last(i));
+	return ws.trace[ws.traceRow[i] + j - band.first(i)];
+}
+
+/** Find the optimal alignment from the traceback of the score matrix.
  * @param[out] align the alignment
  * @return the number of matches
  */
-static unsigned backtrack(int** f, int** g, int** h,
+static unsigned backtrack(const AlignWorkspace& ws, const Band& band,
 		const string& seqA, const string& seqB, NWAlignment& align)
 {
 	string alignmentA, alignmentB, consensus;
 	unsigned matches = 0;
 	unsigned i = seqA.size(), j = seqB.size();
 	while (i > 0 && j > 0) {
-		int fij = f[i][j];
-		char a = seqA[i-1], b = seqB[j-1], c;
-		int s = score(a, b, c);
-		if (fij == f[i-1][j-1] + s) {
+		uint8_t t = traceback(ws, band, i, j);
+		if ((t & FROM_MASK) == FROM_DIAG) {
+			char a = seqA[i-1], b = seqB[j-1], c;
+			int s = score(a, b, c);
 			alignmentA += a;
 			alignmentB += b;
 			consensus += c;
@@ -72,9 +256,8 @@ static unsigned backtrack(int** f, int** g, int** h,
 				matches++;
 			i--;
 			j--;
-		} else if (fij == f[i-1][j] + GAP_OPEN
-				|| fij == g[i-1][j] + GAP_EXTEND) {
-			while (g[i][j] == g[i-1][j] + GAP_EXTEND) {
+		} else if ((t & FROM_MASK) == FROM_G) {
+			while (traceback(ws, band, i, j) & G_EXTEND) {
 				char a = seqA[i-1];
 				alignmentA += a;
 				alignmentB += GAP;
@@ -82,15 +265,13 @@ static unsigned backtrack(int** f, int** g, int** h,
 				i--;
 				assert(i > 0);
 			}
-			assert(g[i][j] == f[i-1][j] + GAP_OPEN);
 			char a = seqA[i-1];
 			alignmentA += a;
 			alignmentB += GAP;
 			consensus += tolower(a);
 			i--;
-		} else if (fij == f[i][j-1] + GAP_OPEN
-				|| fij == h[i][j-1] + GAP_EXTEND) {
-			while (h[i][j] == h[i][j-1] + GAP_EXTEND) {
+		} else if ((t & FROM_MASK) == FROM_H) {
+			while (traceback(ws, band, i, j) & H_EXTEND) {
 				char b = seqB[j-1];
 				alignmentA += GAP;
 				alignmentB += b;
@@ -98,7 +279,6 @@ static unsigned backtrack(int** f, int** g, int** h,
 				j--;
 				assert(j > 0);
 			}
-			assert(h[i][j] == f[i][j-1] + GAP_OPEN);
 			char b = seqB[j-1];
 			alignmentA += GAP;
 			alignmentB += b;
@@ -138,61 +318,38 @@ static unsigned backtrack(int** f, int** g, int** h,
 /** Find the optimal global alignment of the two sequences using the
  * Needleman-Wunsch algorithm and the improvement by Gotoh to use an
  * affine gap penalty rather than a linear gap penalty.
+ *
+ * The score matrix is calculated within a band of diagonals around
+ * the diagonals of the start and end of the alignment. The band is
+ * widened until no alignment that leaves the band can score as well
+ * as the best alignment within the band, so the result is the same
+ * as that of the entire matrix. Only two rows of the score matrix
+ * are stored, and one byte of traceback per cell of the band.
+ *
  * @param[out] align the alignment
  * @return the number of matches
  */
 unsigned alignGlobal(const string& seqA, const string& seqB,
 		NWAlignment& align)
 {
-	unsigned lenA = seqA.size();
-	unsigned lenB = seqB.size();
-	int** f = new int*[lenA + 1];
-	int** g = new int*[lenA + 1];
-	int** h = new int*[lenA + 1];
-	for (unsigned i = 0; i <= lenA; i++) {
-		f[i] = new int[lenB + 1];
-		g[i] = new int[lenB + 1];
-		h[i] = new int[lenB + 1];
-	}
-
-	// Initialize the score matrix.
-	for (unsigned i = 0; i <= lenA; i++) {
-		f[i][0] = g[i][0] = i == 0 ? 0
-			: GAP_OPEN + GAP_EXTEND * ((int)i - 1);
-		h[i][0] = INT_MIN/2;
-	}
-	for (unsigned j = 0; j <= lenB; j++) {
-		f[0][j] = h[0][j] = j == 0 ? 0
-			: GAP_OPEN + GAP_EXTEND * ((int)j - 1);
-		g[0][j] = INT_MIN/2;
-	}
+	AlignWorkspace& ws = alignWorkspace();
+	ws.profile.build(seqA, seqB,
+			static_cast<int (*)(char, char)>(score));
 
-	// Calculate the score matrix.
-	for (unsigned i = 1; i <= lenA; i++) {
-		for (unsigned j = 1; j <= lenB; j++) {
-			g[i][j] = max(
-					f[i-1][j] + GAP_OPEN,
-					g[i-1][j] + GAP_EXTEND);
-			h[i][j] = max(
-					f[i][j-1] + GAP_OPEN,
-					h[i][j-1] + GAP_EXTEND);
-			f[i][j] = max(
-					f[i-1][j-1] + score(seqA[i-1], seqB[j-1]),
-					max(g[i][j], h[i][j]));
-		}
+	Band band;
+	band.lenA = seqA.size();
+	band.lenB = seqB.size();
+	int d = (int)band.lenB - (int)band.lenA;
+	for (int margin = BAND_MARGIN; ; margin *= 4) {
+		band.lo = max(min(0, d) - margin, -(int)band.lenA);
+		band.hi = min(max(0, d) + margin, (int)band.lenB);
+		int best = fillBand(seqA, seqB, band, ws);
+		if (band.full() || bandIsExact(band, best))
+			break;
 	}
 
 	// Find the best alignment.
-	unsigned matches = backtrack(f, g, h, seqA, seqB, align);
-
-	for (unsigned i = 0; i <= lenA; i++) {
-		delete[] f[i];
-		delete[] g[i];
-		delete[] h[i];
-	}
-	delete[] f;
-	delete[] g;
-	delete[] h;
-
+	unsigned matches = backtrack(ws, band, seqA, seqB, align);
+	ws.trim(ALIGN_WORKSPACE_MAX_BYTES);
 	return matches;
 }
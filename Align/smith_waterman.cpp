@@ -6,13 +6,15 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "smith_waterman.h"
+#include "AlignWorkspace.h"
 #include "Sequence.h"
 #include "Align/Options.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
-#include <cfloat> // for DBL_MAX
+#include <climits>
 #include <iostream>
+#include <stdint.h>
 
 using namespace std;
 
@@ -92,17 +94,45 @@ static int gapScore(bool prev_is_gap)
 	return prev_is_gap ? opt::gap_extend : opt::gap_open;
 }
 
+/** The predecessor of a cell of the score matrix. */
+enum { FROM_DIAG, FROM_UP, FROM_LEFT };
+
+/** Return the predecessor of the cell (i, j), where i and j are at
+ * least one. The predecessors are stored one byte per cell. */
+static inline uint8_t& from(vector<uint8_t>& trace, int N_b, int i, int j)
+{
+	return trace[(size_t)(i - 1) * N_b + (j - 1)];
+}
+
 //the backtrack step in smith_waterman
-unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
+unsigned Backtrack(const int i_max, const int j_max,
+		vector<uint8_t>& trace,
 		const string& seq_a, const string& seq_b, SMAlignment& align, unsigned* align_pos)
 {
 	// Backtracking from H_max
+	int N_b = seq_b.length();
 	int current_i=i_max,current_j=j_max;
-	int next_i=I_i[current_i][current_j];
-	int next_j=I_j[current_i][current_j];
+	int next_i, next_j;
 	string consensus_a(""), consensus_b(""), match("");
 	unsigned num_of_match = 0;
-	while(((current_i!=next_i) || (current_j!=next_j)) && (next_j!=0) && (next_i!=0)){
+	for (;;) {
+		switch (from(trace, N_b, current_i, current_j)) {
+		  case FROM_DIAG:
+			next_i = current_i - 1;
+			next_j = current_j - 1;
+			break;
+		  case FROM_UP:
+			next_i = current_i - 1;
+			next_j = current_j;
+			break;
+		  default:
+			next_i = current_i;
+			next_j = current_j - 1;
+			break;
+		}
+		if (next_j == 0 || next_i == 0)
+			break;
+
 		if(next_i==current_i) {
 			consensus_a += '-'; //deletion in A
 			match += tolower(seq_b[current_j-1]);
@@ -131,10 +161,7 @@ unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
 
 		current_i = next_i;
 		current_j = next_j;
-		next_i=I_i[current_i][current_j];
-		next_j=I_j[current_i][current_j];
 	}
-
 	//check whether the alignment is what we want (pinned at the ends), modified version of SW (i_max is already fixed)
 	if (current_j > 1)
 		return 0;
@@ -175,6 +202,9 @@ unsigned Backtrack(const int i_max, const int j_max, int** I_i, int** I_j,
  * looks for a global alignment, but without penalizing overhangs...
  * and make sure the alignment is end-to-end (end of seqA to beginning
  * of seqB).
+ * Only two rows of the score matrix are stored, and the predecessor
+ * of each cell in one byte. The buffers are those of the workspace of
+ * the calling thread.
  */
 void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start_pos,
 	vector<overlap_align>& overlaps, bool multi_align, bool verbose)
@@ -183,86 +213,67 @@ void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start
 	int N_a = seq_a.length();
 	int N_b = seq_b.length();
 
-	// initialize H
-	int i, j;
-	double** H;
-	int **I_i, **I_j;
-	H = new double*[N_a+1];
-	I_i = new int*[N_a+1];
-	I_j = new int*[N_a+1];
-	bool** V = new bool*[N_a+1];
+	AlignWorkspace& ws = alignWorkspace();
+	ws.profile.build(seq_a, seq_b, matchScore);
+	ws.trace.resize((size_t)N_a * N_b);
+	ws.rows.resize(2 * (N_b + 1));
+	vector<uint8_t>& trace = ws.trace;
 
-	for(i=0;i<=N_a;i++){
-		H[i] = new double[N_b+1];
-		I_i[i] = new int[N_b+1];
-		I_j[i] = new int[N_b+1];
-		H[i][0]=0; //only need to initialize first row and first column
-		I_i[i][0] = i-1;
-		V[i] = new bool[N_b+1];
-		V[i][0] = true; //valid start
-	}
-
-	for (j = 0; j <= N_b; j++) {
-		H[0][j] = 0; //initialize first column
-		I_j[0][j] = j-1;
-		V[0][j] = false; //wrong start, not overlap
-	}
-	V[0][0] = true;
+	// The scores of the first row and column are zero. Every cell of
+	// the first column is a valid start, but of the first row only
+	// the cell (0, 0) is a valid start.
+	int* H[2] = { &ws.rows[0], &ws.rows[N_b + 1] };
+	fill(H[0], H[0] + N_b + 1, 0);
+	H[1][0] = 0;
 
+	int i, j;
 	for(i=1;i<=N_a;i++){
+		const int* prev = H[(i - 1) & 1];
+		int* cur = H[i & 1];
+		const int* s = ws.profile.row(seq_a[i-1]);
 		for(j=1;j<=N_b;j++){
-			char a = seq_a[i-1], b = seq_b[j-1];
-			double scores[3] = {
-				V[i-1][j-1] ? H[i-1][j-1] + matchScore(a, b)
-					: -DBL_MAX, // match or mismatch
-				V[i-1][j] ? H[i-1][j] + gapScore(I_j[i-1][j] == j)
-					: -DBL_MAX, // deletion in sequence A
-				V[i][j-1] ? H[i][j-1] + gapScore(I_i[i][j-1] == i)
-					: -DBL_MAX // deletion in sequence B
+			// Every cell below the first row is valid.
+			bool validDiag = i > 1 || j == 1, validUp = i > 1;
+			int scores[3] = {
+				validDiag ? prev[j-1] + s[j]
+					: INT_MIN, // match or mismatch
+				validUp ? prev[j] + gapScore(
+						from(trace, N_b, i-1, j) == FROM_UP)
+					: INT_MIN, // deletion in sequence A
+				cur[j-1] + gapScore(j > 1
+						&& from(trace, N_b, i, j-1) == FROM_LEFT)
+					// deletion in sequence B
 			};
-			double* pMax = max_element(scores, scores + 3);
-			H[i][j] = *pMax;
-			switch (pMax - scores) {
-			  case 0: // match or mismatch
-				I_i[i][j] = i-1;
-				I_j[i][j] = j-1;
-				break;
-			  case 1: // deletion in sequence A
-				I_i[i][j] = i-1;
-				I_j[i][j] = j;
-				break;
-			  case 2: // deletion in sequence B
-				I_i[i][j] = i;
-				I_j[i][j] = j-1;
-				break;
-			}
-			V[i][j] = H[i][j] == -DBL_MAX ? false : true;
+			int* pMax = max_element(scores, scores + 3);
+			cur[j] = *pMax;
+			from(trace, N_b, i, j) = pMax - scores;
 		}
 	}
+	const int* lastRow = H[N_a & 1];
 
 	// search H for the maximal score
 	unsigned num_of_match = 0;
-	double H_max = 0.;
+	int H_max = 0;
 	int i_max=N_a, j_max;
 	int* j_max_indexes=new int[N_b]; //this array holds the index of j_max in H[N_a]
 	for (j=0; j<N_b; j++)
 		j_max_indexes[j]=j+1;
 
 	//sort H[N_a], store the sorted index in j_max_indexes
-	sort(j_max_indexes, j_max_indexes+N_b, index_cmp<double*>(H[N_a]));
+	sort(j_max_indexes, j_max_indexes+N_b, index_cmp<const int*>(lastRow));
 
 	//find ALL overlap alignments, starting from the highest score j_max
 	j = 0;
 	bool found = false;
 	while (j < N_b) {
 		j_max = j_max_indexes[j];
-		H_max = H[N_a][j_max];
+		H_max = lastRow[j_max];
 		if (H_max == 0)
 			break;
 
 		SMAlignment align;
 		unsigned align_pos[4];
-		num_of_match = Backtrack(i_max, j_max, I_i, I_j, seq_a, seq_b, align, align_pos);
+		num_of_match = Backtrack(i_max, j_max, trace, seq_a, seq_b, align, align_pos);
 		if (num_of_match) {
 			overlaps.push_back(overlap_align(seq_a_start_pos+align_pos[0], align_pos[3], align.match_align, num_of_match));
 			if (!found) {
@@ -272,21 +283,12 @@ void alignOverlap(const string& seq_a, const string& seq_b, unsigned seq_a_start
 				found = true;
 				if (!multi_align
 						|| (j+1 < N_b
-							&& H[N_a][j_max_indexes[j+1]] < H_max))
+							&& lastRow[j_max_indexes[j+1]] < H_max))
 					break;
 			}
 		}
 		j++;
 	}
 	delete [] j_max_indexes;
-	for(i=0;i<=N_a;i++){
-		delete [] H[i];
-		delete [] I_i[i];
-		delete [] I_j[i];
-		delete [] V[i];
-	}
-	delete [] H;
-	delete [] I_i;
-	delete [] I_j;
-	delete [] V;
+	ws.trim(ALIGN_WORKSPACE_MAX_BYTES);
 }
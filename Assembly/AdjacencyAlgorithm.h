@@ -9,6 +9,7 @@ template <typename Graph>
 size_t generateAdjacency(Graph* seqCollection)
 {
 	typedef typename graph_traits<Graph>::vertex_descriptor V;
+	typedef typename Graph::value_type value_type;
 	typedef typename Graph::Symbol Symbol;
 	typedef typename Graph::SymbolSet SymbolSet;
 
@@ -16,25 +17,34 @@ size_t generateAdjacency(Graph* seqCollection)
 
 	size_t count = 0;
 	size_t numBasesSet = 0;
-	for (typename Graph::iterator iter = seqCollection->begin();
-			iter != seqCollection->end(); ++iter) {
-		if (iter->second.deleted())
-			continue;
-
-		if (++count % 1000000 == 0)
-			logger(1) << "Finding adjacent k-mer: " << count << '\n';
-
-		for (extDirection dir = SENSE; dir <= ANTISENSE; ++dir) {
-			V testSeq(iter->first);
-			Symbol adjBase = testSeq.shift(dir);
-			for (unsigned i = 0; i < SymbolSet::NUM; ++i) {
-				testSeq.setLastBase(dir, Symbol(i));
-				if (seqCollection->setBaseExtension(
-							testSeq, !dir, adjBase))
-					numBasesSet++;
+	typename Graph::iterator it = seqCollection->begin();
+	const typename Graph::iterator last = seqCollection->end();
+#pragma omp parallel num_threads(opt::threads) reduction(+: numBasesSet)
+	for (std::vector<value_type*> chunk; nextChunk(it, last, chunk);) {
+		for (typename std::vector<value_type*>::const_iterator
+				iter = chunk.begin(); iter != chunk.end(); ++iter) {
+			if ((*iter)->second.deleted())
+				continue;
+
+			size_t n;
+#pragma omp atomic capture
+			n = ++count;
+			if (n % 1000000 == 0)
+#pragma omp critical(logger)
+				logger(1) << "Finding adjacent k-mer: " << n << '\n';
+
+			for (extDirection dir = SENSE; dir <= ANTISENSE; ++dir) {
+				V testSeq((*iter)->first);
+				Symbol adjBase = testSeq.shift(dir);
+				for (unsigned i = 0; i < SymbolSet::NUM; ++i) {
+					testSeq.setLastBase(dir, Symbol(i));
+					if (seqCollection->setBaseExtension(
+								testSeq, !dir, adjBase))
+						numBasesSet++;
+				}
 			}
+			seqCollection->pumpNetwork();
 		}
-		seqCollection->pumpNetwork();
 	}
 
 	if (numBasesSet > 0) {
@@ -44,9 +44,26 @@ initiateBranchGroup(BranchGroup& group,
 		const SequenceCollectionHash::SymbolSet& extension);
 
 template <typename Graph>
-void removeSequenceAndExtensions(Graph* seqCollection,
+bool removeSequenceAndExtensions(Graph* seqCollection,
 		const typename Graph::value_type& seq);
 
+/** Fetch the next chunk of vertices of the shared iterator it.
+ * The threads of a parallel region visit the vertices of the graph
+ * one chunk at a time. The vertices do not move while a chunk is
+ * processed, because no vertices are added to the graph.
+ * @return false when there are no more vertices
+ */
+template <typename It, typename T>
+bool nextChunk(It& it, const It& last, std::vector<T*>& chunk)
+{
+	static const unsigned CHUNK_SIZE = 4096;
+	chunk.clear();
+#pragma omp critical(nextChunk)
+	for (; it != last && chunk.size() < CHUNK_SIZE; ++it)
+		chunk.push_back(&*it);
+	return !chunk.empty();
+}
+
 /** Return the kmer which are adjacent to this kmer. */
 template <typename V, typename SymbolSet>
 void generateSequencesFromExtension(
@@ -115,17 +132,24 @@ template <typename Graph>
 size_t removeMarked(Graph* pSC)
 {
 	typedef typename Graph::iterator iterator;
+	typedef typename Graph::value_type value_type;
 
 	Timer timer(__func__);
 	size_t count = 0;
-	for (iterator it = pSC->begin(); it != pSC->end(); ++it) {
-		if (it->second.deleted())
-			continue;
-		if (it->second.marked()) {
-			removeSequenceAndExtensions(pSC, *it);
-			count++;
+	iterator it = pSC->begin();
+	const iterator last = pSC->end();
+#pragma omp parallel num_threads(opt::threads) reduction(+: count)
+	for (std::vector<value_type*> chunk; nextChunk(it, last, chunk);) {
+		for (typename std::vector<value_type*>::const_iterator
+				p = chunk.begin(); p != chunk.end(); ++p) {
+			const value_type& seq = **p;
+			if (seq.second.deleted())
+				continue;
+			if (seq.second.marked()
+					&& removeSequenceAndExtensions(pSC, seq))
+				count++;
+			pSC->pumpNetwork();
 		}
-		pSC->pumpNetwork();
 	}
 	if (count > 0)
 		logger(1) << "Removed " << count << " marked k-mer.\n";
@@ -39,10 +39,12 @@ class SequenceCollectionHash
 		typedef mapped_type vertex_bundled;
 		typedef std::pair<key_type, key_type> edge_descriptor;
 
-		/** Remove the specified sequence if it exists. */
-		void remove(const key_type& seq)
+		/** Remove the specified sequence if it exists.
+		 * @return false if it was already removed
+		 */
+		bool remove(const key_type& seq)
 		{
-			setFlag(seq, SF_DELETE);
+			return setFlag(seq, SF_DELETE);
 		}
 
 		/** Shrink the hash table. */
@@ -98,7 +100,10 @@ class SequenceCollectionHash
 SequenceCollectionHash()
 	: m_seqObserver(NULL), m_adjacencyLoaded(false)
 {
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
+#if USE_OPEN_HASH_MAP
+	// The open-addressing table grows as k-mers are added. Its
+	// entries are stored inline, so it is not allocated in advance.
+#elif HAVE_GOOGLE_SPARSE_HASH_MAP
 	// sparse_hash_set uses 2.67 bits per element on a 64-bit
 	// architecture and 2 bits per element on a 32-bit architecture.
 	// The number of elements is rounded up to a power of two.
@@ -125,7 +130,7 @@ SequenceCollectionHash()
  */
 void setDeletedKey()
 {
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
+#if !USE_OPEN_HASH_MAP && HAVE_GOOGLE_SPARSE_HASH_MAP
 	for (SequenceDataHash::iterator it = m_data.begin();
 			it != m_data.end(); it++) {
 		key_type rc(reverseComplement(it->first));
@@ -158,6 +163,12 @@ void add(const key_type& seq, unsigned coverage = 1)
 	}
 }
 
+/** Add the specified k-mer and its data to this collection. */
+void insert(const value_type& x)
+{
+	m_data.insert(x);
+}
+
 /** Clean up by erasing sequences flagged as deleted.
  * @return the number of sequences erased
  */
@@ -167,7 +178,12 @@ size_t cleanup()
 	size_t count = 0;
 	for (iterator it = m_data.begin(); it != m_data.end();) {
 		if (it->second.deleted()) {
+#if USE_OPEN_HASH_MAP
+			// Erasing may shift a later k-mer into this slot.
+			it = m_data.erase(it);
+#else
 			m_data.erase(it++);
+#endif
 			count++;
 		} else
 			++it;
@@ -223,12 +239,15 @@ void removeExtension(const key_type& seq, extDirection dir, Symbol base)
 	removeExtension(seq, dir, SymbolSet(base));
 }
 
-void setFlag(const key_type& key, SeqFlag flag)
+/** Set the specified flag of this k-mer.
+ * @return false if the flag was already set
+ */
+bool setFlag(const key_type& key, SeqFlag flag)
 {
 	bool rc;
 	iterator it = find(key, rc);
 	assert(it != m_data.end());
-	it->second.setFlag(rc ? complement(flag) : flag);
+	return it->second.setFlag(rc ? complement(flag) : flag);
 }
 
 /** Mark the specified sequence in both directions. */
@@ -346,7 +365,7 @@ bool getSeqData(const key_type& key,
 void store(const char* path)
 {
 	assert(path != NULL);
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
+#if USE_OPEN_HASH_MAP || HAVE_GOOGLE_SPARSE_HASH_MAP
 	std::ostringstream s;
 	s << path;
 	if (opt::rank >= 0)
@@ -371,7 +390,7 @@ void store(const char* path)
 /** Load this collection from disk. */
 void load(const char* path)
 {
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
+#if USE_OPEN_HASH_MAP || HAVE_GOOGLE_SPARSE_HASH_MAP
 	FILE* f = fopen(path, "r");
 	if (f == NULL) {
 		perror(path);
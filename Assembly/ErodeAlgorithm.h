@@ -13,15 +13,18 @@ void removeExtensionsToSequence(Graph* seqCollection,
 /**
  * Remove a k-mer and update the extension records of the k-mer that
  * extend to it.
+ * @return false if the k-mer had already been removed, possibly by
+ * another thread
  */
 template <typename Graph>
-void removeSequenceAndExtensions(Graph* seqCollection,
+bool removeSequenceAndExtensions(Graph* seqCollection,
 		const typename Graph::value_type& seq)
 {
 	// This removes the reverse complement as well
-	seqCollection->remove(seq.first);
+	bool removed = seqCollection->remove(seq.first);
 	removeExtensionsToSequence(seqCollection, seq, SENSE);
 	removeExtensionsToSequence(seqCollection, seq, ANTISENSE);
+	return removed;
 }
 
 /** Remove all the extensions to this sequence. */
@@ -64,18 +67,20 @@ size_t erode(Graph* c, const typename Graph::value_type& seq)
 {
 	typedef typename vertex_bundle_type<Graph>::type VP;
 
-	if (seq.second.deleted())
-		return 0;
-	extDirection dir;
-	SeqContiguity contiguity = checkSeqContiguity(seq, dir);
-	if (contiguity == SC_CONTIGUOUS)
+	// Copy the vertex properties, which may be modified concurrently
+	// by another thread.
+	const VP data = seq.second;
+	if (data.deleted())
 		return 0;
+	if (data.hasExtension(SENSE) && data.hasExtension(ANTISENSE))
+		return 0; // contiguous
 
-	const VP& data = seq.second;
 	if (data.getMultiplicity() < opt::erode
 			|| data.getMultiplicity(SENSE) < opt::erodeStrand
 			|| data.getMultiplicity(ANTISENSE) < opt::erodeStrand) {
-		removeSequenceAndExtensions(c, seq);
+		if (!removeSequenceAndExtensions(c, seq))
+			return 0;
+#pragma omp atomic
 		g_numEroded++;
 		return 1;
 	} else
@@ -97,15 +102,21 @@ template <typename Graph>
 size_t erodeEnds(Graph* seqCollection)
 {
 	typedef typename Graph::iterator iterator;
+	typedef typename Graph::value_type value_type;
 
 	Timer erodeEndsTimer("Erode");
 	assert(g_numEroded == 0);
 	seqCollection->attach(erosionObserver);
 
-	for (iterator iter = seqCollection->begin();
-			iter != seqCollection->end(); ++iter) {
-		erode(seqCollection, *iter);
-		seqCollection->pumpNetwork();
+	iterator it = seqCollection->begin();
+	const iterator last = seqCollection->end();
+#pragma omp parallel num_threads(opt::threads)
+	for (std::vector<value_type*> chunk; nextChunk(it, last, chunk);) {
+		for (typename std::vector<value_type*>::const_iterator
+				p = chunk.begin(); p != chunk.end(); ++p) {
+			erode(seqCollection, **p);
+			seqCollection->pumpNetwork();
+		}
 	}
 
 	seqCollection->detach(erosionObserver);
@@ -1,7 +1,11 @@
 #ifndef ASSEMBLY_LOADALGORITHM_H
 #define ASSEMBLY_LOADALGORITHM_H 1
 
+#include "Common/KmerIterator.h"
 #include "DataLayer/FastaReader.h"
+#if _OPENMP
+# include <omp.h>
+#endif
 
 namespace AssemblyAlgorithms {
 
@@ -34,11 +38,14 @@ size_t loadKmer(Graph& g, FastaReader& in)
 	return count;
 }
 
-template <typename Graph>
-bool loadSequence(Graph* seqCollection, Sequence& seq)
+/** Extract the k-mer of the specified sequence.
+ * @param[out] kmers the k-mer and their coverage
+ * @return true if the sequence contains no usable k-mer
+ */
+template <typename V>
+bool extractKmer(const Sequence& seq,
+		std::vector<std::pair<V, unsigned> >& kmers)
 {
-	typedef typename graph_traits<Graph>::vertex_descriptor V;
-
 	size_t len = seq.length();
 
 	if (isalnum(seq[0])) {
@@ -56,11 +63,11 @@ bool loadSequence(Graph* seqCollection, Sequence& seq)
 		if (good || kmer.find_first_not_of("acgtACGT0123")
 				== std::string::npos) {
 			if (good || kmer.find_first_of("acgt") == std::string::npos)
-				seqCollection->add(V(kmer));
+				kmers.push_back(std::make_pair(V(kmer), 1u));
 			else {
 				transform(kmer.begin(), kmer.end(), kmer.begin(),
 						::toupper);
-				seqCollection->add(V(kmer), 0);
+				kmers.push_back(std::make_pair(V(kmer), 0u));
 			}
 			discarded = false;
 		}
@@ -69,9 +76,191 @@ bool loadSequence(Graph* seqCollection, Sequence& seq)
 	return discarded;
 }
 
-/** Load sequence data into the collection. */
+/** Extract the k-mer of the specified sequence, rolling each k-mer
+ * from the previous one. A k-mer that contains a masked
+ * (lower-case) base is given a coverage of zero.
+ * @param[out] kmers the k-mer and their coverage
+ * @return true if the sequence contains no usable k-mer
+ */
+static inline bool extractKmer(const Sequence& seq,
+		std::vector<std::pair<Kmer, unsigned> >& kmers)
+{
+	if (isalnum(seq[0])) {
+		if (opt::colourSpace)
+			assert(isdigit(seq[0]));
+		else
+			assert(isalpha(seq[0]));
+	}
+
+	bool discarded = true;
+	for (KmerIterator it(seq, Kmer::length());
+			it != KmerIterator::end(); ++it) {
+		kmers.push_back(std::make_pair(*it, it.masked() ? 0u : 1u));
+		discarded = false;
+	}
+	return discarded;
+}
+
 template <typename Graph>
-void loadSequences(Graph* seqCollection, std::string inFile)
+bool loadSequence(Graph* seqCollection, Sequence& seq)
+{
+	typedef typename graph_traits<Graph>::vertex_descriptor V;
+	typedef std::vector<std::pair<V, unsigned> > Kmers;
+
+	Kmers kmers;
+	bool discarded = extractKmer(seq, kmers);
+	for (typename Kmers::const_iterator it = kmers.begin();
+			it != kmers.end(); ++it)
+		seqCollection->add(it->first, it->second);
+	return discarded;
+}
+
+/** Read a batch of reads that are long enough to contain a k-mer.
+ * @param[in,out] detectColourSpace whether to detect colour-space
+ * reads from the first read
+ */
+template <typename Graph>
+void readBatch(Graph* seqCollection, FastaReader& reader,
+		std::vector<FastaRecord>& batch, size_t& count_small,
+		bool& detectColourSpace)
+{
+	typedef typename graph_traits<Graph>::vertex_descriptor V;
+
+	/** The number of reads read by a thread at a time. */
+	static const unsigned BATCH_SIZE = 1000;
+
+	for (FastaRecord rec; batch.size() < BATCH_SIZE && reader >> rec;) {
+		if (V::length() > rec.seq.length()) {
+			count_small++;
+			continue;
+		}
+		if (detectColourSpace) {
+			// Detect colour-space reads.
+			detectColourSpace = false;
+			bool colourSpace = rec.seq.find_first_of("0123")
+				!= std::string::npos;
+			seqCollection->setColourSpace(colourSpace);
+			if (colourSpace)
+				std::cout << "Colour-space assembly\n";
+		}
+		batch.push_back(rec);
+	}
+}
+
+/** Load reads into the collection using multiple threads.
+ * The reads are parsed and their k-mer are extracted in parallel.
+ * If the file may be split, each thread reads its own part of the
+ * specified section of the file. Otherwise the threads take turns
+ * reading batches of reads from a shared reader.
+ * The k-mer are added to the collection one batch at a time, because
+ * the hash table does not support concurrent insertion.
+ * @return the number of unchaste reads
+ */
+template <typename Graph>
+unsigned loadReadsParallel(Graph* seqCollection,
+		const std::string& inFile, int fastaFlags,
+		unsigned section, unsigned nsections,
+		size_t& count, size_t& count_good, size_t& count_small,
+		size_t& count_nonACGT, size_t& count_reversed)
+{
+	typedef typename graph_traits<Graph>::vertex_descriptor V;
+	typedef std::vector<std::pair<V, unsigned> > Kmers;
+
+	bool splittable = FastaReader::isSplittable(inFile.c_str());
+	FastaReader* shared = splittable ? NULL
+		: new FastaReader(inFile.c_str(), fastaFlags,
+				section, nsections);
+	unsigned unchaste = 0;
+	bool detectColourSpace = opt::rank <= 0 && seqCollection->empty()
+		&& section == 1;
+#pragma omp parallel num_threads(opt::threads)
+	{
+		unsigned nthreads = 1, tid = 0;
+#if _OPENMP
+		nthreads = omp_get_num_threads();
+		tid = omp_get_thread_num();
+#endif
+		FastaReader* reader = !splittable ? shared
+			: new FastaReader(inFile.c_str(), fastaFlags,
+					(section - 1) * nthreads + tid + 1,
+					nsections * nthreads);
+		// The colour space is detected from the first read of the
+		// file, which is read by the first thread.
+		bool noDetect = false;
+		bool& detect = !splittable || tid == 0
+			? detectColourSpace : noDetect;
+
+		for (std::vector<FastaRecord> batch; ;) {
+			batch.clear();
+			size_t small = 0;
+			if (splittable)
+				readBatch(seqCollection, *reader, batch, small,
+						detect);
+			else
+#pragma omp critical(in)
+				readBatch(seqCollection, *reader, batch, small,
+						detect);
+			if (batch.empty() && small == 0)
+				break;
+
+			Kmers kmers;
+			size_t good = 0, nonACGT = 0, reversed = 0;
+			for (std::vector<FastaRecord>::iterator it
+					= batch.begin(); it != batch.end(); ++it) {
+				Sequence& seq = it->seq;
+				if (opt::ss && it->id.size() > 2
+						&& it->id.substr(it->id.size()-2) == "/1") {
+					seq = reverseComplement(seq);
+					reversed++;
+				}
+				if (extractKmer(seq, kmers))
+					nonACGT++;
+				else
+					good++;
+			}
+
+#pragma omp critical(graph)
+			{
+				for (typename Kmers::const_iterator it = kmers.begin();
+						it != kmers.end(); ++it)
+					seqCollection->add(it->first, it->second);
+				count_good += good;
+				count_small += small;
+				count_nonACGT += nonACGT;
+				count_reversed += reversed;
+				size_t n = count + batch.size();
+				if (n / 100000 > count / 100000) {
+					logger(1) << "Read " << n << " reads. ";
+					seqCollection->printLoad();
+				}
+				count = n;
+				// Messages may add k-mer, so receive them here.
+				seqCollection->pumpNetwork();
+			}
+		}
+
+		if (splittable) {
+			assert(reader->eof());
+#pragma omp atomic
+			unchaste += reader->unchaste();
+			delete reader;
+		}
+	}
+
+	if (shared != NULL) {
+		assert(shared->eof());
+		unchaste = shared->unchaste();
+		delete shared;
+	}
+	return unchaste;
+}
+
+/** Load the specified section of the sequence data into the
+ * collection. The file is divided into nsections sections.
+ */
+template <typename Graph>
+void loadSequenceSection(Graph* seqCollection, std::string inFile,
+		unsigned section, unsigned nsections)
 {
 	typedef typename graph_traits<Graph>::vertex_descriptor V;
 
@@ -80,6 +269,7 @@ void loadSequences(Graph* seqCollection, std::string inFile)
 	logger(0) << "Reading `" << inFile << "'...\n";
 
 	if (inFile.find(".kmer") != std::string::npos) {
+		assert(nsections == 1);
 		if (opt::rank <= 0)
 			seqCollection->setColourSpace(false);
 		seqCollection->load(inFile.c_str());
@@ -91,50 +281,60 @@ void loadSequences(Graph* seqCollection, std::string inFile)
 			 count_reversed = 0;
 	int fastaFlags = opt::maskCov ?  FastaReader::NO_FOLD_CASE :
 			FastaReader::FOLD_CASE;
-	FastaReader reader(inFile.c_str(), fastaFlags);
-	if (endsWith(inFile, ".jf") || endsWith(inFile, ".jfq")) {
-		// Load k-mer with coverage data.
-		count = loadKmer(*seqCollection, reader);
-		count_good = count;
-	} else
-	for (FastaRecord rec; reader >> rec;) {
-		Sequence seq = rec.seq;
-		size_t len = seq.length();
-		if (V::length() > len) {
-			count_small++;
-			continue;
-		}
+	unsigned unchaste = 0;
+	if (opt::threads > 1
+			&& !endsWith(inFile, ".jf") && !endsWith(inFile, ".jfq")) {
+		unchaste = loadReadsParallel(seqCollection, inFile, fastaFlags,
+				section, nsections, count, count_good,
+				count_small, count_nonACGT, count_reversed);
+	} else {
+		FastaReader reader(inFile.c_str(), fastaFlags,
+				section, nsections);
+		if (endsWith(inFile, ".jf") || endsWith(inFile, ".jfq")) {
+			// Load k-mer with coverage data.
+			count = loadKmer(*seqCollection, reader);
+			count_good = count;
+		} else
+		for (FastaRecord rec; reader >> rec;) {
+			Sequence seq = rec.seq;
+			size_t len = seq.length();
+			if (V::length() > len) {
+				count_small++;
+				continue;
+			}
 
-		if (opt::rank <= 0
-				&& count == 0 && seqCollection->empty()) {
-			// Detect colour-space reads.
-			bool colourSpace
-				= seq.find_first_of("0123") != std::string::npos;
-			seqCollection->setColourSpace(colourSpace);
-			if (colourSpace)
-				std::cout << "Colour-space assembly\n";
-		}
+			if (opt::rank <= 0 && section == 1
+					&& count == 0 && seqCollection->empty()) {
+				// Detect colour-space reads.
+				bool colourSpace
+					= seq.find_first_of("0123") != std::string::npos;
+				seqCollection->setColourSpace(colourSpace);
+				if (colourSpace)
+					std::cout << "Colour-space assembly\n";
+			}
 
-		if (opt::ss && rec.id.size() > 2
-				&& rec.id.substr(rec.id.size()-2) == "/1") {
-			seq = reverseComplement(seq);
-			count_reversed++;
-		}
+			if (opt::ss && rec.id.size() > 2
+					&& rec.id.substr(rec.id.size()-2) == "/1") {
+				seq = reverseComplement(seq);
+				count_reversed++;
+			}
 
-		bool discarded = loadSequence(seqCollection, seq);
+			bool discarded = loadSequence(seqCollection, seq);
 
-		if (discarded)
-			count_nonACGT++;
-		else
-			count_good++;
+			if (discarded)
+				count_nonACGT++;
+			else
+				count_good++;
 
-		if (++count % 100000 == 0) {
-			logger(1) << "Read " << count << " reads. ";
-			seqCollection->printLoad();
+			if (++count % 100000 == 0) {
+				logger(1) << "Read " << count << " reads. ";
+				seqCollection->printLoad();
+			}
+			seqCollection->pumpNetwork();
 		}
-		seqCollection->pumpNetwork();
+		assert(reader.eof());
+		unchaste = reader.unchaste();
 	}
-	assert(reader.eof());
 
 	logger(1) << "Read " << count << " reads. ";
 	seqCollection->printLoad();
@@ -146,15 +346,15 @@ void loadSequences(Graph* seqCollection, std::string inFile)
 		std::cerr << "`" << inFile << "': "
 			"discarded " << count_small << " reads "
 			"shorter than " << V::length() << " bases\n";
-	if (reader.unchaste() > 0)
+	if (unchaste > 0)
 		std::cerr << "`" << inFile << "': "
-			"discarded " << reader.unchaste() << " unchaste reads\n";
+			"discarded " << unchaste << " unchaste reads\n";
 	if (count_nonACGT > 0)
 		std::cerr << "`" << inFile << "': "
 			"discarded " << count_nonACGT << " reads "
 			"containing non-ACGT characters\n";
 			tempCounter[0] += count_reversed;
-			tempCounter[1] += (count_small + reader.unchaste() + count_nonACGT);
+			tempCounter[1] += (count_small + unchaste + count_nonACGT);
 	if (count_good == 0)
 		std::cerr << "warning: `" << inFile << "': "
 			"contains no usable sequence\n";
@@ -177,6 +377,13 @@ void loadSequences(Graph* seqCollection, std::string inFile)
 	tempCounter.assign(2,0);
 }
 
+/** Load sequence data into the collection. */
+template <typename Graph>
+void loadSequences(Graph* seqCollection, std::string inFile)
+{
+	loadSequenceSection(seqCollection, inFile, 1, 1);
+}
+
 } // namespace AssemblyAlgorithms
 
 #endif
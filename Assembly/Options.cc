@@ -2,6 +2,7 @@
 
 #include "config.h"
 #include "Common/Options.h"
+#include "Common/StringUtil.h"
 #include "DataLayer/Options.h"
 #include <algorithm>
 #include <cassert>
@@ -65,6 +66,7 @@ static const char USAGE_MESSAGE[] =
 "  -m, --mask-cov        do not include kmers containing masked bases in\n"
 "                        coverage calculations [experimental]\n"
 "  -s, --snp=FILE        record popped bubbles in FILE\n"
+"  -j, --threads=N       use N parallel threads [1]\n"
 "  -v, --verbose         display verbose output\n"
 "      --help            display this help and exit\n"
 "      --version         output version information and exit\n"
@@ -77,6 +79,17 @@ static const char USAGE_MESSAGE[] =
 "\n"
 "  -g, --graph=FILE      generate a graph in dot format\n"
 "\n"
+" ABYSS-P Options: (won't work with ABYSS)\n"
+"\n"
+"      --snapshot=PHASES write a snapshot of the assembly after each\n"
+"                        of the comma-separated PHASES, which are\n"
+"                        load, adjacency and trim\n"
+"      --snapshot-prefix=PREFIX  write the snapshots to files named\n"
+"                        PREFIX*.snapshot [the output FILE less .fa]\n"
+"      --resume          resume the assembly from the latest complete\n"
+"                        snapshot, which may have been written by a\n"
+"                        different number of processes\n"
+"\n"
 "Report bugs to <" PACKAGE_BUGREPORT ">.\n";
 
 /** The length of a single k-mer.
@@ -142,12 +155,25 @@ vector<string> inFiles;
 string db;
 vector<string> metaVars;
 
+/** Number of threads. */
+unsigned threads = 1;
+
+/** The phases after which to write a snapshot. */
+vector<string> snapshotPhases;
+
+/** The prefix of the snapshot files. */
+string snapshotPrefix;
+
+/** Resume from the latest snapshot. */
+int resume;
+
 /** commandline specific to assembly */
 string assemblyCmd;
 
-static const char shortopts[] = "b:c:e:E:g:k:K:mo:Q:q:s:t:v";
+static const char shortopts[] = "b:c:e:E:g:j:k:K:mo:Q:q:s:t:v";
 
-enum { OPT_HELP = 1, OPT_VERSION, COVERAGE_HIST, OPT_DB, OPT_LIBRARY, OPT_STRAIN, OPT_SPECIES };
+enum { OPT_HELP = 1, OPT_VERSION, COVERAGE_HIST, OPT_DB, OPT_LIBRARY, OPT_STRAIN, OPT_SPECIES,
+	OPT_SNAPSHOT, OPT_SNAPSHOT_PREFIX };
 
 static const struct option longopts[] = {
 	{ "out",         required_argument, NULL, 'o' },
@@ -172,6 +198,7 @@ static const struct option longopts[] = {
 	{ "no-erode",    no_argument,       (int*)&erode, 0 },
 	{ "mask-cov",    no_argument, NULL, 'm' },
 	{ "graph",       required_argument, NULL, 'g' },
+	{ "threads",     required_argument, NULL, 'j' },
 	{ "snp",         required_argument, NULL, 's' },
 	{ "verbose",     no_argument,       NULL, 'v' },
 	{ "help",        no_argument,       NULL, OPT_HELP },
@@ -180,6 +207,9 @@ static const struct option longopts[] = {
 	{ "library",     required_argument, NULL, OPT_LIBRARY },
 	{ "strain",      required_argument, NULL, OPT_STRAIN },
 	{ "species",     required_argument, NULL, OPT_SPECIES },
+	{ "snapshot",    required_argument, NULL, OPT_SNAPSHOT },
+	{ "snapshot-prefix", required_argument, NULL, OPT_SNAPSHOT_PREFIX },
+	{ "resume",      no_argument,       &opt::resume, 1 },
 	{ NULL, 0, NULL, 0 }
 };
 
@@ -272,6 +302,9 @@ void parse(int argc, char* const* argv)
 			case 'g':
 				getline(arg, graphPath);
 				break;
+			case 'j':
+				arg >> threads;
+				break;
 			case 'q':
 				arg >> opt::qualityThreshold;
 				break;
@@ -302,6 +335,20 @@ void parse(int argc, char* const* argv)
 			case OPT_SPECIES:
 				arg >> opt::metaVars[2];
 				break;
+			case OPT_SNAPSHOT:
+				for (string phase; getline(arg, phase, ',');) {
+					if (phase != "load" && phase != "adjacency"
+							&& phase != "trim") {
+						cerr << PROGRAM ": invalid snapshot phase: `"
+							<< phase << "'\n";
+						die = true;
+					}
+					snapshotPhases.push_back(phase);
+				}
+				break;
+			case OPT_SNAPSHOT_PREFIX:
+				getline(arg, snapshotPrefix);
+				break;
 		}
 		if (optarg != NULL && !arg.eof()) {
 			cerr << PROGRAM ": invalid option: `-"
@@ -322,7 +369,13 @@ void parse(int argc, char* const* argv)
 		cerr << PROGRAM ": missing -o,--out option\n";
 		die = true;
 	}
-	if (argv[optind] == NULL) {
+	if (rank < 0 && (resume || !snapshotPhases.empty()
+				|| !snapshotPrefix.empty())) {
+		cerr << PROGRAM ": the --snapshot, --snapshot-prefix and "
+			"--resume options are supported only by ABYSS-P\n";
+		die = true;
+	}
+	if (argv[optind] == NULL && !resume) {
 		cerr << PROGRAM ": missing input sequence file argument\n";
 		die = true;
 	}
@@ -340,6 +393,9 @@ void parse(int argc, char* const* argv)
 			"but -e,--erode was not specified\n"
 			"Previously, the default was -e2 (or --erode=2)." << endl;
 
+	if (threads == 0)
+		threads = 1;
+
 	if (trimLen < 0)
 		trimLen = kmerSize;
 	if (bubbleLen < 0)
@@ -351,6 +407,12 @@ void parse(int argc, char* const* argv)
 	inFiles.resize(argc - optind);
 	copy(&argv[optind], &argv[argc], inFiles.begin());
 
+	if (snapshotPrefix.empty()) {
+		snapshotPrefix = contigsPath;
+		if (endsWith(snapshotPrefix, ".fa"))
+			snapshotPrefix.erase(snapshotPrefix.size() - 3);
+	}
+
 	if (rank >= 0) {
 		ostringstream s;
 		s << "contigs-" << opt::rank << ".fa";
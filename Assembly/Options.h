@@ -16,6 +16,7 @@ namespace opt {
 	extern float coverage;
 	extern unsigned bubbleLen;
 	extern unsigned ss;
+	extern unsigned threads;
 	extern bool maskCov;
 	extern std::string coverageHistPath;
 	extern std::string contigsPath;
@@ -23,6 +24,9 @@ namespace opt {
 	extern std::string graphPath;
 	extern std::string snpPath;
 	extern std::vector<std::string> inFiles;
+	extern std::vector<std::string> snapshotPhases;
+	extern std::string snapshotPrefix;
+	extern int resume;
 
 	extern std::string db;
 
@@ -54,6 +54,16 @@ class SeqExt
 			m_record |= 1 << base;
 		}
 
+		/** Set the specified adjacency atomically. */
+		void setBaseAtomic(uint8_t base)
+		{
+			uint8_t x = 1 << base;
+#if _OPENMP
+#pragma omp atomic
+#endif
+			m_record |= x;
+		}
+
 		/** Clear the specified adjacency. */
 		void clearBase(uint8_t base)
 		{
@@ -66,6 +76,16 @@ class SeqExt
 			m_record &= ~ext.m_record;
 		}
 
+		/** Remove the specified edges atomically. */
+		void clearAtomic(SeqExt ext)
+		{
+			uint8_t x = ~ext.m_record;
+#if _OPENMP
+#pragma omp atomic
+#endif
+			m_record &= x;
+		}
+
 		/** Return wheter the specified base is adjacent. */
 		bool checkBase(uint8_t base) const
 		{
@@ -9,7 +9,11 @@
 typedef VertexData<uint8_t, SeqExt> KmerData;
 typedef KmerData::SymbolSetPair ExtensionRecord;
 
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
+#if USE_OPEN_HASH_MAP
+# include "Common/OpenHashMap.h"
+typedef OpenHashMap<Kmer, KmerData, hash<Kmer> >
+	SequenceDataHash;
+#elif HAVE_GOOGLE_SPARSE_HASH_MAP
 # include <google/sparse_hash_map>
 typedef google::sparse_hash_map<Kmer, KmerData, hash<Kmer> >
 	SequenceDataHash;
@@ -47,47 +47,55 @@ size_t trimSequences(SequenceCollectionHash* seqCollection,
 		<< maxBranchCull << " bp...\n";
 	size_t numBranchesRemoved = 0;
 
-	for (Graph::iterator iter = seqCollection->begin();
-			iter != seqCollection->end(); ++iter) {
-		if (iter->second.deleted())
-			continue;
-
-		extDirection dir;
-		// dir will be set to the trimming direction if the sequence
-		// can be trimmed.
-		SeqContiguity status = checkSeqContiguity(*iter, dir);
-
-		if (status == SC_CONTIGUOUS)
-			continue;
-		else if(status == SC_ISLAND)
-		{
-			// remove this sequence, it has no extensions
-			seqCollection->mark(iter->first);
-			numBranchesRemoved++;
-			continue;
+	Graph::iterator it = seqCollection->begin();
+	const Graph::iterator last = seqCollection->end();
+#pragma omp parallel num_threads(opt::threads) \
+	reduction(+: numBranchesRemoved)
+	for (std::vector<Graph::value_type*> chunk;
+			nextChunk(it, last, chunk);) {
+		for (std::vector<Graph::value_type*>::const_iterator
+				p = chunk.begin(); p != chunk.end(); ++p) {
+			const Graph::value_type& seq = **p;
+			if (seq.second.deleted())
+				continue;
+
+			extDirection dir;
+			// dir will be set to the trimming direction if the sequence
+			// can be trimmed.
+			SeqContiguity status = checkSeqContiguity(seq, dir);
+
+			if (status == SC_CONTIGUOUS)
+				continue;
+			else if(status == SC_ISLAND)
+			{
+				// remove this sequence, it has no extensions
+				seqCollection->mark(seq.first);
+				numBranchesRemoved++;
+				continue;
+			}
+
+			BranchRecord currBranch(dir);
+			V currSeq = seq.first;
+			while(currBranch.isActive())
+			{
+				SymbolSetPair extRec;
+				int multiplicity = -1;
+				bool success = seqCollection->getSeqData(
+						currSeq, extRec, multiplicity);
+				assert(success);
+				(void)success;
+				processLinearExtensionForBranch(currBranch,
+						currSeq, extRec, multiplicity, maxBranchCull);
+			}
+
+			// The branch has ended check it for removal, returns true if
+			// it was removed.
+			if(processTerminatedBranchTrim(seqCollection, currBranch))
+			{
+				numBranchesRemoved++;
+			}
+			seqCollection->pumpNetwork();
 		}
-
-		BranchRecord currBranch(dir);
-		V currSeq = iter->first;
-		while(currBranch.isActive())
-		{
-			SymbolSetPair extRec;
-			int multiplicity = -1;
-			bool success = seqCollection->getSeqData(
-					currSeq, extRec, multiplicity);
-			assert(success);
-			(void)success;
-			processLinearExtensionForBranch(currBranch,
-					currSeq, extRec, multiplicity, maxBranchCull);
-		}
-
-		// The branch has ended check it for removal, returns true if
-		// it was removed.
-		if(processTerminatedBranchTrim(seqCollection, currBranch))
-		{
-			numBranchesRemoved++;
-		}
-		seqCollection->pumpNetwork();
 	}
 
 	size_t numSweeped = removeMarked(seqCollection);
@@ -188,6 +196,7 @@ bool processTerminatedBranchTrim(Graph* seqCollection, BranchRecord& branch)
 	assert(!branch.empty());
 	if (branch.getState() == BS_NOEXT
 			|| branch.getState() == BS_AMBI_OPP) {
+#pragma omp critical(logger)
 		logger(5) << "Pruning " << branch.size() << ' '
 			<< branch.front().first << '\n';
 		for (BranchRecord::iterator it = branch.begin();
@@ -98,7 +98,17 @@ class VertexData
 		assert(getMultiplicity() == multiplicity);
 	}
 
-	void setFlag(SeqFlag flag) { m_flags |= flag; }
+	/** Set the specified flag atomically.
+	 * @return false if the flag was already set
+	 */
+	bool setFlag(SeqFlag flag)
+	{
+		uint8_t old;
+#pragma omp atomic capture
+		{ old = m_flags; m_flags |= flag; }
+		return (old & flag) != flag;
+	}
+
 	bool isFlagSet(SeqFlag flag) const { return m_flags & flag; }
 	void clearFlag(SeqFlag flag) { m_flags &= ~flag; }
 
@@ -125,14 +135,17 @@ class VertexData
 		return m_ext.dir[dir];
 	}
 
+	/** Add an edge. The edges are updated atomically, so that
+	 * multiple threads may modify the same vertex. */
 	void setBaseExtension(extDirection dir, Symbol x)
 	{
-		m_ext.dir[dir].setBase(x);
+		m_ext.dir[dir].setBaseAtomic(x);
 	}
 
+	/** Remove the specified edges atomically. */
 	void removeExtension(extDirection dir, SymbolSet ext)
 	{
-		m_ext.dir[dir].clear(ext);
+		m_ext.dir[dir].clearAtomic(ext);
 	}
 
 	bool hasExtension(extDirection dir) const
@@ -0,0 +1,294 @@
+/**
+ * A blocked Bloom filter, whose hash functions for a key all fall
+ * within a single cache line.
+ * See Putze, Sanders and Singler (2007), Cache-, Hash- and
+ * Space-Efficient Bloom Filters.
+ */
+#ifndef BLOCKEDBLOOMFILTER_H
+#define BLOCKEDBLOOMFILTER_H 1
+
+#include "Bloom/Bloom.h"
+#include "Bloom/RollingHash.h"
+#include "Common/Kmer.h"
+#include "Common/IOUtil.h"
+#include "Common/BitUtil.h"
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+
+/** A blocked Bloom filter. */
+class BlockedBloomFilter
+{
+  public:
+	/** The number of bits in a block, which is one cache line. */
+	static const unsigned BLOCK_BITS = 512;
+	static const unsigned BLOCK_WORDS = BLOCK_BITS / 64;
+
+	/** The default number of hash functions. */
+	static const unsigned DEFAULT_NUM_HASHES = 4;
+
+	/** Constructor. */
+	BlockedBloomFilter()
+		: m_size(0), m_numBlocks(0),
+		m_numHashes(DEFAULT_NUM_HASHES), m_array(NULL) { }
+
+	/** Constructor. The size n is rounded up to a whole number of
+	 * blocks. */
+	BlockedBloomFilter(size_t n,
+			unsigned numHashes = DEFAULT_NUM_HASHES)
+		: m_size(0), m_numBlocks(0),
+		m_numHashes(numHashes), m_array(NULL)
+	{
+		assert(numHashes > 0);
+		resize(n);
+	}
+
+	~BlockedBloomFilter()
+	{
+		free(m_array);
+	}
+
+	/** Return the size of the bit array. */
+	size_t size() const { return m_size; }
+
+	/** Return the number of hash functions. */
+	unsigned numHashes() const { return m_numHashes; }
+
+	/** Return the population count, i.e. the number of set bits. */
+	size_t popcount() const
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < m_numBlocks * BLOCK_WORDS; i++)
+			count += ::popcount(m_array[i]);
+		return count;
+	}
+
+	/** Return the estimated false positive rate */
+	double FPR() const
+	{
+		return pow((double)popcount() / size(), (double)m_numHashes);
+	}
+
+	/** Return whether the specified bit is set. */
+	bool operator[](size_t i) const
+	{
+		assert(i < m_size);
+		return m_array[i / 64] & (uint64_t)1 << i % 64;
+	}
+
+	/** Return whether the object is present in this set. */
+	bool operator[](const Bloom::key_type& key) const
+	{
+		return containsHash(hash(key));
+	}
+
+	/** Add the object to this set. */
+	void insert(const Bloom::key_type& key)
+	{
+		insertHash(hash(key));
+	}
+
+	/** Return whether the k-mer with the specified canonical rolling
+	 * hash is present in this set. */
+	bool containsHash(uint64_t h) const
+	{
+		const uint64_t* block = getBlock(h);
+		for (unsigned i = 0; i < m_numHashes; i++) {
+			unsigned bit = getBit(h, i);
+			if (!(block[bit / 64] & (uint64_t)1 << bit % 64))
+				return false;
+		}
+		return true;
+	}
+
+	/** Prefetch the block of the specified hash value. */
+	void prefetchHash(uint64_t h) const
+	{
+#if __GNUC__
+		__builtin_prefetch(getBlock(h));
+#else
+		(void)h;
+#endif
+	}
+
+	/** Add the k-mer with the specified canonical rolling hash to
+	 * this set. This method is thread safe. */
+	void insertHash(uint64_t h)
+	{
+		uint64_t* block = getBlock(h);
+		for (unsigned i = 0; i < m_numHashes; i++) {
+			unsigned bit = getBit(h, i);
+			uint64_t& word = block[bit / 64];
+			uint64_t mask = (uint64_t)1 << bit % 64;
+#if _OPENMP
+# pragma omp atomic
+#endif
+			word |= mask;
+		}
+	}
+
+	/** Return the canonical rolling hash of the specified k-mer. */
+	static uint64_t hash(const Bloom::key_type& key)
+	{
+		std::string s = key.str();
+		return RollingHash::hash(s.data(), s.size());
+	}
+
+	/** Operator for reading a bloom filter from a stream. */
+	friend std::istream& operator>>(std::istream& in,
+			BlockedBloomFilter& o)
+	{
+		o.read(in);
+		return in;
+	}
+
+	/** Operator for writing the bloom filter to a stream. */
+	friend std::ostream& operator<<(std::ostream& out,
+			const BlockedBloomFilter& o)
+	{
+		o.write(out);
+		return out;
+	}
+
+	/** Read a bloom filter from a stream. Unless readOp is
+	 * BITWISE_OVERWRITE, the bloom filter of the stream is combined
+	 * with this one, which must have the same size and number of
+	 * hash functions. */
+	void read(std::istream& in, BitwiseOp readOp = BITWISE_OVERWRITE)
+	{
+		Bloom::FileHeader header = Bloom::readHeader(in,
+				Bloom::BLOCKED_BLOOM_VERSION);
+		assert(in);
+		assert(header.startBitPos == 0);
+		assert(header.endBitPos == header.fullBloomSize - 1);
+		unsigned numHashes;
+		in >> numHashes >> expect("\n");
+		assert(in);
+		assert(numHashes > 0);
+
+		if (readOp == BITWISE_OVERWRITE) {
+			m_numHashes = numHashes;
+			resize(header.fullBloomSize);
+			assert(m_size == header.fullBloomSize);
+		} else if (m_size != header.fullBloomSize
+				|| m_numHashes != numHashes) {
+			std::cerr << "error: can't union/intersect blocked bloom "
+				"filters with different sizes or numbers of hash "
+				"functions\n";
+			exit(EXIT_FAILURE);
+		}
+		readBits(in, reinterpret_cast<char*>(m_array), m_size, 0, readOp);
+		assert(in);
+	}
+
+	/** Write a bloom filter to a stream. */
+	void write(std::ostream& out) const
+	{
+		Bloom::FileHeader header;
+		header.fullBloomSize = m_size;
+		header.startBitPos = 0;
+		header.endBitPos = m_size - 1;
+
+		Bloom::writeHeader(out, header, Bloom::BLOCKED_BLOOM_VERSION);
+		out << m_numHashes << '\n';
+		assert(out);
+
+		out.write(reinterpret_cast<const char*>(m_array), m_size / 8);
+		assert(out);
+	}
+
+	/** Resize the bloom filter (wipes the current data) */
+	void resize(size_t size)
+	{
+		free(m_array);
+		m_array = NULL;
+		m_numBlocks = (size + BLOCK_BITS - 1) / BLOCK_BITS;
+		m_size = m_numBlocks * BLOCK_BITS;
+		if (m_numBlocks == 0)
+			return;
+		void* p;
+		if (posix_memalign(&p, BLOCK_BITS / 8, m_size / 8) != 0) {
+			std::cerr << "error: unable to allocate "
+				<< m_size / 8 << " bytes\n";
+			exit(EXIT_FAILURE);
+		}
+		m_array = static_cast<uint64_t*>(p);
+		memset(m_array, 0, m_size / 8);
+	}
+
+  private:
+	BlockedBloomFilter(const BlockedBloomFilter&);
+	BlockedBloomFilter& operator=(const BlockedBloomFilter&);
+
+	/** Return the block of the specified hash value. */
+	uint64_t* getBlock(uint64_t h) const
+	{
+		assert(m_numBlocks > 0);
+		return m_array
+			+ RollingHash::multiHash(h, 0) % m_numBlocks * BLOCK_WORDS;
+	}
+
+	/** Return the bit within its block of the ith hash function. */
+	static unsigned getBit(uint64_t h, unsigned i)
+	{
+		return RollingHash::multiHash(h, i + 1) >> (64 - 9);
+	}
+
+	size_t m_size;
+	size_t m_numBlocks;
+	unsigned m_numHashes;
+	uint64_t* m_array;
+};
+
+namespace Bloom {
+
+	/** Load the k-mers of a sequence into a blocked bloom filter,
+	 * rolling the hash from one k-mer to the next. */
+	template <>
+	inline void loadSeq<BlockedBloomFilter>(BlockedBloomFilter& bloom,
+			unsigned k, const std::string& seq)
+	{
+		for (RollingHashIterator it(seq, k);
+				it != RollingHashIterator::end(); ++it)
+			bloom.insertHash(*it);
+	}
+
+	/** Test the k-mers adjacent to u together. Their hash values are
+	 * rolled from the hash value of u, and their blocks are
+	 * prefetched before any is tested. */
+	template <>
+	inline unsigned adjacentBases<BlockedBloomFilter>(
+			const BlockedBloomFilter& bloom,
+			const key_type& u, extDirection dir)
+	{
+		std::string s = u.str();
+		unsigned k = s.size();
+		uint64_t f = RollingHash::forward(s.data(), k);
+		uint64_t r = RollingHash::reverse(s.data(), k);
+		uint64_t h[NUM_BASES];
+		for (unsigned i = 0; i < NUM_BASES; i++) {
+			char c = codeToBase(i);
+			uint64_t fi, ri;
+			if (dir == SENSE) {
+				fi = RollingHash::rollForward(f, k, s[0], c);
+				ri = RollingHash::rollReverse(r, k, s[0], c);
+			} else {
+				fi = RollingHash::rollBackForward(f, k, s[k - 1], c);
+				ri = RollingHash::rollBackReverse(r, k, s[k - 1], c);
+			}
+			h[i] = fi < ri ? fi : ri;
+			bloom.prefetchHash(h[i]);
+		}
+		unsigned mask = 0;
+		for (unsigned i = 0; i < NUM_BASES; i++)
+			if (bloom.containsHash(h[i]))
+				mask |= 1 << i;
+		return mask;
+	}
+
+} // namespace Bloom
+
+#endif
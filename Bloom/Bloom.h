@@ -17,10 +17,12 @@
 #ifndef BLOOM_H_
 #define BLOOM_H_
 
+#include "Assembly/SeqExt.h" // for NUM_BASES
 #include "Common/Kmer.h"
 #include "Common/HashFunction.h"
 #include "Common/Uncompress.h"
 #include "Common/IOUtil.h"
+#include "Common/KmerIterator.h"
 #include "DataLayer/FastaReader.h"
 #include <iostream>
 #include <vector>
@@ -46,6 +48,8 @@ namespace Bloom {
 	static const unsigned LOAD_PROGRESS_STEP = 100000;
 	/** file format version number */
 	static const unsigned BLOOM_VERSION = 2;
+	/** file format version number of a blocked bloom filter */
+	static const unsigned BLOCKED_BLOOM_VERSION = 3;
 
 	/** Return the hash value of this object. */
 	inline static size_t hash(const key_type& key)
@@ -80,8 +84,38 @@ namespace Bloom {
 		assert(!path.empty());
 		if (verbose)
 			std::cerr << "Reading `" << path << "'...\n";
-		FastaReader in(path.c_str(), FastaReader::FOLD_CASE);
 		uint64_t count = 0;
+		if (FastaReader::isSplittable(path.c_str())) {
+			// Each thread reads its own section of the file.
+#pragma omp parallel
+			{
+				unsigned nthreads = 1, tid = 0;
+#if _OPENMP
+				nthreads = omp_get_num_threads();
+				tid = omp_get_thread_num();
+#endif
+				FastaReader in(path.c_str(), FastaReader::FOLD_CASE,
+						tid + 1, nthreads);
+				for (std::string seq; in >> seq;) {
+					loadSeq(bloomFilter, k, seq);
+					if (verbose)
+#pragma omp critical(cerr)
+					{
+						count++;
+						if (count % LOAD_PROGRESS_STEP == 0)
+							std::cerr << "Loaded " << count << " reads into bloom filter\n";
+					}
+				}
+				assert(in.eof());
+			}
+			if (verbose) {
+				std::cerr << "Loaded " << count << " reads from `"
+					<< path << "` into bloom filter\n";
+			}
+			return;
+		}
+
+		FastaReader in(path.c_str(), FastaReader::FOLD_CASE);
 #pragma omp parallel
 		for (std::vector<std::string> buffer(taskIOBufferSize);;) {
 			buffer.clear();
@@ -116,27 +150,201 @@ namespace Bloom {
 		}
 	}
 
+	/**
+	 * Load a sequence file into one bloom filter per k-mer size,
+	 * reading the file only once. The reads are read in batches, and
+	 * each batch is loaded into each bloom filter in turn, because the
+	 * k-mer size of class Kmer is global. A file that can be split is
+	 * read by all threads, each reading its own section, and the
+	 * threads load their batches into the same bloom filter at the
+	 * same time. The bloom filters must be thread safe when OpenMP is
+	 * used.
+	 */
+	template <typename BF>
+	inline static void loadFileMultiK(const std::vector<BF*>& bloomFilters,
+			const std::vector<unsigned>& ks, const std::string& path,
+			bool verbose = false, size_t taskIOBufferSize = 100000)
+	{
+		assert(!path.empty());
+		assert(bloomFilters.size() == ks.size());
+		if (verbose)
+			std::cerr << "Reading `" << path << "'...\n";
+
+		unsigned k0 = Kmer::length();
+		uint64_t count = 0;
+		if (FastaReader::isSplittable(path.c_str())) {
+			// The number of threads whose last batch was not empty
+			unsigned active = 0;
+#pragma omp parallel
+			{
+				unsigned nthreads = 1, tid = 0;
+#if _OPENMP
+				nthreads = omp_get_num_threads();
+				tid = omp_get_thread_num();
+#endif
+				FastaReader in(path.c_str(), FastaReader::FOLD_CASE,
+						tid + 1, nthreads);
+				for (std::vector<std::string> buffer;;) {
+					buffer.clear();
+					size_t bufferSize = 0;
+					for (std::string seq; bufferSize < taskIOBufferSize
+							&& in >> seq;) {
+						bufferSize += seq.length();
+						buffer.push_back(seq);
+					}
+
+#pragma omp single
+					active = 0;
+					if (!buffer.empty())
+#pragma omp atomic
+						active++;
+#pragma omp barrier
+					if (active == 0)
+						break;
+
+					for (size_t i = 0; i < ks.size(); i++) {
+#pragma omp single
+						Kmer::setLength(ks[i]);
+						BF& bloomFilter = *bloomFilters[i];
+						for (size_t j = 0; j < buffer.size(); j++)
+							loadSeq(bloomFilter, ks[i], buffer[j]);
+#pragma omp barrier
+					}
+
+#pragma omp critical(cerr)
+					{
+						if (verbose && count / LOAD_PROGRESS_STEP
+								!= (count + buffer.size()) / LOAD_PROGRESS_STEP)
+							std::cerr << "Loaded " << count + buffer.size()
+								<< " reads into bloom filters\n";
+						count += buffer.size();
+					}
+				}
+				assert(in.eof());
+			}
+			Kmer::setLength(k0);
+			if (verbose) {
+				std::cerr << "Loaded " << count << " reads from `"
+					<< path << "` into bloom filters\n";
+			}
+			return;
+		}
+
+		unsigned nthreads = 1;
+#if _OPENMP
+		nthreads = omp_get_max_threads();
+#endif
+		FastaReader in(path.c_str(), FastaReader::FOLD_CASE);
+		for (std::vector<std::string> buffer;;) {
+			buffer.clear();
+			size_t bufferSize = 0;
+			for (std::string seq; bufferSize < nthreads * taskIOBufferSize
+					&& in >> seq;) {
+				bufferSize += seq.length();
+				buffer.push_back(seq);
+			}
+			if (buffer.empty())
+				break;
+
+			for (size_t i = 0; i < ks.size(); i++) {
+				Kmer::setLength(ks[i]);
+				BF& bloomFilter = *bloomFilters[i];
+#pragma omp parallel for schedule(dynamic, 64)
+				for (ptrdiff_t j = 0; j < (ptrdiff_t)buffer.size(); j++)
+					loadSeq(bloomFilter, ks[i], buffer[j]);
+			}
+
+			if (verbose && count / LOAD_PROGRESS_STEP
+					!= (count + buffer.size()) / LOAD_PROGRESS_STEP)
+				std::cerr << "Loaded " << count + buffer.size()
+					<< " reads into bloom filters\n";
+			count += buffer.size();
+		}
+		assert(in.eof());
+		Kmer::setLength(k0);
+		if (verbose) {
+			std::cerr << "Loaded " << count << " reads from `"
+				<< path << "` into bloom filters\n";
+		}
+	}
+
 	/** Load a sequence (string) into a bloom filter */
 	template <typename BF>
 	inline static void loadSeq(BF& bloomFilter, unsigned k, const std::string& seq)
 	{
-		if (seq.size() < k)
-			return;
-		for (size_t i = 0; i < seq.size() - k + 1; ++i) {
-			std::string kmer = seq.substr(i, k);
-			size_t pos = kmer.find_last_not_of("ACGTacgt");
-			if (pos == std::string::npos) {
-				bloomFilter.insert(Kmer(kmer));
-			} else
-				i += pos;
+		for (KmerIterator it(seq, k); it != KmerIterator::end(); ++it)
+			bloomFilter.insert(it.canonical());
+	}
+
+	/** Return a bit mask of the bases b such that the k-mer u
+	 * extended by b in direction dir is present in the bloom filter.
+	 * A bloom filter may specialize this function to test the four
+	 * k-mers together.
+	 */
+	template <typename BF>
+	inline static unsigned adjacentBases(const BF& bloom,
+			const key_type& u, extDirection dir)
+	{
+		unsigned mask = 0;
+		key_type v(u);
+		v.shift(dir);
+		for (unsigned i = 0; i < NUM_BASES; i++) {
+			v.setLastBase(dir, i);
+			if (bloom[v])
+				mask |= 1 << i;
+		}
+		return mask;
+	}
+
+	/** Return the canonical k-mers that extend u in direction dir by
+	 * each base. Only u is reverse complemented, rather than each of
+	 * its neighbours.
+	 */
+	inline static void adjacentCanonicalKmers(const key_type& u,
+			extDirection dir, key_type* kmers)
+	{
+		extDirection rcdir = dir == SENSE ? ANTISENSE : SENSE;
+		key_type v(u), rc(u);
+		v.shift(dir);
+		rc.reverseComplement();
+		rc.shift(rcdir);
+		for (unsigned i = 0; i < NUM_BASES; i++) {
+			v.setLastBase(dir, i);
+			rc.setLastBase(rcdir, reverseComplement((uint8_t)i));
+			kmers[i] = v.compare(rc) <= 0 ? v : rc;
+		}
+	}
+
+	/** Return a bit mask of the bases b such that the k-mer u
+	 * extended by b in direction dir is present in a bloom filter
+	 * whose bit of a k-mer is hash(key) % size(). The four bits are
+	 * prefetched before any is tested, so that their cache misses
+	 * overlap.
+	 */
+	template <typename BF>
+	inline static unsigned adjacentBasesByIndex(const BF& bloom,
+			const key_type& u, extDirection dir)
+	{
+		key_type kmers[NUM_BASES];
+		adjacentCanonicalKmers(u, dir, kmers);
+		size_t pos[NUM_BASES];
+		for (unsigned i = 0; i < NUM_BASES; i++) {
+			pos[i] = hashmem(&kmers[i], sizeof kmers[i]) % bloom.size();
+			bloom.prefetch(pos[i]);
 		}
+		unsigned mask = 0;
+		for (unsigned i = 0; i < NUM_BASES; i++)
+			if (bloom[pos[i]])
+				mask |= 1 << i;
+		return mask;
 	}
 
-	inline static void writeHeader(std::ostream& out, const FileHeader& header)
+	inline static void writeHeader(std::ostream& out, const FileHeader& header,
+			unsigned version = BLOOM_VERSION)
 	{
 		(void)writeHeader;
 
-		out << BLOOM_VERSION << '\n';
+		out << version << '\n';
 		assert(out);
 		out << Kmer::length() << '\n';
 		assert(out);
@@ -147,7 +355,8 @@ namespace Bloom {
 		assert(out);
 	}
 
-	FileHeader readHeader(std::istream& in)
+	FileHeader readHeader(std::istream& in,
+			unsigned version = BLOOM_VERSION)
 	{
 		FileHeader header;
 
@@ -155,10 +364,10 @@ namespace Bloom {
 
 		in >> header.bloomVersion >> expect("\n");
 		assert(in);
-		if (header.bloomVersion != BLOOM_VERSION) {
+		if (header.bloomVersion != version) {
 			std::cerr << "error: bloom filter version (`"
 				<< header.bloomVersion << "'), does not match version required "
-				"by this program (`" << BLOOM_VERSION << "').\n";
+				"by this program (`" << version << "').\n";
 			exit(EXIT_FAILURE);
 		}
 
@@ -73,6 +73,15 @@ class BloomFilter
 		return (*this)[Bloom::hash(key) % m_size];
 	}
 
+	/** Prefetch the specified bit. */
+	void prefetch(size_t i) const
+	{
+		assert(i < m_size);
+#if __GNUC__
+		__builtin_prefetch(&m_array[i / 8]);
+#endif
+	}
+
 	/** Add the object with the specified index to this set. */
 	void insert(size_t i)
 	{
@@ -86,6 +95,16 @@ class BloomFilter
 		insert(Bloom::hash(key) % m_size);
 	}
 
+	/** Atomically set the specified bit.
+	 * @return whether the bit was already set
+	 */
+	bool testAndSet(size_t i)
+	{
+		assert(i < m_size);
+		char mask = 1 << (7 - i % 8);
+		return __sync_fetch_and_or(&m_array[i / 8], mask) & mask;
+	}
+
 	/** Operator for reading a bloom filter from a stream. */
 	friend std::istream& operator>>(std::istream& in, BloomFilter& o)
 	{
@@ -152,4 +171,16 @@ class BloomFilter
 	char* m_array;
 };
 
+namespace Bloom {
+
+	/** Test the k-mers adjacent to u together. */
+	template <>
+	inline unsigned adjacentBases<BloomFilter>(const BloomFilter& bloom,
+			const key_type& u, extDirection dir)
+	{
+		return adjacentBasesByIndex(bloom, u, dir);
+	}
+
+} // namespace Bloom
+
 #endif
@@ -83,6 +83,20 @@ class CascadingBloomFilter
 		}
 	}
 
+	/** Atomically add the object with the specified index to this
+	 * multiset.
+	 * @return whether its count was already >= max_count
+	 */
+	bool testAndSet(size_t index)
+	{
+		for (unsigned i = 0; i < m_data.size(); ++i) {
+			assert(m_data.at(i) != NULL);
+			if (!m_data[i]->testAndSet(index))
+				return false;
+		}
+		return true;
+	}
+
 	/** Add the object to this Cascading multiset. */
 	void insert(const Bloom::key_type& key)
 	{
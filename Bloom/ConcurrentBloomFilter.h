@@ -1,17 +1,15 @@
 #ifndef CONCURRENTBLOOMFILTER_H
-#define CONCURRENTBLOOMFILTER
-
-#ifndef _OPENMP
-# error ConcurrentBloomFilter class requires a compiler that supports OpenMP
-#endif
+#define CONCURRENTBLOOMFILTER_H 1
 
 #include "config.h"
-#include <vector>
-#include <omp.h>
+#include "Bloom/Bloom.h"
+#include <cassert>
 
 /**
  * A wrapper class that makes a Bloom filter
- * thread-safe.
+ * thread-safe. Bits are set with an atomic fetch-and-or,
+ * and queries are plain loads, so no locks are taken.
+ * The wrapped type must provide testAndSet(size_t).
  */
 template <class BloomFilterType>
 class ConcurrentBloomFilter
@@ -20,50 +18,29 @@ class ConcurrentBloomFilter
 public:
 
 	/** Constructor */
-	ConcurrentBloomFilter(BloomFilterType& bloom, size_t numLocks) :
-		m_bloom(bloom), m_locks(numLocks)
-	{
-		m_windowSize = bloom.size() / numLocks;
-		// round down to the nearest byte boundary,
-		// because bytes that span locks will
-		// cause concurrency issues
-		m_windowSize -= m_windowSize % 8;
-		assert(numLocks < bloom.size());
-		for (size_t i = 0; i < m_locks.size(); i++)
-			omp_init_lock(&(m_locks.at(i)));
-	}
+	ConcurrentBloomFilter(BloomFilterType& bloom) : m_bloom(bloom) { }
 
-	/** Destructor */
-	~ConcurrentBloomFilter()
-	{
-		for (size_t i = 0; i < m_locks.size(); i++)
-			omp_destroy_lock(&(m_locks.at(i)));
-	}
+	/** Return the size of the bit array. */
+	size_t size() const { return m_bloom.size(); }
 
 	/** Return whether the specified bit is set. */
 	bool operator[](size_t i) const
 	{
 		assert(i < m_bloom.size());
-		bool bit;
-		getLock(i);
-			bit = m_bloom[i];
-		releaseLock(i);
-		return bit;
+		return m_bloom[i];
 	}
 
 	/** Return whether the object is present in this set. */
 	bool operator[](const Bloom::key_type& key) const
 	{
-		return *this[Bloom::hash(key) % m_bloom.size()];
+		return (*this)[Bloom::hash(key) % m_bloom.size()];
 	}
 
 	/** Add the object with the specified index to this set. */
 	void insert(size_t index)
 	{
 		assert(index < m_bloom.size());
-		getLock(index);
-			m_bloom.insert(index);
-		releaseLock(index);
+		m_bloom.testAndSet(index);
 	}
 
 	/** Add the object to this set. */
@@ -74,23 +51,7 @@ public:
 
 private:
 
-	void getLock(size_t bitIndex)
-	{
-		assert(bitIndex < m_bloom.size());
-		size_t lockIndex = std::min(bitIndex / m_windowSize, m_locks.size() - 1);
-		omp_set_lock(&(m_locks.at(lockIndex)));
-	}
-
-	void releaseLock(size_t bitIndex)
-	{
-		assert(bitIndex < m_bloom.size());
-		size_t lockIndex = std::min(bitIndex / m_windowSize, m_locks.size() - 1);
-		omp_unset_lock(&(m_locks.at(lockIndex)));
-	}
-
 	BloomFilterType& m_bloom;
-	std::vector<omp_lock_t> m_locks;
-	size_t m_windowSize;
 };
 
 #endif
@@ -0,0 +1,224 @@
+/**
+ * A read-only Bloom filter backed by a memory-mapped file
+ */
+#ifndef MAPPEDBLOOMFILTER_H
+#define MAPPEDBLOOMFILTER_H 1
+
+#include "Bloom/Bloom.h"
+#include "Common/BitUtil.h"
+#include "Common/Kmer.h"
+#include "Common/MappedFile.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * A read-only Bloom filter whose bit array is memory-mapped from a
+ * file written by BloomFilter. Opening the file does not read the
+ * bit array, and concurrent processes that map the same file share
+ * one copy of it in the page cache.
+ */
+class MappedBloomFilter
+{
+  public:
+
+	/** Constructor. */
+	MappedBloomFilter()
+		: m_size(0), m_file(NULL), m_array(NULL) { }
+
+	/** Constructor. Map the specified file. */
+	explicit MappedBloomFilter(const std::string& path)
+		: m_size(0), m_file(NULL), m_array(NULL)
+	{
+		open(path);
+	}
+
+	~MappedBloomFilter()
+	{
+		close();
+	}
+
+	/** Return whether the file at the specified path can be mapped.
+	 * A file that is not a regular file, such as a pipe, or that is
+	 * compressed must be read by the stream loader of BloomFilter,
+	 * which uncompresses its input. A blocked bloom filter must be
+	 * read by the stream loader of BlockedBloomFilter.
+	 */
+	static bool isMappable(const std::string& path)
+	{
+		static const char* const suffixes[] = {
+			".gz", ".bz2", ".xz", ".Z", ".zip"
+		};
+		for (unsigned i = 0;
+				i < sizeof suffixes / sizeof *suffixes; i++) {
+			size_t n = strlen(suffixes[i]);
+			if (path.size() >= n
+					&& path.compare(path.size() - n, n, suffixes[i]) == 0)
+				return false;
+		}
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+			return false;
+		std::ifstream in(path.c_str());
+		return in.peek() != '0' + (int)Bloom::BLOCKED_BLOOM_VERSION;
+	}
+
+	/** Map the bloom filter file at the specified path. */
+	void open(const std::string& path)
+	{
+		close();
+		m_file = new MappedFile(path);
+		if (m_file->size() == 0)
+			invalid(path, "file is empty");
+
+		// The header is text and is followed by the bit array.
+		std::istringstream in(std::string(m_file->data(),
+					std::min(m_file->size(), MAX_HEADER_SIZE)));
+		Bloom::FileHeader header = readHeader(path, in);
+		if (header.startBitPos != 0
+				|| header.endBitPos != header.fullBloomSize - 1)
+			invalid(path, "cannot map a bloom filter window");
+		uint64_t pos = in.tellg();
+		m_size = header.fullBloomSize;
+		m_array = m_file->map<char>(pos, (m_size + 7) / 8);
+		madvise(const_cast<char*>(m_file->data()), m_file->size(),
+				MADV_RANDOM);
+	}
+
+	/** Unmap the file. */
+	void close()
+	{
+		delete m_file;
+		m_size = 0;
+		m_file = NULL;
+		m_array = NULL;
+	}
+
+	/** Return the size of the bit array. */
+	size_t size() const { return m_size; }
+
+	/** Return the population count, i.e. the number of set bits.
+	 * This reads the entire bit array from the file. */
+	size_t popcount() const
+	{
+		size_t count = 0;
+		size_t bytes = (m_size + 7) / 8;
+		size_t numInts = bytes / sizeof(uint64_t);
+		for (size_t i = 0; i < numInts; i++) {
+			// The bit array is not necessarily aligned.
+			uint64_t x;
+			memcpy(&x, m_array + i * sizeof x, sizeof x);
+			count += ::popcount(x);
+		}
+		for (size_t i = numInts * sizeof(uint64_t) * 8; i < m_size; i++) {
+			if ((*this)[i])
+				count++;
+		}
+		return count;
+	}
+
+	/** Return the estimated false positive rate.
+	 * This reads the entire bit array from the file. */
+	double FPR() const
+	{
+		return (double)popcount() / size();
+	}
+
+	/** Return whether the specified bit is set. */
+	bool operator[](size_t i) const
+	{
+		assert(i < m_size);
+		return m_array[i / 8] & 1 << (7 - i % 8);
+	}
+
+	/** Return whether the object is present in this set. */
+	bool operator[](const Bloom::key_type& key) const
+	{
+		return (*this)[Bloom::hash(key) % m_size];
+	}
+
+	/** Prefetch the specified bit. */
+	void prefetch(size_t i) const
+	{
+		assert(i < m_size);
+#if __GNUC__
+		__builtin_prefetch(&m_array[i / 8]);
+#endif
+	}
+
+  private:
+	MappedBloomFilter(const MappedBloomFilter&);
+	MappedBloomFilter& operator=(const MappedBloomFilter&);
+
+	/** The largest size of the text header of a bloom filter file. */
+	static const size_t MAX_HEADER_SIZE = 4096;
+
+	/** Print an error message about an invalid file and exit. */
+	static void invalid(const std::string& path, const char* message)
+	{
+		std::cerr << "error: `" << path << "': " << message << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	/** Read the header of a bloom filter file. Unlike
+	 * Bloom::readHeader, report a malformed header rather than
+	 * assert, since the header is not checked by a stream that is
+	 * read to the end.
+	 */
+	static Bloom::FileHeader readHeader(const std::string& path,
+			std::istream& in)
+	{
+		Bloom::FileHeader header;
+		if (!(in >> header.bloomVersion >> expect("\n")))
+			invalid(path, "invalid bloom filter header");
+		if (header.bloomVersion != Bloom::BLOOM_VERSION) {
+			std::cerr << "error: bloom filter version (`"
+				<< header.bloomVersion << "'), does not match version required "
+				"by this program (`" << Bloom::BLOOM_VERSION << "').\n";
+			exit(EXIT_FAILURE);
+		}
+		if (!(in >> header.k >> expect("\n")))
+			invalid(path, "invalid bloom filter header");
+		if (header.k != Kmer::length()) {
+			std::cerr << "error: this program must be run with the same kmer "
+				"size as the bloom filter being loaded (k="
+				<< header.k << ").\n";
+			exit(EXIT_FAILURE);
+		}
+		if (!(in >> header.fullBloomSize
+					>> expect("\t") >> header.startBitPos
+					>> expect("\t") >> header.endBitPos
+					>> expect("\n"))
+				|| header.fullBloomSize == 0
+				|| header.startBitPos > header.endBitPos
+				|| header.endBitPos >= header.fullBloomSize)
+			invalid(path, "invalid bloom filter header");
+		return header;
+	}
+
+	size_t m_size;
+	MappedFile* m_file;
+	const char* m_array;
+};
+
+namespace Bloom {
+
+	/** Test the k-mers adjacent to u together. */
+	template <>
+	inline unsigned adjacentBases<MappedBloomFilter>(
+			const MappedBloomFilter& bloom,
+			const key_type& u, extDirection dir)
+	{
+		return adjacentBasesByIndex(bloom, u, dir);
+	}
+
+} // namespace Bloom
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * A canonical rolling hash of the k-mers of a DNA sequence,
+ * in the style of ntHash (Mohamadi et al. 2016).
+ */
+#ifndef ROLLINGHASH_H
+#define ROLLINGHASH_H 1
+
+#include <cassert>
+#include <iterator>
+#include <limits>
+#include <stdint.h>
+#include <string>
+
+namespace RollingHash {
+
+	/** Random seeds for each nucleotide. */
+	static const uint64_t SEED_A = 0x3c8bfbb395c60474ULL;
+	static const uint64_t SEED_C = 0x3193c18562a02b4cULL;
+	static const uint64_t SEED_G = 0x20323ed082572324ULL;
+	static const uint64_t SEED_T = 0x295549f54be24456ULL;
+
+	/** Seed used to derive multiple hash values from one. */
+	static const uint64_t MULTI_SEED = 0x90b45d39fb6da1faULL;
+	static const unsigned MULTI_SHIFT = 27;
+
+	/** Rotate left by n bits. */
+	static inline uint64_t rol(uint64_t x, unsigned n)
+	{
+		n %= 64;
+		return n == 0 ? x : x << n | x >> (64 - n);
+	}
+
+	/** Rotate right by n bits. */
+	static inline uint64_t ror(uint64_t x, unsigned n)
+	{
+		n %= 64;
+		return n == 0 ? x : x >> n | x << (64 - n);
+	}
+
+	/** Return the seed of the specified nucleotide, or 0 if it is
+	 * not one of ACGT. */
+	static inline uint64_t seed(char c)
+	{
+		switch (c) {
+		  case 'A': case 'a': return SEED_A;
+		  case 'C': case 'c': return SEED_C;
+		  case 'G': case 'g': return SEED_G;
+		  case 'T': case 't': return SEED_T;
+		  default: return 0;
+		}
+	}
+
+	/** Return the seed of the complement of the specified
+	 * nucleotide. */
+	static inline uint64_t seedRC(char c)
+	{
+		switch (c) {
+		  case 'A': case 'a': return SEED_T;
+		  case 'C': case 'c': return SEED_G;
+		  case 'G': case 'g': return SEED_C;
+		  case 'T': case 't': return SEED_A;
+		  default: return 0;
+		}
+	}
+
+	/** Return the hash of the forward strand of the k-mer
+	 * starting at p. */
+	static inline uint64_t forward(const char* p, unsigned k)
+	{
+		uint64_t h = 0;
+		for (unsigned i = 0; i < k; i++)
+			h ^= rol(seed(p[i]), k - 1 - i);
+		return h;
+	}
+
+	/** Return the hash of the reverse complement of the k-mer
+	 * starting at p. */
+	static inline uint64_t reverse(const char* p, unsigned k)
+	{
+		uint64_t h = 0;
+		for (unsigned i = 0; i < k; i++)
+			h ^= rol(seedRC(p[i]), i);
+		return h;
+	}
+
+	/** Roll the forward hash by one nucleotide. */
+	static inline uint64_t rollForward(uint64_t h, unsigned k,
+			char out, char in)
+	{
+		return rol(h, 1) ^ rol(seed(out), k) ^ seed(in);
+	}
+
+	/** Roll the reverse-complement hash by one nucleotide. */
+	static inline uint64_t rollReverse(uint64_t h, unsigned k,
+			char out, char in)
+	{
+		return ror(h, 1) ^ ror(seedRC(out), 1) ^ rol(seedRC(in), k - 1);
+	}
+
+	/** Roll the forward hash back by one nucleotide, removing the
+	 * last nucleotide out and prepending the nucleotide in. */
+	static inline uint64_t rollBackForward(uint64_t h, unsigned k,
+			char out, char in)
+	{
+		return ror(h ^ seed(out), 1) ^ rol(seed(in), k - 1);
+	}
+
+	/** Roll the reverse-complement hash back by one nucleotide. */
+	static inline uint64_t rollBackReverse(uint64_t h, unsigned k,
+			char out, char in)
+	{
+		return rol(h ^ rol(seedRC(out), k - 1), 1) ^ seedRC(in);
+	}
+
+	/** Return the canonical hash of the k-mer starting at p, which
+	 * is the same for a k-mer and its reverse complement. */
+	static inline uint64_t hash(const char* p, unsigned k)
+	{
+		uint64_t f = forward(p, k), r = reverse(p, k);
+		return f < r ? f : r;
+	}
+
+	/** Return the ith hash value derived from the canonical hash h
+	 * of a k-mer. */
+	static inline uint64_t multiHash(uint64_t h, unsigned i)
+	{
+		uint64_t x = h * (i ^ MULTI_SEED);
+		return x ^ x >> MULTI_SHIFT;
+	}
+
+} // namespace RollingHash
+
+/**
+ * Iterate over the canonical hash values of the k-mers of a
+ * sequence, skipping the k-mers that contain a non-ACGT character.
+ * Each step costs O(1) rather than O(k).
+ */
+class RollingHashIterator
+	: public std::iterator<std::input_iterator_tag, uint64_t>
+{
+  public:
+	/** Construct an end iterator. */
+	RollingHashIterator()
+		: m_seq(NULL), m_k(0),
+		m_pos(std::numeric_limits<size_t>::max()),
+		m_forward(0), m_reverse(0), m_hash(0) { }
+
+	/** Construct an iterator over the k-mers of seq. The sequence
+	 * must outlive this iterator. */
+	RollingHashIterator(const std::string& seq, unsigned k)
+		: m_seq(&seq), m_k(k), m_pos(0),
+		m_forward(0), m_reverse(0), m_hash(0)
+	{
+		assert(k > 0);
+		init();
+	}
+
+	/** Return the canonical hash of the current k-mer. */
+	uint64_t operator*() const
+	{
+		assert(m_seq != NULL);
+		return m_hash;
+	}
+
+	/** Return the position of the current k-mer. */
+	size_t pos() const { return m_pos; }
+
+	bool operator==(const RollingHashIterator& it) const
+	{
+		return m_pos == it.m_pos;
+	}
+
+	bool operator!=(const RollingHashIterator& it) const
+	{
+		return !(*this == it);
+	}
+
+	RollingHashIterator& operator++()
+	{
+		assert(m_seq != NULL);
+		const std::string& s = *m_seq;
+		size_t next = m_pos + m_k;
+		if (next >= s.size()) {
+			m_pos = std::numeric_limits<size_t>::max();
+			return *this;
+		}
+		if (RollingHash::seed(s[next]) == 0) {
+			m_pos = next + 1;
+			init();
+			return *this;
+		}
+		char out = s[m_pos];
+		m_forward = RollingHash::rollForward(m_forward, m_k, out, s[next]);
+		m_reverse = RollingHash::rollReverse(m_reverse, m_k, out, s[next]);
+		m_hash = m_forward < m_reverse ? m_forward : m_reverse;
+		m_pos++;
+		return *this;
+	}
+
+	static const RollingHashIterator& end()
+	{
+		static const RollingHashIterator s_end;
+		return s_end;
+	}
+
+  private:
+	/** Find the next k-mer at or after m_pos that contains only
+	 * ACGT and compute its hash from scratch. */
+	void init()
+	{
+		const std::string& s = *m_seq;
+		for (size_t i = m_pos; i < s.size(); i++) {
+			if (RollingHash::seed(s[i]) == 0) {
+				m_pos = i + 1;
+				continue;
+			}
+			if (i + 1 - m_pos == m_k) {
+				const char* p = s.data() + m_pos;
+				m_forward = RollingHash::forward(p, m_k);
+				m_reverse = RollingHash::reverse(p, m_k);
+				m_hash = m_forward < m_reverse ? m_forward : m_reverse;
+				return;
+			}
+		}
+		m_pos = std::numeric_limits<size_t>::max();
+	}
+
+	const std::string* m_seq;
+	unsigned m_k;
+	size_t m_pos;
+	uint64_t m_forward;
+	uint64_t m_reverse;
+	uint64_t m_hash;
+};
+
+#endif
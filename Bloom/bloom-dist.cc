@@ -0,0 +1,360 @@
+/**
+ * Build a bloom filter in parallel using MPI. Each process owns one
+ * window of the bit array.
+ */
+
+#include "config.h"
+#include "Common/Options.h"
+#include "Common/Kmer.h"
+#include "Common/StringUtil.h"
+#include "DataLayer/Options.h"
+#include "DataLayer/FastaReader.h"
+#include "Bloom/Bloom.h"
+#include "Bloom/BloomFilterWindow.h"
+#include "Bloom/CascadingBloomFilterWindow.h"
+
+#include <mpi.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define PROGRAM "abyss-bloom-dist"
+
+static const char VERSION_MESSAGE[] =
+PROGRAM " (" PACKAGE_NAME ") " VERSION "\n"
+"\n"
+"Copyright 2013 Canada's Michael Smith Genome Science Centre\n";
+
+static const char USAGE_MESSAGE[] =
+"Usage: mpirun -np N " PROGRAM " -k K [OPTION]... OUTPUT_PREFIX READS_FILE...\n"
+"Build a bloom filter in parallel with N processes.\n"
+"Each process reads a share of the reads once and sends the\n"
+"position of each k-mer to the process that owns that window of the\n"
+"bloom filter. Process M of N writes window M to OUTPUT_PREFIX-M.bloom.\n"
+"Concatenate the windows with `abyss-bloom concat'.\n"
+"\n"
+" Options:\n"
+"\n"
+"  -k, --kmer=N               the size of a k-mer [required]\n"
+"  -b, --bloom-size=N         size of bloom filter [500M]\n"
+"  -B, --buffer-size=N        number of bases read per batch [100000]\n"
+"  -l, --levels=N             build a cascading bloom filter with N levels\n"
+"                             and output the last level\n"
+"      --chastity             discard unchaste reads [default]\n"
+"      --no-chastity          do not discard unchaste reads\n"
+"      --trim-masked          trim masked bases from the ends of reads\n"
+"      --no-trim-masked       do not trim masked bases from the ends\n"
+"                             of reads [default]\n"
+"  -q, --trim-quality=N       trim bases from the ends of reads whose\n"
+"                             quality is less than the threshold\n"
+"      --standard-quality     zero quality is `!' (33)\n"
+"                             default for FASTQ and SAM files\n"
+"      --illumina-quality     zero quality is `@' (64)\n"
+"                             default for qseq and export files\n"
+"  -v, --verbose              display verbose output\n"
+"      --help                 display this help and exit\n"
+"      --version              output version information and exit\n"
+"\n"
+"Report bugs to <" PACKAGE_BUGREPORT ">.\n";
+
+namespace opt {
+
+	/** The size of the bloom filter in bytes. */
+	size_t bloomSize = 500 * 1024 * 1024;
+
+	/** The number of bases read per batch. */
+	size_t bufferSize = 100000;
+
+	/** The size of a k-mer. */
+	unsigned k;
+
+	/** Number of levels for cascading bloom filter. */
+	unsigned levels = 1;
+}
+
+static const char shortopts[] = "b:B:k:l:q:v";
+
+enum { OPT_HELP = 1, OPT_VERSION };
+
+static const struct option longopts[] = {
+	{ "bloom-size",		  required_argument, NULL, 'b' },
+	{ "buffer-size",	  required_argument, NULL, 'B' },
+	{ "kmer",			  required_argument, NULL, 'k' },
+	{ "levels",			  required_argument, NULL, 'l' },
+	{ "chastity",		  no_argument, &opt::chastityFilter, 1 },
+	{ "no-chastity",	  no_argument, &opt::chastityFilter, 0 },
+	{ "trim-masked",	  no_argument, &opt::trimMasked, 1 },
+	{ "no-trim-masked",   no_argument, &opt::trimMasked, 0 },
+	{ "trim-quality",	  required_argument, NULL, 'q' },
+	{ "standard-quality", no_argument, &opt::qualityOffset, 33 },
+	{ "illumina-quality", no_argument, &opt::qualityOffset, 64 },
+	{ "verbose",		  no_argument, NULL, 'v' },
+	{ "help",			  no_argument, NULL, OPT_HELP },
+	{ "version",		  no_argument, NULL, OPT_VERSION },
+	{ NULL, 0, NULL, 0 }
+};
+
+/** The rank of this process. */
+static int g_rank;
+
+/** The number of processes. */
+static int g_numProc;
+
+/**
+ * Read the next batch of reads that belongs to this process.
+ * If the file is shared, the batches of the file are dealt out
+ * round robin. Otherwise the reader reads the section of the file
+ * of this process.
+ * @return false at the end of the input
+ */
+static bool readBatch(FastaReader& in, vector<string>& batch,
+		bool shared)
+{
+	vector<string> skipped;
+	batch.clear();
+	for (int i = 0; i < (shared ? g_numProc : 1); i++) {
+		vector<string>& v = !shared || i == g_rank ? batch : skipped;
+		v.clear();
+		size_t bases = 0;
+		for (string seq; bases < opt::bufferSize && in >> seq;) {
+			bases += seq.length();
+			v.push_back(seq);
+		}
+	}
+	return !batch.empty();
+}
+
+/** Append the position of each k-mer of seq to the send buffer of
+ * the process that owns it. */
+static void routeSeq(const string& seq, size_t fullBloomSize,
+		size_t windowBits, vector< vector<uint64_t> >& sendBuffers)
+{
+	unsigned k = opt::k;
+	if (seq.size() < k)
+		return;
+	for (size_t i = 0; i < seq.size() - k + 1; ++i) {
+		string kmer = seq.substr(i, k);
+		size_t pos = kmer.find_last_not_of("ACGTacgt");
+		if (pos != string::npos) {
+			i += pos;
+			continue;
+		}
+		size_t bit = Bloom::hash(Kmer(kmer)) % fullBloomSize;
+		size_t owner = min(bit / windowBits, (size_t)g_numProc - 1);
+		sendBuffers[owner].push_back(bit);
+	}
+}
+
+/** Exchange the k-mer positions with the other processes and insert
+ * the positions received into this window. */
+template <typename BF>
+static size_t exchange(BF& bloom,
+		vector< vector<uint64_t> >& sendBuffers,
+		vector<uint64_t>& recvBuffer)
+{
+	vector<int> sendCounts(g_numProc), sendDispls(g_numProc);
+	vector<int> recvCounts(g_numProc), recvDispls(g_numProc);
+	vector<uint64_t> sendBuffer;
+	for (int i = 0; i < g_numProc; i++) {
+		sendDispls[i] = sendBuffer.size();
+		sendCounts[i] = sendBuffers[i].size();
+		sendBuffer.insert(sendBuffer.end(),
+				sendBuffers[i].begin(), sendBuffers[i].end());
+		sendBuffers[i].clear();
+	}
+
+	MPI_Alltoall(&sendCounts[0], 1, MPI_INT,
+			&recvCounts[0], 1, MPI_INT, MPI_COMM_WORLD);
+	size_t n = 0;
+	for (int i = 0; i < g_numProc; i++) {
+		recvDispls[i] = n;
+		n += recvCounts[i];
+	}
+	recvBuffer.resize(n);
+
+	MPI_Alltoallv(sendBuffer.empty() ? NULL : &sendBuffer[0],
+			&sendCounts[0], &sendDispls[0], MPI_UINT64_T,
+			recvBuffer.empty() ? NULL : &recvBuffer[0],
+			&recvCounts[0], &recvDispls[0], MPI_UINT64_T,
+			MPI_COMM_WORLD);
+
+	for (size_t i = 0; i < n; i++)
+		bloom.insert(recvBuffer[i]);
+	return n;
+}
+
+/** Load the reads of the input files into this window. */
+template <typename BF>
+static void loadWindow(BF& bloom, size_t fullBloomSize,
+		size_t windowBits, int argc, char** argv)
+{
+	vector<string> batch;
+	vector< vector<uint64_t> > sendBuffers(g_numProc);
+	vector<uint64_t> recvBuffer;
+	size_t numReads = 0, numKmers = 0;
+
+	for (int i = optind; i < argc; i++) {
+		// Each process reads its own section of a file that may be
+		// split, rather than reading and skipping the whole file.
+		bool shared = !FastaReader::isSplittable(argv[i]);
+		FastaReader in(argv[i], FastaReader::FOLD_CASE,
+				shared ? 1 : g_rank + 1, shared ? 1 : g_numProc);
+		for (int more = 1; more;) {
+			int good = readBatch(in, batch, shared);
+			if (good) {
+				numReads += batch.size();
+				for (size_t j = 0; j < batch.size(); j++)
+					routeSeq(batch[j], fullBloomSize, windowBits,
+							sendBuffers);
+			}
+			numKmers += exchange(bloom, sendBuffers, recvBuffer);
+			MPI_Allreduce(&good, &more, 1, MPI_INT, MPI_LOR,
+					MPI_COMM_WORLD);
+		}
+		assert(in.eof());
+	}
+
+	if (opt::verbose)
+		cerr << PROGRAM " " << g_rank << ": read " << numReads
+			<< " reads and inserted " << numKmers << " k-mers\n";
+}
+
+/** Build and write the window of this process. */
+template <typename BF>
+static void buildWindow(BF& bloom, size_t fullBloomSize,
+		size_t windowBits, const string& path, int argc, char** argv)
+{
+	loadWindow(bloom, fullBloomSize, windowBits, argc, argv);
+
+	if (opt::verbose)
+		cerr << PROGRAM " " << g_rank << ": writing `"
+			<< path << "'...\n";
+	ofstream out(path.c_str());
+	assert_good(out, path);
+	out << bloom;
+	out.flush();
+	assert_good(out, path);
+}
+
+static void dieWithUsageError()
+{
+	if (g_rank == 0)
+		cerr << "Try `" << PROGRAM
+			<< " --help' for more information.\n";
+	MPI_Finalize();
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv)
+{
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &g_rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &g_numProc);
+
+	bool die = false;
+	for (int c; (c = getopt_long(argc, argv,
+					shortopts, longopts, NULL)) != -1;) {
+		istringstream arg(optarg != NULL ? optarg : "");
+		switch (c) {
+		  case '?':
+			die = true; break;
+		  case 'b':
+			opt::bloomSize = SIToBytes(arg); break;
+		  case 'B':
+			arg >> opt::bufferSize; break;
+		  case 'k':
+			arg >> opt::k; break;
+		  case 'l':
+			arg >> opt::levels; break;
+		  case 'q':
+			arg >> opt::qualityThreshold; break;
+		  case 'v':
+			opt::verbose++; break;
+		  case OPT_HELP:
+			if (g_rank == 0)
+				cout << USAGE_MESSAGE;
+			MPI_Finalize();
+			exit(EXIT_SUCCESS);
+		  case OPT_VERSION:
+			if (g_rank == 0)
+				cout << VERSION_MESSAGE;
+			MPI_Finalize();
+			exit(EXIT_SUCCESS);
+		}
+		if (optarg != NULL && (!arg.eof() || arg.fail())) {
+			if (g_rank == 0)
+				cerr << PROGRAM ": invalid option: `-"
+					<< (char)c << optarg << "'\n";
+			MPI_Finalize();
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (opt::k == 0) {
+		if (g_rank == 0)
+			cerr << PROGRAM ": missing mandatory option `-k'\n";
+		die = true;
+	}
+
+	if (opt::levels == 0) {
+		if (g_rank == 0)
+			cerr << PROGRAM ": number of levels (-l) must be "
+				"greater than zero\n";
+		die = true;
+	}
+
+	if (argc - optind < 2) {
+		if (g_rank == 0)
+			cerr << PROGRAM ": missing arguments\n";
+		die = true;
+	}
+
+	// bloom filter size in bits of each level
+	size_t bits = opt::bloomSize * 8 / opt::levels;
+
+	// Round each window down to a whole number of bytes, so that
+	// the windows may be concatenated. The last window takes the
+	// remainder.
+	size_t windowBits = bits / g_numProc / 8 * 8;
+	if (windowBits == 0) {
+		if (g_rank == 0)
+			cerr << PROGRAM ": bloom filter size (-b) is too small "
+				"for " << g_numProc << " processes\n";
+		die = true;
+	}
+
+	if (die)
+		dieWithUsageError();
+
+	Kmer::setLength(opt::k);
+
+	size_t startBitPos = g_rank * windowBits;
+	size_t endBitPos = g_rank == g_numProc - 1
+		? bits - 1 : startBitPos + windowBits - 1;
+
+	ostringstream path;
+	path << argv[optind] << '-' << g_rank + 1 << ".bloom";
+	optind++;
+
+	if (opt::levels == 1) {
+		BloomFilterWindow bloom(bits, startBitPos, endBitPos);
+		buildWindow(bloom, bits, windowBits, path.str(), argc, argv);
+	} else {
+		CascadingBloomFilterWindow bloom(
+				bits, startBitPos, endBitPos, opt::levels);
+		buildWindow(bloom, bits, windowBits, path.str(), argc, argv);
+	}
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	MPI_Finalize();
+	return 0;
+}
@@ -11,6 +11,8 @@
 #include "Common/StringUtil.h"
 #include "Bloom/Bloom.h"
 #include "Bloom/BloomFilter.h"
+#include "Bloom/BlockedBloomFilter.h"
+#include "Bloom/MappedBloomFilter.h"
 #include "Bloom/CascadingBloomFilter.h"
 #include "Bloom/BloomFilterWindow.h"
 #include "Bloom/CascadingBloomFilterWindow.h"
@@ -45,6 +47,7 @@ static const char USAGE_MESSAGE[] =
 "Usage 4: " PROGRAM " info [GLOBAL_OPTS] [COMMAND_OPTS] <BLOOM_FILE>\n"
 "Usage 5: " PROGRAM " compare [GLOBAL_OPTS] [COMMAND_OPTS] <BLOOM_FILE_1> <BLOOM_FILE_2>\n"
 "Usage 6: " PROGRAM " getKmers [GLOBAL_OPTS] [COMMAND_OPTS] <BLOOM_FILE> <READS_FILE>\n"
+"Usage 7: " PROGRAM " concat [GLOBAL_OPTS] <OUTPUT_BLOOM_FILE> <WINDOW_FILE_1> [WINDOW_FILE_2]...\n"
 "Build and manipulate bloom filter files.\n"
 "\n"
 " Global options:\n"
@@ -58,6 +61,10 @@ static const char USAGE_MESSAGE[] =
 "\n"
 "  -b, --bloom-size=N         size of bloom filter [500M]\n"
 "  -B, --buffer-size=N        size of I/O buffer for each thread, in bytes [100000]\n"
+"      --blocked              build a blocked bloom filter, whose hash\n"
+"                             functions for a k-mer share one cache line\n"
+"  -H, --num-hashes=N         number of hash functions of a blocked\n"
+"                             bloom filter [4]\n"
 "  -j, --threads=N            use N parallel threads [1]\n"
 "  -l, --levels=N             build a cascading bloom filter with N levels\n"
 "                             and output the last level\n"
@@ -68,7 +75,6 @@ static const char USAGE_MESSAGE[] =
 "      --trim-masked          trim masked bases from the ends of reads\n"
 "      --no-trim-masked       do not trim masked bases from the ends\n"
 "                             of reads [default]\n"
-"  -n, --num-locks=N          number of write locks on bloom filter [1000]\n"
 "  -q, --trim-quality=N       trim bases from the ends of reads whose\n"
 "                             quality is less than the threshold\n"
 "      --standard-quality     zero quality is `!' (33)\n"
@@ -80,6 +86,7 @@ static const char USAGE_MESSAGE[] =
 " Options for `" PROGRAM " union': (none)\n"
 " Options for `" PROGRAM " intersect': (none)\n"
 " Options for `" PROGRAM " info': (none)\n"
+" Options for `" PROGRAM " concat': (none)\n"
 " Options for `" PROGRAM " compare':\n"
 "\n"
 "  -m, --method=`String'      choose distance calculation method \n"
@@ -102,6 +109,12 @@ namespace opt {
 	/** The number of parallel threads. */
 	unsigned threads = 1;
 
+	/** Build a blocked bloom filter. */
+	int blocked = 0;
+
+	/** The number of hash functions of a blocked bloom filter. */
+	unsigned numHashes = BlockedBloomFilter::DEFAULT_NUM_HASHES;
+
 	/** The size of a k-mer. */
 	unsigned k;
 
@@ -115,8 +128,8 @@ namespace opt {
 	vector< vector<string> > levelInitPaths;
 
 	/**
-	 * Num of locked windows to use, when invoking with
-	 * the -j option.
+	 * Num of locked windows (-n option). This option is
+	 * obsolete and is ignored.
 	 */
 	size_t numLocks = 1000;
 
@@ -138,13 +151,15 @@ namespace opt {
 	bool inverse = false;
 }
 
-static const char shortopts[] = "b:B:j:k:l:L:m:n:q:rvw:";
+static const char shortopts[] = "b:B:H:j:k:l:L:m:n:q:rvw:";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
 static const struct option longopts[] = {
 	{ "bloom-size",		  required_argument, NULL, 'b' },
 	{ "buffer-size",	  required_argument, NULL, 'B' },
+	{ "blocked",		  no_argument, &opt::blocked, 1 },
+	{ "num-hashes",		  required_argument, NULL, 'H' },
 	{ "threads",		  required_argument, NULL, 'j' },
 	{ "kmer",			  required_argument, NULL, 'k' },
 	{ "levels",			  required_argument, NULL, 'l' },
@@ -254,6 +269,12 @@ static inline void closeOutputStream(ostream* out, const string& path)
 	delete ofs;
 }
 
+/** Return whether the stream holds a blocked bloom filter. */
+static inline bool isBlocked(istream& in)
+{
+	return in.peek() == '0' + (int)Bloom::BLOCKED_BLOOM_VERSION;
+}
+
 template <typename CBF>
 void initBloomFilterLevels(CBF& bf)
 {
@@ -341,6 +362,8 @@ int build(int argc, char** argv)
 			opt::bloomSize = SIToBytes(arg); break;
 		  case 'B':
 			arg >> opt::bufferSize; break;
+		  case 'H':
+			arg >> opt::numHashes; break;
 		  case 'j':
 			arg >> opt::threads; break;
 		  case 'l':
@@ -361,7 +384,10 @@ int build(int argc, char** argv)
 				break;
 			}
 		  case 'n':
-			arg >> opt::numLocks; break;
+			arg >> opt::numLocks;
+			cerr << PROGRAM ": warning: the -n option is obsolete "
+				"and is ignored\n";
+			break;
 		  case 'q':
 			arg >> opt::qualityThreshold; break;
 		  case 'w':
@@ -384,6 +410,18 @@ int build(int argc, char** argv)
 		dieWithUsageError();
 	}
 
+	if (opt::blocked && (opt::levels > 1 || opt::windows > 0)) {
+		cerr << PROGRAM ": --blocked cannot be used with cascading "
+			"bloom filters (-l) or windows (-w)\n";
+		dieWithUsageError();
+	}
+
+	if (opt::numHashes == 0) {
+		cerr << PROGRAM ": number of hash functions (-H) must be "
+			"greater than zero\n";
+		dieWithUsageError();
+	}
+
 	if (opt::levelInitPaths.size() > opt::levels) {
 		cerr << PROGRAM ": level arg to -L is greater than number"
 			" of bloom filter levels (-l)\n";
@@ -426,11 +464,17 @@ int build(int argc, char** argv)
 	optind++;
 	if (opt::windows == 0) {
 
-		if (opt::levels == 1) {
+		if (opt::blocked) {
+			// insertions into a blocked bloom filter are atomic
+			BlockedBloomFilter bloom(bits, opt::numHashes);
+			loadFilters(bloom, argc, argv);
+			printBloomStats(cerr, bloom);
+			writeBloom(bloom, outputPath);
+		}
+		else if (opt::levels == 1) {
 			BloomFilter bloom(bits);
 #ifdef _OPENMP
-			ConcurrentBloomFilter<BloomFilter>
-				cbf(bloom, opt::numLocks);
+			ConcurrentBloomFilter<BloomFilter> cbf(bloom);
 			loadFilters(cbf, argc, argv);
 #else
 			loadFilters(bloom, argc, argv);
@@ -443,7 +487,7 @@ int build(int argc, char** argv)
 			initBloomFilterLevels(cascadingBloom);
 #ifdef _OPENMP
 			ConcurrentBloomFilter<CascadingBloomFilter>
-				cbf(cascadingBloom, opt::numLocks);
+				cbf(cascadingBloom);
 			loadFilters(cbf, argc, argv);
 #else
 			loadFilters(cascadingBloom, argc, argv);
@@ -482,6 +526,40 @@ int build(int argc, char** argv)
 	return 0;
 }
 
+/** Write the union or intersection of bloom filters. */
+template <typename BF>
+static void writeCombined(const BF& bloom, BitwiseOp readOp,
+		const string& outputPath)
+{
+	if (opt::verbose) {
+		cerr << "Successfully loaded bloom filter.\n";
+		printBloomStats(cerr, bloom);
+		switch(readOp) {
+			case BITWISE_OR:
+				std::cerr << "Writing union of bloom filters to `"
+					<< outputPath << "'...\n";
+				break;
+			case BITWISE_AND:
+				std::cerr << "Writing intersection of bloom filters to `"
+					<< outputPath << "'...\n";
+				break;
+			default:
+				std::cerr << "error: expected BITWISE_OR or BITWISE_AND\n";
+				assert(false);
+				break;
+		}
+	}
+
+	ostream* out = openOutputStream(outputPath);
+
+	assert_good(*out, outputPath);
+	*out << bloom;
+	out->flush();
+	assert_good(*out, outputPath);
+
+	closeOutputStream(out, outputPath);
+}
+
 int combine(int argc, char** argv, BitwiseOp readOp)
 {
 	parseGlobalOpts(argc, argv);
@@ -494,7 +572,11 @@ int combine(int argc, char** argv, BitwiseOp readOp)
 	string outputPath(argv[optind]);
 	optind++;
 
+	// The first bloom filter determines whether the bloom filters
+	// are blocked.
 	BloomFilter bloom;
+	BlockedBloomFilter blockedBloom;
+	bool blocked = false;
 
 	for (int i = optind; i < argc; i++) {
 		string path(argv[i]);
@@ -503,40 +585,97 @@ int combine(int argc, char** argv, BitwiseOp readOp)
 				<< path << "'...\n";
 		istream* in = openInputStream(path);
 		assert_good(*in, path);
+		if (i == optind)
+			blocked = isBlocked(*in);
 		BitwiseOp op = (i > optind) ? readOp : BITWISE_OVERWRITE;
-		bloom.read(*in, op);
+		if (blocked)
+			blockedBloom.read(*in, op);
+		else
+			bloom.read(*in, op);
 		assert_good(*in, path);
 		closeInputStream(in, path);
 	}
 
-	if (opt::verbose) {
-		cerr << "Successfully loaded bloom filter.\n";
-		printBloomStats(cerr, bloom);
-		switch(readOp) {
-			case BITWISE_OR:
-				std::cerr << "Writing union of bloom filters to `"
-					<< outputPath << "'...\n";
-				break;
-			case BITWISE_AND:
-				std::cerr << "Writing intersection of bloom filters to `"
-					<< outputPath << "'...\n";
-				break;
-			default:
-				std::cerr << "error: expected BITWISE_OR or BITWISE_AND\n";
-				assert(false);
-				break;
-		}
+	if (blocked)
+		writeCombined(blockedBloom, readOp, outputPath);
+	else
+		writeCombined(bloom, readOp, outputPath);
+
+	return 0;
+}
+
+/**
+ * Concatenate contiguous bloom filter windows, in order, into one
+ * bloom filter. The bits of each window are copied without loading
+ * the full bloom filter into memory.
+ */
+int concat(int argc, char** argv)
+{
+	parseGlobalOpts(argc, argv);
+
+	if (argc - optind < 2) {
+		cerr << PROGRAM ": missing arguments\n";
+		dieWithUsageError();
 	}
 
-	ostream* out = openOutputStream(outputPath);
+	string outputPath(argv[optind]);
+	optind++;
 
+	ostream* out = openOutputStream(outputPath);
 	assert_good(*out, outputPath);
-	*out << bloom;
+
+	const size_t IO_BUFFER_SIZE = 32 * 1024;
+	vector<char> buffer(IO_BUFFER_SIZE);
+	size_t fullBloomSize = 0;
+	size_t nextBitPos = 0;
+	for (int i = optind; i < argc; i++) {
+		string path(argv[i]);
+		if (opt::verbose)
+			cerr << "Copying bloom filter window `" << path << "'...\n";
+		istream* in = openInputStream(path);
+		assert_good(*in, path);
+		Bloom::FileHeader header = Bloom::readHeader(*in);
+		assert_good(*in, path);
+
+		if (i == optind) {
+			fullBloomSize = header.fullBloomSize;
+			Bloom::FileHeader fullHeader = header;
+			fullHeader.startBitPos = 0;
+			fullHeader.endBitPos = fullBloomSize - 1;
+			Bloom::writeHeader(*out, fullHeader);
+			assert_good(*out, outputPath);
+		}
+		if (header.fullBloomSize != fullBloomSize
+				|| header.startBitPos != nextBitPos
+				|| header.startBitPos % 8 != 0) {
+			cerr << PROGRAM ": `" << path << "': expected a window "
+				"starting at bit " << nextBitPos << " of a bloom filter "
+				"of " << fullBloomSize << " bits\n";
+			exit(EXIT_FAILURE);
+		}
+
+		size_t bytes = (header.endBitPos - header.startBitPos + 8) / 8;
+		while (bytes > 0) {
+			size_t n = min(bytes, IO_BUFFER_SIZE);
+			in->read(&buffer[0], n);
+			assert_good(*in, path);
+			out->write(&buffer[0], n);
+			assert_good(*out, outputPath);
+			bytes -= n;
+		}
+		closeInputStream(in, path);
+		nextBitPos = header.endBitPos + 1;
+	}
+
+	if (nextBitPos != fullBloomSize) {
+		cerr << PROGRAM ": missing the windows from bit "
+			<< nextBitPos << " to the end of the bloom filter\n";
+		exit(EXIT_FAILURE);
+	}
+
 	out->flush();
 	assert_good(*out, outputPath);
-
 	closeOutputStream(out, outputPath);
-
 	return 0;
 }
 
@@ -549,7 +688,6 @@ int info(int argc, char** argv)
 		dieWithUsageError();
 	}
 
-	BloomFilter bloom;
 	string path = argv[optind];
 
 	if (opt::verbose)
@@ -558,9 +696,19 @@ int info(int argc, char** argv)
 
 	istream* in = openInputStream(path);
 	assert_good(*in, path);
-	*in >> bloom;
-
-	printBloomStats(cerr, bloom);
+	if (isBlocked(*in)) {
+		BlockedBloomFilter bloom;
+		*in >> bloom;
+		printBloomStats(cerr, bloom);
+		cerr << "Bloom hash functions: " << bloom.numHashes() << "\n";
+	} else if (path != "-" && MappedBloomFilter::isMappable(path)) {
+		MappedBloomFilter bloom(path);
+		printBloomStats(cerr, bloom);
+	} else {
+		BloomFilter bloom;
+		*in >> bloom;
+		printBloomStats(cerr, bloom);
+	}
 
 	closeInputStream(in, path);
 
@@ -611,12 +759,34 @@ int compare(int argc, char ** argv){
 	// Not sure this conversion is needed, check docs
 	std::istream & tA = *inA;
 	std::istream & tB = *inB;
+	// The bits of a blocked bloom filter are comparable only with
+	// those of another blocked bloom filter
+	bool blocked = isBlocked(tA);
+	if (blocked != isBlocked(tB)) {
+		cerr << PROGRAM ": cannot compare a blocked bloom filter with "
+			"a bloom filter that is not blocked\n";
+		exit(EXIT_FAILURE);
+	}
+	unsigned version = blocked ? Bloom::BLOCKED_BLOOM_VERSION
+		: Bloom::BLOOM_VERSION;
 	// Need to read header for bit start and end info
-	Bloom::FileHeader headerA = Bloom::readHeader(tA);
-	Bloom::FileHeader headerB = Bloom::readHeader(tB);
+	Bloom::FileHeader headerA = Bloom::readHeader(tA, version);
+	Bloom::FileHeader headerB = Bloom::readHeader(tB, version);
 	// Need to assert after every read operation
 	assert(tA);
 	assert(tB);
+	if (blocked) {
+		unsigned numHashesA, numHashesB;
+		tA >> numHashesA >> expect("\n");
+		tB >> numHashesB >> expect("\n");
+		assert(tA);
+		assert(tB);
+		if (numHashesA != numHashesB) {
+			cerr << PROGRAM ": cannot compare blocked bloom filters "
+				"with different numbers of hash functions\n";
+			exit(EXIT_FAILURE);
+		}
+	}
 
 	const size_t IO_BUFFER_SIZE = 32 * 1024;
 	unsigned char mask = 1;
@@ -828,6 +998,9 @@ int main(int argc, char** argv)
 	else if (command == "info") {
 		return info(argc, argv);
 	}
+	else if (command == "concat") {
+		return concat(argc, argv);
+	}
 	else if (command == "compare") {
 		return compare(argc, argv);
 	}
@@ -21,14 +21,84 @@ static uint8_t getBaseCode(const char* pSeq,
 static void setBaseCode(char* pSeq,
 		unsigned byteNum, unsigned index, uint8_t base);
 
+/** The maximum number of 64-bit words of a k-mer. */
+static const unsigned MAX_WORDS = (Kmer::NUM_BYTES + 7) / 8;
+
+/** Return the number of 64-bit words needed to store n bytes. */
+static inline unsigned numWords(unsigned n)
+{
+	return (n + 7) / 8;
+}
+
+/** Convert between big-endian and native byte order. */
+static inline uint64_t bigEndian(uint64_t x)
+{
+#if WORDS_BIGENDIAN
+	return x;
+#else
+	return __builtin_bswap64(x);
+#endif
+}
+
+/** Load the words of a k-mer that hold its first n bytes, so that
+ * the first base is in the two most significant bits of the first
+ * word. Only the words needed for the current k-mer length are
+ * touched, so the cost of an operation depends on k rather than on
+ * MAX_KMER. The bytes that follow the k-mer are zero.
+ */
+static inline void loadWords(uint64_t* w, const char* src, unsigned n)
+{
+	unsigned nwords = numWords(n);
+	for (unsigned i = 0; i < nwords; i++) {
+		if (8 * (i + 1) <= Kmer::NUM_BYTES)
+			memcpy(&w[i], src + 8 * i, 8);
+		else {
+			w[i] = 0;
+			memcpy(&w[i], src + 8 * i, Kmer::NUM_BYTES % 8);
+		}
+		w[i] = bigEndian(w[i]);
+	}
+}
+
+/** Store the words loaded by loadWords. */
+static inline void storeWords(char* dest, uint64_t* w, unsigned n)
+{
+	unsigned nwords = numWords(n);
+	for (unsigned i = 0; i < nwords; i++) {
+		uint64_t x = bigEndian(w[i]);
+		if (8 * (i + 1) <= Kmer::NUM_BYTES)
+			memcpy(dest + 8 * i, &x, 8);
+		else
+			memcpy(dest + 8 * i, &x, Kmer::NUM_BYTES % 8);
+	}
+}
+
+/** Return the shift of the base at index i within its word. */
+static inline unsigned baseShift(unsigned i)
+{
+	return 62 - 2 * (i % 32);
+}
+
+/** Reverse the order of the 32 bases of a word. */
+static inline uint64_t reverseBases(uint64_t x)
+{
+	x = (x >> 2 & 0x3333333333333333ULL)
+		| (x & 0x3333333333333333ULL) << 2;
+	x = (x >> 4 & 0x0f0f0f0f0f0f0f0fULL)
+		| (x & 0x0f0f0f0f0f0f0f0fULL) << 4;
+	return __builtin_bswap64(x);
+}
+
 /** Construct a k-mer from a string. */
 Kmer::Kmer(const Sequence& seq)
 {
 	assert(seq.length() == s_length);
 	memset(m_seq, 0, NUM_BYTES);
+	uint64_t w[MAX_WORDS] = { 0 };
 	const char* p = seq.data();
 	for (unsigned i = 0; i < s_length; i++)
-		set(i, baseToCode(*p++));
+		w[i / 32] |= (uint64_t)baseToCode(*p++) << baseShift(i);
+	storeWords(m_seq, w, bytes());
 }
 
 /** Compare two k-mer. */
@@ -37,29 +107,16 @@ int Kmer::compare(const Kmer& other) const
 	return memcmp(m_seq, other.m_seq, bytes());
 }
 
-/** Compute a hash-like value of the packed sequence over the first 16
- * bases and the reverse complement of the last 16 bases
- * The reverse complement of the last 16 bases is used so that a
- * sequence and its reverse complement will hash to the same value.
- * @todo make this faster
+/** Return a hash value of this k-mer that is the same for its
+ * reverse complement. The value is uniformly distributed, and is used
+ * to divide the k-mer among processes.
  */
 unsigned Kmer::getCode() const
 {
-	/* At k=19, this hash function always returns an even number due
-	 * to the sequence and its reverse complement overlapping when the
-	 * xor is calculated. A more general solution is needed. */
-	const unsigned NUM_BYTES
-		= s_length < 8 ? 1
-		: s_length < 20 ? s_length/8
-		: 4;
 	Kmer rc = *this;
 	rc.reverseComplement();
-
-	const unsigned prime = 101;
-	unsigned sum = 0;
-	for (unsigned i = 0; i < NUM_BYTES; i++)
-		sum = prime * sum + (m_seq[i] ^ rc.m_seq[i]);
-	return sum;
+	const Kmer& kmer = compare(rc) <= 0 ? *this : rc;
+	return hashmem(kmer.m_seq, bytes());
 }
 
 size_t Kmer::getHashCode() const
@@ -79,219 +136,29 @@ Sequence Kmer::str() const
 	return s;
 }
 
-/** Swap the positions of four bases. */
-static const uint8_t swapBases[256] = {
-	0x00, 0x40, 0x80, 0xc0, 0x10, 0x50, 0x90, 0xd0,
-	0x20, 0x60, 0xa0, 0xe0, 0x30, 0x70, 0xb0, 0xf0,
-	0x04, 0x44, 0x84, 0xc4, 0x14, 0x54, 0x94, 0xd4,
-	0x24, 0x64, 0xa4, 0xe4, 0x34, 0x74, 0xb4, 0xf4,
-	0x08, 0x48, 0x88, 0xc8, 0x18, 0x58, 0x98, 0xd8,
-	0x28, 0x68, 0xa8, 0xe8, 0x38, 0x78, 0xb8, 0xf8,
-	0x0c, 0x4c, 0x8c, 0xcc, 0x1c, 0x5c, 0x9c, 0xdc,
-	0x2c, 0x6c, 0xac, 0xec, 0x3c, 0x7c, 0xbc, 0xfc,
-	0x01, 0x41, 0x81, 0xc1, 0x11, 0x51, 0x91, 0xd1,
-	0x21, 0x61, 0xa1, 0xe1, 0x31, 0x71, 0xb1, 0xf1,
-	0x05, 0x45, 0x85, 0xc5, 0x15, 0x55, 0x95, 0xd5,
-	0x25, 0x65, 0xa5, 0xe5, 0x35, 0x75, 0xb5, 0xf5,
-	0x09, 0x49, 0x89, 0xc9, 0x19, 0x59, 0x99, 0xd9,
-	0x29, 0x69, 0xa9, 0xe9, 0x39, 0x79, 0xb9, 0xf9,
-	0x0d, 0x4d, 0x8d, 0xcd, 0x1d, 0x5d, 0x9d, 0xdd,
-	0x2d, 0x6d, 0xad, 0xed, 0x3d, 0x7d, 0xbd, 0xfd,
-	0x02, 0x42, 0x82, 0xc2, 0x12, 0x52, 0x92, 0xd2,
-	0x22, 0x62, 0xa2, 0xe2, 0x32, 0x72, 0xb2, 0xf2,
-	0x06, 0x46, 0x86, 0xc6, 0x16, 0x56, 0x96, 0xd6,
-	0x26, 0x66, 0xa6, 0xe6, 0x36, 0x76, 0xb6, 0xf6,
-	0x0a, 0x4a, 0x8a, 0xca, 0x1a, 0x5a, 0x9a, 0xda,
-	0x2a, 0x6a, 0xaa, 0xea, 0x3a, 0x7a, 0xba, 0xfa,
-	0x0e, 0x4e, 0x8e, 0xce, 0x1e, 0x5e, 0x9e, 0xde,
-	0x2e, 0x6e, 0xae, 0xee, 0x3e, 0x7e, 0xbe, 0xfe,
-	0x03, 0x43, 0x83, 0xc3, 0x13, 0x53, 0x93, 0xd3,
-	0x23, 0x63, 0xa3, 0xe3, 0x33, 0x73, 0xb3, 0xf3,
-	0x07, 0x47, 0x87, 0xc7, 0x17, 0x57, 0x97, 0xd7,
-	0x27, 0x67, 0xa7, 0xe7, 0x37, 0x77, 0xb7, 0xf7,
-	0x0b, 0x4b, 0x8b, 0xcb, 0x1b, 0x5b, 0x9b, 0xdb,
-	0x2b, 0x6b, 0xab, 0xeb, 0x3b, 0x7b, 0xbb, 0xfb,
-	0x0f, 0x4f, 0x8f, 0xcf, 0x1f, 0x5f, 0x9f, 0xdf,
-	0x2f, 0x6f, 0xaf, 0xef, 0x3f, 0x7f, 0xbf, 0xff
-};
-
-#if MAX_KMER > 96
-# include <bitset>
-typedef bitset<2 * MAX_KMER> Seq;
-#else
-# define SEQ_WORDS ((Kmer::NUM_BYTES + 7)/8)
-# define SEQ_BITS (64 * SEQ_WORDS)
-# define SEQ_FULL_WORDS ((int)Kmer::NUM_BYTES/8)
-# define SEQ_ODD_BYTES (Kmer::NUM_BYTES - 8*SEQ_FULL_WORDS)
-
-/** A sequence of bits of length SEQ_BITS. */
-struct Seq {
-	uint64_t x[SEQ_WORDS];
-
-	/** Return the number of bits in this sequence. */
-	static unsigned size() { return SEQ_BITS; }
-
-	/** Flip all the bits. */
-	void flip()
-	{
-		for (unsigned i = 0; i < SEQ_WORDS; i++)
-			x[i] = ~x[i];
-	}
-
-	/** Shift right by the specified number of bits. */
-	void operator>>=(uint8_t n)
-	{
-		if (n == 0)
-			return;
-#if MAX_KMER <= 32
-		x[0] >>= n;
-#elif MAX_KMER <= 64
-		uint64_t x0 = x[0], x1 = x[1];
-		if (n < 64) {
-			x[0] = x0 >> n;
-			x[1] = x1 >> n | x0 << (64 - n);
-		} else {
-			x[0] = 0;
-			x[1] = x0 >> (n - 64);
-		}
-#elif MAX_KMER <= 96
-		uint64_t x0 = x[0], x1 = x[1], x2 = x[2];
-		if (n < 64) {
-			x[0] = x0 >> n;
-			x[1] = x1 >> n | x0 << (64 - n);
-			x[2] = x2 >> n | x1 << (64 - n);
-		} else if (n == 64) {
-			x[0] = 0;
-			x[1] = x0;
-			x[2] = x1;
-		} else if (n < 128) {
-			n -= 64;
-			x[0] = 0;
-			x[1] = x0 >> n;
-			x[2] = x1 >> n | x0 << (64 - n);
-		} else {
-			n -= 128;
-			x[0] = 0;
-			x[1] = 0;
-			x[2] = x0 >> n;
-		}
-#else
-# error
-#endif
-	}
-};
-#endif
-
-/** Load with appropriate endianness for shifting. */
-static Seq load(const uint8_t *src)
-{
-	Seq seq;
-#if MAX_KMER > 96
-# if WORDS_BIGENDIAN
-	const uint64_t *s = reinterpret_cast<const uint64_t*>(src);
-	uint64_t *d = reinterpret_cast<uint64_t*>(&seq + 1);
-	copy(s, s + SEQ_WORDS, reverse_iterator<uint64_t*>(d));
-# else
-	uint8_t *d = reinterpret_cast<uint8_t*>(&seq);
-	memcpy(d, src, sizeof seq);
-	reverse(d, d + sizeof seq);
-# endif
-#else
-	uint64_t *px = seq.x;
-	const uint8_t *p = src;
-	for (int i = 0; i < SEQ_FULL_WORDS; i++) {
-		*px++ = (uint64_t)p[0] << 56
-			| (uint64_t)p[1] << 48
-			| (uint64_t)p[2] << 40
-			| (uint64_t)p[3] << 32
-			| (uint64_t)p[4] << 24
-			| (uint64_t)p[5] << 16
-			| (uint64_t)p[6] << 8
-			| (uint64_t)p[7] << 0;
-		p += 8;
-	}
-	if (SEQ_ODD_BYTES > 0) {
-		uint64_t x = 0;
-		if (SEQ_ODD_BYTES > 0) x |= (uint64_t)p[0] << 56;
-		if (SEQ_ODD_BYTES > 1) x |= (uint64_t)p[1] << 48;
-		if (SEQ_ODD_BYTES > 2) x |= (uint64_t)p[2] << 40;
-		if (SEQ_ODD_BYTES > 3) x |= (uint64_t)p[3] << 32;
-		if (SEQ_ODD_BYTES > 4) x |= (uint64_t)p[4] << 24;
-		if (SEQ_ODD_BYTES > 5) x |= (uint64_t)p[5] << 16;
-		if (SEQ_ODD_BYTES > 6) x |= (uint64_t)p[6] << 8;
-		if (SEQ_ODD_BYTES > 7) x |= (uint64_t)p[7] << 0;
-		*px = x;
-	}
-#endif
-	return seq;
-}
-
-/**
- * Reverse the bytes by storing them in the reverse order of
- * loading, and reverse the words in the same fashion.
- */
-static void storeReverse(uint8_t *dest, const Seq seq)
-{
-#if MAX_KMER > 96
-# if WORDS_BIGENDIAN
-	const uint64_t *s = reinterpret_cast<const uint64_t*>(&seq);
-	uint64_t *d = reinterpret_cast<uint64_t*>(dest);
-	copy(s, s + SEQ_WORDS,
-			reverse_iterator<uint64_t*>(d + SEQ_WORDS));
-	reverse(dest, dest + Kmer::NUM_BYTES);
-# else
-	memcpy(dest, &seq, Kmer::NUM_BYTES);
-# endif
-#else
-	const uint64_t *px = &seq.x[SEQ_WORDS-1];
-# if WORDS_BIGENDIAN
-	for (int i = 0; i < SEQ_FULL_WORDS; i++) {
-		dest[0] = *px >> 0;
-		dest[1] = *px >> 8;
-		dest[2] = *px >> 16;
-		dest[3] = *px >> 24;
-		dest[4] = *px >> 32;
-		dest[5] = *px >> 40;
-		dest[6] = *px >> 48;
-		dest[7] = *px >> 56;
-		dest += 8;
-		px--;
-	}
-# else
-	uint64_t *d = (uint64_t*)dest;
-	for (int i = 0; i < SEQ_FULL_WORDS; i++)
-		*d++ = *px--;
-	dest = (uint8_t*)d;
-# endif
-	if (SEQ_ODD_BYTES > 0) dest[0] = *px >> 0;
-	if (SEQ_ODD_BYTES > 1) dest[1] = *px >> 8;
-	if (SEQ_ODD_BYTES > 2) dest[2] = *px >> 16;
-	if (SEQ_ODD_BYTES > 3) dest[3] = *px >> 24;
-	if (SEQ_ODD_BYTES > 4) dest[4] = *px >> 32;
-	if (SEQ_ODD_BYTES > 5) dest[5] = *px >> 40;
-	if (SEQ_ODD_BYTES > 6) dest[6] = *px >> 48;
-	if (SEQ_ODD_BYTES > 7) dest[7] = *px >> 56;
-#endif
-}
-
 /** Reverse-complement this sequence. */
 void Kmer::reverseComplement()
 {
-	Seq seq = load((uint8_t*)m_seq);
-
-	// Complement the bits.
-	if (!opt::colourSpace)
-		seq.flip();
-
-	// Shift the bits flush to the right of the double word.
-	seq >>= seq.size() - 2*s_length;
-
-	storeReverse((uint8_t*)m_seq, seq);
-
-	// Reverse the pairs of bits withing a byte.
-	unsigned numBytes = bytes();
-	for (unsigned i = 0; i < numBytes; i++)
-		m_seq[i] = swapBases[(uint8_t)m_seq[i]];
+	unsigned n = bytes(), nwords = numWords(n);
+	uint64_t w[MAX_WORDS], rc[MAX_WORDS];
+	loadWords(w, m_seq, n);
+
+	// Reverse the words and the bases within each word, and
+	// complement the bits.
+	uint64_t mask = opt::colourSpace ? 0 : ~(uint64_t)0;
+	for (unsigned i = 0; i < nwords; i++)
+		rc[i] = reverseBases(w[nwords - 1 - i] ^ mask);
+
+	// Shift the bases flush to the left, which also clears the
+	// complemented padding that followed the last base.
+	unsigned shift = 64 * nwords - 2 * s_length;
+	assert(shift < 64);
+	if (shift > 0) {
+		for (unsigned i = 0; i + 1 < nwords; i++)
+			rc[i] = rc[i] << shift | rc[i + 1] >> (64 - shift);
+		rc[nwords - 1] <<= shift;
+	}
+	storeWords(m_seq, rc, n);
 }
 
 bool Kmer::isCanonical() const
@@ -325,15 +192,17 @@ void Kmer::setLastBase(extDirection dir, uint8_t base)
  */
 uint8_t Kmer::shiftAppend(uint8_t base)
 {
-	unsigned numBytes = bytes();
-	uint8_t shiftIn = base;
-	for(int i = numBytes - 1; i >= 0; i--)
-	{
-		unsigned index = (unsigned)i == numBytes - 1
-			? seqIndexToBaseIndex(s_length - 1) : 3;
-		shiftIn = leftShiftByte(m_seq, i, index, shiftIn);
-	}
-	return shiftIn;
+	unsigned n = bytes(), nwords = numWords(n);
+	uint64_t w[MAX_WORDS] = { };
+	loadWords(w, m_seq, n);
+	uint8_t out = w[0] >> 62;
+	for (unsigned i = 0; i + 1 < nwords; i++)
+		w[i] = w[i] << 2 | w[i + 1] >> 62;
+	w[nwords - 1] <<= 2;
+	unsigned last = s_length - 1;
+	w[last / 32] |= (uint64_t)(base & 0x3) << baseShift(last);
+	storeWords(m_seq, w, n);
+	return out;
 }
 
 /** Shift the sequence right and prepend a new base at the front.
@@ -341,55 +210,21 @@ uint8_t Kmer::shiftAppend(uint8_t base)
  */
 uint8_t Kmer::shiftPrepend(uint8_t base)
 {
-	unsigned numBytes = bytes();
-
-	unsigned lastBaseByte = seqIndexToByteNumber(s_length - 1);
-	unsigned lastBaseIndex = seqIndexToBaseIndex(s_length - 1);
-
-	// save the last base (which gets shifted out)
-	uint8_t lastBase = getBaseCode(m_seq,
-			lastBaseByte, lastBaseIndex);
-	// Zero the last base, which is required by compare.
-	setBaseCode(m_seq, lastBaseByte, lastBaseIndex, 0);
-
-	uint8_t shiftIn = base;
-	for(unsigned i = 0; i <= numBytes - 1; i++)
-	{
-		// index is always zero
-		unsigned index = 0;
-		shiftIn = rightShiftByte(m_seq, i, index, shiftIn);
-	}
-	return lastBase;
-}
-
-uint8_t Kmer::leftShiftByte(char* pSeq,
-		unsigned byteNum, unsigned index, uint8_t base)
-{
-	// save the first base
-	uint8_t outBase = (pSeq[byteNum] >> 6) & 0x3;
-
-	// shift left one position
-	pSeq[byteNum] <<= 2;
-
-	// Set the new base
-	setBaseCode(pSeq, byteNum, index, base);
-
-	return outBase;
-}
-
-uint8_t Kmer::rightShiftByte(char* pSeq,
-		unsigned byteNum, unsigned index, uint8_t base)
-{
-	// save the last base
-	uint8_t outBase = pSeq[byteNum] & 0x3;
-
-	// shift right one position
-	pSeq[byteNum] >>= 2;
-
-	// add the new base
-	setBaseCode(pSeq, byteNum, index, base);
-
-	return outBase;
+	unsigned n = bytes(), nwords = numWords(n);
+	uint64_t w[MAX_WORDS] = { };
+	loadWords(w, m_seq, n);
+
+	// Save and zero the last base, which is required by compare.
+	unsigned last = s_length - 1;
+	uint64_t& lastWord = w[last / 32];
+	uint8_t out = lastWord >> baseShift(last) & 0x3;
+	lastWord &= ~((uint64_t)0x3 << baseShift(last));
+
+	for (unsigned i = nwords - 1; i > 0; i--)
+		w[i] = w[i] >> 2 | w[i - 1] << 62;
+	w[0] = w[0] >> 2 | (uint64_t)(base & 0x3) << 62;
+	storeWords(m_seq, w, n);
+	return out;
 }
 
 //Set a base by byte number/ sub index
@@ -116,11 +116,6 @@ class Kmer
 	uint8_t at(unsigned i) const;
 	void set(unsigned i, uint8_t base);
 
-	static uint8_t leftShiftByte(char* pSeq,
-			unsigned byteNum, unsigned index, uint8_t base);
-	static uint8_t rightShiftByte(char* pSeq,
-			unsigned byteNum, unsigned index, uint8_t base);
-
   public:
 #if MAX_KMER > 96
 # if MAX_KMER % 32 != 0
@@ -3,39 +3,52 @@
 
 #include "Common/Sequence.h"
 #include "Common/Kmer.h"
+#include "Common/Options.h"
 #include <limits>
 #include <iterator>
 #include <string>
 
+/** Iterate over the k-mer of a sequence that contain only the bases
+ * ACGT, in either case, or the colours 0123. Each k-mer is rolled
+ * from the previous k-mer by shifting in one base, and its reverse
+ * complement is rolled alongside it.
+ */
 struct KmerIterator
 : public std::iterator<std::input_iterator_tag, Kmer>
 {
+	/** The code of a character that is not a base. */
+	static const uint8_t INVALID = 4;
+
+	/** Return the 2-bit code of the specified base, or INVALID. */
+	static uint8_t code(char c)
+	{
+		switch (c) {
+		  case 'A': case 'a': case '0': return 0;
+		  case 'C': case 'c': case '1': return 1;
+		  case 'G': case 'g': case '2': return 2;
+		  case 'T': case 't': case '3': return 3;
+		  default: return INVALID;
+		}
+	}
+
+	/** Shift in bases until the next k-mer is complete. */
 	void next()
 	{
-		for(; m_pos + m_k < m_seq.size() + 1; m_pos++) {
-			//TODO(daattali) substr() and find_first_not_of() might be
-			// slow and could be improved for better performance
-			std::string kmerStr = m_seq.substr(m_pos, m_k);
-
-			if (m_pos_invalid >= m_pos + m_k) {
-				// no invalid characters in current kmer, move along
-			} else {
-				size_t pos = m_seq.find_first_not_of("AGCTagct", m_pos);
-				if (pos == std::string::npos) {
-					m_pos_invalid = std::numeric_limits<std::size_t>::max();
-				} else if (pos >= m_pos + m_k) {
-					m_pos_invalid = pos;
-				} else {
-					pos = kmerStr.find_last_not_of("AGCTagct");
-					m_pos += pos;
-					continue;
-				}
+		for (; m_next < m_seq.size(); m_next++) {
+			char c = m_seq[m_next];
+			uint8_t x = code(c);
+			if (x == INVALID) {
+				m_run = 0;
+				continue;
+			}
+			if (c >= 'a')
+				m_lastMasked = m_next;
+			m_kmer.shift(SENSE, x);
+			m_rcKmer.shift(ANTISENSE, opt::colourSpace ? x : 3 - x);
+			if (++m_run >= m_k) {
+				m_pos = ++m_next - m_k;
+				return;
 			}
-
-			m_kmer = Kmer(kmerStr);
-			if (m_rc)
-				m_kmer.reverseComplement();
-			return;
 		}
 		m_pos = std::numeric_limits<std::size_t>::max();
 	}
@@ -44,20 +57,47 @@ public:
 
 	KmerIterator() :
 		m_seq(),
+		m_k(0), m_rc(false),
 		m_pos(std::numeric_limits<std::size_t>::max()),
-		m_pos_invalid(0),
-		m_kmer() { }
+		m_next(0), m_run(0),
+		m_lastMasked(std::numeric_limits<std::size_t>::max()),
+		m_kmer(), m_rcKmer() { }
 
 	KmerIterator(const Sequence& seq, unsigned k, bool rc = false)
-		: m_seq(seq), m_k(k), m_rc(rc), m_pos(0), m_pos_invalid(0), m_kmer()
+		: m_seq(seq), m_k(k), m_rc(rc), m_pos(0),
+		m_next(0), m_run(0),
+		m_lastMasked(std::numeric_limits<std::size_t>::max()),
+		m_kmer(), m_rcKmer()
 	{
+		assert(k == Kmer::length());
+		if (m_seq.size() < m_k) {
+			m_pos = std::numeric_limits<std::size_t>::max();
+			return;
+		}
+		// Zero the k-mer, which is required by compare.
+		m_kmer = m_rcKmer = Kmer(Sequence(m_k, 'A'));
 		next();
 	}
 
+	/** Return the k-mer, or its reverse complement if rc is set. */
 	const Kmer& operator*() const
 	{
 		assert(m_pos + m_k < m_seq.size() + 1);
-		return m_kmer;
+		return m_rc ? m_rcKmer : m_kmer;
+	}
+
+	/** Return the lesser of the k-mer and its reverse complement. */
+	const Kmer& canonical() const
+	{
+		assert(m_pos + m_k < m_seq.size() + 1);
+		return m_rcKmer < m_kmer ? m_rcKmer : m_kmer;
+	}
+
+	/** Return whether this k-mer contains a lower-case base. */
+	bool masked() const
+	{
+		return m_lastMasked != std::numeric_limits<std::size_t>::max()
+			&& m_lastMasked >= m_pos;
 	}
 
 	bool operator==(const KmerIterator& it) const
@@ -73,7 +113,6 @@ public:
 	KmerIterator& operator++()
 	{
 		assert(m_pos + m_k < m_seq.size() + 1);
-		m_pos++;
 		next();
 		return *this;
 	}
@@ -91,20 +130,30 @@ public:
 
 	static const KmerIterator& end()
 	{
-		return KmerIterator::m_end;
+		static const KmerIterator s_end;
+		return s_end;
 	}
-	
+
 private:
 
 	const Sequence m_seq;
 	unsigned m_k;
 	bool m_rc;
+
+	/** The position of the current k-mer. */
 	size_t m_pos;
-	size_t m_pos_invalid;
+
+	/** The position of the next base to shift in. */
+	size_t m_next;
+
+	/** The number of consecutive bases shifted in. */
+	size_t m_run;
+
+	/** The position of the last lower-case base. */
+	size_t m_lastMasked;
+
 	Kmer m_kmer;
-	static const KmerIterator m_end;
+	Kmer m_rcKmer;
 };
 
-const KmerIterator KmerIterator::m_end = KmerIterator();
-
 #endif
@@ -0,0 +1,142 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H 1
+
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** A file mapped read-only into memory. Concurrent processes that map
+ * the same file share one copy of it in the page cache.
+ */
+class MappedFile
+{
+  public:
+	/** Map the file at the specified path. */
+	explicit MappedFile(const std::string& path)
+		: m_path(path), m_data(NULL), m_size(0)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1)
+			die();
+		struct stat st;
+		if (fstat(fd, &st) == -1)
+			die();
+		m_size = st.st_size;
+		if (m_size > 0) {
+			void* p = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED)
+				die();
+			m_data = static_cast<const char*>(p);
+			// Start reading the file in the background.
+			madvise(p, m_size, MADV_WILLNEED);
+		}
+		::close(fd);
+	}
+
+	~MappedFile()
+	{
+		if (m_data != NULL)
+			munmap(const_cast<char*>(m_data), m_size);
+	}
+
+	/** Return the path of the file. */
+	const std::string& path() const { return m_path; }
+
+	/** Return the contents of the file. */
+	const char* data() const { return m_data; }
+
+	/** Return the size of the file. */
+	size_t size() const { return m_size; }
+
+	/** Return a pointer to n elements of type T at position pos of
+	 * the file, and advance pos past them.
+	 */
+	template <typename T>
+	const T* map(uint64_t& pos, size_t n) const
+	{
+		assert(pos % sizeof (T) == 0);
+		if (pos > m_size || n > (m_size - pos) / sizeof (T)) {
+			std::cerr << "error: `" << m_path
+				<< "': file is truncated\n";
+			exit(EXIT_FAILURE);
+		}
+		const T* p = reinterpret_cast<const T*>(m_data + pos);
+		pos += n * sizeof (T);
+		return p;
+	}
+
+	/** The alignment of the sections of a mappable file. */
+	static const unsigned ALIGNMENT = 4096;
+
+	/** Return the number of bytes of padding that follow position pos
+	 * to align the next section.
+	 */
+	static size_t padding(uint64_t pos)
+	{
+		return (ALIGNMENT - pos % ALIGNMENT) % ALIGNMENT;
+	}
+
+	/** Write n elements of type T, and advance pos past them. */
+	template <typename T>
+	static void write(std::ostream& out, uint64_t& pos,
+			const T* p, size_t n)
+	{
+		out.write(reinterpret_cast<const char*>(p), n * sizeof (T));
+		pos += n * sizeof (T);
+	}
+
+	/** Read n elements of type T, and advance pos past them. */
+	template <typename T>
+	static void read(std::istream& in, uint64_t& pos, T* p, size_t n)
+	{
+		in.read(reinterpret_cast<char*>(p), n * sizeof (T));
+		pos += n * sizeof (T);
+	}
+
+	/** Write the padding that aligns the next section. */
+	static void writePadding(std::ostream& out, uint64_t& pos)
+	{
+		static const char zeros[ALIGNMENT] = {};
+		write(out, pos, zeros, padding(pos));
+	}
+
+	/** Skip the padding that aligns the next section. */
+	static void readPadding(std::istream& in, uint64_t& pos)
+	{
+		size_t n = padding(pos);
+		in.ignore(n);
+		pos += n;
+	}
+
+	/** Skip the padding that aligns the next section. */
+	static void mapPadding(uint64_t& pos)
+	{
+		pos += padding(pos);
+	}
+
+  private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	/** Print an error message and exit. */
+	void die() const
+	{
+		std::cerr << "error: `" << m_path << "': "
+			<< strerror(errno) << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	std::string m_path;
+	const char* m_data;
+	size_t m_size;
+};
+
+#endif
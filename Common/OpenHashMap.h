@@ -0,0 +1,548 @@
+#ifndef OPENHASHMAP_H
+#define OPENHASHMAP_H 1
+
+#include "config.h"
+#include "Common/Hash.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/**
+ * An open-addressing hash table with linear probing.
+ *
+ * The entries are stored inline in one flat array that is aligned to
+ * a cache line. The array is divided into buckets of BUCKET_SLOTS
+ * slots, as many entries as fit in CACHE_LINE bytes, and a key hashes
+ * to the first slot of its bucket. When the size of an entry divides
+ * CACHE_LINE, each bucket is exactly one cache line, and the first
+ * probe of a lookup reads a single cache line; otherwise a bucket may
+ * straddle two cache lines. Probing continues linearly into the
+ * following buckets. An occupancy bitmap stores one bit per slot.
+ *
+ * Deletion shifts the following entries backward rather than leaving
+ * a tombstone, so erasing entries never lengthens a probe sequence.
+ * An erase may move a later entry into the erased slot, so the
+ * iterator returned by erase() must be examined again.
+ *
+ * clear() zeroes only the words of the occupancy bitmap that have
+ * been set since the last clear, so that clearing a large table that
+ * holds few entries is cheap.
+ *
+ * The table is resized in place with realloc, so that growing it
+ * does not hold two copies of the table at once. For that reason the
+ * key and the value must be plain old data that may be moved with
+ * memcpy.
+ *
+ * The interface mimics sparse_hash_map, so that this table is a
+ * drop-in replacement for SequenceDataHash.
+ */
+template <typename K, typename T, typename Hash = hash<K> >
+class OpenHashMap
+{
+  public:
+	typedef K key_type;
+	typedef T mapped_type;
+	typedef std::pair<const K, T> value_type;
+	typedef Hash hasher;
+	typedef size_t size_type;
+
+	/** The size of a cache line in bytes. */
+	static const size_t CACHE_LINE = 64;
+
+	/** The number of slots in a bucket, which is at most one cache
+	 * line in size unless an entry is larger than a cache line. */
+	static const size_t BUCKET_SLOTS = sizeof (value_type) < CACHE_LINE
+		? CACHE_LINE / sizeof (value_type) : 1;
+
+  private:
+	/** Iterate over the occupied slots of the table. */
+	template <typename Map, typename Value>
+	class basic_iterator
+		: public std::iterator<std::forward_iterator_tag, Value>
+	{
+	  public:
+		basic_iterator() : m_map(NULL), m_i(0) { }
+		basic_iterator(Map* map, size_t i) : m_map(map), m_i(i) { }
+
+		/** Convert an iterator to a const_iterator. */
+		template <typename M, typename V>
+		basic_iterator(const basic_iterator<M, V>& it)
+			: m_map(it.m_map), m_i(it.m_i) { }
+
+		Value& operator*() const { return m_map->slot(m_i); }
+		Value* operator->() const { return &m_map->slot(m_i); }
+
+		basic_iterator& operator++()
+		{
+			m_i = m_map->nextUsed(m_i + 1);
+			return *this;
+		}
+
+		basic_iterator operator++(int)
+		{
+			basic_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+		bool operator==(const basic_iterator& it) const
+		{
+			return m_i == it.m_i;
+		}
+
+		bool operator!=(const basic_iterator& it) const
+		{
+			return m_i != it.m_i;
+		}
+
+		Map* m_map;
+		size_t m_i;
+	};
+
+  public:
+	typedef basic_iterator<OpenHashMap, value_type> iterator;
+	typedef basic_iterator<const OpenHashMap, const value_type>
+		const_iterator;
+
+	OpenHashMap()
+		: m_alloc(NULL), m_slots(NULL), m_capacity(0), m_size(0),
+		m_maxLoad(0.8), m_dirtyAll(false)
+	{
+	}
+
+	OpenHashMap(const OpenHashMap& o)
+		: m_alloc(NULL), m_slots(NULL), m_capacity(0), m_size(0),
+		m_maxLoad(o.m_maxLoad), m_hash(o.m_hash), m_dirtyAll(true)
+	{
+		reallocate(o.m_capacity);
+		m_capacity = o.m_capacity;
+		if (m_capacity > 0)
+			memcpy(m_slots, o.m_slots, m_capacity * sizeof *m_slots);
+		m_used = o.m_used;
+		m_size = o.m_size;
+	}
+
+	OpenHashMap& operator=(OpenHashMap o)
+	{
+		swap(o);
+		return *this;
+	}
+
+	~OpenHashMap()
+	{
+		free(m_alloc);
+	}
+
+	void swap(OpenHashMap& o)
+	{
+		std::swap(m_alloc, o.m_alloc);
+		std::swap(m_slots, o.m_slots);
+		m_used.swap(o.m_used);
+		std::swap(m_capacity, o.m_capacity);
+		std::swap(m_size, o.m_size);
+		std::swap(m_maxLoad, o.m_maxLoad);
+		std::swap(m_hash, o.m_hash);
+		m_dirty.swap(o.m_dirty);
+		std::swap(m_dirtyAll, o.m_dirtyAll);
+	}
+
+	iterator begin() { return iterator(this, nextUsed(0)); }
+	const_iterator begin() const
+	{
+		return const_iterator(this, nextUsed(0));
+	}
+	iterator end() { return iterator(this, m_capacity); }
+	const_iterator end() const
+	{
+		return const_iterator(this, m_capacity);
+	}
+
+	bool empty() const { return m_size == 0; }
+	size_t size() const { return m_size; }
+	size_t bucket_count() const { return m_capacity; }
+	/** Return the number of bytes allocated by this table, including
+	 * the slots that are empty. */
+	size_t allocated_size() const
+	{
+		return m_capacity * sizeof *m_slots
+			+ m_used.capacity() * sizeof m_used[0]
+			+ m_dirty.capacity() * sizeof m_dirty[0];
+	}
+
+	float load_factor() const
+	{
+		return m_capacity == 0 ? 0 : (float)m_size / m_capacity;
+	}
+
+	float max_load_factor() const { return m_maxLoad; }
+
+	/** Set the maximum load factor before the table grows. */
+	void max_load_factor(float x)
+	{
+		assert(x > 0 && x < 1);
+		m_maxLoad = x;
+	}
+
+	/** Return an iterator to the specified key. */
+	iterator find(const key_type& key)
+	{
+		return iterator(this, findSlot(key));
+	}
+
+	/** Return an iterator to the specified key. */
+	const_iterator find(const key_type& key) const
+	{
+		return const_iterator(this, findSlot(key));
+	}
+
+	size_t count(const key_type& key) const
+	{
+		return findSlot(key) != m_capacity;
+	}
+
+	/** Insert the specified value if its key is not present.
+	 * @return an iterator to the entry and whether it was inserted
+	 */
+	std::pair<iterator, bool> insert(const value_type& x)
+	{
+		size_t i = findSlot(x.first);
+		if (i != m_capacity)
+			return std::make_pair(iterator(this, i), false);
+
+		// Grow only when a new entry is added, so that inserting a
+		// key that is present never invalidates iterators.
+		if (m_size + 1 > m_maxLoad * m_capacity) {
+			// Grow by half rather than doubling to limit the memory
+			// overhead.
+			rehash(std::max(m_size + 1, m_size + m_size / 2));
+		}
+		for (i = home(x.first); isUsed(i); i = next(i))
+			;
+		new (&m_slots[i]) value_type(x);
+		setUsed(i);
+		m_size++;
+		return std::make_pair(iterator(this, i), true);
+	}
+
+	/** Return the value of the specified key, inserting a default
+	 * value if it is not present.
+	 */
+	mapped_type& operator[](const key_type& key)
+	{
+		return insert(value_type(key, mapped_type())).first->second;
+	}
+
+	/** Erase the entry at the specified position.
+	 * Entries following the erased entry in its probe sequence are
+	 * shifted backward to fill the hole.
+	 * @return an iterator to the next entry to examine, which is the
+	 * same slot if an entry was shifted into it
+	 */
+	iterator erase(iterator it)
+	{
+		size_t hole = it.m_i;
+		assert(hole < m_capacity && isUsed(hole));
+		clearUsed(hole);
+		m_size--;
+		for (size_t j = next(hole); isUsed(j); j = next(j)) {
+			// Move the entry at j if the hole lies between its home
+			// slot and j, cyclically.
+			if (distance(home(slot(j).first), j) >= distance(hole, j)) {
+				m_slots[hole] = m_slots[j];
+				setUsed(hole);
+				clearUsed(j);
+				hole = j;
+			}
+		}
+		return iterator(this, isUsed(it.m_i) ? it.m_i
+				: nextUsed(it.m_i + 1));
+	}
+
+	/** Erase the specified key.
+	 * @return the number of entries erased
+	 */
+	size_t erase(const key_type& key)
+	{
+		size_t i = findSlot(key);
+		if (i == m_capacity)
+			return 0;
+		erase(iterator(this, i));
+		return 1;
+	}
+
+	/** Remove all entries without releasing memory. The time taken
+	 * is proportional to the number of entries inserted since the
+	 * last clear, up to the size of the occupancy bitmap.
+	 */
+	void clear()
+	{
+		if (m_dirtyAll) {
+			std::fill(m_used.begin(), m_used.end(), 0);
+		} else {
+			for (std::vector<size_t>::const_iterator it
+					= m_dirty.begin(); it != m_dirty.end(); ++it)
+				if (*it < m_used.size())
+					m_used[*it] = 0;
+		}
+		m_dirty.clear();
+		m_dirtyAll = false;
+		m_size = 0;
+	}
+
+	/** Resize the table to hold at least n entries without
+	 * exceeding the maximum load factor. If n is zero, shrink the
+	 * table to fit its current contents.
+	 */
+	void rehash(size_t n)
+	{
+		n = std::max(n, m_size);
+		size_t buckets = (size_t)(n / m_maxLoad) / BUCKET_SLOTS + 1;
+		resize(std::max(buckets, (size_t)2) * BUCKET_SLOTS);
+	}
+
+	/** Write the size of this table. */
+	bool write_metadata(FILE* f)
+	{
+		uint64_t header[2] = { m_capacity, m_size };
+		return fwrite(header, sizeof header, 1, f) == 1;
+	}
+
+	/** Write the occupancy bitmap and the slots of this table. */
+	bool write_nopointer_data(FILE* f)
+	{
+		return fwrite(&m_used[0], sizeof m_used[0], m_used.size(), f)
+				== m_used.size()
+			&& fwrite(m_slots, sizeof *m_slots, m_capacity, f)
+				== m_capacity;
+	}
+
+	/** Read the size of this table and allocate it. */
+	bool read_metadata(FILE* f)
+	{
+		uint64_t header[2];
+		if (fread(header, sizeof header, 1, f) != 1
+				|| header[0] % BUCKET_SLOTS != 0
+				|| header[1] >= header[0])
+			return false;
+		clear();
+		resize(header[0]);
+		m_size = header[1];
+		return true;
+	}
+
+	/** Read the occupancy bitmap and the slots of this table. */
+	bool read_nopointer_data(FILE* f)
+	{
+		m_dirtyAll = true;
+		return fread(&m_used[0], sizeof m_used[0], m_used.size(), f)
+				== m_used.size()
+			&& fread(m_slots, sizeof *m_slots, m_capacity, f)
+				== m_capacity;
+	}
+
+  private:
+	/** Uninitialized storage for one entry. The array of slots is
+	 * aligned to a cache line, which aligns every entry.
+	 */
+	struct Slot {
+		char data[sizeof (value_type)];
+	};
+
+	value_type& slot(size_t i)
+	{
+		return *reinterpret_cast<value_type*>(&m_slots[i]);
+	}
+
+	const value_type& slot(size_t i) const
+	{
+		return *reinterpret_cast<const value_type*>(&m_slots[i]);
+	}
+
+	bool isUsed(size_t i) const
+	{
+		return m_used[i / 64] & (uint64_t)1 << (i % 64);
+	}
+
+	/** Mark slot i occupied, and record the word of the bitmap to be
+	 * zeroed by clear. */
+	void setUsed(size_t i)
+	{
+		uint64_t& word = m_used[i / 64];
+		if (word == 0 && !m_dirtyAll) {
+			// Zero the whole bitmap rather than record more words
+			// than a fraction of it.
+			if (m_dirty.size() < m_used.size() / 8)
+				m_dirty.push_back(i / 64);
+			else
+				m_dirtyAll = true;
+		}
+		word |= (uint64_t)1 << (i % 64);
+	}
+	void clearUsed(size_t i)
+	{
+		m_used[i / 64] &= ~((uint64_t)1 << (i % 64));
+	}
+
+	/** Return the index of the first occupied slot at or after i,
+	 * or the capacity if there is none.
+	 */
+	size_t nextUsed(size_t i) const
+	{
+		while (i < m_capacity) {
+			uint64_t word = m_used[i / 64] >> (i % 64);
+			if (word != 0) {
+#if __GNUC__
+				i += __builtin_ctzll(word);
+#else
+				for (; (word & 1) == 0; word >>= 1)
+					i++;
+#endif
+				return i;
+			}
+			i = (i / 64 + 1) * 64;
+		}
+		return m_capacity;
+	}
+
+	/** Return the slot following slot i, cyclically. */
+	size_t next(size_t i) const
+	{
+		return ++i == m_capacity ? 0 : i;
+	}
+
+	/** Return the distance from slot i forward to slot j. */
+	size_t distance(size_t i, size_t j) const
+	{
+		return j >= i ? j - i : j + m_capacity - i;
+	}
+
+	/** Return the first slot of the bucket of the specified key. */
+	size_t home(const key_type& key) const
+	{
+		// Scramble the hash with Fibonacci hashing and scale it to
+		// the number of buckets without a division.
+		uint64_t h = (uint64_t)m_hash(key) * 0x9e3779b97f4a7c15ULL;
+		uint64_t buckets = m_capacity / BUCKET_SLOTS;
+#if __GNUC__ && __x86_64__
+		return (size_t)(((unsigned __int128)h * buckets) >> 64)
+			* BUCKET_SLOTS;
+#else
+		return (h >> 32) % buckets * BUCKET_SLOTS;
+#endif
+	}
+
+	/** Return the slot of the specified key,
+	 * or the capacity if it is not present.
+	 */
+	size_t findSlot(const key_type& key) const
+	{
+		if (m_size == 0)
+			return m_capacity;
+		for (size_t i = home(key); isUsed(i); i = next(i))
+			if (slot(i).first == key)
+				return i;
+		return m_capacity;
+	}
+
+	/** Change the number of slots, and move every entry to its new
+	 * position in place.
+	 */
+	void resize(size_t capacity)
+	{
+		if (capacity == m_capacity)
+			return;
+		assert(capacity % BUCKET_SLOTS == 0);
+		assert(capacity > m_size);
+		size_t oldCapacity = m_capacity;
+		if (capacity > oldCapacity)
+			reallocate(capacity);
+		m_capacity = capacity;
+
+		// Place each entry at its new position. A placed entry is
+		// never moved again, and probing skips only placed entries.
+		// An unplaced entry in the way is displaced and placed next.
+		std::vector<uint64_t> placed(
+				(std::max(capacity, oldCapacity) + 63) / 64);
+		for (size_t i = 0; i < oldCapacity; i++) {
+			if (!isUsed(i) || (placed[i / 64] >> (i % 64) & 1))
+				continue;
+			Slot x = m_slots[i];
+			clearUsed(i);
+			for (;;) {
+				size_t j = home(
+						reinterpret_cast<const value_type&>(x).first);
+				while (placed[j / 64] >> (j % 64) & 1)
+					j = next(j);
+				placed[j / 64] |= (uint64_t)1 << (j % 64);
+				if (!isUsed(j)) {
+					m_slots[j] = x;
+					setUsed(j);
+					break;
+				}
+				std::swap(x, m_slots[j]);
+			}
+		}
+
+		if (capacity < oldCapacity)
+			reallocate(capacity);
+	}
+
+	/** Change the size of the arrays to the specified number of
+	 * slots, preserving their contents. The slots are aligned to a
+	 * cache line.
+	 */
+	void reallocate(size_t capacity)
+	{
+		size_t oldOffset = (char*)m_slots - (char*)m_alloc;
+		size_t n = std::min(capacity, m_capacity) * sizeof *m_slots;
+		void* p = realloc(m_alloc,
+				capacity * sizeof *m_slots + CACHE_LINE);
+		if (p == NULL)
+			throw std::bad_alloc();
+		m_alloc = p;
+		m_slots = reinterpret_cast<Slot*>(
+				((uintptr_t)p + CACHE_LINE - 1)
+				& ~(uintptr_t)(CACHE_LINE - 1));
+		size_t offset = (char*)m_slots - (char*)m_alloc;
+		if (offset != oldOffset && n > 0)
+			memmove(m_slots, (char*)m_alloc + oldOffset, n);
+		m_used.resize((capacity + 63) / 64);
+	}
+
+	/** The block of memory holding the slots. */
+	void* m_alloc;
+
+	/** The entries, aligned to a cache line within m_alloc. */
+	Slot* m_slots;
+
+	/** The occupancy bitmap. */
+	std::vector<uint64_t> m_used;
+
+	/** The number of slots, a multiple of BUCKET_SLOTS. */
+	size_t m_capacity;
+
+	/** The number of entries. */
+	size_t m_size;
+
+	/** The maximum load factor. */
+	float m_maxLoad;
+
+	/** The hash function. */
+	Hash m_hash;
+
+	/** The words of the occupancy bitmap that have become nonzero
+	 * since the last clear. */
+	std::vector<size_t> m_dirty;
+
+	/** Whether clear must zero the entire occupancy bitmap. */
+	bool m_dirtyAll;
+};
+
+#endif
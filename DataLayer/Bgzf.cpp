@@ -0,0 +1,203 @@
+#include "DataLayer/Bgzf.h"
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+#if HAVE_ZLIB_H && HAVE_LIBZ
+# include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace Bgzf {
+
+/** The size of the header of a block written by bgzip. */
+static const unsigned HEADER_SIZE = 18;
+
+/** The size of the CRC and size that follow the compressed data. */
+static const unsigned FOOTER_SIZE = 8;
+
+/** The maximum size of a block. */
+static const unsigned MAX_BLOCK_SIZE = 1 << 16;
+
+/** Return whether p is the header of a block written by bgzip: a
+ * gzip header with the extra field holding only the BC subfield.
+ */
+static bool isHeader(const unsigned char* p)
+{
+	return p[0] == 31 && p[1] == 139 && p[2] == 8 && (p[3] & 4)
+		&& p[10] == 6 && p[11] == 0
+		&& p[12] == 'B' && p[13] == 'C' && p[14] == 2 && p[15] == 0;
+}
+
+/** Return the size of the block whose header is p. */
+static uint32_t blockSize(const unsigned char* p)
+{
+	return (p[16] | p[17] << 8) + 1;
+}
+
+/** Read the header of the block at the specified offset, and
+ * return the size of the compressed block and of its data.
+ * @return false if there is no block at this offset
+ */
+bool readBlockSize(FILE* f, uint64_t offset,
+		uint32_t& size, uint32_t& dataSize)
+{
+	unsigned char p[HEADER_SIZE];
+	if (fseeko(f, offset, SEEK_SET) != 0
+			|| fread(p, 1, sizeof p, f) != sizeof p || !isHeader(p))
+		return false;
+	size = blockSize(p);
+	unsigned char q[4];
+	if (fseeko(f, offset + size - sizeof q, SEEK_SET) != 0
+			|| fread(q, 1, sizeof q, f) != sizeof q)
+		return false;
+	dataSize = q[0] | q[1] << 8 | q[2] << 16 | (uint32_t)q[3] << 24;
+	return true;
+}
+
+/** Return the offset of the first block that starts at or after the
+ * specified offset, or the size of the file if there is none. A
+ * candidate block is accepted only if it is followed by another
+ * block or by the end of the file.
+ */
+uint64_t findBlock(FILE* f, uint64_t offset)
+{
+	struct stat st;
+	if (fstat(fileno(f), &st) != 0)
+		return offset;
+	uint64_t fileSize = st.st_size;
+
+	vector<unsigned char> buf(MAX_BLOCK_SIZE + HEADER_SIZE);
+	for (uint64_t start = offset; start < fileSize;
+			start += MAX_BLOCK_SIZE) {
+		if (fseeko(f, start, SEEK_SET) != 0)
+			break;
+		size_t n = fread(&buf[0], 1, buf.size(), f);
+		for (size_t i = 0; i + HEADER_SIZE <= n
+				&& i < MAX_BLOCK_SIZE; i++) {
+			if (buf[i] != 31 || !isHeader(&buf[i]))
+				continue;
+			uint64_t next = start + i + blockSize(&buf[i]);
+			uint32_t size, dataSize;
+			if (next == fileSize
+					|| readBlockSize(f, next, size, dataSize))
+				return start + i;
+		}
+	}
+	return fileSize;
+}
+
+/** Return whether the specified file is compressed with BGZF. */
+bool isBgzf(const char* path)
+{
+	// Opening a file with mode "rb" bypasses the hook that
+	// decompresses it through a pipe.
+	FILE* f = fopen(path, "rb");
+	if (f == NULL)
+		return false;
+	unsigned char p[HEADER_SIZE];
+	bool bgzf = fread(p, 1, sizeof p, f) == sizeof p && isHeader(p);
+	fclose(f);
+	return bgzf;
+}
+
+} // namespace Bgzf
+
+/** Decompress the blocks of the specified BGZF file starting at the
+ * block at the specified offset. */
+BgzfStreambuf::BgzfStreambuf(const string& path, uint64_t offset)
+	: m_path(path), m_file(fopen(path.c_str(), "rb")),
+	m_offset(offset), m_pos(0),
+	m_block(Bgzf::MAX_BLOCK_SIZE), m_buffer(Bgzf::MAX_BLOCK_SIZE)
+{
+	if (m_file == NULL) {
+		cerr << "error: `" << m_path << "': "
+			<< strerror(errno) << endl;
+		exit(EXIT_FAILURE);
+	}
+	setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+}
+
+BgzfStreambuf::~BgzfStreambuf()
+{
+	fclose(m_file);
+}
+
+/** Print an error message and exit. */
+void BgzfStreambuf::die(const char* message) const
+{
+	cerr << "error: `" << m_path << "': " << message
+		<< " at offset " << m_offset << endl;
+	exit(EXIT_FAILURE);
+}
+
+/** Decompress the next non-empty block. */
+BgzfStreambuf::int_type BgzfStreambuf::underflow()
+{
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+	m_pos += egptr() - eback();
+	setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+
+#if HAVE_ZLIB_H && HAVE_LIBZ
+	using namespace Bgzf;
+	unsigned char* p = &m_block[0];
+	for (;;) {
+		if (fseeko(m_file, m_offset, SEEK_SET) != 0)
+			die(strerror(errno));
+		size_t n = fread(p, 1, HEADER_SIZE, m_file);
+		if (n == 0)
+			return traits_type::eof();
+		if (n != HEADER_SIZE || !isHeader(p))
+			die("invalid BGZF block");
+		uint32_t size = blockSize(p);
+		if (size < HEADER_SIZE + FOOTER_SIZE
+				|| fread(p + HEADER_SIZE, 1, size - HEADER_SIZE,
+					m_file) != size - HEADER_SIZE)
+			die("truncated BGZF block");
+		const unsigned char* footer = p + size - FOOTER_SIZE;
+		uint32_t crc = footer[0] | footer[1] << 8 | footer[2] << 16
+			| (uint32_t)footer[3] << 24;
+		uint32_t dataSize = footer[4] | footer[5] << 8
+			| footer[6] << 16 | (uint32_t)footer[7] << 24;
+		if (dataSize > MAX_BLOCK_SIZE)
+			die("invalid BGZF block");
+
+		z_stream zs;
+		memset(&zs, 0, sizeof zs);
+		zs.next_in = p + HEADER_SIZE;
+		zs.avail_in = size - HEADER_SIZE - FOOTER_SIZE;
+		zs.next_out = reinterpret_cast<Bytef*>(&m_buffer[0]);
+		zs.avail_out = m_buffer.size();
+		if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+			die("unable to initialize zlib");
+		int status = inflate(&zs, Z_FINISH);
+		inflateEnd(&zs);
+		if (status != Z_STREAM_END || zs.total_out != dataSize
+				|| crc32(0, zs.next_out - dataSize, dataSize) != crc)
+			die("corrupt BGZF block");
+
+		m_offset += size;
+		if (dataSize > 0) {
+			setg(&m_buffer[0], &m_buffer[0],
+					&m_buffer[0] + dataSize);
+			return traits_type::to_int_type(*gptr());
+		}
+	}
+#else
+	die("BGZF is not supported without zlib");
+	return traits_type::eof();
+#endif
+}
+
+/** Return the current position. Seeking is not supported. */
+BgzfStreambuf::pos_type BgzfStreambuf::seekoff(off_type off,
+		ios_base::seekdir dir, ios_base::openmode which)
+{
+	if (off != 0 || dir != ios_base::cur || !(which & ios_base::in))
+		return pos_type(off_type(-1));
+	return pos_type(off_type(m_pos + (gptr() - eback())));
+}
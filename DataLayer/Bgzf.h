@@ -0,0 +1,77 @@
+#ifndef DATALAYER_BGZF_H
+#define DATALAYER_BGZF_H 1
+
+#include "config.h"
+#include <cstdio>
+#include <stdint.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/** Blocked GNU Zip Format (BGZF), as written by bgzip. A BGZF file
+ * is a series of gzip members, called blocks, of at most 64 kB each,
+ * whose headers record the size of the block. Reading may start at
+ * any block, so a BGZF file may be divided among processes or
+ * threads without an index.
+ */
+namespace Bgzf {
+
+/** Return whether BGZF-compressed files may be read natively. */
+static inline bool enabled()
+{
+#if HAVE_ZLIB_H && HAVE_LIBZ
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool isBgzf(const char* path);
+uint64_t findBlock(FILE* f, uint64_t offset);
+bool readBlockSize(FILE* f, uint64_t offset,
+		uint32_t& blockSize, uint32_t& dataSize);
+
+} // namespace Bgzf
+
+/** A stream buffer that decompresses the blocks of a BGZF file
+ * starting at a given block. The position of the stream is the
+ * number of decompressed bytes that precede it, counted from the
+ * first block read.
+ */
+class BgzfStreambuf : public std::streambuf
+{
+  public:
+	BgzfStreambuf(const std::string& path, uint64_t offset);
+	~BgzfStreambuf();
+
+  protected:
+	int_type underflow();
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+			std::ios_base::openmode which);
+
+  private:
+	BgzfStreambuf(const BgzfStreambuf&);
+	BgzfStreambuf& operator=(const BgzfStreambuf&);
+
+	void die(const char* message) const;
+
+	/** The path of the file. */
+	std::string m_path;
+
+	/** The file. */
+	FILE* m_file;
+
+	/** The offset in the file of the next block. */
+	uint64_t m_offset;
+
+	/** The number of decompressed bytes preceding the buffer. */
+	uint64_t m_pos;
+
+	/** The compressed block. */
+	std::vector<unsigned char> m_block;
+
+	/** The decompressed block. */
+	std::vector<char> m_buffer;
+};
+
+#endif
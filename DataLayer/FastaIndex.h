@@ -2,10 +2,13 @@
 #define FASTA_INDEX_H 1
 
 #include "IOUtil.h"
+#include "MappedFile.h"
 #include <boost/tuple/tuple.hpp>
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <fstream>
+#include <iostream>
 #include <iterator> // for ostream_iterator
 #include <string>
 #include <vector>
@@ -92,6 +95,46 @@ class FastaIndex
 		assert(in.eof());
 	}
 
+	/** Read the FASTA index at the specified path. The file is mapped
+	 * and parsed in one pass, which is faster than operator>>.
+	 */
+	void open(const std::string& path)
+	{
+		m_data.clear();
+		MappedFile file(path);
+		const char* first = file.data();
+		const char* last = first + file.size();
+		m_data.reserve(std::count(first, last, '\n'));
+		for (const char* p = first; p < last;) {
+			if (*p == '\n') {
+				++p;
+				continue;
+			}
+			const char* tab = std::find(p, last, '\t');
+			const char* eol = std::find(tab, last, '\n');
+			if (tab == last) {
+				std::cerr << "error: `" << path
+					<< "': invalid FASTA index\n";
+				exit(EXIT_FAILURE);
+			}
+			FAIRecord rec;
+			rec.id.assign(p, tab);
+			p = tab;
+			rec.size = parseField(p, eol, path);
+			rec.offset = parseField(p, eol, path);
+			size_t lineLen = parseField(p, eol, path);
+			size_t lineBinLen = parseField(p, eol, path);
+			assert(rec.size == lineLen || lineLen == lineBinLen);
+			(void)lineLen;
+			(void)lineBinLen;
+			if (!m_data.empty())
+				assert(rec.offset > m_data.back().offset);
+			m_data.push_back(rec);
+			p = eol + 1;
+		}
+		assert(!m_data.empty());
+	}
+
 	/** Translate a file offset to a sequence:position coordinate. */
 	SeqPos operator[](size_t offset) const
 	{
@@ -175,6 +218,25 @@ class FastaIndex
 	}
 
   private:
+	/** Parse a tab-separated unsigned integer at [p, last), and
+	 * advance p past it.
+	 */
+	static size_t parseField(const char*& p, const char* last,
+			const std::string& path)
+	{
+		while (p < last && (*p == '\t' || *p == ' '))
+			++p;
+		if (p == last || *p < '0' || *p > '9') {
+			std::cerr << "error: `" << path
+				<< "': invalid FASTA index\n";
+			exit(EXIT_FAILURE);
+		}
+		size_t x = 0;
+		for (; p < last && *p >= '0' && *p <= '9'; ++p)
+			x = 10 * x + (*p - '0');
+		return x;
+	}
+
 	Data m_data;
 };
 
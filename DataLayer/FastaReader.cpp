@@ -4,9 +4,14 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <sstream>
+#include <sys/stat.h>
 #include <vector>
 
 using namespace std;
@@ -38,9 +43,9 @@ ostream& FastaReader::die()
 
 FastaReader::FastaReader(const char* path, int flags, int len)
 	: m_path(path), m_fin(path),
-	m_in(strcmp(path, "-") == 0 ? cin : m_fin),
+	m_in(strcmp(path, "-") == 0 ? cin : m_fin), m_bgzf(NULL),
 	m_flags(flags), m_line(0), m_unchaste(0),
-	m_end(numeric_limits<streamsize>::max()),
+	m_end(numeric_limits<streamsize>::max()), m_sectioned(false),
 	m_maxLength(len)
 {
 	if (strcmp(path, "-") != 0)
@@ -50,42 +55,255 @@ FastaReader::FastaReader(const char* path, int flags, int len)
 			"file is empty\n";
 }
 
-/** Split the fasta file into nsections and seek to the start
- * of section. */
-void FastaReader::split(unsigned section, unsigned nsections)
+/** The format of a file that may be divided into sections. */
+enum SplitFormat { SPLIT_NONE, SPLIT_FASTA, SPLIT_FASTQ };
+
+/** Return the format of the specified file if it is a FASTA or FASTQ
+ * file that may be divided into sections, which is either an
+ * uncompressed file or a BGZF-compressed file.
+ * @param[out] bgzf whether the file is BGZF-compressed
+ */
+static SplitFormat splitFormat(const char* path, bool& bgzf)
 {
-	assert(nsections >= section);
-	assert(section > 0);
-	assert(strcmp(m_path, "-") != 0);
-	if (nsections == 1)
+	bgzf = false;
+	struct stat st;
+	if (strcmp(path, "-") == 0 || strstr(path, "://") != NULL
+			|| stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		return SPLIT_NONE;
+
+	// Read the start of the file without decompressing it through
+	// a pipe, which is what opening it with an ifstream would do.
+	string head;
+	bgzf = Bgzf::isBgzf(path);
+	if (bgzf) {
+		if (!Bgzf::enabled() || !endsWith(path, ".gz")
+				|| endsWith(path, ".tar.gz"))
+			return SPLIT_NONE;
+		BgzfStreambuf buf(path, 0);
+		istream in(&buf);
+		char p[4096];
+		in.read(p, sizeof p);
+		head.assign(p, in.gcount());
+	} else {
+		FILE* f = fopen(path, "rb");
+		if (f == NULL)
+			return SPLIT_NONE;
+		char p[4096];
+		head.assign(p, fread(p, 1, sizeof p, f));
+		fclose(f);
+	}
+
+	if (head.empty())
+		return SPLIT_NONE;
+	if (head[0] == '>')
+		return SPLIT_FASTA;
+	if (head[0] == '@') {
+		// Distinguish FASTQ from the header of a SAM file.
+		size_t i = head.find('\n');
+		i = i == string::npos ? i : head.find('\n', i + 1);
+		if (i != string::npos && i + 1 < head.size()
+				&& head[i + 1] == '+')
+			return SPLIT_FASTQ;
+	}
+	return SPLIT_NONE;
+}
+
+/** Return whether the specified file may be divided into sections
+ * that are read in parallel.
+ */
+bool FastaReader::isSplittable(const char* path)
+{
+	bool bgzf;
+	return splitFormat(path, bgzf) != SPLIT_NONE;
+}
+
+/** Return the position of the first record that starts after the
+ * current line, or -1 if there is none.
+ * @param pos the position of the stream
+ */
+static streamoff findRecord(istream& in, streamoff pos, bool fastq)
+{
+	string line;
+	if (!getline(in, line))
+		return -1;
+	pos += line.size() + 1;
+
+	// The first character and position of the last three lines.
+	deque<pair<char, streamoff> > lines;
+	for (; getline(in, line); pos += line.size() + 1) {
+		char c = line.empty() ? '\0' : line[0];
+		if (!fastq) {
+			if (c == '>')
+				return pos;
+			continue;
+		}
+		// A FASTQ record starts with a line that begins with `@'
+		// and is followed two lines later by a line that begins
+		// with `+'. A quality line that begins with `@' is followed
+		// two lines later by a sequence.
+		lines.push_back(make_pair(c, pos));
+		if (lines.size() > 3)
+			lines.pop_front();
+		if (lines.size() == 3 && lines[0].first == '@' && c == '+')
+			return lines[0].second;
+	}
+	return -1;
+}
+
+/** Read the section of the file that begins at the specified
+ * position and ends with the record that crosses end.
+ */
+void FastaReader::setSection(streamoff start, streamoff end)
+{
+	m_sectioned = true;
+	if (start < 0 || start >= end) {
+		// There are no records in this section.
+		m_end = 0;
 		return;
-	// Move the get pointer to the first entry in this section and
-	// update the m_end if there is more than one section.
-	m_in.seekg(0, ios::end);
-	streampos length = m_in.tellg();
-	assert(length > 0);
-	streampos start = length * (section - 1) / nsections;
-	streampos end = length * section / nsections;
-	assert(end > 0);
-	if (end < length) {
-		m_in.seekg(end);
-		if (m_in.peek() == '>')
-			end += 1;
 	}
 	m_end = end;
-	m_in.seekg(start);
-	if (start > 0) {
-		m_in.ignore(numeric_limits<streamsize>::max(), '\n');
-		m_in.ignore(numeric_limits<streamsize>::max(), '>');
-		if (m_in.peek() == EOF)
-			cerr << m_path << ':' << section << ": warning: "
-				"there are no contigs in this section\n";
-		m_in.putback('>');
+}
+
+/** Construct a reader of a section of the specified file. The file
+ * is divided into nsections sections of roughly equal size, and
+ * this reader reads the records that start within the specified
+ * section, numbered from one. If the file cannot be divided, the
+ * first section is the whole file.
+ */
+FastaReader::FastaReader(const char* path, int flags,
+		unsigned section, unsigned nsections)
+	: m_path(path),
+	m_in(strcmp(path, "-") == 0 && section == 1 ? cin : m_fin),
+	m_bgzf(NULL), m_flags(flags), m_line(0), m_unchaste(0),
+	m_end(numeric_limits<streamsize>::max()), m_sectioned(false),
+	m_maxLength(0)
+{
+	assert(section > 0 && section <= nsections);
+	bool bgzf = false;
+	SplitFormat format = nsections > 1
+		? splitFormat(path, bgzf) : SPLIT_NONE;
+	if (format == SPLIT_NONE) {
+		if (section > 1) {
+			setSection(-1, 0);
+			return;
+		}
+		if (strcmp(path, "-") != 0) {
+			m_fin.open(path);
+			assert_good(m_fin, path);
+		}
+		return;
 	}
-	assert(m_end > 0);
+	if (bgzf)
+		openBgzfSection(section, nsections, format == SPLIT_FASTQ);
+	else
+		openSection(section, nsections, format == SPLIT_FASTQ);
+}
+
+/** Open a section of an uncompressed file. */
+void FastaReader::openSection(unsigned section, unsigned nsections,
+		bool fastq)
+{
+	m_fin.open(m_path);
+	assert_good(m_fin, m_path);
+	m_fin.seekg(0, ios::end);
+	streamoff size = m_fin.tellg();
+	streamoff begin = size * (section - 1) / nsections;
+	streamoff end = section < nsections ? size * section / nsections
+		: numeric_limits<streamoff>::max();
+	streamoff start = 0;
+	if (begin > 0) {
+		m_fin.seekg(begin - 1);
+		start = findRecord(m_fin, begin - 1, fastq);
+		m_fin.clear();
+	}
+	setSection(start, end);
+	m_fin.seekg(m_end == streampos(0) ? 0 : start);
+	assert(m_fin.good());
+}
+
+/** Open a section of a BGZF-compressed file. The sections are
+ * divided at block boundaries. A section starts reading one block
+ * before its first block to determine whether that block starts
+ * with a new line.
+ */
+void FastaReader::openBgzfSection(unsigned section, unsigned nsections,
+		bool fastq)
+{
+	FILE* f = fopen(m_path, "rb");
+	if (f == NULL) {
+		cerr << "error: `" << m_path << "': "
+			<< strerror(errno) << endl;
+		exit(EXIT_FAILURE);
+	}
+	struct stat st;
+	int err = fstat(fileno(f), &st);
+	assert(err == 0);
+	(void)err;
+	uint64_t size = st.st_size;
+
+	// The position of the stream is counted from the origin block.
+	uint64_t origin = section == 1 ? 0
+		: Bgzf::findBlock(f, size * (section - 1) / nsections);
+	uint32_t blockSize, dataSize;
+	streamoff begin = 0;
+	if (section > 1) {
+		if (!Bgzf::readBlockSize(f, origin, blockSize, dataSize)) {
+			fclose(f);
+			setSection(-1, 0);
+			return;
+		}
+		begin = dataSize;
+	}
+	streamoff end = numeric_limits<streamoff>::max();
+	if (section < nsections) {
+		uint64_t last = Bgzf::findBlock(f, size * section / nsections);
+		if (last < size) {
+			end = 0;
+			for (uint64_t offset = origin; offset <= last
+					&& Bgzf::readBlockSize(f, offset,
+						blockSize, dataSize);
+					offset += blockSize)
+				end += dataSize;
+		}
+	}
+	fclose(f);
+
+	streamoff start = 0;
+	if (begin > 0) {
+		BgzfStreambuf buf(m_path, origin);
+		istream in(&buf);
+		in.ignore(begin - 1);
+		start = findRecord(in, begin - 1, fastq);
+	}
+	setSection(start, end);
+	if (m_end == streampos(0))
+		return;
+	m_bgzf = new BgzfStreambuf(m_path, origin);
+	m_in.rdbuf(m_bgzf);
+	m_in.ignore(start);
 	assert(m_in.good());
 }
 
+/** Split the file into nsections and seek to the start of section.
+ * The file must be an uncompressed FASTA or FASTQ file.
+ */
+void FastaReader::split(unsigned section, unsigned nsections)
+{
+	assert(nsections >= section);
+	assert(section > 0);
+	bool bgzf;
+	SplitFormat format = splitFormat(m_path, bgzf);
+	if (format == SPLIT_NONE || bgzf) {
+		die() << "unable to split this file\n";
+		exit(EXIT_FAILURE);
+	}
+	if (nsections == 1)
+		return;
+	m_fin.close();
+	m_fin.clear();
+	openSection(section, nsections, format == SPLIT_FASTQ);
+}
+
 /** Return whether this read passed the chastity filter. */
 bool FastaReader::isChaste(const string& s, const string& line)
 {
@@ -136,7 +354,7 @@ next_record:
 	Sequence s;
 
 	unsigned qualityOffset = 0;
-	if (recordType == EOF || m_in.tellg() >= m_end) {
+	if (recordType == EOF || (m_sectioned && m_in.tellg() >= m_end)) {
 		m_in.seekg(0, ios::end);
 		m_in.clear(std::ios::eofbit | std::ios::failbit);
 		return s;
@@ -2,6 +2,7 @@
 #define FASTAREADER_H 1
 
 #include "Common/Sequence.h"
+#include "DataLayer/Bgzf.h"
 #include "Common/StringUtil.h" // for chomp
 #include <cassert>
 #include <cstdlib> // for exit
@@ -23,6 +24,8 @@ class FastaReader {
 		bool flagConvertQual() { return m_flags & CONVERT_QUALITY; }
 
 		FastaReader(const char* path, int flags, int len = 0);
+		FastaReader(const char* path, int flags,
+				unsigned section, unsigned nsections);
 
 		~FastaReader()
 		{
@@ -33,12 +36,15 @@ class FastaReader {
 					<< line << '\n';
 				exit(EXIT_FAILURE);
 			}
+			delete m_bgzf;
 		}
 
+		static bool isSplittable(const char* path);
+
 		Sequence read(std::string& id, std::string& comment,
 				char& anchor, std::string& qual);
 
-		/** Split the fasta file into nsections and seek to the start
+		/** Split the file into nsections and seek to the start
 		 * of section. */
 		void split(unsigned section, unsigned nsections);
 
@@ -98,11 +104,19 @@ class FastaReader {
 		std::ostream& die();
 		bool isChaste(const std::string& s, const std::string& line);
 		void checkSeqQual(const std::string& s, const std::string& q);
+		void openSection(unsigned section, unsigned nsections,
+				bool fastq);
+		void openBgzfSection(unsigned section, unsigned nsections,
+				bool fastq);
+		void setSection(std::streamoff start, std::streamoff end);
 
 		const char* m_path;
 		std::ifstream m_fin;
 		std::istream& m_in;
 
+		/** The stream buffer of a BGZF-compressed file. */
+		BgzfStreambuf* m_bgzf;
+
 		/** Flags indicating parsing options. */
 		int m_flags;
 
@@ -115,6 +129,9 @@ class FastaReader {
 		/** Position of the end of the current section. */
 		std::streampos m_end;
 
+		/** Whether this reader reads a section of the file. */
+		bool m_sectioned;
+
 		/** Trim sequences to this length. 0 is unlimited. */
 		const int m_maxLength;
 };
@@ -4,17 +4,25 @@
 #include "config.h"
 #include "BitArrays.h"
 #include "IOUtil.h"
+#include "MappedFile.h"
+#include "OccTable.h"
+#include "PackedArray.h"
 #include "sais.hxx"
 #include <boost/integer.hpp>
+#include <boost/shared_ptr.hpp>
 #include <algorithm>
 #include <cassert>
 #include <cstdlib> // for exit
+#include <fstream>
 #include <iostream>
 #include <iterator>
 #include <limits> // for numeric_limits
 #include <stdint.h>
 #include <string>
 #include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 /** An FM index. */
 class FMIndex
@@ -135,10 +143,19 @@ void setSA(size_t sai, size_t pos)
 	if (sai % m_sampleSA == 0) {
 		size_t i = sai / m_sampleSA;
 		assert(i < m_sa.size());
-		m_sa[i] = pos;
+		m_sa.set(i, pos);
 	}
 }
 
+/** Return the LF-mapping of the specified suffix array index, the
+ * index of the suffix that is one symbol longer.
+ */
+size_t lf(size_t sai, T c) const
+{
+	assert(c != SENTINEL());
+	return m_cf[c] + m_occ.rank(c, sai);
+}
+
 /** Construct the suffix array from the FM index. */
 void constructSuffixArray()
 {
@@ -146,18 +163,101 @@ void constructSuffixArray()
 	size_t n = m_occ.size() - 1;
 	assert(n > 0);
 	assert(m_sampleSA > 0);
-	m_sa.resize(n / m_sampleSA + 1);
+	m_sa.resize(n / m_sampleSA + 1, PackedArray::bitsFor(n));
+#if _OPENMP
+	if (omp_get_max_threads() > 1 && m_occ.count(0) > 0) {
+		constructSuffixArrayParallel();
+		return;
+	}
+#endif
 	size_t sai = 0;
 	for (size_t i = n; i > 0; i--) {
 		setSA(sai, i);
 		T c = m_occ.at(sai);
 		assert(c != SENTINEL());
-		sai = m_cf[c] + m_occ.rank(c, sai);
+		sai = lf(sai, c);
 		assert(sai > 0);
 	}
 	setSA(sai, 0);
 }
 
+/** Construct the suffix array from the FM index using multiple
+ * threads. The LF-mapping walk from the end of the string to its
+ * start is cut at each occurrence of the symbol 0, which separates
+ * the lines of a FASTA file. The suffixes that start with the symbol
+ * 0 are at [1, 1 + count(0)) of the suffix array, so each piece of
+ * the walk has a known starting index and may be walked
+ * independently. The first pass measures each piece, a short
+ * sequential pass chains the pieces to find the position of each in
+ * the string, and the second pass samples the suffix array.
+ */
+void constructSuffixArrayParallel()
+{
+	const size_t n = m_occ.size() - 1;
+	const size_type NONE = std::numeric_limits<size_type>::max();
+
+	// Piece 0 starts at the sentinel suffix, and piece i > 0 starts
+	// at suffix array index i.
+	const size_t pieces = m_occ.count(0) + 1;
+	std::vector<size_type> next(pieces), length(pieces);
+#if _OPENMP
+# pragma omp parallel for schedule(dynamic, 1024)
+#endif
+	for (size_t i = 0; i < pieces; i++) {
+		size_t sai = i, len = 0;
+		next[i] = NONE;
+		for (T c; (c = m_occ.at(sai)) != SENTINEL();) {
+			sai = lf(sai, c);
+			len++;
+			if (c == 0) {
+				assert(sai > 0 && sai < pieces);
+				next[i] = sai;
+				break;
+			}
+		}
+		length[i] = len;
+	}
+
+	// Chain the pieces from the end of the string, and replace the
+	// successor of each piece with its starting position.
+	std::vector<size_type>& pos = next;
+	size_t visited = 0;
+	for (size_t i = 0, p = n;; visited++) {
+		size_type j = next[i];
+		pos[i] = p;
+		if (j == NONE) {
+			assert(p == length[i]);
+			break;
+		}
+		assert(p >= length[i]);
+		p -= length[i];
+		i = j;
+	}
+	assert(visited + 1 == pieces);
+	(void)visited;
+	std::vector<size_type>().swap(length);
+
+	// Sample the suffix array. Threads write distinct elements of
+	// an unpacked array, which is then packed.
+	std::vector<size_type> sa(m_sa.size());
+#if _OPENMP
+# pragma omp parallel for schedule(dynamic, 1024)
+#endif
+	for (size_t i = 0; i < pieces; i++) {
+		size_t sai = i;
+		for (size_t p = pos[i];; p--) {
+			if (sai % m_sampleSA == 0)
+				sa[sai / m_sampleSA] = p;
+			T c = m_occ.at(sai);
+			if (c == SENTINEL() || c == 0)
+				break;
+			sai = lf(sai, c);
+		}
+	}
+	for (size_t i = 0; i < sa.size(); i++)
+		m_sa.set(i, sa[i]);
+}
+
 /** Build an FM-index of the specified BWT. */
 template<typename It>
 void assignBWT(It first, It last)
@@ -175,7 +275,9 @@ void assignBWT(It first, It last)
 	constructSuffixArray();
 }
 
-/** Build an FM-index of the specified data. */
+/** Build an FM-index of the specified data.
+ * The suffix array is sampled at the period set by sampleSA.
+ */
 template<typename It>
 void assign(It first, It last)
 {
@@ -189,13 +291,12 @@ void assign(It first, It last)
 	// Construct the suffix array.
 	std::cerr << "Building the suffix array...\n";
 	size_t n = last - first;
-	m_sampleSA = 1;
-	m_sa.resize(n + 1);
-	m_sa[0] = n;
+	std::vector<size_type> sa(n + 1);
+	sa[0] = n;
 
 	assert(sizeof (size_type) == sizeof (sais_size_type));
 	int status = saisxx(first,
-			reinterpret_cast<sais_size_type*>(&m_sa[1]),
+			reinterpret_cast<sais_size_type*>(&sa[1]),
 			(sais_size_type)n,
 			(sais_size_type)m_alphabet.size());
 	assert(status == 0);
@@ -205,13 +306,32 @@ void assign(It first, It last)
 	// Construct the Burrows-Wheeler transform.
 	std::vector<T> bwt;
 	std::cerr << "Building the Burrows-Wheeler transform...\n";
-	bwt.resize(m_sa.size());
-	for (size_t i = 0; i < m_sa.size(); i++)
-		bwt[i] = m_sa[i] == 0 ? SENTINEL() : first[m_sa[i] - 1];
+	bwt.resize(sa.size());
+#if _OPENMP
+# pragma omp parallel for
+#endif
+	for (size_t i = 0; i < sa.size(); i++)
+		bwt[i] = sa[i] == 0 ? SENTINEL() : first[sa[i] - 1];
 
 	std::cerr << "Building the character occurrence table...\n";
 	m_occ.assign(bwt.begin(), bwt.end());
+	std::vector<T>().swap(bwt);
 	countOccurrences();
+
+	// Sample and pack the suffix array. Each thread packs whole
+	// blocks of 64 elements, which occupy whole words.
+	assert(m_sampleSA > 0);
+	m_sa.resize((sa.size() - 1) / m_sampleSA + 1,
+			PackedArray::bitsFor(n));
+	const size_t blocks = (m_sa.size() + 63) / 64;
+#if _OPENMP
+# pragma omp parallel for
+#endif
+	for (size_t b = 0; b < blocks; b++) {
+		size_t end = std::min(64 * (b + 1), m_sa.size());
+		for (size_t i = 64 * b; i < end; i++)
+			m_sa.set(i, sa[i * m_sampleSA]);
+	}
 }
 
 /** Sample the suffix array. */
@@ -224,10 +344,11 @@ void sampleSA(unsigned period)
 	m_sampleSA = period;
 	if (m_sampleSA == 1 || m_sa.empty())
 		return;
-	std::vector<size_type>::iterator out = m_sa.begin();
-	for (size_t i = 0; i < m_sa.size(); i += m_sampleSA)
-		*out++ = m_sa[i];
-	m_sa.erase(out, m_sa.end());
+	// A mapped suffix array is read-only, so copy the samples.
+	PackedArray sa((m_sa.size() - 1) / m_sampleSA + 1, m_sa.bits());
+	for (size_t i = 0; i < sa.size(); i++)
+		sa.set(i, m_sa[i * m_sampleSA]);
+	m_sa.swap(sa);
 	assert(!m_sa.empty());
 }
 
@@ -505,24 +626,36 @@ void setAlphabet(const std::string& s)
 }
 
 #define STRINGIFY(X) #X
-#define FM_VERSION_BITS(BITS) "FM " STRINGIFY(BITS) " 1"
+#define FM_VERSION_BITS(BITS) "FM " STRINGIFY(BITS) " 3"
 #define FM_VERSION FM_VERSION_BITS(FMBITS)
 
-/** Store an index. */
-friend std::ostream& operator<<(std::ostream& out, const FMIndex& o)
-{
-	out << FM_VERSION << '\n'
-		<< o.m_sampleSA << '\n';
-
-	out << o.m_alphabet.size() << '\n';
-	out.write(reinterpret_cast<const char*>(&o.m_alphabet[0]),
-			o.m_alphabet.size() * sizeof o.m_alphabet[0]);
+/** The version of an index with an unpacked suffix array and an
+ * occurrence table of BitArrays. */
+#define FM_VERSION_1_BITS(BITS) "FM " STRINGIFY(BITS) " 1"
+#define FM_VERSION_1 FM_VERSION_1_BITS(FMBITS)
 
-	out << o.m_sa.size() << '\n';
-	out.write(reinterpret_cast<const char*>(&o.m_sa[0]),
-		o.m_sa.size() * sizeof o.m_sa[0]);
+/** The version of an index with a packed suffix array and an OccTable
+ * that is not aligned for mapping. */
+#define FM_VERSION_2_BITS(BITS) "FM " STRINGIFY(BITS) " 2"
+#define FM_VERSION_2 FM_VERSION_2_BITS(FMBITS)
 
-	return out << o.m_occ;
+/** Store an index. The version line is followed by the sampling
+ * period, the alphabet, the suffix array and the occurrence table.
+ * The suffix array and the occurrence table are aligned to a page so
+ * that the index may be mapped by open.
+ */
+friend std::ostream& operator<<(std::ostream& out, const FMIndex& o)
+{
+	out << FM_VERSION << '\n';
+	uint64_t pos = sizeof FM_VERSION;
+	uint64_t header[2] = { o.m_sampleSA, o.m_alphabet.size() };
+	MappedFile::write(out, pos, header, 2);
+	MappedFile::write(out, pos, &o.m_alphabet[0], o.m_alphabet.size());
+	MappedFile::writePadding(out, pos);
+	o.m_sa.store(out, pos);
+	MappedFile::writePadding(out, pos);
+	o.m_occ.store(out, pos);
+	return out;
 }
 
 /** Load an index. */
@@ -531,7 +664,27 @@ friend std::istream& operator>>(std::istream& in, FMIndex& o)
 	std::string version;
 	std::getline(in, version);
 	assert(in);
-	if (version != FM_VERSION) {
+	if (version == FM_VERSION) {
+		uint64_t pos = version.size() + 1;
+		uint64_t header[2] = { 0, 0 };
+		MappedFile::read(in, pos, header, 2);
+		assert(in);
+		o.m_sampleSA = header[0];
+		o.m_alphabet.resize(header[1]);
+		MappedFile::read(in, pos, &o.m_alphabet[0], header[1]);
+		o.setAlphabet(o.m_alphabet.begin(), o.m_alphabet.end());
+		MappedFile::readPadding(in, pos);
+		o.m_sa.load(in, pos);
+		MappedFile::readPadding(in, pos);
+		o.m_occ.load(in, pos);
+		assert(in);
+		o.countOccurrences();
+		o.m_file.reset();
+		return in;
+	}
+
+	bool version1 = version == FM_VERSION_1;
+	if (version != FM_VERSION_2 && !version1) {
 		std::cerr << "error: the version of this FM-index, `"
 			<< version << "', does not match the version required "
 			"by this program, `" FM_VERSION "'.\n";
@@ -550,22 +703,80 @@ friend std::istream& operator>>(std::istream& in, FMIndex& o)
 			n * sizeof o.m_alphabet[0]);
 	o.setAlphabet(o.m_alphabet.begin(), o.m_alphabet.end());
 
-	in >> n >> expect("\n");
-	assert(in);
-	assert(n < std::numeric_limits<size_type>::max());
-	o.m_sa.resize(n);
-	in.read(reinterpret_cast<char*>(&o.m_sa[0]),
-			n * sizeof o.m_sa[0]);
-
-	in >> o.m_occ;
+	if (version1)
+		o.readVersion1(in);
+	else
+		in >> o.m_sa >> o.m_occ;
 	assert(in);
 	o.countOccurrences();
+	o.m_file.reset();
 
 	return in;
 }
 
+/** Load the index at the specified path. An index of the current
+ * version is mapped read-only rather than read, so that loading it
+ * is fast and concurrent processes share one copy of it in memory.
+ * An index of an older version is read.
+ */
+void open(const std::string& path)
+{
+	boost::shared_ptr<MappedFile> file(new MappedFile(path));
+	const char* p = file->data();
+	if (file->size() < sizeof FM_VERSION
+			|| !std::equal(p, p + sizeof FM_VERSION - 1, FM_VERSION)
+			|| p[sizeof FM_VERSION - 1] != '\n') {
+		file.reset();
+		std::ifstream in(path.c_str());
+		assert_good(in, path);
+		in >> *this;
+		assert_good(in, path);
+		return;
+	}
+
+	uint64_t pos = sizeof FM_VERSION;
+	const uint64_t* header = file->map<uint64_t>(pos, 2);
+	m_sampleSA = header[0];
+	const T* alphabet = file->map<T>(pos, header[1]);
+	m_alphabet.assign(alphabet, alphabet + header[1]);
+	setAlphabet(m_alphabet.begin(), m_alphabet.end());
+	MappedFile::mapPadding(pos);
+	m_sa.map(*file, pos);
+	MappedFile::mapPadding(pos);
+	m_occ.map(*file, pos);
+	countOccurrences();
+	m_file = file;
+}
+
 private:
 
+/** Load the suffix array and occurrence table of an index of version
+ * 1, and convert them to their packed representations.
+ */
+void readVersion1(std::istream& in)
+{
+	size_t n;
+	in >> n >> expect("\n");
+	assert(in);
+	assert(n < std::numeric_limits<size_type>::max());
+	std::vector<size_type> sa(n);
+	in.read(reinterpret_cast<char*>(&sa[0]), n * sizeof sa[0]);
+
+	BitArrays occ;
+	in >> occ;
+	if (!in)
+		return;
+
+	m_sa.resize(n, PackedArray::bitsFor(occ.size() - 1));
+	for (size_t i = 0; i < n; i++)
+		m_sa.set(i, sa[i]);
+
+	std::vector<T> bwt(occ.size());
+	for (size_t i = 0; i < bwt.size(); i++)
+		bwt[i] = occ.at(i);
+	m_occ.assign(bwt.begin(), bwt.end());
+}
+
 /** Build the cumulative frequency table m_cf from m_occ. */
 void countOccurrences()
 {
@@ -581,8 +792,11 @@ void countOccurrences()
 	std::vector<T> m_alphabet;
 	std::vector<T> m_mapping;
 	std::vector<size_type> m_cf;
-	std::vector<size_type> m_sa;
-	BitArrays m_occ;
+	PackedArray m_sa;
+	OccTable m_occ;
+
+	/** The file of a mapped index. */
+	boost::shared_ptr<MappedFile> m_file;
 };
 
 #endif
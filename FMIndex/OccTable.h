@@ -0,0 +1,432 @@
+#ifndef OCCTABLE_H
+#define OCCTABLE_H 1
+
+#include "BitUtil.h" // for popcount
+#include "MappedFile.h"
+#include <algorithm>
+#include <cassert>
+#include <istream>
+#include <limits> // for numeric_limits
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+/** Store a string of symbols from a small alphabet for rank queries.
+ * The string is divided into blocks that, for an alphabet of up to
+ * eight symbols, fit in one cache line, as in BWA. Each block holds
+ * the occurrence count of each symbol preceding the block, relative
+ * to its superblock, followed by the symbols of the block stored as
+ * bit planes of 64 symbols. A rank query reads one block and one
+ * entry of the small superblock table. The blocks may be mapped
+ * read-only from a file.
+ */
+class OccTable
+{
+	/** A symbol. */
+	typedef uint8_t T;
+
+	/** The sentinel symbol. */
+	static T SENTINEL() { return std::numeric_limits<T>::max(); }
+
+	/** The number of words of a cache line. */
+	static const unsigned LINE_WORDS = 8;
+
+	/** The number of bits of a count relative to a superblock. */
+	static const unsigned COUNT_BITS = 16;
+	static const unsigned COUNTS_PER_WORD = 64 / COUNT_BITS;
+
+	/** The base-2 logarithm of the number of symbols of a
+	 * superblock. */
+	static const unsigned SUPER_SHIFT = COUNT_BITS;
+
+	/** No position. */
+	static size_t NPOS() { return std::numeric_limits<size_t>::max(); }
+
+  public:
+
+	OccTable()
+		: m_size(0), m_sigma(0), m_sentinel(NPOS()), m_mapped(NULL) { }
+
+	OccTable(const OccTable& o)
+		: m_size(0), m_sigma(0), m_sentinel(NPOS()), m_mapped(NULL)
+	{
+		*this = o;
+	}
+
+	OccTable& operator=(const OccTable& o)
+	{
+		if (this == &o)
+			return *this;
+		if (o.m_sigma == 0) {
+			m_size = 0;
+			m_sigma = 0;
+			m_sentinel = NPOS();
+			m_mapped = NULL;
+			m_data.clear();
+			return *this;
+		}
+		init(o.m_size, o.m_sigma);
+		m_sentinel = o.m_sentinel;
+		m_count = o.m_count;
+		m_super = o.m_super;
+		std::copy(o.block(0), o.block(m_numBlocks), block(0));
+		return *this;
+	}
+
+/** Count the occurrences of the symbols of [first, last). */
+template<typename It>
+void assign(It first, It last)
+{
+	assert(first < last);
+
+	// Determine the size of the alphabet ignoring the sentinel.
+	T sigma = 0;
+	for (It it = first; it != last; ++it)
+		if (*it != SENTINEL())
+			sigma = std::max<T>(sigma, *it);
+	sigma++;
+	assert(sigma < std::numeric_limits<T>::max());
+
+	size_t n = last - first;
+	init(n, sigma);
+
+	std::vector<size_t> counts(sigma);
+	size_t i = 0;
+	for (It it = first;; ++it, ++i) {
+		if ((i & m_blockMask) == 0)
+			setCounts(i, counts);
+		if (i == n)
+			break;
+		T c = *it;
+		if (c == SENTINEL()) {
+			// Store the sentinel as symbol 0 and correct for it
+			// in rank().
+			assert(m_sentinel == NPOS());
+			m_sentinel = i;
+			c = 0;
+		}
+		counts[c]++;
+		uint64_t* p = plane(i);
+		uint64_t bit = (uint64_t)1 << (i & 63);
+		for (unsigned b = 0; b < m_bits; b++)
+			if (c & 1 << b)
+				p[b] |= bit;
+	}
+	m_count.assign(counts.begin(), counts.end());
+	if (m_sentinel != NPOS())
+		m_count[0]--;
+}
+
+	/** Return the size of the string. */
+	size_t size() const { return m_size; }
+
+	/** Return the number of occurrences of the specified symbol. */
+	size_t count(T c) const
+	{
+		return c < m_sigma ? m_count[c] : 0;
+	}
+
+	/** Return the count of symbol c in s[0, i). */
+	size_t rank(T c, size_t i) const
+	{
+		assert(i <= m_size);
+		if (c >= m_sigma)
+			return 0;
+		const uint64_t* p = block(i >> m_blockShift);
+		size_t n = m_super[(i >> SUPER_SHIFT) * m_sigma + c]
+			+ (p[c / COUNTS_PER_WORD]
+					>> (c % COUNTS_PER_WORD * COUNT_BITS)
+				& ((1 << COUNT_BITS) - 1));
+		p += m_countWords;
+		for (size_t j = i & m_blockMask; j >= 64; j -= 64) {
+			n += popcount(match(p, c));
+			p += m_bits;
+		}
+		if ((i & 63) != 0)
+			n += popcount(match(p, c)
+					& (((uint64_t)1 << (i & 63)) - 1));
+		if (c == 0 && m_sentinel < i)
+			n--;
+		return n;
+	}
+
+	/** Return the symbol at the specified position. */
+	T at(size_t i) const
+	{
+		assert(i < m_size);
+		if (i == m_sentinel)
+			return SENTINEL();
+		const uint64_t* p = plane(i);
+		unsigned shift = i & 63;
+		T c = 0;
+		for (unsigned b = 0; b < m_bits; b++)
+			c |= (p[b] >> shift & 1) << b;
+		return c;
+	}
+
+	/** Store this data structure. */
+	friend std::ostream& operator<<(std::ostream& out,
+			const OccTable& o)
+	{
+		uint64_t n = o.m_size, sentinel = o.m_sentinel;
+		uint32_t sigma = o.m_sigma;
+		out.write(reinterpret_cast<const char*>(&n), sizeof n);
+		out.write(reinterpret_cast<const char*>(&sigma), sizeof sigma);
+		out.write(reinterpret_cast<const char*>(&sentinel),
+				sizeof sentinel);
+		out.write(reinterpret_cast<const char*>(o.block(0)),
+				o.m_numBlocks * o.m_blockWords * sizeof (uint64_t));
+		return out;
+	}
+
+	/** Load this data structure. */
+	friend std::istream& operator>>(std::istream& in, OccTable& o)
+	{
+		uint64_t n = 0, sentinel = 0;
+		uint32_t sigma = 0;
+		in.read(reinterpret_cast<char*>(&n), sizeof n);
+		in.read(reinterpret_cast<char*>(&sigma), sizeof sigma);
+		in.read(reinterpret_cast<char*>(&sentinel), sizeof sentinel);
+		if (!in)
+			return in;
+		assert(sigma > 0 && sigma < std::numeric_limits<T>::max());
+		o.init(n, sigma);
+		o.m_sentinel = sentinel;
+		in.read(reinterpret_cast<char*>(o.block(0)),
+				o.m_numBlocks * o.m_blockWords * sizeof (uint64_t));
+		if (!in)
+			return in;
+		o.countSuperblocks();
+		return in;
+	}
+
+	/** Store this data structure in the mappable layout, in which
+	 * the blocks are aligned to a page.
+	 * @param pos the position of the output stream
+	 */
+	void store(std::ostream& out, uint64_t& pos) const
+	{
+		uint64_t header[3] = { m_size, m_sigma, m_sentinel };
+		MappedFile::write(out, pos, header, 3);
+		std::vector<uint64_t> super(m_super.begin(), m_super.end());
+		MappedFile::write(out, pos, &super[0], super.size());
+		std::vector<uint64_t> count(m_count.begin(), m_count.end());
+		MappedFile::write(out, pos, &count[0], count.size());
+		MappedFile::writePadding(out, pos);
+		MappedFile::write(out, pos, block(0),
+				m_numBlocks * m_blockWords);
+	}
+
+	/** Load this data structure from the mappable layout. */
+	void load(std::istream& in, uint64_t& pos)
+	{
+		uint64_t header[3] = { 0, 0, 0 };
+		MappedFile::read(in, pos, header, 3);
+		if (!in)
+			return;
+		assert(header[1] > 0
+				&& header[1] < std::numeric_limits<T>::max());
+		init(header[0], header[1]);
+		m_sentinel = header[2];
+		std::vector<uint64_t> super(m_super.size()), count(m_sigma);
+		MappedFile::read(in, pos, &super[0], super.size());
+		MappedFile::read(in, pos, &count[0], count.size());
+		MappedFile::readPadding(in, pos);
+		MappedFile::read(in, pos, block(0), m_numBlocks * m_blockWords);
+		m_super.assign(super.begin(), super.end());
+		m_count.assign(count.begin(), count.end());
+	}
+
+	/** Map this data structure from the mappable layout. */
+	void map(const MappedFile& file, uint64_t& pos)
+	{
+		const uint64_t* header = file.map<uint64_t>(pos, 3);
+		assert(header[1] > 0
+				&& header[1] < std::numeric_limits<T>::max());
+		setLayout(header[0], header[1]);
+		m_sentinel = header[2];
+		size_t numSuper = ((m_size >> SUPER_SHIFT) + 1) * m_sigma;
+		const uint64_t* super = file.map<uint64_t>(pos, numSuper);
+		m_super.assign(super, super + numSuper);
+		const uint64_t* count = file.map<uint64_t>(pos, m_sigma);
+		m_count.assign(count, count + m_sigma);
+		MappedFile::mapPadding(pos);
+		std::vector<uint64_t>().swap(m_data);
+		m_offset = 0;
+		m_mapped = file.map<uint64_t>(pos, m_numBlocks * m_blockWords);
+	}
+
+  private:
+
+	/** Set the layout for a string of n symbols from an alphabet of
+	 * sigma symbols, and clear the table.
+	 */
+	void init(size_t n, unsigned sigma)
+	{
+		setLayout(n, sigma);
+		m_mapped = NULL;
+
+		// Allocate one cache line of slack for alignment.
+		m_data.assign(m_numBlocks * m_blockWords + LINE_WORDS - 1, 0);
+		uintptr_t p = reinterpret_cast<uintptr_t>(&m_data[0]);
+		m_offset = (LINE_WORDS - p / 8 % LINE_WORDS) % LINE_WORDS;
+		m_super.assign(((n >> SUPER_SHIFT) + 1) * sigma, 0);
+		m_count.assign(sigma, 0);
+	}
+
+	/** Set the layout for a string of n symbols from an alphabet of
+	 * sigma symbols.
+	 */
+	void setLayout(size_t n, unsigned sigma)
+	{
+		assert(sigma > 0);
+		m_size = n;
+		m_sigma = sigma;
+		m_sentinel = NPOS();
+
+		m_bits = 1;
+		while ((1U << m_bits) < sigma)
+			m_bits++;
+		m_countWords = (sigma + COUNTS_PER_WORD - 1) / COUNTS_PER_WORD;
+
+		// Use the largest power of two groups of 64 symbols that
+		// fit in a cache line with the counts.
+		unsigned groupShift = 0;
+		while (m_countWords + (2U << groupShift) * m_bits <= LINE_WORDS)
+			groupShift++;
+		m_blockShift = 6 + groupShift;
+		m_blockMask = ((size_t)1 << m_blockShift) - 1;
+		m_blockWords = m_countWords + (1U << groupShift) * m_bits;
+
+		// Allocate one extra block for rank(c, n).
+		m_numBlocks = (n >> m_blockShift) + 1;
+	}
+
+	/** Return the bit mask of the symbols equal to c of the 64
+	 * symbols whose bit planes start at p.
+	 */
+	uint64_t match(const uint64_t* p, T c) const
+	{
+		uint64_t x = ~(uint64_t)0;
+		for (unsigned b = 0; b < m_bits; b++) {
+			// Avoid a branch that depends on the symbol.
+			uint64_t mask = (uint64_t)(c >> b & 1) - 1;
+			x &= p[b] ^ mask;
+		}
+		return x;
+	}
+
+	/** Return the bit planes of the 64 symbols containing position
+	 * i. */
+	uint64_t* plane(size_t i)
+	{
+		return block(i >> m_blockShift) + m_countWords
+			+ ((i & m_blockMask) >> 6) * m_bits;
+	}
+
+	/** Return the bit planes of the 64 symbols containing position
+	 * i. */
+	const uint64_t* plane(size_t i) const
+	{
+		return block(i >> m_blockShift) + m_countWords
+			+ ((i & m_blockMask) >> 6) * m_bits;
+	}
+
+	/** Record the occurrence counts preceding position i, which is
+	 * the start of a block.
+	 */
+	void setCounts(size_t i, const std::vector<size_t>& counts)
+	{
+		size_t* super = &m_super[(i >> SUPER_SHIFT) * m_sigma];
+		if ((i & (((size_t)1 << SUPER_SHIFT) - 1)) == 0)
+			std::copy(counts.begin(), counts.end(), super);
+		uint64_t* p = block(i >> m_blockShift);
+		for (unsigned c = 0; c < m_sigma; c++) {
+			uint64_t x = counts[c] - super[c];
+			assert(x < (1U << COUNT_BITS));
+			p[c / COUNTS_PER_WORD]
+				|= x << (c % COUNTS_PER_WORD * COUNT_BITS);
+		}
+	}
+
+	/** Rebuild the superblock table and the symbol counts from the
+	 * blocks.
+	 */
+	void countSuperblocks()
+	{
+		std::vector<size_t> counts(m_sigma);
+		for (size_t b = 0; b < m_numBlocks; b++) {
+			size_t i = b << m_blockShift;
+			if ((i & (((size_t)1 << SUPER_SHIFT) - 1)) == 0)
+				std::copy(counts.begin(), counts.end(),
+						&m_super[(i >> SUPER_SHIFT) * m_sigma]);
+			// Every block but the last is full.
+			if (b + 1 == m_numBlocks)
+				break;
+			const uint64_t* p = block(b) + m_countWords;
+			for (size_t g = 0; g < (m_blockMask + 1) >> 6; g++)
+				for (unsigned c = 0; c < m_sigma; c++)
+					counts[c] += popcount(match(p + g * m_bits, c));
+		}
+		for (unsigned c = 0; c < m_sigma; c++)
+			m_count[c] = rank(c, m_size);
+	}
+
+	/** Return the specified block, aligned to a cache line. */
+	uint64_t* block(size_t b)
+	{
+		assert(m_mapped == NULL);
+		return &m_data[0] + m_offset + b * m_blockWords;
+	}
+
+	/** Return the specified block, aligned to a cache line. */
+	const uint64_t* block(size_t b) const
+	{
+		return (m_mapped != NULL ? m_mapped : &m_data[0] + m_offset)
+			+ b * m_blockWords;
+	}
+
+	/** The length of the string. */
+	size_t m_size;
+
+	/** The size of the alphabet. */
+	unsigned m_sigma;
+
+	/** The position of the sentinel. */
+	size_t m_sentinel;
+
+	/** The number of bits of a symbol. */
+	unsigned m_bits;
+
+	/** The number of words of counts at the start of a block. */
+	unsigned m_countWords;
+
+	/** The number of words of a block. */
+	unsigned m_blockWords;
+
+	/** The base-2 logarithm of the number of symbols of a block. */
+	unsigned m_blockShift;
+
+	/** The number of symbols of a block less one. */
+	size_t m_blockMask;
+
+	/** The number of blocks. */
+	size_t m_numBlocks;
+
+	/** The blocks of a mapped table, or NULL. */
+	const uint64_t* m_mapped;
+
+	/** The blocks. */
+	std::vector<uint64_t> m_data;
+
+	/** The offset of the first block, aligned to a cache line. */
+	size_t m_offset;
+
+	/** The occurrence counts preceding each superblock. */
+	std::vector<size_t> m_super;
+
+	/** The number of occurrences of each symbol. */
+	std::vector<size_t> m_count;
+};
+
+#endif
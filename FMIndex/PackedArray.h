@@ -0,0 +1,211 @@
+#ifndef PACKEDARRAY_H
+#define PACKEDARRAY_H 1
+
+#include "MappedFile.h"
+#include <algorithm> // for swap
+#include <cassert>
+#include <istream>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+/** An array of unsigned integers packed into a fixed number of bits
+ * each. The array may be mapped read-only from a file.
+ */
+class PackedArray
+{
+  public:
+	typedef uint64_t value_type;
+
+	PackedArray() : m_size(0), m_bits(1), m_mapped(NULL) { }
+
+	PackedArray(size_t n, unsigned bits)
+		: m_size(0), m_bits(1), m_mapped(NULL)
+	{
+		resize(n, bits);
+	}
+
+	/** Return the number of bits needed to store x. */
+	static unsigned bitsFor(uint64_t x)
+	{
+		unsigned bits = 1;
+		while (bits < 64 && x >> bits != 0)
+			bits++;
+		return bits;
+	}
+
+	/** Return the number of elements. */
+	size_t size() const { return m_size; }
+
+	/** Return whether this array is empty. */
+	bool empty() const { return m_size == 0; }
+
+	/** Return the number of bits of each element. */
+	unsigned bits() const { return m_bits; }
+
+	/** Resize this array to n elements of the specified number of
+	 * bits, and set each element to zero.
+	 */
+	void resize(size_t n, unsigned bits)
+	{
+		assert(bits > 0 && bits <= 64);
+		m_size = n;
+		m_bits = bits;
+		m_mapped = NULL;
+		m_data.assign(words(n, bits), 0);
+	}
+
+	/** Remove the elements following the first n elements. */
+	void truncate(size_t n)
+	{
+		assert(n <= m_size);
+		assert(m_mapped == NULL);
+		m_size = n;
+		m_data.resize(words(n, m_bits));
+		std::vector<uint64_t>(m_data).swap(m_data);
+	}
+
+	/** Return the specified element. */
+	uint64_t at(size_t i) const
+	{
+		assert(i < m_size);
+		size_t pos = i * m_bits;
+		size_t w = pos / 64;
+		unsigned shift = pos % 64;
+		const uint64_t* p = data();
+		uint64_t x = p[w] >> shift;
+		if (shift + m_bits > 64)
+			x |= p[w + 1] << (64 - shift);
+		return x & mask();
+	}
+
+	/** Return the specified element. */
+	uint64_t operator[](size_t i) const { return at(i); }
+
+	/** Set the specified element. */
+	void set(size_t i, uint64_t x)
+	{
+		assert(i < m_size);
+		assert(m_mapped == NULL);
+		assert((x & ~mask()) == 0);
+		size_t pos = i * m_bits;
+		size_t w = pos / 64;
+		unsigned shift = pos % 64;
+		m_data[w] = (m_data[w] & ~(mask() << shift)) | x << shift;
+		if (shift + m_bits > 64) {
+			unsigned n = 64 - shift;
+			m_data[w + 1] = (m_data[w + 1] & ~(mask() >> n))
+				| x >> n;
+		}
+	}
+
+	/** Swap the contents of two arrays. */
+	void swap(PackedArray& o)
+	{
+		std::swap(m_size, o.m_size);
+		std::swap(m_bits, o.m_bits);
+		std::swap(m_mapped, o.m_mapped);
+		m_data.swap(o.m_data);
+	}
+
+	/** Store this data structure in the mappable layout, in which
+	 * the elements are aligned to a page.
+	 * @param pos the position of the output stream
+	 */
+	void store(std::ostream& out, uint64_t& pos) const
+	{
+		uint64_t n = m_size, bits = m_bits;
+		MappedFile::write(out, pos, &n, 1);
+		MappedFile::write(out, pos, &bits, 1);
+		MappedFile::writePadding(out, pos);
+		if (m_size > 0)
+			MappedFile::write(out, pos, data(), words(m_size, m_bits));
+	}
+
+	/** Load this data structure from the mappable layout. */
+	void load(std::istream& in, uint64_t& pos)
+	{
+		uint64_t n = 0, bits = 0;
+		MappedFile::read(in, pos, &n, 1);
+		MappedFile::read(in, pos, &bits, 1);
+		MappedFile::readPadding(in, pos);
+		if (!in)
+			return;
+		resize(n, bits);
+		if (!m_data.empty())
+			MappedFile::read(in, pos, &m_data[0], m_data.size());
+	}
+
+	/** Map this data structure from the mappable layout. */
+	void map(const MappedFile& file, uint64_t& pos)
+	{
+		uint64_t n = *file.map<uint64_t>(pos, 1);
+		uint64_t bits = *file.map<uint64_t>(pos, 1);
+		assert(bits > 0 && bits <= 64);
+		MappedFile::mapPadding(pos);
+		std::vector<uint64_t>().swap(m_data);
+		m_size = n;
+		m_bits = bits;
+		m_mapped = file.map<uint64_t>(pos, words(n, bits));
+	}
+
+	/** Store this data structure. */
+	friend std::ostream& operator<<(std::ostream& out,
+			const PackedArray& o)
+	{
+		uint64_t n = o.m_size;
+		uint32_t bits = o.m_bits;
+		out.write(reinterpret_cast<const char*>(&n), sizeof n);
+		out.write(reinterpret_cast<const char*>(&bits), sizeof bits);
+		if (o.m_size > 0)
+			out.write(reinterpret_cast<const char*>(o.data()),
+					words(o.m_size, o.m_bits) * sizeof (uint64_t));
+		return out;
+	}
+
+	/** Load this data structure. */
+	friend std::istream& operator>>(std::istream& in, PackedArray& o)
+	{
+		uint64_t n = 0;
+		uint32_t bits = 0;
+		in.read(reinterpret_cast<char*>(&n), sizeof n);
+		in.read(reinterpret_cast<char*>(&bits), sizeof bits);
+		if (!in)
+			return in;
+		o.resize(n, bits);
+		if (!o.m_data.empty())
+			in.read(reinterpret_cast<char*>(&o.m_data[0]),
+					o.m_data.size() * sizeof o.m_data[0]);
+		return in;
+	}
+
+  private:
+	/** Return the words of this array. */
+	const uint64_t* data() const
+	{
+		return m_mapped != NULL ? m_mapped : &m_data[0];
+	}
+
+	/** Return the number of words needed for n elements. */
+	static size_t words(size_t n, unsigned bits)
+	{
+		return (n * bits + 63) / 64;
+	}
+
+	/** Return a mask of the low m_bits bits. */
+	uint64_t mask() const
+	{
+		return m_bits == 64 ? ~(uint64_t)0
+			: ((uint64_t)1 << m_bits) - 1;
+	}
+
+	size_t m_size;
+	unsigned m_bits;
+
+	/** The words of a mapped array, or NULL. */
+	const uint64_t* m_mapped;
+
+	std::vector<uint64_t> m_data;
+};
+
+#endif
@@ -0,0 +1,427 @@
+#ifndef ARENA_GRAPH_H
+#define ARENA_GRAPH_H
+
+#include "Common/OpenHashMap.h"
+#include <boost/graph/graph_traits.hpp>
+#include <cassert>
+#include <iterator>
+#include <limits>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/**
+ * A directed graph whose vertices and edges are stored in two flat
+ * arrays. The successors of a vertex are a linked list of edges,
+ * in the order that the edges were added. A vertex descriptor maps to
+ * its index by an open-addressing hash table.
+ *
+ * clear() keeps the memory of the arrays and the hash table, so
+ * a graph that is cleared and rebuilt many times, such as the
+ * traversal history of a graph search, allocates memory only when it
+ * outgrows its largest previous size. The vertex descriptor must be
+ * plain old data.
+ */
+template <class VertexType>
+class ArenaGraph
+{
+public:
+
+	typedef ArenaGraph<VertexType> Graph;
+	typedef boost::graph_traits<Graph> GraphTraits;
+	typedef typename GraphTraits::vertex_descriptor vertex_descriptor;
+	typedef typename GraphTraits::edge_descriptor edge_descriptor;
+	typedef typename GraphTraits::out_edge_iterator out_edge_iterator;
+	typedef typename GraphTraits::adjacency_iterator adjacency_iterator;
+	typedef typename GraphTraits::degree_size_type degree_size_type;
+	typedef typename GraphTraits::vertex_iterator vertex_iterator;
+	typedef typename GraphTraits::vertices_size_type vertices_size_type;
+
+	/** The index of the end of a list of edges. */
+	static const uint32_t NIL = std::numeric_limits<uint32_t>::max();
+
+	/** A vertex and its list of successors. */
+	struct VertexNode {
+		vertex_descriptor v;
+		uint32_t first;
+		uint32_t last;
+		VertexNode(const vertex_descriptor& v)
+			: v(v), first(NIL), last(NIL) { }
+	};
+
+	/** An edge and the next edge of the same source vertex. */
+	struct EdgeNode {
+		uint32_t target;
+		uint32_t next;
+		EdgeNode(uint32_t target) : target(target), next(NIL) { }
+	};
+
+protected:
+
+	typedef OpenHashMap<vertex_descriptor, uint32_t,
+		hash<vertex_descriptor> > IndexMap;
+
+	IndexMap m_index;
+	std::vector<VertexNode> m_vertices;
+	std::vector<EdgeNode> m_edges;
+
+public:
+
+	/** Remove all vertices and edges without releasing memory. */
+	void clear()
+	{
+		m_index.clear();
+		m_vertices.clear();
+		m_edges.clear();
+	}
+
+	/** Release the memory of the arrays and the hash table. */
+	void release()
+	{
+		IndexMap().swap(m_index);
+		std::vector<VertexNode>().swap(m_vertices);
+		std::vector<EdgeNode>().swap(m_edges);
+	}
+
+	/** Return the approximate memory allocated by the vertices, the
+	 * edges and the hash table, including the memory that is kept for
+	 * reuse after clear().
+	 */
+	size_t approxMemSize() const
+	{
+		return m_vertices.capacity() * sizeof (VertexNode)
+			+ m_edges.capacity() * sizeof (EdgeNode)
+			+ m_index.allocated_size();
+	}
+
+	vertices_size_type num_vertices() const
+	{
+		return m_vertices.size();
+	}
+
+	size_t num_edges() const
+	{
+		return m_edges.size();
+	}
+
+	/** Return the vertex of the specified index. */
+	const VertexNode& vertex(uint32_t i) const
+	{
+		assert(i < m_vertices.size());
+		return m_vertices[i];
+	}
+
+	/** Return the edge of the specified index. */
+	const EdgeNode& edge(uint32_t i) const
+	{
+		assert(i < m_edges.size());
+		return m_edges[i];
+	}
+
+	/** Return the index of the specified vertex. */
+	uint32_t index(const vertex_descriptor& v) const
+	{
+		typename IndexMap::const_iterator it = m_index.find(v);
+		assert(it != m_index.end());
+		return it->second;
+	}
+
+	degree_size_type
+	out_degree(const vertex_descriptor& v) const
+	{
+		typename IndexMap::const_iterator it = m_index.find(v);
+		if (it == m_index.end())
+			return 0;
+		degree_size_type n = 0;
+		for (uint32_t e = m_vertices[it->second].first; e != NIL;
+				e = m_edges[e].next)
+			n++;
+		return n;
+	}
+
+	/** Return the index of the specified vertex, adding the vertex if
+	 * it is not present. */
+	uint32_t add_vertex(const vertex_descriptor& v)
+	{
+		assert(m_vertices.size() < NIL);
+		std::pair<typename IndexMap::iterator, bool> inserted
+			= m_index.insert(std::make_pair(v, (uint32_t)m_vertices.size()));
+		if (inserted.second)
+			m_vertices.push_back(VertexNode(v));
+		return inserted.first->second;
+	}
+
+	std::pair<edge_descriptor, bool>
+	add_edge(const vertex_descriptor& u, const vertex_descriptor& v)
+	{
+		uint32_t ui = add_vertex(u);
+		uint32_t vi = add_vertex(v);
+		for (uint32_t e = m_vertices[ui].first; e != NIL;
+				e = m_edges[e].next)
+			if (m_edges[e].target == vi)
+				return std::make_pair(edge_descriptor(u, v), false);
+
+		assert(m_edges.size() < NIL);
+		uint32_t e = m_edges.size();
+		m_edges.push_back(EdgeNode(vi));
+		VertexNode& node = m_vertices[ui];
+		if (node.last == NIL)
+			node.first = e;
+		else
+			m_edges[node.last].next = e;
+		node.last = e;
+		return std::make_pair(edge_descriptor(u, v), true);
+	}
+};
+
+namespace boost {
+
+template <class VertexType>
+struct graph_traits< ArenaGraph<VertexType> > {
+
+	// Graph
+	typedef VertexType vertex_descriptor;
+	typedef std::pair<vertex_descriptor, vertex_descriptor> edge_descriptor;
+	typedef boost::directed_tag directed_category;
+	typedef boost::disallow_parallel_edge_tag edge_parallel_category;
+	struct traversal_category
+		: boost::incidence_graph_tag,
+		boost::adjacency_graph_tag,
+		boost::vertex_list_graph_tag { };
+
+	// BidirectionalGraph
+	typedef void in_edge_iterator;
+
+	// VertexListGraph
+	typedef unsigned vertices_size_type;
+
+	// EdgeListGraph
+	typedef void edge_iterator;
+	typedef void edges_size_type;
+
+	// IncidenceGraph
+	typedef unsigned degree_size_type;
+
+	class vertex_iterator
+		: public std::iterator<std::input_iterator_tag,
+			const vertex_descriptor>
+	{
+		public:
+
+			vertex_iterator() : m_g(NULL), m_i(0) { }
+
+			vertex_iterator(const ArenaGraph<VertexType>& g, uint32_t i)
+				: m_g(&g), m_i(i) { }
+
+			vertex_descriptor operator*() const
+			{
+				return m_g->vertex(m_i).v;
+			}
+
+			bool operator==(const vertex_iterator& it) const
+			{
+				return m_i == it.m_i;
+			}
+
+			bool operator!=(const vertex_iterator& it) const
+			{
+				return m_i != it.m_i;
+			}
+
+			vertex_iterator& operator++()
+			{
+				++m_i;
+				return *this;
+			}
+
+			vertex_iterator operator++(int)
+			{
+				vertex_iterator it = *this;
+				++*this;
+				return it;
+			}
+
+		private:
+
+			const ArenaGraph<VertexType>* m_g;
+			uint32_t m_i;
+	};
+
+	/** Iterate over the list of edges of a vertex. */
+	class edge_list_iterator
+	{
+		public:
+
+			edge_list_iterator()
+				: m_g(NULL), m_e(ArenaGraph<VertexType>::NIL) { }
+
+			edge_list_iterator(const ArenaGraph<VertexType>& g,
+					vertex_descriptor u, uint32_t e)
+				: m_g(&g), m_u(u), m_e(e) { }
+
+			bool operator==(const edge_list_iterator& it) const
+			{
+				return m_e == it.m_e;
+			}
+
+			bool operator!=(const edge_list_iterator& it) const
+			{
+				return m_e != it.m_e;
+			}
+
+		protected:
+
+			vertex_descriptor target() const
+			{
+				return m_g->vertex(m_g->edge(m_e).target).v;
+			}
+
+			void next()
+			{
+				m_e = m_g->edge(m_e).next;
+			}
+
+			const ArenaGraph<VertexType>* m_g;
+			vertex_descriptor m_u;
+			uint32_t m_e;
+	};
+
+	struct adjacency_iterator
+		: public edge_list_iterator,
+		public std::iterator<std::input_iterator_tag, vertex_descriptor>
+	{
+		adjacency_iterator() { }
+
+		adjacency_iterator(const ArenaGraph<VertexType>& g,
+				vertex_descriptor u, uint32_t e)
+			: edge_list_iterator(g, u, e) { }
+
+		vertex_descriptor operator*() const
+		{
+			return this->target();
+		}
+
+		adjacency_iterator& operator++()
+		{
+			this->next();
+			return *this;
+		}
+
+		adjacency_iterator operator++(int)
+		{
+			adjacency_iterator it = *this;
+			++*this;
+			return it;
+		}
+	};
+
+	struct out_edge_iterator
+		: public edge_list_iterator,
+		public std::iterator<std::input_iterator_tag, edge_descriptor>
+	{
+		out_edge_iterator() { }
+
+		out_edge_iterator(const ArenaGraph<VertexType>& g,
+				vertex_descriptor u, uint32_t e)
+			: edge_list_iterator(g, u, e) { }
+
+		edge_descriptor operator*() const
+		{
+			return edge_descriptor(this->m_u, this->target());
+		}
+
+		out_edge_iterator& operator++()
+		{
+			this->next();
+			return *this;
+		}
+
+		out_edge_iterator operator++(int)
+		{
+			out_edge_iterator it = *this;
+			++*this;
+			return it;
+		}
+	};
+
+}; // graph_traits
+
+}
+
+// IncidenceGraph
+
+template <class VertexType>
+std::pair<
+	typename ArenaGraph<VertexType>::out_edge_iterator,
+	typename ArenaGraph<VertexType>::out_edge_iterator>
+out_edges(
+	typename ArenaGraph<VertexType>::vertex_descriptor u,
+	const ArenaGraph<VertexType>& g)
+{
+	typedef typename ArenaGraph<VertexType>::out_edge_iterator
+		out_edge_iterator;
+	uint32_t first = g.vertex(g.index(u)).first;
+	return std::make_pair(out_edge_iterator(g, u, first),
+		out_edge_iterator(g, u, ArenaGraph<VertexType>::NIL));
+}
+
+template <class VertexType>
+typename ArenaGraph<VertexType>::degree_size_type
+out_degree(
+	typename ArenaGraph<VertexType>::vertex_descriptor u,
+	const ArenaGraph<VertexType>& g)
+{
+	return g.out_degree(u);
+}
+
+// AdjacencyGraph
+
+template <class VertexType>
+std::pair<
+	typename ArenaGraph<VertexType>::adjacency_iterator,
+	typename ArenaGraph<VertexType>::adjacency_iterator>
+adjacent_vertices(
+	typename ArenaGraph<VertexType>::vertex_descriptor u,
+	const ArenaGraph<VertexType>& g)
+{
+	typedef typename ArenaGraph<VertexType>::adjacency_iterator
+		adjacency_iterator;
+	uint32_t first = g.vertex(g.index(u)).first;
+	return std::make_pair(adjacency_iterator(g, u, first),
+		adjacency_iterator(g, u, ArenaGraph<VertexType>::NIL));
+}
+
+// VertexListGraph
+
+template <class VertexType>
+std::pair<
+	typename ArenaGraph<VertexType>::vertex_iterator,
+	typename ArenaGraph<VertexType>::vertex_iterator>
+vertices(const ArenaGraph<VertexType>& g)
+{
+	typedef typename ArenaGraph<VertexType>::vertex_iterator
+		vertex_iterator;
+	return std::make_pair(vertex_iterator(g, 0),
+		vertex_iterator(g, g.num_vertices()));
+}
+
+template <class VertexType>
+typename ArenaGraph<VertexType>::vertices_size_type
+num_vertices(const ArenaGraph<VertexType>& g)
+{
+	return g.num_vertices();
+}
+
+// MutableGraph
+
+template <class VertexType>
+std::pair<typename ArenaGraph<VertexType>::edge_descriptor, bool>
+add_edge(
+	typename ArenaGraph<VertexType>::vertex_descriptor u,
+	typename ArenaGraph<VertexType>::vertex_descriptor v,
+	ArenaGraph<VertexType>& g)
+{
+	return g.add_edge(u, v);
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef BIDIBFSCONTEXT_H
+#define BIDIBFSCONTEXT_H 1
+
+#include "Graph/BidirectionalBFS.h"
+#include "Graph/ConstrainedBidiBFSVisitor.h"
+#include "Graph/FlatColorMap.h"
+#include <boost/graph/graph_traits.hpp>
+#include <cassert>
+#include <vector>
+
+/**
+ * The state of a constrained bidirectional breadth first search, which
+ * is reused from one search to the next. The visited vertices, their
+ * depths and the traversal history are stored in flat tables that are
+ * cleared but not freed between searches, so that a thread that
+ * searches many read pairs allocates memory only while its tables
+ * grow. The memory kept between searches counts toward the memory
+ * limit of a search. Use one context per thread.
+ */
+template <typename G>
+class BidiBFSContext
+{
+  public:
+	typedef typename boost::graph_traits<G>::vertex_descriptor V;
+	typedef ConstrainedBidiBFSVisitor<G> Visitor;
+
+	/** A FIFO queue that is stored in a vector. The popped vertices
+	 * are not removed until the queue is cleared, so that pushing
+	 * and popping never free memory. */
+	class Queue
+	{
+	  public:
+		Queue() : m_head(0) { }
+		bool empty() const { return m_head == m_v.size(); }
+		size_t size() const { return m_v.size() - m_head; }
+		const V& top() const { assert(!empty()); return m_v[m_head]; }
+		void push(const V& v) { m_v.push_back(v); }
+		void pop() { assert(!empty()); m_head++; }
+		void clear() { m_v.clear(); m_head = 0; }
+	  private:
+		std::vector<V> m_v;
+		size_t m_head;
+	};
+
+	BidiBFSContext(const G& g) : m_g(g), m_visitor(g)
+	{
+		m_visitor.setColorMaps(m_color);
+	}
+
+	/**
+	 * Search for the paths from start to goal.
+	 * @return the visitor, which holds the result of the search
+	 * until the next search
+	 */
+	Visitor& search(const V& start, const V& goal,
+			unsigned maxPaths, unsigned minPathLength,
+			unsigned maxPathLength, unsigned maxBranches,
+			size_t memLimit)
+	{
+		// Release the tables that an earlier search grew beyond the
+		// memory limit, so that the memory kept by each thread between
+		// searches is bounded by the limit.
+		if (m_visitor.approxMemUsage() > memLimit) {
+			m_visitor.release();
+			for (unsigned i = 0; i < 2; i++)
+				m_color[i].release();
+		}
+		m_visitor.reset(start, goal, maxPaths, minPathLength,
+				maxPathLength, maxBranches, memLimit);
+		for (unsigned i = 0; i < 2; i++) {
+			m_color[i].clear();
+			m_queue[i].clear();
+		}
+		bidirectionalBFS(m_g, start, goal, m_queue[0], m_queue[1],
+				m_visitor, m_color[0], m_color[1]);
+		return m_visitor;
+	}
+
+  private:
+	BidiBFSContext(const BidiBFSContext&);
+	BidiBFSContext& operator=(const BidiBFSContext&);
+
+	const G& m_g;
+	Visitor m_visitor;
+	FlatColorMap<G> m_color[2];
+	Queue m_queue[2];
+};
+
+#endif
@@ -1,20 +1,28 @@
 #ifndef CONSTRAINED_BIDI_BFS_VISITOR_H
 #define CONSTRAINED_BIDI_BFS_VISITOR_H
 
-#include "Common/UnorderedMap.h"
+#include "Common/OpenHashMap.h"
 #include "Common/UnorderedSet.h"
 #include "Common/IOUtil.h"
 #include "Graph/Path.h"
+#include "Graph/ArenaGraph.h"
+#include "Graph/FlatColorMap.h"
 #include "Graph/HashGraph.h"
 #include "Graph/BidirectionalBFSVisitor.h"
 #include "Graph/AllPathsSearch.h"
-#include "Common/MemUtils.h"
 #include <boost/graph/graph_traits.hpp>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <algorithm>
 
+/**
+ * Find the paths between two vertices by a bidirectional breadth first
+ * search, subject to limits on the path length, the number of paths
+ * and branches, and the memory used. The visitor may be reset and
+ * reused for another search, which reuses the memory of its tables.
+ * The vertex descriptor must be plain old data.
+ */
 template <typename G>
 class ConstrainedBidiBFSVisitor : public BidirectionalBFSVisitor<G>
 {
@@ -25,14 +33,14 @@ protected:
 	typedef typename boost::graph_traits<G>::edge_descriptor E;
 	typedef unsigned short depth_t;
 	typedef std::vector< Path<V> > PathList;
-	typedef unordered_map<V, depth_t, hash<V> > DepthMap;
+	typedef OpenHashMap<V, depth_t, hash<V> > DepthMap;
 
 	struct EdgeHash {
-		const G& m_g;
-		EdgeHash(const G& g) : m_g(g) { }
+		const G* m_g;
+		EdgeHash(const G& g) : m_g(&g) { }
 		std::size_t operator()(const E& e) const {
-			V u = source(e, m_g);
-			V v = target(e, m_g);
+			V u = source(e, *m_g);
+			V v = target(e, *m_g);
 			return hash<V>()(u) ^ hash<V>()(v);
 		}
 	};
@@ -47,11 +55,15 @@ protected:
 	unsigned m_maxPaths;
 
 	/** records history of forward/reverse traversals */
-	HashGraph<V> m_traversalGraph[2];
+	ArenaGraph<V> m_traversalGraph[2];
 
 	/** records depth of vertices during forward/reverse traversal */
 	DepthMap m_depthMap[2];
 
+	/** the color maps of the forward/reverse traversal, whose memory
+	 * is counted by approxMemUsage, or NULL */
+	const FlatColorMap<G>* m_colorMaps;
+
 	/** depth limits for forward/reverse traversal */
 	depth_t m_maxDepth[2];
 
@@ -100,21 +112,75 @@ public:
 		size_t memLimit
 		) :
 			m_graph(graph),
-			m_start(start),
-			m_goal(goal),
-			m_maxPaths(maxPaths),
-			m_minPathLength(minPathLength),
-			m_maxPathLength(maxPathLength),
-			m_maxBranches(maxBranches),
-			m_memLimit(memLimit),
-			m_memCheckCounter(0),
-			m_exceededMemLimit(false),
-			m_peakActiveBranches(0),
-			m_tooManyBranches(false),
-			m_tooManyPaths(false),
-			m_numNodesVisited(0),
-			m_commonEdges(m_maxPaths, EdgeHash(m_graph))
+			m_colorMaps(NULL),
+			m_commonEdges(0, EdgeHash(m_graph))
+	{
+		reset(start, goal, maxPaths, minPathLength, maxPathLength,
+			maxBranches, memLimit);
+	}
+
+	/** Construct a visitor to be reset before each search. */
+	explicit ConstrainedBidiBFSVisitor(const G& graph) :
+			m_graph(graph),
+			m_colorMaps(NULL),
+			m_commonEdges(0, EdgeHash(m_graph))
+	{
+	}
+
+	/** Count the memory of the two specified color maps of the
+	 * forward and reverse traversals in approxMemUsage. */
+	void setColorMaps(const FlatColorMap<G>* colorMaps)
+	{
+		m_colorMaps = colorMaps;
+	}
+
+	/** Release the memory of the traversal graphs and the depth
+	 * maps. */
+	void release()
+	{
+		for (unsigned i = 0; i < 2; i++) {
+			m_traversalGraph[i].release();
+			DepthMap().swap(m_depthMap[i]);
+		}
+	}
+
+	/**
+	 * Prepare for a new search. The traversal graphs and the depth
+	 * maps are cleared, but keep their memory for the next search.
+	 */
+	void reset(
+		const V& start,
+		const V& goal,
+		unsigned maxPaths,
+		depth_t minPathLength,
+		depth_t maxPathLength,
+		unsigned maxBranches,
+		size_t memLimit)
 	{
+		m_start = start;
+		m_goal = goal;
+		m_maxPaths = maxPaths;
+		m_minPathLength = minPathLength;
+		m_maxPathLength = maxPathLength;
+		m_maxBranches = maxBranches;
+		m_memLimit = memLimit;
+		m_memCheckCounter = 0;
+		m_exceededMemLimit = false;
+		m_peakActiveBranches = 0;
+		m_tooManyBranches = false;
+		m_tooManyPaths = false;
+		m_numNodesVisited = 0;
+
+		m_traversalGraph[FORWARD].clear();
+		m_traversalGraph[REVERSE].clear();
+		m_depthMap[FORWARD].clear();
+		m_depthMap[REVERSE].clear();
+		m_pathsFound.clear();
+
+		// The paths are built in the order of the common edges, which
+		// depends on the number of buckets of the set, so construct
+		// the set afresh rather than clearing it.
+		EdgeSet(m_maxPaths, EdgeHash(m_graph)).swap(m_commonEdges);
 
 		depth_t maxDepth = maxPathLength - 1;
 		m_maxDepth[FORWARD] = maxDepth / 2 + maxDepth % 2;
@@ -237,23 +303,30 @@ public:
 		return m_numNodesVisited;
 	}
 
+	/** Return the approximate memory allocated by the traversal
+	 * graphs, the depth maps and the color maps, including the
+	 * memory that is kept for reuse by the next search. */
 	size_t approxMemUsage()
 	{
-		return
+		size_t n =
 			m_traversalGraph[FORWARD].approxMemSize() +
 			m_traversalGraph[REVERSE].approxMemSize() +
-			approxMemSize(m_depthMap[FORWARD]) +
-			approxMemSize(m_depthMap[REVERSE]);
+			m_depthMap[FORWARD].allocated_size() +
+			m_depthMap[REVERSE].allocated_size();
+		if (m_colorMaps != NULL)
+			n += m_colorMaps[FORWARD].approxMemSize()
+				+ m_colorMaps[REVERSE].approxMemSize();
+		return n;
 	}
 
 	void getTraversalGraph(HashGraph<V>& traversalGraph)
 	{
-		typedef typename HashGraph<V>::vertex_iterator vertex_iterator;
-		typedef typename HashGraph<V>::adjacency_iterator adjacency_iterator;
+		typedef typename ArenaGraph<V>::vertex_iterator vertex_iterator;
+		typedef typename ArenaGraph<V>::adjacency_iterator adjacency_iterator;
 
 		Direction dir[] = { FORWARD, REVERSE };
 		for (unsigned i = 0; i < 2; i++) {
-			HashGraph<V>& g = m_traversalGraph[dir[i]];
+			const ArenaGraph<V>& g = m_traversalGraph[dir[i]];
 			vertex_iterator vi, vi_end;
 			boost::tie(vi, vi_end) = vertices(g);
 			for(; vi != vi_end; vi++) {
@@ -0,0 +1,70 @@
+#ifndef FLATCOLORMAP_H
+#define FLATCOLORMAP_H
+
+#include "Common/OpenHashMap.h"
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/properties.hpp>
+
+/**
+ * A vertex color map stored in an open-addressing hash table. Unlike
+ * DefaultColorMap, it may be cleared and reused without freeing its
+ * memory. The vertex descriptor must be plain old data.
+ */
+template <typename G>
+class FlatColorMap
+{
+public:
+
+	typedef typename boost::graph_traits<G>::vertex_descriptor key_type;
+	typedef typename boost::graph_traits<G>::vertex_descriptor& reference;
+	typedef boost::default_color_type value_type;
+	typedef boost::read_write_property_map_tag category;
+
+	typedef OpenHashMap<key_type, value_type, hash<key_type> >
+		map_type;
+	map_type map;
+
+	/** Set every vertex to white without releasing memory. */
+	void clear() { map.clear(); }
+
+	/** Set every vertex to white and release the memory. */
+	void release() { map_type().swap(map); }
+
+	/** Return the approximate memory allocated by this map. */
+	size_t approxMemSize() const { return map.allocated_size(); }
+};
+
+namespace boost {
+template <typename G>
+struct property_traits< FlatColorMap<G> > {
+	typedef typename FlatColorMap<G>::key_type key_type;
+	typedef typename FlatColorMap<G>::reference reference;
+	typedef typename FlatColorMap<G>::value_type value_type;
+	typedef typename FlatColorMap<G>::category category;
+};
+}
+
+template <typename G>
+typename FlatColorMap<G>::value_type
+get(const FlatColorMap<G>& colorMap, typename FlatColorMap<G>::key_type key)
+{
+	typedef typename FlatColorMap<G>::map_type::const_iterator It;
+
+	It i = colorMap.map.find(key);
+
+	if (i != colorMap.map.end())
+		return i->second;
+
+	return boost::white_color;
+}
+
+template <typename G>
+void
+put(FlatColorMap<G>& colorMap,
+	typename FlatColorMap<G>::key_type key,
+	typename FlatColorMap<G>::value_type value)
+{
+	colorMap.map[key] = value;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#!/usr/bin/make -rRf
+# Measure the throughput of building a bloom filter with abyss-bloom
+# for 1 to 64 threads.
+#
+# Usage: threads-benchmark.mk [new=abyss-bloom] [old=abyss-bloom-old]
+#
+# Set old to an abyss-bloom built before ConcurrentBloomFilter was made
+# lock-free to compare the two designs. The bloom filter built with
+# each number of threads must be identical to that built with one
+# thread.
+
+SHELL=/bin/bash
+
+#------------------------------------------------------------
+# test input/output files
+#------------------------------------------------------------
+
+# reads to load into the bloom filter
+reads_url:=http://gage.cbcb.umd.edu/data/Staphylococcus_aureus/Data.original/frag_1.fastq.gz
+reads=reads.fq.gz
+test_reads=test_reads.fq
+
+# the table of results
+results=threads-benchmark.tsv
+
+#------------------------------------------------------------
+# params
+#------------------------------------------------------------
+
+# the abyss-bloom to benchmark
+new?=abyss-bloom
+# the abyss-bloom to compare against, if any
+old?=
+# k-mer size
+k?=25
+# bloom filter size
+b?=100M
+# numbers of levels of the bloom filter
+levels?=1 2
+# num of reads to load
+n?=1000000
+# numbers of threads
+threads?=1 2 4 8 16 32 64
+
+#------------------------------------------------------------
+# special targets
+#------------------------------------------------------------
+
+.PHONY: clean benchmark
+
+default: benchmark
+
+clean:
+	rm -f $(test_reads) $(results) *.bloom
+
+#------------------------------------------------------------
+# downloading/building test input data
+#------------------------------------------------------------
+
+# download some reads
+$(reads):
+	curl $(reads_url) > $@
+
+# extract first $n reads
+$(test_reads): $(reads)
+	zcat $(reads) | paste - - - - | head -$n | \
+		tr '\t' '\n' > $@
+
+#------------------------------------------------------------
+# running abyss-bloom
+#------------------------------------------------------------
+
+# Print the program, the number of levels, the number of threads, the
+# elapsed seconds and the number of reads loaded per second.
+$(results): $(test_reads)
+	printf 'program\tlevels\tthreads\tseconds\treads_per_second\n' > $@
+	n=$$(($$(wc -l < $(test_reads)) / 4)); \
+	for prog in $(new) $(old); do \
+		for l in $(levels); do \
+			for j in $(threads); do \
+				start=$$(date +%s.%N); \
+				$$prog build -k$k -b$b -l$$l -j$$j \
+					l$$l-j$$j.bloom $^ 2>/dev/null || exit 1; \
+				end=$$(date +%s.%N); \
+				cmp l$$l-j$$j.bloom l$$l-j1.bloom || exit 1; \
+				echo "$$prog $$l $$j $$start $$end" | awk -v n=$$n \
+					'{ s = $$5 - $$4; \
+					printf "%s\t%d\t%d\t%.2f\t%.0f\n", \
+						$$1, $$2, $$3, s, n / s }' \
+					>> $@; \
+			done; \
+		done; \
+	done
+
+benchmark: $(results)
+	cat $(results)
@@ -0,0 +1,92 @@
+#!/usr/bin/make -rRf
+# Measure the throughput of KAligner for 1 to 64 threads.
+#
+# Usage: threads-benchmark.mk [new=KAligner] [old=KAligner-old]
+#
+# Set old to a KAligner built before the reads were passed to the
+# workers in batches to compare the two designs.
+
+SHELL=/bin/bash
+
+#------------------------------------------------------------
+# test input/output files
+#------------------------------------------------------------
+
+# target seq for alignments
+ref_url:=http://gage.cbcb.umd.edu/data/Staphylococcus_aureus/Data.original/genome.fasta
+ref:=ref.fa
+
+# query seqs for alignments
+reads_url:=http://gage.cbcb.umd.edu/data/Staphylococcus_aureus/Data.original/frag_1.fastq.gz
+reads=reads.fq.gz
+test_reads=test_reads.fq
+
+# the table of results
+results=threads-benchmark.tsv
+
+#------------------------------------------------------------
+# params
+#------------------------------------------------------------
+
+# the KAligner to benchmark
+new?=KAligner
+# the KAligner to compare against, if any
+old?=
+# k-mer size
+k?=25
+# num of reads to align
+n?=1000000
+# numbers of threads
+threads?=1 2 4 8 16 32 64
+
+#------------------------------------------------------------
+# special targets
+#------------------------------------------------------------
+
+.PHONY: clean benchmark
+
+default: benchmark
+
+clean:
+	rm -f $(test_reads) $(results)
+
+#------------------------------------------------------------
+# downloading/building test input data
+#------------------------------------------------------------
+
+# download ref
+$(ref):
+	curl $(ref_url) > $@
+
+# download some reads
+$(reads):
+	curl $(reads_url) > $@
+
+# extract first $n reads
+$(test_reads): $(reads)
+	zcat $(reads) | paste - - - - | head -$n | \
+		tr '\t' '\n' > $@
+
+#------------------------------------------------------------
+# running KAligner
+#------------------------------------------------------------
+
+# Print the program, the number of threads, the elapsed seconds and
+# the number of reads aligned per second.
+$(results): $(test_reads) $(ref)
+	printf 'program\tthreads\tseconds\treads_per_second\n' > $@
+	n=$$(($$(wc -l < $(test_reads)) / 4)); \
+	for prog in $(new) $(old); do \
+		for j in $(threads); do \
+			start=$$(date +%s.%N); \
+			$$prog -k$k -j$$j $^ > /dev/null || exit 1; \
+			end=$$(date +%s.%N); \
+			echo "$$prog $$j $$start $$end" | awk -v n=$$n \
+				'{ s = $$4 - $$3; \
+				printf "%s\t%d\t%.2f\t%.0f\n", $$1, $$2, s, n / s }' \
+				>> $@; \
+		done; \
+	done
+
+benchmark: $(results)
+	cat $(results)
@@ -0,0 +1,91 @@
+#!/usr/bin/make -rRf
+# Measure the throughput of konnector for 1 to 64 threads.
+#
+# Usage: threads-benchmark.mk [new=konnector] [old=konnector-old]
+#
+# Set old to a konnector built before each thread reused its path
+# search state from one read pair to the next to compare the two
+# designs.
+
+SHELL=/bin/bash
+
+#------------------------------------------------------------
+# test input/output files
+#------------------------------------------------------------
+
+# paired-end reads to connect
+reads_url:=http://gage.cbcb.umd.edu/data/Staphylococcus_aureus/Data.original
+reads1=frag_1.fastq.gz
+reads2=frag_2.fastq.gz
+test_reads1=test_reads_1.fq
+test_reads2=test_reads_2.fq
+
+# the table of results
+results=threads-benchmark.tsv
+
+#------------------------------------------------------------
+# params
+#------------------------------------------------------------
+
+# the konnector to benchmark
+new?=konnector
+# the konnector to compare against, if any
+old?=
+# k-mer size
+k?=50
+# bloom filter size
+b?=100M
+# num of read pairs to connect
+n?=200000
+# numbers of threads
+threads?=1 2 4 8 16 32 64
+
+#------------------------------------------------------------
+# special targets
+#------------------------------------------------------------
+
+.PHONY: clean benchmark
+
+default: benchmark
+
+clean:
+	rm -f $(test_reads1) $(test_reads2) $(results) out_*
+
+#------------------------------------------------------------
+# downloading/building test input data
+#------------------------------------------------------------
+
+# download some reads
+$(reads1) $(reads2):
+	curl $(reads_url)/$@ > $@
+
+# extract first $n read pairs
+test_reads_%.fq: frag_%.fastq.gz
+	zcat $< | paste - - - - | head -$n | \
+		tr '\t' '\n' > $@
+
+#------------------------------------------------------------
+# running konnector
+#------------------------------------------------------------
+
+# Print the program, the number of threads, the elapsed seconds and
+# the number of read pairs connected per second. Each time includes
+# building the Bloom filter.
+$(results): $(test_reads1) $(test_reads2)
+	printf 'program\tthreads\tseconds\tpairs_per_second\n' > $@
+	n=$$(($$(wc -l < $(test_reads1)) / 4)); \
+	for prog in $(new) $(old); do \
+		for j in $(threads); do \
+			start=$$(date +%s.%N); \
+			$$prog -k$k -b$b -j$$j -o out_$$j $^ \
+				> /dev/null || exit 1; \
+			end=$$(date +%s.%N); \
+			echo "$$prog $$j $$start $$end" | awk -v n=$$n \
+				'{ s = $$4 - $$3; \
+				printf "%s\t%d\t%.2f\t%.0f\n", $$1, $$2, s, n / s }' \
+				>> $@; \
+		done; \
+	done
+
+benchmark: $(results)
+	cat $(results)
@@ -1,5 +1,6 @@
 #include "Aligner.h"
 #include "Iterator.h"
+#include "KmerIterator.h"
 #include "SAM.h"
 #include "Sequence.h"
 #include <algorithm>
@@ -59,13 +60,11 @@ void Aligner<SeqPosHashMap>::addReferenceSequence(
 		const StringID& idString, const Sequence& seq)
 {
 	unsigned id = contigIDToIndex(idString);
-	int size = seq.length();
-	for(int i = 0; i < (size - m_hashSize + 1); ++i)
-	{
-		Sequence subseq(seq, i, m_hashSize);
-		if (subseq.find_first_not_of("ACGT0123") != string::npos)
-			continue;
-		addReferenceSequence(Kmer(subseq), Position(id, i));
+	for (KmerIterator it(seq, m_hashSize);
+			it != KmerIterator::end(); ++it) {
+		// Skip the k-mer that contain masked (lower-case) bases.
+		if (!it.masked())
+			addReferenceSequence(*it, Position(id, it.pos()));
 	}
 }
 
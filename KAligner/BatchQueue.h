@@ -0,0 +1,129 @@
+#ifndef BATCHQUEUE_H
+#define BATCHQUEUE_H 1
+
+#include "Semaphore.h"
+#include <algorithm> // for swap
+#include <cassert>
+#include <sched.h>
+#include <vector>
+
+/** A bounded queue for passing values between any number of producer
+ * and consumer threads. A slot of the ring buffer is claimed by an
+ * atomic increment of a ticket, and published by setting its sequence
+ * number, so no lock is taken. The semaphores block a thread only
+ * when the queue is full or empty.
+ */
+template <class T>
+class BatchQueue
+{
+  public:
+	/** Construct a queue that holds up to size values. */
+	BatchQueue(unsigned size)
+		: m_slots(size), m_sem_in(size), m_sem_out(0),
+		m_head(0), m_tail(0), m_items(0), m_open(true)
+	{
+		assert(size > 0);
+		for (size_t i = 0; i < m_slots.size(); i++)
+			m_slots[i].seq = i;
+	}
+
+	/** Add a value to the queue, and swap x with the empty value of
+	 * its slot. Block while the queue is full.
+	 */
+	void push(T& x)
+	{
+		assert(m_open);
+		m_sem_in.wait();
+		size_t pos = __sync_fetch_and_add(&m_head, 1);
+		Slot& slot = m_slots[pos % m_slots.size()];
+		// Wait for the consumer of the previous lap to free the slot.
+		while (load(slot.seq) != pos)
+			sched_yield();
+		std::swap(slot.value, x);
+		__sync_synchronize();
+		slot.seq = pos + 1;
+		__sync_fetch_and_add(&m_items, 1);
+		m_sem_out.post();
+	}
+
+	/** Remove a value from the queue. Block while the queue is empty
+	 * and open.
+	 * @return false if the queue is closed and empty
+	 */
+	bool pop(T& x)
+	{
+		m_sem_out.wait();
+		for (size_t n = load(m_items);;) {
+			if (n == 0) {
+				// The queue is closed and empty. Wake the next
+				// consumer.
+				assert(!m_open);
+				m_sem_out.post();
+				return false;
+			}
+			size_t old = __sync_val_compare_and_swap(
+					&m_items, n, n - 1);
+			if (old == n)
+				break;
+			n = old;
+		}
+		size_t pos = __sync_fetch_and_add(&m_tail, 1);
+		Slot& slot = m_slots[pos % m_slots.size()];
+		// Wait for the producer of this ticket to publish the value.
+		while (load(slot.seq) != pos + 1)
+			sched_yield();
+		std::swap(slot.value, x);
+		__sync_synchronize();
+		slot.seq = pos + m_slots.size();
+		m_sem_in.post();
+		return true;
+	}
+
+	/** Close the queue. The producers must not push after it is
+	 * closed. Once the values are consumed, pop returns false.
+	 */
+	void close()
+	{
+		m_open = false;
+		__sync_synchronize();
+		m_sem_out.post();
+	}
+
+  private:
+	BatchQueue(const BatchQueue&);
+	BatchQueue& operator=(const BatchQueue&);
+
+	/** Load a value written by another thread. */
+	static size_t load(const volatile size_t& x)
+	{
+		size_t v = x;
+		__sync_synchronize();
+		return v;
+	}
+
+	/** A slot of the ring buffer. Its sequence number is its ticket
+	 * when it is free, and its ticket plus one when it is full.
+	 */
+	struct Slot
+	{
+		volatile size_t seq;
+		T value;
+		Slot() : seq(0), value() { }
+	};
+
+	std::vector<Slot> m_slots;
+
+	/** The number of free and full slots. */
+	Semaphore m_sem_in, m_sem_out;
+
+	/** The tickets of the next push and the next pop. */
+	size_t m_head, m_tail;
+
+	/** The number of published values that are not yet claimed. */
+	volatile size_t m_items;
+
+	/** True if close() has not been called. */
+	volatile bool m_open;
+};
+
+#endif
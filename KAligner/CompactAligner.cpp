@@ -0,0 +1,299 @@
+#include "CompactAligner.h"
+#include "HashFunction.h"
+#include "Iterator.h"
+#include "KmerIterator.h"
+#include "SAM.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+using namespace std;
+
+/** Return whether two bases of a query and target match. A masked
+ * (lower-case) base matches nothing, so that an alignment stops at a
+ * masked base, like those of the hash table index, which skips the
+ * k-mer that contain a masked base.
+ */
+static bool match(char a, char b)
+{
+	if (a >= 'a' || b >= 'a')
+		return false;
+	uint8_t x = KmerIterator::code(a);
+	return x != KmerIterator::INVALID && x == KmerIterator::code(b);
+}
+
+/** Return the hash value of a k-mer. Kmer::getHashCode ignores the
+ * last byte of the k-mer, which would give many k-mer of a window the
+ * same hash value.
+ */
+static uint32_t hashKmer(const Kmer& kmer)
+{
+	char buf[Kmer::NUM_BYTES];
+	kmer.serialize(buf);
+	return hashmem(buf, Kmer::bytes());
+}
+
+/** Find the (w,k)-minimizers of a sequence. Of each w consecutive
+ * k-mer, return the k-mer with the smallest hash value, preferring the
+ * rightmost. A k-mer that contains a base other than ACGT or a masked
+ * base is not a candidate.
+ */
+void CompactAligner::getMinimizers(const Sequence& seq,
+		vector<Minimizer>& minimizers) const
+{
+	minimizers.clear();
+	if (seq.size() < m_k)
+		return;
+
+	// The candidates of the current window in order of position and
+	// of increasing hash value.
+	deque<Minimizer> window;
+	size_t last = numeric_limits<size_t>::max();
+	size_t numKmer = seq.size() - m_k + 1;
+	KmerIterator it(seq, m_k);
+	for (size_t end = 0; end < numKmer; end++) {
+		if (it != KmerIterator::end() && it.pos() == end) {
+			if (!it.masked()) {
+				Minimizer x(hashKmer(*it), end);
+				while (!window.empty() && window.back().hash >= x.hash)
+					window.pop_back();
+				window.push_back(x);
+			}
+			++it;
+		}
+		if (end + 1 < m_w && end + 1 < numKmer)
+			continue;
+
+		// The window is [end + 1 - w, end].
+		while (!window.empty() && window.front().pos + m_w <= end)
+			window.pop_front();
+		if (!window.empty() && window.front().pos != last) {
+			minimizers.push_back(window.front());
+			last = window.front().pos;
+		}
+	}
+}
+
+/** Index the minimizers of a target sequence. */
+void CompactAligner::addReferenceSequence(
+		const StringID& id, const Sequence& seq)
+{
+	assert(m_directory.empty());
+	assert(seq.size() < numeric_limits<uint32_t>::max());
+	m_dict.push_back(id);
+	m_seqs.push_back(seq);
+	unsigned contig = m_dict.size() - 1;
+	assert(contig < numeric_limits<uint32_t>::max());
+
+	vector<Minimizer> minimizers;
+	getMinimizers(seq, minimizers);
+	for (vector<Minimizer>::const_iterator it = minimizers.begin();
+			it != minimizers.end(); ++it)
+		m_index.push_back(Entry(it->hash, contig, it->pos));
+}
+
+struct CompactAligner::CompareEntry
+{
+	const vector<string>& seqs;
+	unsigned k;
+
+	CompareEntry(const vector<string>& seqs, unsigned k)
+		: seqs(seqs), k(k) { }
+
+	/** Compare the k-mer of two entries. */
+	int compare(const Entry& a, const Entry& b) const
+	{
+		return seqs[a.contig].compare(a.pos, k,
+				seqs[b.contig], b.pos, k);
+	}
+
+	bool operator()(const Entry& a, const Entry& b) const
+	{
+		if (a.hash != b.hash)
+			return a.hash < b.hash;
+		int c = compare(a, b);
+		if (c != 0)
+			return c < 0;
+		return a.contig != b.contig ? a.contig < b.contig
+			: a.pos < b.pos;
+	}
+};
+
+/** Sort the index and build its directory. Handle the duplicate k-mer
+ * in the target according to opt::multimap. Unlike the hash table
+ * index, a k-mer whose reverse complement is in the target is not a
+ * duplicate.
+ */
+void CompactAligner::build()
+{
+	assert(m_directory.empty());
+	assert(m_index.size() < numeric_limits<uint32_t>::max());
+	CompareEntry compare(m_seqs, m_k);
+	sort(m_index.begin(), m_index.end(), compare);
+
+	if (opt::multimap != opt::MULTIMAP) {
+		// Remove the duplicate k-mer.
+		vector<Entry>::iterator out = m_index.begin();
+		for (vector<Entry>::iterator it = m_index.begin();
+				it != m_index.end();) {
+			vector<Entry>::iterator last = it + 1;
+			while (last != m_index.end() && last->hash == it->hash
+					&& compare.compare(*it, *last) == 0)
+				++last;
+			if (last - it == 1) {
+				*out++ = *it;
+			} else if (opt::multimap == opt::IGNORE) {
+				m_duplicates++;
+			} else {
+				cerr << "error: duplicate k-mer in "
+					<< contigIndexToID(it->contig)
+					<< " also in "
+					<< contigIndexToID((it + 1)->contig)
+					<< ": " << m_seqs[it->contig].substr(it->pos, m_k)
+					<< '\n';
+				exit(EXIT_FAILURE);
+			}
+			it = last;
+		}
+		m_index.erase(out, m_index.end());
+		vector<Entry>(m_index).swap(m_index);
+	}
+
+	// Use about four entries per bucket.
+	for (m_bits = 1; m_bits < 32
+			&& size_t(4) << m_bits < m_index.size(); m_bits++)
+		;
+	m_directory.resize((size_t(1) << m_bits) + 1);
+	vector<Entry>::const_iterator it = m_index.begin();
+	for (size_t i = 0; i < m_directory.size(); i++) {
+		while (it != m_index.end() && it->hash >> (32 - m_bits) < i)
+			++it;
+		m_directory[i] = it - m_index.begin();
+	}
+}
+
+template <class oiterator>
+void CompactAligner::alignRead(
+		const string& qid, const Sequence& seq,
+		oiterator dest) const
+{
+	assert(!m_directory.empty());
+	AlignmentSet aligns;
+	getAlignmentsInternal(seq, false, aligns);
+	printAlignments(qid, seq, aligns, dest);
+
+	Sequence seqrc = reverseComplement(seq);
+	aligns.clear();
+	getAlignmentsInternal(seqrc, true, aligns);
+	printAlignments(qid, seqrc, aligns, dest);
+}
+
+/** Order entries by hash value. */
+struct CompareHash
+{
+	template <class T>
+	bool operator()(const T& a, uint32_t b) const
+	{
+		return b > a.hash;
+	}
+};
+
+/** Find the maximal exact matches of the query that contain a
+ * minimizer.
+ * @param[out] aligns Map of contig IDs to alignment vectors.
+ */
+void CompactAligner::getAlignmentsInternal(
+		const Sequence& seq, bool isRC, AlignmentSet& aligns) const
+{
+	vector<Minimizer> minimizers;
+	getMinimizers(seq, minimizers);
+	int seqLen = seq.size();
+	for (vector<Minimizer>::const_iterator mit = minimizers.begin();
+			mit != minimizers.end(); ++mit) {
+		size_t bucket = mit->hash >> (32 - m_bits);
+		vector<Entry>::const_iterator first = lower_bound(
+				m_index.begin() + m_directory[bucket],
+				m_index.begin() + m_directory[bucket + 1],
+				mit->hash, CompareHash());
+		for (vector<Entry>::const_iterator it = first;
+				it != m_index.end() && it->hash == mit->hash; ++it) {
+			// Verify the seed, which may be a hash collision.
+			const string& target = m_seqs[it->contig];
+			size_t qstart = mit->pos, tstart = it->pos;
+			size_t i;
+			for (i = 0; i < m_k
+					&& match(seq[qstart + i], target[tstart + i]); i++)
+				;
+			if (i < m_k)
+				continue;
+
+			// Extend the seed.
+			size_t qend = qstart + m_k, tend = tstart + m_k;
+			while (qstart > 0 && tstart > 0
+					&& match(seq[qstart - 1], target[tstart - 1]))
+				qstart--, tstart--;
+			while (qend < seq.size() && tend < target.size()
+					&& match(seq[qend], target[tend]))
+				qend++, tend++;
+
+			int length = qend - qstart;
+			int read_pos = !isRC ? qstart
+				: Alignment::calculateReverseReadStart(
+						qstart, seqLen, length);
+			aligns[it->contig].push_back(Alignment(string(),
+						tstart, read_pos, length, seqLen, isRC));
+		}
+	}
+}
+
+static bool compareQueryPos(const Alignment& a, const Alignment& b)
+{
+	return a.read_start_pos != b.read_start_pos
+		? a.read_start_pos < b.read_start_pos
+		: a.contig_start_pos < b.contig_start_pos;
+}
+
+static bool equalPos(const Alignment& a, const Alignment& b)
+{
+	return a.read_start_pos == b.read_start_pos
+		&& a.contig_start_pos == b.contig_start_pos;
+}
+
+/** Print the alignments, of which some are found by more than one
+ * minimizer. */
+template <class oiterator>
+void CompactAligner::printAlignments(
+		const string& qid, const string& seq,
+		AlignmentSet& alignSet, oiterator& dest) const
+{
+	typedef typename output_iterator_traits<oiterator>::value_type
+		value_type;
+	for (AlignmentSet::iterator ctgIter = alignSet.begin();
+			ctgIter != alignSet.end(); ++ctgIter) {
+		AlignmentVector& alignVec = ctgIter->second;
+		sort(alignVec.begin(), alignVec.end(), compareQueryPos);
+		alignVec.erase(unique(alignVec.begin(), alignVec.end(),
+					equalPos), alignVec.end());
+		for (AlignmentVector::iterator it = alignVec.begin();
+				it != alignVec.end(); ++it) {
+			it->contig = contigIndexToID(ctgIter->first);
+			*dest++ = value_type(*it, qid, seq);
+		}
+	}
+}
+
+// Explicit instantiation.
+template void CompactAligner::
+alignRead<affix_ostream_iterator<Alignment> >(
+		const string& qid, const Sequence& seq,
+		affix_ostream_iterator<Alignment> dest) const;
+
+template void CompactAligner::
+alignRead<ostream_iterator<SAMRecord> >(
+		const string& qid, const Sequence& seq,
+		ostream_iterator<SAMRecord> dest) const;
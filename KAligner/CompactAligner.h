@@ -0,0 +1,143 @@
+#ifndef COMPACTALIGNER_H
+#define COMPACTALIGNER_H 1
+
+#include "KAligner/Aligner.h"
+#include "Alignment.h"
+#include "ConstString.h"
+#include "Sequence.h"
+#include <cassert>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Index the (w,k)-minimizers of a target sequence, and align query
+ * sequences to that indexed target.
+ *
+ * Of each w consecutive k-mer of the target, only the k-mer with the
+ * smallest hash value is indexed. A match of at least k+w-1 bases
+ * contains a window of w k-mer that are identical in the query and the
+ * target, and so shares its minimizer. Each seed is verified against
+ * the target sequence and extended to a maximal exact match.
+ * When w is 1, every k-mer is indexed, and every match of at least
+ * k bases is found.
+ *
+ * The index is a flat array of (hash, contig, position) sorted by
+ * hash, and a directory of the first entry of each bucket of hash
+ * values. It uses about 24/(w+1) bytes per k-mer of the target plus
+ * one byte per base to store the target sequence.
+ */
+class CompactAligner
+{
+	public:
+		CompactAligner(unsigned k, unsigned w)
+			: m_k(k), m_w(w), m_bits(0), m_duplicates(0)
+		{
+			assert(k > 0);
+			assert(w > 0);
+		}
+
+		/** Reserve space for the minimizers of the specified number
+		 * of k-mer. */
+		void reserve(size_t numKmer)
+		{
+			m_index.reserve(2 * numKmer / (m_w + 1));
+		}
+
+		void addReferenceSequence(const StringID& id,
+				const Sequence& seq);
+
+		void build();
+
+		template <class oiterator>
+		void alignRead(const std::string& qid, const Sequence& seq,
+				oiterator dest) const;
+
+		/** Return the number of indexed k-mer. */
+		size_t size() const { return m_index.size(); }
+
+		/** Return the number of buckets of the directory. */
+		size_t bucket_count() const
+		{
+			return m_directory.empty() ? 0 : m_directory.size() - 1;
+		}
+
+		/** Return the number of duplicate k-mer in the target. */
+		size_t countDuplicates() const
+		{
+			assert(opt::multimap == opt::IGNORE);
+			return m_duplicates;
+		}
+
+	private:
+		explicit CompactAligner(const CompactAligner&);
+
+		/** A k-mer of a sequence and its hash value. */
+		struct Minimizer
+		{
+			uint32_t hash;
+			uint32_t pos;
+			Minimizer(uint32_t hash, uint32_t pos)
+				: hash(hash), pos(pos) { }
+		};
+
+		/** An entry of the index. */
+		struct Entry
+		{
+			uint32_t hash;
+			uint32_t contig;
+			uint32_t pos;
+			Entry(uint32_t hash, uint32_t contig, uint32_t pos)
+				: hash(hash), contig(contig), pos(pos) { }
+		};
+
+		/** Order the entries by hash value and then by k-mer. */
+		struct CompareEntry;
+
+		typedef std::map<unsigned, AlignmentVector> AlignmentSet;
+
+		void getMinimizers(const Sequence& seq,
+				std::vector<Minimizer>& minimizers) const;
+
+		void getAlignmentsInternal(const Sequence& seq, bool isRC,
+				AlignmentSet& aligns) const;
+
+		template <class oiterator>
+		void printAlignments(
+				const std::string& qid, const std::string& seq,
+				AlignmentSet& alignSet, oiterator& dest) const;
+
+		/** The k-mer size. */
+		unsigned m_k;
+
+		/** The number of k-mer in a window. */
+		unsigned m_w;
+
+		/** The number of bits of the hash value that select a
+		 * bucket. */
+		unsigned m_bits;
+
+		/** The index sorted by hash value. */
+		std::vector<Entry> m_index;
+
+		/** The first entry of each bucket. */
+		std::vector<uint32_t> m_directory;
+
+		/** The target sequences. */
+		std::vector<std::string> m_seqs;
+
+		/** A dictionary of contig IDs. */
+		std::vector<const_string> m_dict;
+
+		/** The number of duplicate k-mer. */
+		size_t m_duplicates;
+
+		cstring contigIndexToID(unsigned index) const
+		{
+			assert(index < m_dict.size());
+			return m_dict[index];
+		}
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "Aligner.h"
+#include "CompactAligner.h"
 #include "Common/Options.h"
 #include "DataLayer/Options.h"
 #include "KAligner/Options.h"
@@ -9,8 +10,8 @@
 #include "SAM.h"
 #include "StringUtil.h" // for toSI
 #include "Uncompress.h"
-#include "Pipe.h"
-#include "PipeMux.h"
+#include "BatchQueue.h"
+#include "Semaphore.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
@@ -20,6 +21,7 @@
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
+#include <map>
 #include <pthread.h>
 #include <sstream>
 #include <string>
@@ -50,6 +52,11 @@ static const char USAGE_MESSAGE[] =
 "                        [default]\n"
 "  -m, --multimap        allow duplicate k-mer in the target\n"
 "      --no-multimap     disallow duplicate k-mer in the target\n"
+"  -w, --window=N        index only the minimizer of each N consecutive\n"
+"                        k-mer of the target, which uses less memory,\n"
+"                        and find only the matches of at least k+N-1\n"
+"                        bases. When N is 1, index every k-mer.\n"
+"                        When N is 0, use a hash table [0]\n"
 "  -j, --threads=N       use N threads [2] up to one per query file\n"
 "                        or if N is 0 use one thread per query file\n"
 "  -v, --verbose         display verbose output\n"
@@ -71,11 +78,14 @@ namespace opt {
 	static unsigned section = 1;
 	static unsigned nsections = 1;
 
+	/** The number of k-mer of a minimizer window */
+	static unsigned window;
+
 	/** Output formats */
 	static int format;
 }
 
-static const char shortopts[] = "ij:k:l:mo:s:v";
+static const char shortopts[] = "ij:k:l:mo:s:vw:";
 
 
 enum { OPT_HELP = 1, OPT_VERSION, OPT_SYNC };
@@ -88,6 +98,7 @@ static const struct option longopts[] = {
 	{ "ignore-multimap", no_argument, &opt::multimap, opt::IGNORE },
 	{ "threads",     required_argument,	NULL, 'j' },
 	{ "verbose",     no_argument,       NULL, 'v' },
+	{ "window",      required_argument, NULL, 'w' },
 	{ "no-sam",      no_argument,       &opt::format, KALIGNER },
 	{ "sam",         no_argument,       &opt::format, SAM },
 	{ "no-seq",		 no_argument,		&opt::printSeq, 0 },
@@ -164,17 +175,18 @@ static size_t countKmer(const string& path)
 			<< contigs << " contigs, " << scaffolds << " scaffolds"
 			" from `" << path << "'. "
 			"Expecting " << kmer << " k-mer.\n";
-		cerr << "Index will use at least "
-			<< toSI(kmer * sizeof(pair<Kmer, Position>))
-			<< "B.\n";
+		size_t bytes = opt::window > 0
+			? bases + 24 * kmer / (opt::window + 1)
+			: kmer * sizeof(pair<Kmer, Position>);
+		cerr << "Index will use at least " << toSI(bytes) << "B.\n";
 	}
 	assert(bases > overlaps);
 	return kmer;
 }
 
-template <class SeqPosHashMap>
+template <class AlignerType>
 static void readContigsIntoDB(string refFastaFile,
-		Aligner<SeqPosHashMap>& aligner);
+		AlignerType& aligner);
 static void *alignReadsToDB(void *arg);
 static void *readFile(void *arg);
 
@@ -184,6 +196,9 @@ static Aligner<SeqPosHashUniqueMap> *g_aligner_u;
 /** Multimap aligner using multimap */
 static Aligner<SeqPosHashMultiMap> *g_aligner_m;
 
+/** Aligner using an index of minimizers */
+static CompactAligner *g_aligner_c;
+
 /** Number of reads. */
 static unsigned g_readCount;
 
@@ -193,82 +208,103 @@ static unsigned g_alignedCount;
 /** Guard cerr. */
 static pthread_mutex_t g_mutexCerr = PTHREAD_MUTEX_INITIALIZER;
 
-/** Stores the output string and the read index number for an
- * alignment. */
-struct OutData
+/** The number of reads of a batch. */
+static const size_t BATCH_SIZE = 4096;
+
+/** The number of batches of each query file that may be read but not
+ * yet written. */
+static unsigned g_window;
+
+/** A batch of reads of one query file, and their alignments. */
+struct Batch
 {
-	string s;
+	/** The index of the query file. */
+	unsigned file;
+
+	/** The number of this batch within its file. */
 	size_t index;
 
-	OutData(string s = string(), size_t index = 0)
-		: s(s), index(index) { }
+	/** Whether this is the last batch of its file. */
+	bool eof;
 
-	/** Operator needed for sorting priority queue. */
-	bool operator<(const OutData& a) const
-	{
-		// Smaller index number has higher priority.
-		return index > a.index;
-	}
-};
+	/** The reads. */
+	vector<FastaRecord> reads;
 
-/** Shares data between workers and the output thread. */
-static Pipe<OutData> g_pipeOut(1<<7);
+	/** The alignments of the reads. */
+	string out;
 
-/** Shares data between producer and worker threads. */
-static PipeMux<FastaRecord> g_pipeMux(1);
+	Batch(unsigned file = 0, size_t index = 0)
+		: file(file), index(index), eof(false) { }
+};
+
+/** Batches of reads waiting to be aligned. */
+static BatchQueue<Batch*>* g_work;
 
-/** Notification of the current size of the g_pqueue. */
-static size_t g_pqSize;
-static const size_t MAX_PQ_SIZE = 1000;
+/** Batches of alignments waiting to be written. */
+static BatchQueue<Batch*>* g_done;
 
-/** Conditional variable used to block workers until the g_pqueue has
- * become small enough. */
-static pthread_cond_t g_pqSize_cv = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t g_mutexPqSize = PTHREAD_MUTEX_INITIALIZER;
+/** Limits the number of batches of each query file that are read but
+ * not yet written, which bounds the memory of the reorder buffer. */
+static vector<Semaphore*> g_fileWindow;
 
+/** Write the batches of alignments in order. The batches of the
+ * query files are interleaved: the first batch of each file, then the
+ * second batch of each file, and so on.
+ */
 static void* printAlignments(void*)
 {
-	priority_queue<OutData> pqueue;
-	size_t index = 1;
-	for (pair<OutData, size_t> p = g_pipeOut.pop();
-			p.second > 0; p = g_pipeOut.pop()) {
-		pqueue.push(p.first);
-		while (!pqueue.empty()) {
-			const OutData& rec = pqueue.top();
-			if (index == rec.index) {
-				// Print the record at the current index.
-				index++;
-				assert(rec.index > 0);
-				cout << rec.s;
-				assert_good(cout, "stdout");
-				pqueue.pop();
-			} else if (g_pipeMux.invalidEntry(index)) {
-				// Skip this index since it is invalid.
-				index++;
-			} else {
-				// The record for this index has not been added, get
-				// another record from the pipe.
-				break;
-			}
+	// Batches that are aligned but not yet written, by batch number
+	// and file.
+	typedef map<pair<size_t, unsigned>, Batch*> Pending;
+	Pending pending;
+
+	unsigned numFiles = g_fileWindow.size();
+	vector<bool> done(numFiles);
+	unsigned open = numFiles;
+	pair<size_t, unsigned> next(0, 0);
+	for (Batch* batch = NULL; open > 0;) {
+		Pending::iterator it = pending.find(next);
+		if (it == pending.end()) {
+			// Wait for another batch.
+			bool good = g_done->pop(batch);
+			assert(good);
+			(void)good;
+			pending[make_pair(batch->index, batch->file)] = batch;
+			continue;
 		}
 
-		// Let waiting workers continue if the pqueue is small enough.
-		pthread_mutex_lock(&g_mutexPqSize);
-		g_pqSize = pqueue.size();
-		if (g_pqSize < MAX_PQ_SIZE)
-			pthread_cond_broadcast(&g_pqSize_cv);
-		pthread_mutex_unlock(&g_mutexPqSize);
+		batch = it->second;
+		pending.erase(it);
+		cout << batch->out;
+		assert_good(cout, "stdout");
+		if (batch->eof) {
+			done[batch->file] = true;
+			open--;
+		}
+		g_fileWindow[batch->file]->post();
+		delete batch;
+
+		// Find the next batch in order.
+		for (unsigned i = 0; open > 0 && i < numFiles; i++) {
+			if (++next.second == numFiles) {
+				next.first++;
+				next.second = 0;
+			}
+			if (!done[next.second])
+				break;
+		}
 	}
+	assert(pending.empty());
 	return NULL;
 }
 
-/** Store a FastaReader and Pipe. */
-struct WorkerArg {
+/** A query file and its index. */
+struct ReadFileArg {
 	FastaReader& in;
-	Pipe<FastaRecord>& out;
-	WorkerArg(FastaReader& in, Pipe<FastaRecord>& out)
-		: in(in), out(out) { }
-	~WorkerArg() { delete &in; }
+	unsigned file;
+	ReadFileArg(FastaReader& in, unsigned file)
+		: in(in), file(file) { }
+	~ReadFileArg() { delete &in; }
 };
 
 static pthread_t getReadFiles(const char *readsFile)
@@ -281,7 +317,8 @@ static pthread_t getReadFiles(const char *readsFile)
 
 	FastaReader* in = new FastaReader(
 			readsFile, FastaReader::FOLD_CASE);
-	WorkerArg* arg = new WorkerArg(*in, *g_pipeMux.addPipe());
+	ReadFileArg* arg = new ReadFileArg(*in, g_fileWindow.size());
+	g_fileWindow.push_back(new Semaphore(g_window));
 
 	pthread_t thread;
 	pthread_create(&thread, NULL, readFile, static_cast<void*>(arg));
@@ -314,6 +351,7 @@ int main(int argc, char** argv)
 			case 'i': opt::multimap = opt::IGNORE; break;
 			case 'j': arg >> opt::threads; break;
 			case 'v': opt::verbose++; break;
+			case 'w': arg >> opt::window; break;
 			case 's': arg >> opt::section >> delim >>
 					  opt::nsections; break;
 			case OPT_HELP:
@@ -365,7 +403,11 @@ int main(int argc, char** argv)
 		"CL:" << commandLine << '\n';
 
 	size_t numKmer = countKmer(refFastaFile);
-	if (opt::multimap == opt::MULTIMAP) {
+	if (opt::window > 0) {
+		g_aligner_c = new CompactAligner(opt::k, opt::window);
+		g_aligner_c->reserve(numKmer);
+		readContigsIntoDB(refFastaFile, *g_aligner_c);
+	} else if (opt::multimap == opt::MULTIMAP) {
 		g_aligner_m = new Aligner<SeqPosHashMultiMap>(opt::k,
 				numKmer);
 		readContigsIntoDB(refFastaFile, *g_aligner_m);
@@ -381,6 +423,12 @@ int main(int argc, char** argv)
 	}
 
 	g_readCount = 0;
+	opt::chastityFilter = false;
+	opt::trimMasked = false;
+
+	g_window = 2 * opt::threads + 2;
+	g_work = new BatchQueue<Batch*>(2 * opt::threads);
+	g_done = new BatchQueue<Batch*>(2 * opt::threads);
 
 	vector<pthread_t> producer_threads;
 	transform(argv + optind, argv + argc,
@@ -400,11 +448,17 @@ int main(int argc, char** argv)
 	// Wait for all threads to finish.
 	for (size_t i = 0; i < producer_threads.size(); i++)
 		pthread_join(producer_threads[i], &status);
+	g_work->close();
 	for (size_t i = 0; i < threads.size(); i++)
 		pthread_join(threads[i], &status);
-	g_pipeOut.close();
+	g_done->close();
 	pthread_join(out_thread, &status);
 
+	delete g_work;
+	delete g_done;
+	for (size_t i = 0; i < g_fileWindow.size(); i++)
+		delete g_fileWindow[i];
+
 	if (opt::verbose > 0)
 		cerr << "Aligned " << g_alignedCount
 			<< " of " << g_readCount << " reads ("
@@ -418,9 +472,8 @@ int main(int argc, char** argv)
 	return 0;
 }
 
-template <class SeqPosHashMap>
-static void printProgress(const Aligner<SeqPosHashMap>& align,
-		unsigned count)
+template <class AlignerType>
+static void printProgress(const AlignerType& align, unsigned count)
 {
 	size_t size = align.size();
 	size_t buckets = align.bucket_count();
@@ -430,9 +483,28 @@ static void printProgress(const Aligner<SeqPosHashMap>& align,
 		<< " using " << toSI(getMemoryUsage()) << "B." << endl;
 }
 
-template <class SeqPosHashMap>
+static void printProgress(const CompactAligner& align,
+		unsigned count)
+{
+	cerr << "Read " << count << " contigs. "
+		"Indexed " << align.size() << " k-mer"
+		" using " << toSI(getMemoryUsage()) << "B." << endl;
+}
+
+/** Finish building the index of the target. */
+template <class AlignerType>
+static void buildIndex(AlignerType&)
+{
+}
+
+static void buildIndex(CompactAligner& aligner)
+{
+	aligner.build();
+}
+
+template <class AlignerType>
 static void readContigsIntoDB(string refFastaFile,
-		Aligner<SeqPosHashMap>& aligner)
+		AlignerType& aligner)
 {
 	if (opt::verbose > 0)
 		cerr << "Reading target `" << refFastaFile << "'..." << endl;
@@ -461,6 +533,7 @@ static void readContigsIntoDB(string refFastaFile,
 			printProgress(aligner, count);
 	}
 	assert(in.eof());
+	buildIndex(aligner);
 	if (opt::verbose > 0)
 		printProgress(aligner, count);
 
@@ -474,20 +547,32 @@ static void readContigsIntoDB(string refFastaFile,
 	}
 }
 
-/** Read each fasta record from 'in', and add it to 'pipe'. */
-static void readFile(FastaReader& in, Pipe<FastaRecord>& pipe)
+/** Read the records of 'in' in batches, and queue them for the
+ * workers.
+ */
+static void readFile(FastaReader& in, unsigned file)
 {
-	for (FastaRecord rec; in >> rec;)
-		pipe.push(rec);
+	for (size_t index = 0;; index++) {
+		g_fileWindow[file]->wait();
+		Batch* batch = new Batch(file, index);
+		batch->reads.reserve(BATCH_SIZE);
+		for (FastaRecord rec;
+				batch->reads.size() < BATCH_SIZE && in >> rec;)
+			batch->reads.push_back(rec);
+		batch->eof = batch->reads.size() < BATCH_SIZE;
+		bool eof = batch->eof;
+		g_work->push(batch);
+		if (eof)
+			break;
+	}
 	assert(in.eof());
-	pipe.close();
 }
 
 /** Producer thread. */
 static void* readFile(void* arg)
 {
-	WorkerArg* p = static_cast<WorkerArg*>(arg);
-	readFile(p->in, p->out);
+	ReadFileArg* p = static_cast<ReadFileArg*>(arg);
+	readFile(p->in, p->file);
 	delete p;
 	return NULL;
 }
@@ -502,85 +587,98 @@ static double timeDiff(const timeval& start, const timeval& end)
 	return result;
 }
 
+/** Align a read using the specified aligner. */
+template <class AlignerType>
+static void alignRead(AlignerType& aligner, const FastaRecord& rec,
+		ostream& output)
+{
+	switch (opt::format) {
+	  case KALIGNER:
+		aligner.alignRead(rec.id, rec.seq,
+				affix_ostream_iterator<Alignment>(output, "\t"));
+		break;
+	  case SAM:
+		aligner.alignRead(rec.id, rec.seq,
+				ostream_iterator<SAMRecord>(output, "\n"));
+		break;
+	}
+}
+
+/** Align a read and write its alignments to out.
+ * @return whether the read aligned
+ */
+static bool alignRead(const FastaRecord& rec, ostream& out)
+{
+	const Sequence& seq = rec.seq;
+	ostringstream output;
+	if (seq.find_first_not_of("ACGT0123") == string::npos) {
+		if (opt::colourSpace)
+			assert(isdigit(seq[0]));
+		else
+			assert(isalpha(seq[0]));
+	}
+
+	if (g_aligner_c != NULL)
+		alignRead(*g_aligner_c, rec, output);
+	else if (opt::multimap == opt::MULTIMAP)
+		alignRead(*g_aligner_m, rec, output);
+	else
+		alignRead(*g_aligner_u, rec, output);
+
+	string s = output.str();
+	switch (opt::format) {
+	  case KALIGNER:
+		out << rec.id;
+		if (opt::printSeq) {
+			out << ' ';
+			if (opt::colourSpace)
+				out << rec.anchor;
+			out << seq;
+		}
+		out << s << '\n';
+		break;
+	  case SAM:
+		out << s;
+		break;
+	}
+	return !s.empty();
+}
+
+/** Worker thread. Align each batch of reads. */
 static void* alignReadsToDB(void*)
 {
-	opt::chastityFilter = false;
-	opt::trimMasked = false;
 	static timeval start, end;
+	static unsigned startCount;
 
 	pthread_mutex_lock(&g_mutexCerr);
 	gettimeofday(&start, NULL);
 	pthread_mutex_unlock(&g_mutexCerr);
 
-	for (pair<FastaRecord, size_t> recPair = g_pipeMux.nextValue();
-			recPair.second > 0; recPair = g_pipeMux.nextValue()) {
-		const FastaRecord& rec = recPair.first;
-		const Sequence& seq = rec.seq;
-		ostringstream output;
-		if (seq.find_first_not_of("ACGT0123") == string::npos) {
-			if (opt::colourSpace)
-				assert(isdigit(seq[0]));
-			else
-				assert(isalpha(seq[0]));
-		}
-
-		switch (opt::format) {
-		  case KALIGNER:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			break;
-		  case SAM:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			break;
-		}
-
+	for (Batch* batch = NULL; g_work->pop(batch);) {
 		ostringstream out;
-		string s = output.str();
-		switch (opt::format) {
-		  case KALIGNER:
-			out << rec.id;
-			if (opt::printSeq) {
-				out << ' ';
-				if (opt::colourSpace)
-					out << rec.anchor;
-				out << seq;
-			}
-			out << s << '\n';
-			break;
-		  case SAM:
-			out << s;
-			break;
-		}
-		g_pipeOut.push(OutData(out.str(), recPair.second));
-
-		// Prevent the priority_queue from growing too large by
-		// waiting for threads going far too slow.
-		pthread_mutex_lock(&g_mutexPqSize);
-		if (g_pqSize >= MAX_PQ_SIZE)
-			pthread_cond_wait(&g_pqSize_cv, &g_mutexPqSize);
-		pthread_mutex_unlock(&g_mutexPqSize);
+		unsigned aligned = 0;
+		for (vector<FastaRecord>::const_iterator it
+				= batch->reads.begin();
+				it != batch->reads.end(); ++it)
+			if (alignRead(*it, out))
+				aligned++;
+		batch->out = out.str();
+		unsigned n = batch->reads.size();
+		vector<FastaRecord>().swap(batch->reads);
+		g_done->push(batch);
 
 		if (opt::verbose > 0) {
 			pthread_mutex_lock(&g_mutexCerr);
-			if (!s.empty())
-				g_alignedCount++;
-			if (++g_readCount % 1000000 == 0) {
+			g_alignedCount += aligned;
+			g_readCount += n;
+			if (g_readCount - startCount >= 1000000) {
 				gettimeofday(&end, NULL);
 				double result = timeDiff(start, end);
 				cerr << "Aligned " << g_readCount << " reads at "
-					<< (int)(1000000 / result) << " reads/sec.\n";
+					<< (int)((g_readCount - startCount) / result)
+					<< " reads/sec.\n";
 				start = end;
+				startCount = g_readCount;
 			}
 			pthread_mutex_unlock(&g_mutexCerr);
 		}
@@ -7,6 +7,8 @@
 #define DBGBLOOM_H 1
 
 #include "Assembly/SeqExt.h" // for NUM_BASES
+#include "Bloom/Bloom.h"
+#include "Common/BitUtil.h"
 #include "Common/IOUtil.h"
 #include "Common/Kmer.h"
 #include "Common/Uncompress.h"
@@ -109,18 +111,18 @@ struct adjacency_iterator
 	/** Skip to the next edge that is present. */
 	void next()
 	{
-		for (; m_i < NUM_BASES; ++m_i) {
+		for (; m_i < NUM_BASES && !(m_adj & 1 << m_i); ++m_i)
+			;
+		if (m_i < NUM_BASES)
 			m_v.setLastBase(SENSE, m_i);
-			if (vertex_exists(m_v, m_g))
-				break;
-		}
 	}
 
   public:
-	adjacency_iterator(const DBGBloom<BF>& g) : m_g(g), m_i(NUM_BASES) { }
+	adjacency_iterator(const DBGBloom<BF>& g)
+		: m_g(g), m_adj(0), m_i(NUM_BASES) { }
 
 	adjacency_iterator(const DBGBloom<BF>& g, vertex_descriptor u)
-		: m_g(g), m_v(u), m_i(0)
+		: m_g(g), m_v(u), m_adj(adjacentBases(u, g, SENSE)), m_i(0)
 	{
 		m_v.shift(SENSE);
 		next();
@@ -153,6 +155,8 @@ struct adjacency_iterator
   private:
 	const DBGBloom<BF>& m_g;
 	vertex_descriptor m_v;
+	/** The bases of the adjacent vertices. */
+	unsigned m_adj;
 	short unsigned m_i;
 }; // adjacency_iterator
 
@@ -163,20 +167,21 @@ struct out_edge_iterator
 	/** Skip to the next edge that is present. */
 	void next()
 	{
-		for (; m_i < NUM_BASES; ++m_i) {
+		for (; m_i < NUM_BASES && !(m_adj & 1 << m_i); ++m_i)
+			;
+		if (m_i < NUM_BASES)
 			m_v.setLastBase(SENSE, m_i);
-			if (vertex_exists(m_v, *m_g))
-				break;
-		}
 	}
 
   public:
 	out_edge_iterator() { }
 
-	out_edge_iterator(const DBGBloom<BF>& g) : m_g(&g), m_i(NUM_BASES) { }
+	out_edge_iterator(const DBGBloom<BF>& g)
+		: m_g(&g), m_adj(0), m_i(NUM_BASES) { }
 
 	out_edge_iterator(const DBGBloom<BF>& g, vertex_descriptor u)
-		: m_g(&g), m_u(u), m_v(u), m_i(0)
+		: m_g(&g), m_u(u), m_v(u), m_adj(adjacentBases(u, g, SENSE)),
+		m_i(0)
 	{
 		m_v.shift(SENSE);
 		next();
@@ -217,6 +222,8 @@ struct out_edge_iterator
 	const DBGBloom<BF>* m_g;
 	vertex_descriptor m_u;
 	vertex_descriptor m_v;
+	/** The bases of the adjacent vertices. */
+	unsigned m_adj;
 	unsigned m_i;
 }; // out_edge_iterator
 
@@ -227,20 +234,21 @@ struct in_edge_iterator
 	/** Skip to the next edge that is present. */
 	void next()
 	{
-		for (; m_i < NUM_BASES; ++m_i) {
+		for (; m_i < NUM_BASES && !(m_adj & 1 << m_i); ++m_i)
+			;
+		if (m_i < NUM_BASES)
 			m_v.setLastBase(ANTISENSE, m_i);
-			if (vertex_exists(m_v, *m_g))
-				break;
-		}
 	}
 
   public:
 	in_edge_iterator() { }
 
-	in_edge_iterator(const DBGBloom<BF>& g) : m_g(&g), m_i(NUM_BASES) { }
+	in_edge_iterator(const DBGBloom<BF>& g)
+		: m_g(&g), m_adj(0), m_i(NUM_BASES) { }
 
 	in_edge_iterator(const DBGBloom<BF>& g, vertex_descriptor u)
-		: m_g(&g), m_u(u), m_v(u), m_i(0)
+		: m_g(&g), m_u(u), m_v(u), m_adj(adjacentBases(u, g, ANTISENSE)),
+		m_i(0)
 	{
 		m_v.shift(ANTISENSE);
 		next();
@@ -281,6 +289,8 @@ struct in_edge_iterator
 	const DBGBloom<BF>* m_g;
 	vertex_descriptor m_u;
 	vertex_descriptor m_v;
+	/** The bases of the adjacent vertices. */
+	unsigned m_adj;
 	unsigned m_i;
 }; // in_edge_iterator
 
@@ -298,6 +308,29 @@ vertex_exists(typename graph_traits<Graph>::vertex_descriptor u, const Graph& g)
 	return g.m_bloom[u] > g.m_depthThresh;
 }
 
+/**
+ * Return the bases that extend u to a vertex in the direction dir, as
+ * a bit mask. The bloom filter tests the four neighbours together.
+ */
+template <typename Graph>
+static inline unsigned
+adjacentBases(typename graph_traits<Graph>::vertex_descriptor u,
+		const Graph& g, extDirection dir)
+{
+	if (g.m_depthThresh == 0)
+		return Bloom::adjacentBases(g.m_bloom, u, dir);
+
+	unsigned mask = 0;
+	typename graph_traits<Graph>::vertex_descriptor v(u);
+	v.shift(dir);
+	for (unsigned i = 0; i < NUM_BASES; i++) {
+		v.setLastBase(dir, i);
+		if (vertex_exists(v, g))
+			mask |= 1 << i;
+	}
+	return mask;
+}
+
 template <typename Graph>
 static inline
 std::pair<typename graph_traits<Graph>::adjacency_iterator,
@@ -317,9 +350,7 @@ out_degree(
 		typename graph_traits<Graph>::vertex_descriptor u,
 		const Graph& g)
 {
-	typedef typename graph_traits<Graph>::adjacency_iterator Ait;
-	std::pair<Ait, Ait> adj = adjacent_vertices(u, g);
-	return std::distance(adj.first, adj.second);
+	return popcount(adjacentBases(u, g, SENSE));
 }
 
 template <typename Graph>
@@ -341,7 +372,16 @@ typename graph_traits<Graph>::degree_size_type
 in_degree(typename graph_traits<Graph>::vertex_descriptor u,
 		const Graph& g)
 {
-	return out_degree(reverseComplement(u), g);
+	return popcount(adjacentBases(u, g, ANTISENSE));
+}
+
+template <typename Graph>
+static inline
+typename graph_traits<Graph>::degree_size_type
+degree(typename graph_traits<Graph>::vertex_descriptor u,
+		const Graph& g)
+{
+	return in_degree(u, g) + out_degree(u, g);
 }
 
 template <typename Graph>
@@ -6,7 +6,9 @@
 #include "config.h"
 
 #include "konnector.h"
+#include "Bloom/BlockedBloomFilter.h"
 #include "Bloom/CascadingBloomFilter.h"
+#include "Bloom/MappedBloomFilter.h"
 #include "DBGBloom.h"
 #include "DBGBloomAlgorithms.h"
 
@@ -470,6 +472,7 @@ static inline string getConnectingSeq(ConnectPairsResult& result,
 template <typename Graph, typename Bloom>
 static void connectPair(const Graph& g,
 	const Bloom& bloom,
+	BidiBFSContext<Graph>& context,
 	FastqRecord& read1,
 	FastqRecord& read2,
 	const ConnectPairsParams& params,
@@ -490,7 +493,7 @@ static void connectPair(const Graph& g,
 	}
 
 	ConnectPairsResult result =
-		connectPairs(opt::k, read1, read2, g, params);
+		connectPairs(opt::k, read1, read2, g, params, context);
 
 	vector<FastaRecord>& paths = result.mergedSeqs;
 	bool mergedSeqRedundant = false;
@@ -690,27 +693,57 @@ static void connectPairs(const Graph& g,
 	ofstream& traceStream)
 {
 #pragma omp parallel
-	for (FastqRecord a, b;;) {
-		bool good;
+	{
+		BidiBFSContext<Graph> context(g);
+		for (FastqRecord a, b;;) {
+			bool good;
 #pragma omp critical(in)
-		good = in >> a >> b;
-		if (good) {
-			connectPair(g, bloom, a, b, params, mergedStream, read1Stream,
-				read2Stream, traceStream);
+			good = in >> a >> b;
+			if (good) {
+				connectPair(g, bloom, context, a, b, params, mergedStream,
+					read1Stream, read2Stream, traceStream);
 #pragma omp atomic
-			g_count.readPairsProcessed++;
-			if (opt::verbose >= 2)
+				g_count.readPairsProcessed++;
+				if (opt::verbose >= 2)
 #pragma omp critical(cerr)
-			{
-				if(g_count.readPairsProcessed % g_progressStep == 0)
-					printProgressMessage();
+				{
+					if(g_count.readPairsProcessed % g_progressStep == 0)
+						printProgressMessage();
+				}
+			} else {
+				break;
 			}
-		} else {
-			break;
 		}
 	}
 }
 
+/** Connect the read pairs of the input files. */
+template <typename BF>
+static void connectPairsInFiles(const BF& bloom,
+	int argc, char** argv,
+	const ConnectPairsParams& params,
+	ofstream& mergedStream,
+	ofstream& read1Stream,
+	ofstream& read2Stream,
+	ofstream& traceStream)
+{
+	DBGBloom<BF> g(bloom);
+
+	if (opt::interleaved) {
+		FastaConcat in(argv + optind, argv + argc,
+				FastaReader::FOLD_CASE);
+		connectPairs(g, bloom, in, params, mergedStream, read1Stream,
+				read2Stream, traceStream);
+		assert(in.eof());
+	} else {
+		FastaInterleave in(argv + optind, argv + argc,
+				FastaReader::FOLD_CASE);
+		connectPairs(g, bloom, in, params, mergedStream, read1Stream,
+				read2Stream, traceStream);
+		assert(in.eof());
+	}
+}
+
 /**
  * Set the value for a commandline option, using "nolimit"
  * to represent NO_LIMIT.
@@ -853,21 +886,40 @@ int main(int argc, char** argv)
 	if (opt::dupBloomSize > 0)
 		g_dupBloom.resize(opt::dupBloomSize * 8);
 
-	BloomFilter* bloom;
+	BloomFilter* bloom = NULL;
+	BloomFilter* loadedBloom = NULL;
+	BlockedBloomFilter* blockedBloom = NULL;
 	CascadingBloomFilter* cascadingBloom = NULL;
+	MappedBloomFilter mappedBloom;
 
-	if (!opt::inputBloomPath.empty()) {
+	if (!opt::inputBloomPath.empty()
+			&& MappedBloomFilter::isMappable(opt::inputBloomPath)) {
 
 		if (opt::verbose)
-			std::cerr << "Loading bloom filter from `"
+			std::cerr << "Mapping bloom filter from `"
 				<< opt::inputBloomPath << "'...\n";
 
-		bloom = new BloomFilter();
+		mappedBloom.open(opt::inputBloomPath);
+
+	} else if (!opt::inputBloomPath.empty()) {
+
+		if (opt::verbose)
+			std::cerr << "Loading bloom filter from `"
+				<< opt::inputBloomPath << "'...\n";
 
 		const char* inputPath = opt::inputBloomPath.c_str();
-		ifstream inputBloom(inputPath, ios_base::in | ios_base::binary);
+		// Uncompress hooks only the opening of a file for reading in
+		// text mode, which on POSIX is the same as binary mode.
+		ifstream inputBloom(inputPath);
 		assert_good(inputBloom, inputPath);
-		inputBloom >> *bloom;
+		if (inputBloom.peek()
+				== '0' + (int)Bloom::BLOCKED_BLOOM_VERSION) {
+			blockedBloom = new BlockedBloomFilter();
+			inputBloom >> *blockedBloom;
+		} else {
+			bloom = loadedBloom = new BloomFilter();
+			inputBloom >> *bloom;
+		}
 		assert_good(inputBloom, inputPath);
 		inputBloom.close();
 
@@ -883,7 +935,7 @@ int main(int argc, char** argv)
 		size_t bits = opt::bloomSize * 8 / opt::minCoverage;
 		cascadingBloom = new CascadingBloomFilter(bits, opt::minCoverage);
 #ifdef _OPENMP
-		ConcurrentBloomFilter<CascadingBloomFilter> cbf(*cascadingBloom, 1000);
+		ConcurrentBloomFilter<CascadingBloomFilter> cbf(*cascadingBloom);
 		for (int i = optind; i < argc; i++)
 			Bloom::loadFile(cbf, opt::k, string(argv[i]), opt::verbose);
 #else
@@ -893,9 +945,15 @@ int main(int argc, char** argv)
 		bloom = &cascadingBloom->getBloomFilter(opt::minCoverage - 1);
 	}
 
-	if (opt::verbose)
+	// The FPR of a mapped filter reads the entire filter, so it is
+	// reported only at -vv.
+	bool mapped = bloom == NULL && blockedBloom == NULL;
+	if (mapped ? opt::verbose > 1 : opt::verbose > 0)
 		cerr << "Bloom filter FPR: " << setprecision(3)
-			<< 100 * bloom->FPR() << "%\n";
+			<< 100 * (bloom != NULL ? bloom->FPR()
+				: blockedBloom != NULL ? blockedBloom->FPR()
+				: mappedBloom.FPR())
+			<< "%\n";
 
 	ofstream dotStream;
 	if (!opt::dotPath.empty()) {
@@ -917,8 +975,6 @@ int main(int argc, char** argv)
 		assert_good(traceStream, opt::tracefilePath);
 	}
 
-	DBGBloom<BloomFilter> g(*bloom);
-
 	/*
 	 * read pairs that were successfully connected
 	 * (and possibly extended outwards)
@@ -972,19 +1028,15 @@ int main(int argc, char** argv)
 	params.dotPath = opt::dotPath;
 	params.dotStream = opt::dotPath.empty() ? NULL : &dotStream;
 
-	if (opt::interleaved) {
-		FastaConcat in(argv + optind, argv + argc,
-				FastaReader::FOLD_CASE);
-		connectPairs(g, *bloom, in, params, mergedStream, read1Stream,
-				read2Stream, traceStream);
-		assert(in.eof());
-	} else {
-		FastaInterleave in(argv + optind, argv + argc,
-				FastaReader::FOLD_CASE);
-		connectPairs(g, *bloom, in, params, mergedStream, read1Stream,
-				read2Stream, traceStream);
-		assert(in.eof());
-	}
+	if (bloom != NULL)
+		connectPairsInFiles(*bloom, argc, argv, params,
+				mergedStream, read1Stream, read2Stream, traceStream);
+	else if (blockedBloom != NULL)
+		connectPairsInFiles(*blockedBloom, argc, argv, params,
+				mergedStream, read1Stream, read2Stream, traceStream);
+	else
+		connectPairsInFiles(mappedBloom, argc, argv, params,
+				mergedStream, read1Stream, read2Stream, traceStream);
 
 	if (opt::verbose > 0) {
 		cerr <<
@@ -1043,14 +1095,16 @@ int main(int argc, char** argv)
 					g_count.uniquePath - g_count.multiplePaths) * 2)
 					<< "%)\n";
 			}
-			std::cerr << "Bloom filter FPR: " << setprecision(3)
-				<< 100 * bloom->FPR() << "%\n";
+			if (!mapped || opt::verbose > 1)
+				std::cerr << "Bloom filter FPR: " << setprecision(3)
+					<< 100 * (bloom != NULL ? bloom->FPR()
+						: blockedBloom != NULL ? blockedBloom->FPR()
+						: mappedBloom.FPR()) << "%\n";
 	}
 
-	if (!opt::inputBloomPath.empty())
-		delete bloom;
-	else
-		delete cascadingBloom;
+	delete loadedBloom;
+	delete blockedBloom;
+	delete cascadingBloom;
 
 	assert_good(mergedStream, mergedOutputPath.c_str());
 	mergedStream.close();
@@ -4,6 +4,7 @@
 #include "DBGBloomAlgorithms.h"
 #include "Bloom/CascadingBloomFilter.h"
 #include "DataLayer/FastaInterleave.h"
+#include "Graph/BidiBFSContext.h"
 #include "Graph/BidirectionalBFS.h"
 #include "Graph/ConstrainedBidiBFSVisitor.h"
 #include "Graph/ExtendPath.h"
@@ -202,13 +203,19 @@ static inline void writeDot(
 	assert_good(*params.dotStream, params.dotPath);
 };
 
+/**
+ * Connect a read pair.
+ * @param context the search state of the calling thread, which is
+ * reused for each read pair
+ */
 template <typename Graph>
 static inline ConnectPairsResult connectPairs(
 	unsigned k,
 	const FastaRecord& read1,
 	const FastaRecord& read2,
 	const Graph& g,
-	const ConnectPairsParams& params)
+	const ConnectPairsParams& params,
+	BidiBFSContext<Graph>& context)
 {
 	ConnectPairsResult result;
 	result.k = k;
@@ -285,10 +292,9 @@ static inline ConnectPairsResult connectPairs(
 				pRead1->seq.length() - k + 1 - startKmerPos,
 				pRead2->seq.length() - k + 1 - goalKmerPos));
 
-	ConstrainedBidiBFSVisitor<Graph> visitor(g, startKmer, goalKmer,
-			params.maxPaths, minPathLen, maxPathLen, params.maxBranches,
-			params.memLimit);
-	bidirectionalBFS(g, startKmer, goalKmer, visitor);
+	ConstrainedBidiBFSVisitor<Graph>& visitor = context.search(
+			startKmer, goalKmer, params.maxPaths, minPathLen, maxPathLen,
+			params.maxBranches, params.memLimit);
 
 	std::vector< Path<Kmer> > paths;
 	result.pathResult = visitor.pathsToGoal(paths);
@@ -354,6 +360,19 @@ static inline ConnectPairsResult connectPairs(
 	return result;
 }
 
+/** Connect a read pair. */
+template <typename Graph>
+static inline ConnectPairsResult connectPairs(
+	unsigned k,
+	const FastaRecord& read1,
+	const FastaRecord& read2,
+	const Graph& g,
+	const ConnectPairsParams& params)
+{
+	BidiBFSContext<Graph> context(g);
+	return connectPairs(k, read1, read2, g, params, context);
+}
+
 static inline unsigned getHeadKmerPos(const Sequence& seq, Direction dir,
 	unsigned k)
 {
@@ -14,6 +14,9 @@
 #include <iostream>
 #include <iterator>
 #include <string>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -41,6 +44,7 @@ static const char USAGE_MESSAGE[] =
 "      --dna               equivalent to -a'-ACGT'\n"
 "      --protein           equivalent to -a'#*ACDEFGHIKLMNPQRSTVWY'\n"
 "  -s, --sample=N          sample the suffix array [16]\n"
+"  -j, --threads=N         use N parallel threads [1]\n"
 "  -d, --decompress        decompress the index FILE\n"
 "  -c, --stdout            write output to standard output\n"
 "  -v, --verbose           display verbose output\n"
@@ -53,6 +57,9 @@ namespace opt {
 	/** Sample the suffix array. */
 	static unsigned sampleSA = 16;
 
+	/** The number of parallel threads. */
+	static unsigned threads = 1;
+
 	/** Which indexes to create. */
 	enum { NONE, FAI, FM, BOTH };
 	static int indexes = BOTH;
@@ -76,7 +83,7 @@ namespace opt {
 	static int verbose;
 }
 
-static const char shortopts[] = "a:cds:v";
+static const char shortopts[] = "a:cdj:s:v";
 
 enum { OPT_HELP = 1, OPT_VERSION,
 	OPT_ALPHA, OPT_DNA, OPT_PROTEIN };
@@ -93,6 +100,7 @@ static const struct option longopts[] = {
 	{ "protein", optional_argument, NULL, OPT_PROTEIN },
 	{ "decompress", no_argument, NULL, 'd' },
 	{ "sample", required_argument, NULL, 's' },
+	{ "threads", required_argument, NULL, 'j' },
 	{ "stdout", no_argument, NULL, 'c' },
 	{ "help", no_argument, NULL, OPT_HELP },
 	{ "version", no_argument, NULL, OPT_VERSION },
@@ -172,8 +180,8 @@ static void buildFMIndex(FMIndex& fm, const string& path)
 		fm.assignBWT(s.begin(), s.end());
 	} else {
 		// Construct the suffix array first.
-		fm.assign(s.begin(), s.end());
 		fm.sampleSA(opt::sampleSA);
+		fm.assign(s.begin(), s.end());
 	}
 }
 
@@ -200,6 +208,7 @@ int main(int argc, char **argv)
 				break;
 			case 'c': opt::toStdout = true; break;
 			case 'd': opt::decompress = true; break;
+			case 'j': arg >> opt::threads; break;
 			case 's': arg >> opt::sampleSA; break;
 			case 'v': opt::verbose++; break;
 			case OPT_HELP:
@@ -232,6 +241,11 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	if (opt::decompress) {
 		// Decompress the index.
 		string fmPath(argv[optind]);
@@ -240,12 +254,8 @@ int main(int argc, char **argv)
 			fmPath.append(".fm");
 		string faPath(fmPath, 0, fmPath.size() - 3);
 
-		ifstream in(fmPath.c_str());
-		assert_good(in, fmPath);
 		FMIndex fmIndex;
-		in >> fmIndex;
-		assert_good(in, fmPath);
-		in.close();
+		fmIndex.open(fmPath);
 
 		ofstream fout;
 		if (!opt::toStdout)
@@ -257,7 +267,7 @@ int main(int argc, char **argv)
 		out.flush();
 		assert_good(out, faPath);
 
-		in.open((faPath + ".fai").c_str());
+		ifstream in((faPath + ".fai").c_str());
 		FastaIndex faIndex;
 		if (in) {
 			in >> faIndex;
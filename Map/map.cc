@@ -17,11 +17,15 @@
 #include <cstdlib>
 #include <getopt.h>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <stdint.h>
+#include <unistd.h> // for access
 #include <utility>
-#include <queue>
+#include <vector>
 #if _OPENMP
 # include <omp.h>
+# include <pthread.h>
 #endif
 #include "DataBase/Options.h"
 #include "DataBase/DB.h"
@@ -277,7 +281,7 @@ static size_t getMaxLen(const Match& m, const FastaIndex& faIndex,
  * contig in m. */
 static void printDuplicates(const Match& m, const Match& rcm,
 		const FastaIndex& faIndex, const FMIndex& fmIndex,
-		const FastqRecord& rec)
+		const FastqRecord& rec, ostream& out)
 {
 	size_t myLen = m.qspan();
 	size_t maxLen;
@@ -289,11 +293,7 @@ static void printDuplicates(const Match& m, const Match& rcm,
 	if (myLen < maxLen) {
 #pragma omp atomic
 		g_count.multimapped++;
-#pragma omp critical(cout)
-		{
-			cout << rec.id << '\n';
-			assert_good(cout, "stdout");
-		}
+		out << rec.id << '\n';
 		return;
 	}
 	size_t myPos = getMyPos(m, faIndex, fmIndex, rec.id);
@@ -306,11 +306,7 @@ static void printDuplicates(const Match& m, const Match& rcm,
 	if (myPos > minPos) {
 #pragma omp atomic
 		g_count.multimapped++;
-#pragma omp critical(cout)
-		{
-			cout << rec.id << '\n';
-			assert_good(cout, "stdout");
-		}
+		out << rec.id << '\n';
 	}
 #pragma omp atomic
 	g_count.unique++;
@@ -335,11 +331,9 @@ pair<Match, Match> findMatch(const FMIndex& fmIndex, const string& seq)
 	return make_pair(m, rcm);
 }
 
-static queue<string> g_pq;
-
-/** Return the mapping of the specified sequence. */
+/** Write the mapping of the specified sequence to out. */
 static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
-		const FastqRecord& rec)
+		const FastqRecord& rec, ostream& out)
 {
 	if (rec.seq.empty()) {
 		cerr << PROGRAM ": error: "
@@ -351,7 +345,7 @@ static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 	tie(m, rcm) = findMatch(fmIndex, rec.seq);
 
 	if (opt::dup) {
-		printDuplicates(m, rcm, faIndex, fmIndex, rec);
+		printDuplicates(m, rcm, faIndex, fmIndex, rec, out);
 		return;
 	}
 
@@ -425,27 +419,12 @@ static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 		reverse(sam.qual.begin(), sam.qual.end());
 #endif
 
-	bool print = opt::order == 0;
-	do {
-#pragma omp critical(cout)
-		{
-#pragma omp critical(g_pq)
-			if (!print) {
-				print = g_pq.front() == rec.id;
-				if (print)
-					g_pq.pop();
-			}
-			if (print) {
-				cout << sam;
+	out << sam;
 #if SAM_SEQ_QUAL
-				if (alts.size() > 0)
-					cout << "\tXA:Z:" << join(alts, ";");
+	if (alts.size() > 0)
+		out << "\tXA:Z:" << join(alts, ";");
 #endif
-				cout << '\n';
-				assert_good(cout, "stdout");
-			}
-		}
-	} while (!print); // spinlock :(
+	out << '\n';
 
 	if (sam.isUnmapped())
 #pragma omp atomic
@@ -458,27 +437,142 @@ static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 		g_count.unique++;
 }
 
-/** Map the sequences of the specified file. */
+/** The number of reads mapped by a thread at a time. */
+static const unsigned BATCH_SIZE = 256;
+
+/** The batches of output that are waiting to be written in order.
+ * The thread that completes the next batch in sequence becomes the
+ * writer, and writes every completed batch that follows it, while
+ * the other threads continue mapping.
+ */
+static struct {
+	/** The output of the completed batches, by batch number. */
+	map<size_t, string> pending;
+
+	/** The number of the next batch to write. */
+	size_t next;
+
+	/** Whether a thread is writing. */
+	bool writing;
+
+#if _OPENMP
+	pthread_mutex_t mutex;
+
+	/** Signalled when a batch is written. */
+	pthread_cond_t written;
+#endif
+} g_out;
+
+static void lockOutput()
+{
+#if _OPENMP
+	pthread_mutex_lock(&g_out.mutex);
+#endif
+}
+
+static void unlockOutput()
+{
+#if _OPENMP
+	pthread_mutex_unlock(&g_out.mutex);
+#endif
+}
+
+/** Wait until the specified batch is within the reorder window,
+ * which limits the number of completed batches held in memory.
+ */
+static void waitForWindow(size_t batch, size_t window)
+{
+#if _OPENMP
+	lockOutput();
+	while (batch >= g_out.next + window)
+		pthread_cond_wait(&g_out.written, &g_out.mutex);
+	unlockOutput();
+#else
+	(void)batch;
+	(void)window;
+#endif
+}
+
+/** Write the output of the specified batch after the output of the
+ * batches that precede it. */
+static void writeOrdered(size_t batch, string& s)
+{
+	lockOutput();
+	g_out.pending[batch].swap(s);
+	if (g_out.writing) {
+		// The writer will write this batch.
+		unlockOutput();
+		return;
+	}
+	g_out.writing = true;
+	while (!g_out.pending.empty()
+			&& g_out.pending.begin()->first == g_out.next) {
+		string t;
+		t.swap(g_out.pending.begin()->second);
+		g_out.pending.erase(g_out.pending.begin());
+		unlockOutput();
+		cout << t;
+		assert_good(cout, "stdout");
+		lockOutput();
+		g_out.next++;
+#if _OPENMP
+		pthread_cond_broadcast(&g_out.written);
+#endif
+	}
+	g_out.writing = false;
+	unlockOutput();
+}
+
+/** Map the sequences of the specified file. Each thread reads a
+ * numbered batch of reads and formats their mappings into a buffer,
+ * which is written as a whole.
+ */
 static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 		FastaInterleave& in)
 {
+	size_t numBatches = 0;
+	size_t window = 1;
+#if _OPENMP
+	pthread_mutex_init(&g_out.mutex, NULL);
+	pthread_cond_init(&g_out.written, NULL);
+	window = 4 * omp_get_max_threads();
+#endif
+
 #pragma omp parallel
-	for (FastqRecord rec;;) {
-		bool good;
+	for (vector<FastqRecord> batch(BATCH_SIZE);;) {
+		size_t n = 0, id;
 #pragma omp critical(in)
 		{
-			good = in >> rec;
-			if (opt::order) {
-#pragma omp critical(g_pq)
-				g_pq.push(rec.id);
-			}
+			while (n < BATCH_SIZE && in >> batch[n])
+				n++;
+			id = numBatches++;
+		}
+		if (opt::order)
+			waitForWindow(id, window);
+
+		ostringstream out;
+		for (size_t i = 0; i < n; i++)
+			find(faIndex, fmIndex, batch[i], out);
+		string s = out.str();
+
+		if (opt::order)
+			writeOrdered(id, s);
+		else if (!s.empty())
+#pragma omp critical(cout)
+		{
+			cout << s;
+			assert_good(cout, "stdout");
 		}
-		if (good)
-			find(faIndex, fmIndex, rec);
-		else
+		if (n < BATCH_SIZE)
 			break;
 	}
 	assert(in.eof());
+	assert(g_out.pending.empty());
+
+#if _OPENMP
+	pthread_cond_destroy(&g_out.written);
+	pthread_mutex_destroy(&g_out.mutex);
+#endif
 }
 
 /** Build an FM index of the specified file. */
@@ -655,17 +749,12 @@ int main(int argc, char** argv)
 	ss << targetFile << ".fai";
 	string faiPath(ss.str());
 
-	ifstream in;
-
 	// Read the FASTA index.
 	FastaIndex faIndex;
-	in.open(faiPath.c_str());
-	if (in) {
+	if (access(faiPath.c_str(), R_OK) == 0) {
 		if (opt::verbose > 0)
 			cerr << "Reading `" << faiPath << "'...\n";
-		in >> faIndex;
-		assert(in.eof());
-		in.close();
+		faIndex.open(faiPath);
 	} else {
 		if (opt::verbose > 0)
 			cerr << "Reading `" << targetFile << "'...\n";
@@ -681,14 +770,10 @@ int main(int argc, char** argv)
 
 	// Read the FM index.
 	FMIndex fmIndex;
-	in.open(fmPath.c_str());
-	if (in) {
+	if (access(fmPath.c_str(), R_OK) == 0) {
 		if (opt::verbose > 0)
 			cerr << "Reading `" << fmPath << "'...\n";
-		assert_good(in, fmPath);
-		in >> fmIndex;
-		assert_good(in, fmPath);
-		in.close();
+		fmIndex.open(fmPath);
 	} else
 		buildFMIndex(fmIndex, targetFile);
 	if (opt::sampleSA > 1)
@@ -31,6 +31,7 @@
 #include <iterator>
 #include <sstream>
 #include <string>
+#include <unistd.h> // for access
 #include <utility>
 #if _OPENMP
 # include <omp.h>
@@ -433,17 +434,12 @@ int main(int argc, char** argv)
 	ss << fastaFile << ".fai";
 	string faiPath(ss.str());
 
-	ifstream in;
-
 	// Read the FASTA index.
 	FastaIndex faIndex;
-	in.open(faiPath.c_str());
-	if (in) {
+	if (access(faiPath.c_str(), R_OK) == 0) {
 		if (opt::verbose > 0)
 			cerr << "Reading `" << faiPath << "'...\n";
-		in >> faIndex;
-		assert(in.eof());
-		in.close();
+		faIndex.open(faiPath);
 	} else {
 		if (opt::verbose > 0)
 			cerr << "Reading `" << fastaFile << "'...\n";
@@ -452,14 +448,10 @@ int main(int argc, char** argv)
 
 	// Read the FM index.
 	FMIndex fmIndex;
-	in.open(fmPath.c_str());
-	if (in) {
+	if (access(fmPath.c_str(), R_OK) == 0) {
 		if (opt::verbose > 0)
 			cerr << "Reading `" << fmPath << "'...\n";
-		assert_good(in, fmPath);
-		in >> fmIndex;
-		assert_good(in, fmPath);
-		in.close();
+		fmIndex.open(fmPath);
 	} else
 		buildFMIndex(fmIndex, fastaFile);
 	if (opt::sampleSA > 1)
@@ -131,6 +131,16 @@ void setBase(const Dinuc& x)
 	m_data |= 1 << x.toInt();
 }
 
+/** Add the specified element to this set atomically. */
+void setBaseAtomic(const Dinuc& x)
+{
+	Bits bits = 1 << x.toInt();
+#if _OPENMP
+#pragma omp atomic
+#endif
+	m_data |= bits;
+}
+
 /** Remove all elements from this set. */
 void clear()
 {
@@ -143,6 +153,16 @@ void clear(const DinucSet& x)
 	m_data &= ~x.m_data;
 }
 
+/** Remove the specified elements from this set atomically. */
+void clearAtomic(const DinucSet& x)
+{
+	Bits bits = ~x.m_data;
+#if _OPENMP
+#pragma omp atomic
+#endif
+	m_data &= bits;
+}
+
 /** Return the complementary nucleotides of this set. */
 DinucSet complement() const
 {
@@ -8,7 +8,11 @@
 
 typedef VertexData<Dinuc, DinucSet> KmerPairData;
 
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
+#if USE_OPEN_HASH_MAP
+# include "Common/OpenHashMap.h"
+typedef OpenHashMap<KmerPair, KmerPairData, hash<KmerPair> >
+	SequenceDataHash;
+#elif HAVE_GOOGLE_SPARSE_HASH_MAP
 # include <google/sparse_hash_map>
 typedef google::sparse_hash_map<KmerPair, KmerPairData, hash<KmerPair> >
 	SequenceDataHash;
@@ -4,30 +4,40 @@
 #include "Common/Log.h"
 #include "Common/Options.h"
 #include <mpi.h>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
 using namespace std;
 
-static const unsigned RX_BUFSIZE = 16*1024;
+static const unsigned RX_BUFSIZE = CommLayer::MAX_PACKET_SIZE;
 
 CommLayer::CommLayer()
 	: m_msgID(0),
-	  m_rxBuffer(new uint8_t[RX_BUFSIZE]),
-	  m_request(MPI_REQUEST_NULL),
+	  m_rxHead(0),
+	  m_rxSpare(new uint8_t[RX_BUFSIZE]),
+	  m_inflightBytes(0),
 	  m_rxPackets(0), m_rxMessages(0), m_rxBytes(0),
-	  m_txPackets(0), m_txMessages(0), m_txBytes(0)
+	  m_txPackets(0), m_txMessages(0), m_txBytes(0),
+	  m_idleTime(0)
 {
-	assert(m_request == MPI_REQUEST_NULL);
-	MPI_Irecv(m_rxBuffer, RX_BUFSIZE,
-			MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD,
-			&m_request);
+	for (unsigned i = 0; i < NUM_RX; i++) {
+		m_rxBuffers[i] = new uint8_t[RX_BUFSIZE];
+		m_rxRequests[i] = MPI_REQUEST_NULL;
+		postReceive(i);
+	}
 }
 
 CommLayer::~CommLayer()
 {
-	MPI_Cancel(&m_request);
-	delete[] m_rxBuffer;
+	for (unsigned i = 0; i < NUM_RX; i++) {
+		MPI_Cancel(&m_rxRequests[i]);
+		delete[] m_rxBuffers[i];
+	}
+	delete[] m_rxSpare;
+	if (!m_txRequests.empty())
+		MPI_Waitall(m_txRequests.size(), &m_txRequests[0],
+				MPI_STATUSES_IGNORE);
 	logger(1) << "Sent " << m_msgID << " control, "
 		<< m_txPackets << " packets, "
 		<< m_txMessages << " messages, "
@@ -37,6 +47,15 @@ CommLayer::~CommLayer()
 		<< m_rxBytes << " bytes.\n";
 }
 
+/** Post a receive into the specified receive buffer. */
+void CommLayer::postReceive(unsigned i)
+{
+	assert(m_rxRequests[i] == MPI_REQUEST_NULL);
+	MPI_Irecv(m_rxBuffers[i], RX_BUFSIZE,
+			MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD,
+			&m_rxRequests[i]);
+}
+
 /** Return the status of an MPI request.
  * Wraps MPI_Request_get_status.
  */
@@ -61,7 +80,7 @@ static bool request_get_status(const MPI_Request& req,
 APMessage CommLayer::checkMessage(int& sendID)
 {
 	MPI_Status status;
-	bool flag = request_get_status(m_request, status);
+	bool flag = request_get_status(m_rxRequests[m_rxHead], status);
 	if (flag)
 		sendID = status.MPI_SOURCE;
 	return flag ? (APMessage)status.MPI_TAG : APM_NONE;
@@ -71,14 +90,16 @@ APMessage CommLayer::checkMessage(int& sendID)
 bool CommLayer::receiveEmpty()
 {
 	MPI_Status status;
-	return !request_get_status(m_request, status);
+	return !request_get_status(m_rxRequests[m_rxHead], status);
 }
 
 /** Block until all processes have reached this routine. */
 void CommLayer::barrier()
 {
 	logger(4) << "entering barrier\n";
+	double t = MPI_Wtime();
 	MPI_Barrier(MPI_COMM_WORLD);
+	m_idleTime += MPI_Wtime() - t;
 	logger(4) << "left barrier\n";
 }
 
@@ -107,8 +128,10 @@ long long unsigned CommLayer::reduce(long long unsigned count)
 {
 	logger(4) << "entering reduce: " << count << '\n';
 	long long unsigned sum;
+	double t = MPI_Wtime();
 	MPI_Allreduce(&count, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
 			MPI_COMM_WORLD);
+	m_idleTime += MPI_Wtime() - t;
 	logger(4) << "left reduce: " << sum << '\n';
 	return sum;
 }
@@ -118,9 +141,11 @@ vector<unsigned> CommLayer::reduce(const vector<unsigned>& v)
 {
 	logger(4) << "entering reduce\n";
 	vector<unsigned> sum(v.size());
+	double t = MPI_Wtime();
 	MPI_Allreduce(const_cast<unsigned*>(&v[0]),
 			&sum[0], v.size(), MPI_UNSIGNED, MPI_SUM,
 			MPI_COMM_WORLD);
+	m_idleTime += MPI_Wtime() - t;
 	logger(4) << "left reduce\n";
 	return sum;
 }
@@ -131,9 +156,11 @@ vector<long unsigned> CommLayer::reduce(
 {
 	logger(4) << "entering reduce\n";
 	vector<long unsigned> sum(v.size());
+	double t = MPI_Wtime();
 	MPI_Allreduce(const_cast<long unsigned*>(&v[0]),
 			&sum[0], v.size(), MPI_UNSIGNED_LONG, MPI_SUM,
 			MPI_COMM_WORLD);
+	m_idleTime += MPI_Wtime() - t;
 	logger(4) << "left reduce\n";
 	return sum;
 }
@@ -180,7 +207,7 @@ ControlMessage CommLayer::receiveControlMessage()
 {
 	int flag;
 	MPI_Status status;
-	MPI_Test(&m_request, &flag, &status);
+	MPI_Test(&m_rxRequests[m_rxHead], &flag, &status);
 	assert(flag);
 	assert((APMessage)status.MPI_TAG == APM_CONTROL);
 
@@ -188,85 +215,107 @@ ControlMessage CommLayer::receiveControlMessage()
 	MPI_Get_count(&status, MPI_BYTE, &count);
 	ControlMessage msg;
 	assert(count == sizeof msg);
-	memcpy(&msg, m_rxBuffer, sizeof msg);
-	assert(m_request == MPI_REQUEST_NULL);
-	MPI_Irecv(m_rxBuffer, RX_BUFSIZE,
-			MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD,
-			&m_request);
+	memcpy(&msg, m_rxBuffers[m_rxHead], sizeof msg);
+	postReceive(m_rxHead);
+	m_rxHead = (m_rxHead + 1) % NUM_RX;
 	return msg;
 }
 
-/** Send a buffered collection of messages. */
-void CommLayer::sendBufferedMessage(int destID,
-		char* msg, size_t size)
+/** Return the index of a free send buffer. Reuse the buffer of a
+ * completed send if possible.
+ */
+unsigned CommLayer::getSendSlot()
 {
-	MPI_Send(msg, size, MPI_BYTE, destID, APM_BUFFERED,
-			MPI_COMM_WORLD);
+	if (m_txFree.empty() && !m_txRequests.empty()) {
+		std::vector<int> done(m_txRequests.size());
+		int count;
+		MPI_Testsome(m_txRequests.size(), &m_txRequests[0],
+				&count, &done[0], MPI_STATUSES_IGNORE);
+		assert(count != MPI_UNDEFINED);
+		if (count == 0 && m_txRequests.size() >= MAX_TX) {
+			// Too many sends are in progress. Wait for one.
+			MPI_Waitany(m_txRequests.size(), &m_txRequests[0],
+					&done[0], MPI_STATUS_IGNORE);
+			count = 1;
+		}
+		for (int i = 0; i < count; i++)
+			m_txFree.push_back(done[i]);
+	}
+	if (m_txFree.empty()) {
+		m_txBuffers.push_back(std::vector<char>());
+		m_txRequests.push_back(MPI_REQUEST_NULL);
+		return m_txRequests.size() - 1;
+	}
+	unsigned i = m_txFree.back();
+	m_txFree.pop_back();
+	return i;
 }
 
-/** Receive a buffered message. */
-void CommLayer::receiveBufferedMessage(MessagePtrVector& outmessages)
+/** Send a buffered collection of messages without blocking.
+ * The contents of msg are moved to a send buffer, and msg is
+ * replaced by an empty buffer, which may be reused.
+ */
+void CommLayer::sendBufferedMessage(int destID, vector<char>& msg)
+{
+	assert(!msg.empty() && msg.size() <= RX_BUFSIZE);
+	unsigned i = getSendSlot();
+	assert(m_txRequests[i] == MPI_REQUEST_NULL);
+	m_txBuffers[i].swap(msg);
+	msg.clear();
+	MPI_Isend(&m_txBuffers[i][0], m_txBuffers[i].size(), MPI_BYTE,
+			destID, APM_BUFFERED, MPI_COMM_WORLD, &m_txRequests[i]);
+}
+
+/** Return the number of packets sent but not yet received by all
+ * processes, and record the number of bytes in flight.
+ */
+uint64_t CommLayer::reduceInflight()
+{
+	vector<long unsigned> v(2);
+	v[0] = m_txPackets - m_rxPackets;
+	v[1] = m_txBytes - m_rxBytes;
+	v = reduce(v);
+	m_inflightBytes = v[1];
+	logger(4) << "inflight: " << v[0] << " packets, "
+		<< v[1] << " bytes\n";
+	return v[0];
+}
+
+/** Receive a buffered sequence of messages.
+ * The messages are not copied. The buffer remains valid until the
+ * next call to receiveBufferedMessage.
+ * @param [out] buffer the received messages
+ * @return the size of the received messages in bytes
+ */
+size_t CommLayer::receiveBufferedMessage(const char*& buffer)
 {
-	assert(outmessages.empty());
 	int flag;
 	MPI_Status status;
-	MPI_Test(&m_request, &flag, &status);
+	MPI_Test(&m_rxRequests[m_rxHead], &flag, &status);
 	assert(flag);
 	assert((APMessage)status.MPI_TAG == APM_BUFFERED);
 
 	int size;
 	MPI_Get_count(&status, MPI_BYTE, &size);
 
+	// Post a new receive into the spare buffer while this packet is
+	// being handled.
+	std::swap(m_rxBuffers[m_rxHead], m_rxSpare);
+	postReceive(m_rxHead);
+	m_rxHead = (m_rxHead + 1) % NUM_RX;
+	buffer = (const char*)m_rxSpare;
+
+	size_t numMessages = 0;
 	int offset = 0;
 	while (offset < size) {
-		MessageType type = Message::readMessageType(
-				(char*)m_rxBuffer + offset);
-
-		Message* pNewMessage;
-		switch(type)
-		{
-			case MT_ADD:
-				pNewMessage = new SeqAddMessage();
-				break;
-			case MT_REMOVE:
-				pNewMessage = new SeqRemoveMessage();
-				break;
-			case MT_SET_FLAG:
-				pNewMessage = new SetFlagMessage();
-				break;
-			case MT_REMOVE_EXT:
-				pNewMessage = new RemoveExtensionMessage();
-				break;
-			case MT_SEQ_DATA_REQUEST:
-				pNewMessage = new SeqDataRequest();
-				break;
-			case MT_SEQ_DATA_RESPONSE:
-				pNewMessage = new SeqDataResponse();
-				break;
-			case MT_SET_BASE:
-				pNewMessage = new SetBaseMessage();
-				break;
-			default:
-				assert(false);
-				break;
-		}
-
-		// Unserialize the new message from the buffer
-		offset += pNewMessage->unserialize(
-				(char*)m_rxBuffer + offset);
-
-		// Constructed message will be deleted in the
-		// NetworkSequenceCollection calling function.
-		outmessages.push_back(pNewMessage);
+		offset += Message::getNetworkSize(
+				Message::readMessageType(buffer + offset));
+		numMessages++;
 	}
 	assert(offset == size);
 
-	assert(m_request == MPI_REQUEST_NULL);
-	MPI_Irecv(m_rxBuffer, RX_BUFSIZE,
-			MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD,
-			&m_request);
-
 	m_rxPackets++;
-	m_rxMessages += outmessages.size();
+	m_rxMessages += numMessages;
 	m_rxBytes += size;
+	return size;
 }
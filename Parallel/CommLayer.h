@@ -3,6 +3,7 @@
 
 #include "Messages.h"
 #include <mpi.h>
+#include <deque>
 #include <vector>
 
 enum APMessage
@@ -24,8 +25,6 @@ enum APControl
 	APC_BARRIER,
 };
 
-typedef std::vector<Message*> MessagePtrVector;
-
 struct ControlMessage
 {
 	int64_t id;
@@ -72,20 +71,65 @@ class CommLayer
 		uint64_t sendCheckPointMessage(int argument = 0);
 
 		// Send a buffered message
-		void sendBufferedMessage(int destID, char* msg, size_t size);
+		void sendBufferedMessage(int destID, std::vector<char>& msg);
 
 		// Receive a buffered sequence of messages
-		void receiveBufferedMessage(MessagePtrVector& outmessages);
+		size_t receiveBufferedMessage(const char*& buffer);
+
+		// Return the number of packets sent but not yet received by
+		// all processes.
+		uint64_t reduceInflight();
+
+		/** Return the number of bytes sent but not yet received by
+		 * all processes, as of the last call to reduceInflight. */
+		uint64_t inflightBytes() const { return m_inflightBytes; }
+
+		/** Return the number of messages sent. */
+		uint64_t txMessages() const { return m_txMessages; }
+
+		/** Return the number of bytes sent. */
+		uint64_t txBytes() const { return m_txBytes; }
+
+		/** Return the time in seconds spent waiting for other
+		 * processes. */
+		double idleTime() const { return m_idleTime; }
+
+		/** Add time in seconds spent waiting for other processes. */
+		void addIdleTime(double t) { m_idleTime += t; }
 
-		uint64_t reduceInflight()
-		{
-			return reduce(m_txPackets - m_rxPackets);
-		}
+		/** The maximum size of a packet. */
+		static const size_t MAX_PACKET_SIZE = 16*1024;
 
 	private:
+		void postReceive(unsigned i);
+		unsigned getSendSlot();
+
+		/** The number of receives posted at once. */
+		static const unsigned NUM_RX = 4;
+
+		/** The maximum number of sends in progress. */
+		static const unsigned MAX_TX = 1024;
+
 		uint64_t m_msgID;
-		uint8_t* m_rxBuffer;
-		MPI_Request m_request;
+
+		/** The receive buffers. Packets are received in the order in
+		 * which the receives were posted, starting at m_rxHead. */
+		uint8_t* m_rxBuffers[NUM_RX];
+		MPI_Request m_rxRequests[NUM_RX];
+		unsigned m_rxHead;
+
+		/** The buffer of the packet most recently received. */
+		uint8_t* m_rxSpare;
+
+		/** The buffers of the sends in progress, which are reused
+		 * once the send completes. A deque does not move its
+		 * elements when it grows, so the buffer of a send in
+		 * progress never moves. */
+		std::deque< std::vector<char> > m_txBuffers;
+		std::vector<MPI_Request> m_txRequests;
+		std::vector<unsigned> m_txFree;
+
+		uint64_t m_inflightBytes;
 
 	protected:
 		// Counters
@@ -95,6 +139,7 @@ class CommLayer
 		uint64_t m_txPackets;
 		uint64_t m_txMessages;
 		uint64_t m_txBytes;
+		double m_idleTime;
 };
 
 #endif
@@ -4,35 +4,37 @@
 
 using namespace std;
 
+const double MessageBuffer::MAX_AGE = 0.01;
+
 MessageBuffer::MessageBuffer()
-	: m_msgQueues(opt::numProc)
+	: m_msgQueues(opt::numProc), m_lastFlush(MPI_Wtime())
 {
 	for (unsigned i = 0; i < m_msgQueues.size(); i++)
-		m_msgQueues[i].reserve(MAX_MESSAGES);
+		m_msgQueues[i].data.reserve(MAX_PACKET_SIZE);
 }
 
 void MessageBuffer::sendSeqAddMessage(int nodeID, const V& seq)
 {
-	queueMessage(nodeID, new SeqAddMessage(seq), SM_BUFFERED);
+	queueMessage(nodeID, SeqAddMessage(seq), SM_BUFFERED);
 }
 
 void MessageBuffer::sendSeqRemoveMessage(int nodeID, const V& seq)
 {
-	queueMessage(nodeID, new SeqRemoveMessage(seq), SM_BUFFERED);
+	queueMessage(nodeID, SeqRemoveMessage(seq), SM_BUFFERED);
 }
 
 // Send a set flag message
 void MessageBuffer::sendSetFlagMessage(int nodeID,
 		const V& seq, SeqFlag flag)
 {
-	queueMessage(nodeID, new SetFlagMessage(seq, flag), SM_BUFFERED);
+	queueMessage(nodeID, SetFlagMessage(seq, flag), SM_BUFFERED);
 }
 
 // Send a remove extension message
 void MessageBuffer::sendRemoveExtension(int nodeID,
 		const V& seq, extDirection dir, SymbolSet ext)
 {
-	queueMessage(nodeID, new RemoveExtensionMessage(seq, dir, ext),
+	queueMessage(nodeID, RemoveExtensionMessage(seq, dir, ext),
 			SM_BUFFERED);
 }
 
@@ -41,7 +43,7 @@ void MessageBuffer::sendSeqDataRequest(int nodeID,
 		IDType group, IDType id, const V& seq)
 {
 	queueMessage(nodeID,
-			new SeqDataRequest(seq, group, id), SM_IMMEDIATE);
+			SeqDataRequest(seq, group, id), SM_IMMEDIATE);
 }
 
 // Send a sequence data response
@@ -50,7 +52,7 @@ void MessageBuffer::sendSeqDataResponse(int nodeID,
 		SymbolSetPair extRec, int multiplicity)
 {
 	queueMessage(nodeID,
-			new SeqDataResponse(seq, group, id, extRec, multiplicity),
+			SeqDataResponse(seq, group, id, extRec, multiplicity),
 			SM_IMMEDIATE);
 }
 
@@ -59,63 +61,38 @@ void MessageBuffer::sendSetBaseExtension(int nodeID,
 		const V& seq, extDirection dir, Symbol base)
 {
 	queueMessage(nodeID,
-			new SetBaseMessage(seq, dir, base), SM_BUFFERED);
-}
-
-void MessageBuffer::queueMessage(
-		int nodeID, Message* message, SendMode mode)
-{
-	if (opt::verbose >= 9)
-		cout << opt::rank << " to " << nodeID << ": " << *message;
-	m_msgQueues[nodeID].push_back(message);
-	checkQueueForSend(nodeID, mode);
+			SetBaseMessage(seq, dir, base), SM_BUFFERED);
 }
 
 void MessageBuffer::checkQueueForSend(int nodeID, SendMode mode)
 {
-	size_t numMsgs = m_msgQueues[nodeID].size();
+	const MsgBuffer& q = m_msgQueues[nodeID];
+	if (q.empty())
+		return;
 	// check if the messages should be sent
-	if ((numMsgs == MAX_MESSAGES || mode == SM_IMMEDIATE)
-			&& numMsgs > 0) {
-		// Calculate the total size of the message
-		size_t totalSize = 0;
-		for(size_t i = 0; i < numMsgs; i++)
-		{
-			totalSize += m_msgQueues[nodeID][i]->getNetworkSize();
-		}
-
-		// Generate a buffer for all the messages
-		char* buffer = new char[totalSize];
-
-		// Copy the messages into the buffer
-		size_t offset = 0;
-		for(size_t i = 0; i < numMsgs; i++)
-			offset += m_msgQueues[nodeID][i]->serialize(
-					buffer + offset);
-
-		assert(offset == totalSize);
-		sendBufferedMessage(nodeID, buffer, totalSize);
-
-		delete [] buffer;
-		clearQueue(nodeID);
+	if (mode == SM_IMMEDIATE || MPI_Wtime() - q.time > MAX_AGE)
+		sendQueue(nodeID);
+}
 
-		m_txPackets++;
-		m_txMessages += numMsgs;
-		m_txBytes += totalSize;
-	}
+/** Send the queued messages of the specified destination. */
+void MessageBuffer::sendQueue(int nodeID)
+{
+	MsgBuffer& q = m_msgQueues[nodeID];
+	size_t numMsgs = q.count;
+	size_t totalSize = q.data.size();
+	sendBufferedMessage(nodeID, q.data);
+	clearQueue(nodeID);
+
+	m_txPackets++;
+	m_txMessages += numMsgs;
+	m_txBytes += totalSize;
 }
 
 // Clear a queue of messages
 void MessageBuffer::clearQueue(int nodeID)
 {
-	size_t numMsgs = m_msgQueues[nodeID].size();
-	for(size_t i = 0; i < numMsgs; i++)
-	{
-		// Delete the messages
-		delete m_msgQueues[nodeID][i];
-		m_msgQueues[nodeID][i] = 0;
-	}
-	m_msgQueues[nodeID].clear();
+	m_msgQueues[nodeID].data.clear();
+	m_msgQueues[nodeID].count = 0;
 }
 
 // Flush the message buffer by sending all messages that are queued
@@ -129,6 +106,17 @@ void MessageBuffer::flush()
 	}
 }
 
+/** Send the queues whose oldest message is older than MAX_AGE. */
+void MessageBuffer::flushStale()
+{
+	double now = MPI_Wtime();
+	if (now - m_lastFlush < MAX_AGE)
+		return;
+	m_lastFlush = now;
+	for (size_t id = 0; id < m_msgQueues.size(); ++id)
+		checkQueueForSend(id, SM_BUFFERED);
+}
+
 // Check if all the queues are empty
 bool MessageBuffer::transmitBufferEmpty() const
 {
@@ -138,12 +126,9 @@ bool MessageBuffer::transmitBufferEmpty() const
 		if (!it->empty()) {
 			cerr
 				<< opt::rank << ": error: tx buffer should be empty: "
-				<< it->size() << " messages from "
+				<< it->count << " messages from "
 				<< opt::rank << " to " << it - m_msgQueues.begin()
 				<< '\n';
-			for (MsgBuffer::const_iterator j = it->begin();
-					j != it->end(); ++j)
-				cerr << **j << '\n';
 			isEmpty = false;
 		}
 	}
@@ -4,10 +4,21 @@
 class MessageBuffer;
 
 #include "CommLayer.h"
+#include "Common/Options.h"
 #include "Messages.h"
+#include <iostream>
 #include <vector>
 
-typedef std::vector<Message*> MsgBuffer;
+/** The serialized messages queued for one destination. */
+struct MsgBuffer
+{
+	std::vector<char> data;
+	size_t count;
+	/** The time at which the oldest message was queued. */
+	double time;
+	MsgBuffer() : count(0), time(0) { }
+	bool empty() const { return count == 0; }
+};
 typedef std::vector<MsgBuffer> MessageQueues;
 
 enum SendMode
@@ -16,7 +27,8 @@ enum SendMode
 	SM_IMMEDIATE
 };
 
-/** A buffer of Message. */
+/** A buffer of Message. Each message is serialized into the send
+ * buffer of its destination when it is queued. */
 class MessageBuffer : public CommLayer
 {
 	public:
@@ -63,21 +75,51 @@ class MessageBuffer : public CommLayer
 				const V& seq, extDirection dir, Symbol base);
 
 		void flush();
-		void queueMessage
-			(int nodeID, Message* message, SendMode mode);
+		void flushStale();
+
+		/** Serialize the specified message into the send buffer of
+		 * its destination. */
+		template <typename M>
+		void queueMessage(int nodeID, const M& message, SendMode mode)
+		{
+			if (opt::verbose >= 9)
+				std::cout << opt::rank << " to " << nodeID << ": "
+					<< message;
+			MsgBuffer& q = m_msgQueues[nodeID];
+			if (q.data.size() + M::getNetworkSize() > MAX_PACKET_SIZE)
+				sendQueue(nodeID);
+			if (q.empty())
+				q.time = MPI_Wtime();
+			size_t offset = q.data.size();
+			q.data.resize(offset + M::getNetworkSize());
+			size_t size = message.serialize(&q.data[offset]);
+			assert(size == M::getNetworkSize());
+			(void)size;
+			q.count++;
+			checkQueueForSend(nodeID, mode);
+		}
 
 		// clear out a queue
 		void clearQueue(int nodeID);
 		bool transmitBufferEmpty() const;
 
-		// check if a queue is full, if so, send the messages if the
-		// immediate mode flag is set, send even if the queue is not
-		// full.
+		// check if a queue is full or stale, if so, send the
+		// messages if the immediate mode flag is set, send even if
+		// the queue is not full.
 		void checkQueueForSend(int nodeID, SendMode mode);
 
 	private:
-		static const size_t MAX_MESSAGES = 100;
+		void sendQueue(int nodeID);
+
+		/** Send a queue whose oldest message is older than this
+		 * many seconds. */
+		static const double MAX_AGE;
+
 		MessageQueues m_msgQueues;
+
+		/** The time at which the queues were last checked for stale
+		 * messages. */
+		double m_lastFlush;
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include "Messages.h"
-#include "NetworkSequenceCollection.h"
+#include <cassert>
+#include <cstdlib>
 #include <cstring>
 
 static size_t serializeData(const void* ptr, char* buffer,
@@ -16,9 +17,34 @@ static size_t unserializeData(void* ptr, const char* buffer,
 	return size;
 }
 
-MessageType Message::readMessageType(char* buffer)
+MessageType Message::readMessageType(const char* buffer)
 {
-	return (MessageType)*(uint8_t*)buffer;
+	return (MessageType)*(const uint8_t*)buffer;
+}
+
+/** Return the size of a message of the specified type. */
+size_t Message::getNetworkSize(MessageType type)
+{
+	switch (type)
+	{
+		case MT_ADD:
+			return SeqAddMessage::getNetworkSize();
+		case MT_REMOVE:
+			return SeqRemoveMessage::getNetworkSize();
+		case MT_SET_FLAG:
+			return SetFlagMessage::getNetworkSize();
+		case MT_REMOVE_EXT:
+			return RemoveExtensionMessage::getNetworkSize();
+		case MT_SEQ_DATA_REQUEST:
+			return SeqDataRequest::getNetworkSize();
+		case MT_SEQ_DATA_RESPONSE:
+			return SeqDataResponse::getNetworkSize();
+		case MT_SET_BASE:
+			return SetBaseMessage::getNetworkSize();
+		default:
+			assert(false);
+			abort();
+	}
 }
 
 size_t Message::unserialize(const char* buffer)
@@ -29,7 +55,7 @@ size_t Message::unserialize(const char* buffer)
 	return offset;
 }
 
-size_t SeqAddMessage::serialize(char* buffer)
+size_t SeqAddMessage::serialize(char* buffer) const
 {
 	size_t offset = 0;
 	buffer[offset++] = TYPE;
@@ -37,13 +63,7 @@ size_t SeqAddMessage::serialize(char* buffer)
 	return offset;
 }
 
-void SeqAddMessage::handle(int senderID,
-		NetworkSequenceCollection& handler)
-{
-	handler.handle(senderID, *this);
-}
-
-size_t SeqRemoveMessage::serialize(char* buffer)
+size_t SeqRemoveMessage::serialize(char* buffer) const
 {
 	size_t offset = 0;
 	buffer[offset++] = TYPE;
@@ -51,13 +71,7 @@ size_t SeqRemoveMessage::serialize(char* buffer)
 	return offset;
 }
 
-void SeqRemoveMessage::handle(int senderID,
-		NetworkSequenceCollection& handler)
-{
-	handler.handle(senderID, *this);
-}
-
-size_t SetFlagMessage::serialize(char* buffer)
+size_t SetFlagMessage::serialize(char* buffer) const
 {
 	size_t offset = 0;
 	buffer[offset++] = TYPE;
@@ -75,13 +89,7 @@ size_t SetFlagMessage::unserialize(const char* buffer)
 	return offset;
 }
 
-void SetFlagMessage::handle(
-		int senderID, NetworkSequenceCollection& handler)
-{
-	handler.handle(senderID, *this);
-}
-
-size_t RemoveExtensionMessage::serialize(char* buffer)
+size_t RemoveExtensionMessage::serialize(char* buffer) const
 {
 	size_t offset = 0;
 	buffer[offset++] = TYPE;
@@ -100,13 +108,7 @@ size_t RemoveExtensionMessage::unserialize(const char* buffer)
 	return offset;
 }
 
-void RemoveExtensionMessage::handle(
-		int senderID, NetworkSequenceCollection& handler)
-{
-	handler.handle(senderID, *this);
-}
-
-size_t SetBaseMessage::serialize(char* buffer)
+size_t SetBaseMessage::serialize(char* buffer) const
 {
 	size_t offset = 0;
 	buffer[offset++] = TYPE;
@@ -126,13 +128,7 @@ size_t SetBaseMessage::unserialize(const char* buffer)
 	return offset;
 }
 
-void SetBaseMessage::handle(
-		int senderID, NetworkSequenceCollection& handler)
-{
-	handler.handle(senderID, *this);
-}
-
-size_t SeqDataRequest::serialize(char* buffer)
+size_t SeqDataRequest::serialize(char* buffer) const
 {
 	size_t offset = 0;
 	buffer[offset++] = TYPE;
@@ -153,13 +149,7 @@ size_t SeqDataRequest::unserialize(const char* buffer)
 	return offset;
 }
 
-void SeqDataRequest::handle(
-		int senderID, NetworkSequenceCollection& handler)
-{
-	handler.handle(senderID, *this);
-}
-
-size_t SeqDataResponse::serialize(char* buffer)
+size_t SeqDataResponse::serialize(char* buffer) const
 {
 	size_t offset = 0;
 	buffer[offset++] = TYPE;
@@ -189,9 +179,3 @@ size_t SeqDataResponse::unserialize(const char* buffer)
 			&m_multiplicity, buffer + offset, sizeof(m_multiplicity));
 	return offset;
 }
-
-void SeqDataResponse::handle(
-		int senderID, NetworkSequenceCollection& handler)
-{
-	handler.handle(senderID, *this);
-}
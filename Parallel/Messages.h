@@ -4,8 +4,6 @@
 #include "SequenceCollection.h"
 #include <ostream>
 
-class NetworkSequenceCollection;
-
 enum MessageType
 {
 	MT_VOID,
@@ -27,7 +25,10 @@ enum MessageOp
 
 typedef uint32_t IDType;
 
-/** The base class of all interprocess messages. */
+/** The base class of all interprocess messages.
+ * A message is a fixed-size record. Its first byte is its type, and
+ * it is serialized directly into the send buffer of its destination.
+ */
 class Message
 {
 	public:
@@ -39,20 +40,16 @@ class Message
 
 		Message() { }
 		Message(const V& seq) : m_seq(seq) { }
-		virtual ~Message() { }
-
-		virtual void handle(
-				int senderID, NetworkSequenceCollection& handler) = 0;
 
-		virtual size_t getNetworkSize() const
+		static size_t getNetworkSize()
 		{
 			return sizeof (uint8_t) // MessageType
 				+ V::serialSize();
 		}
 
-		static MessageType readMessageType(char* buffer);
-		virtual size_t serialize(char* buffer) = 0;
-		virtual size_t unserialize(const char* buffer);
+		static MessageType readMessageType(const char* buffer);
+		static size_t getNetworkSize(MessageType type);
+		size_t unserialize(const char* buffer);
 
 		friend std::ostream& operator <<(std::ostream& out,
 				const Message& message)
@@ -70,8 +67,7 @@ class SeqAddMessage : public Message
 		SeqAddMessage() { }
 		SeqAddMessage(const V& seq) : Message(seq) { }
 
-		void handle(int senderID, NetworkSequenceCollection& handler);
-		size_t serialize(char* buffer);
+		size_t serialize(char* buffer) const;
 
 		static const MessageType TYPE = MT_ADD;
 };
@@ -83,8 +79,7 @@ class SeqRemoveMessage : public Message
 		SeqRemoveMessage() { }
 		SeqRemoveMessage(const V& seq) : Message(seq) { }
 
-		void handle(int senderID, NetworkSequenceCollection& handler);
-		size_t serialize(char* buffer);
+		size_t serialize(char* buffer) const;
 
 		static const MessageType TYPE = MT_REMOVE;
 };
@@ -97,13 +92,12 @@ class SetFlagMessage : public Message
 		SetFlagMessage(const V& seq, SeqFlag flag)
 			: Message(seq), m_flag(flag) { }
 
-		size_t getNetworkSize() const
+		static size_t getNetworkSize()
 		{
-			return Message::getNetworkSize() + sizeof m_flag;
+			return Message::getNetworkSize() + sizeof (uint8_t);
 		}
 
-		void handle(int senderID, NetworkSequenceCollection& handler);
-		size_t serialize(char* buffer);
+		size_t serialize(char* buffer) const;
 		size_t unserialize(const char* buffer);
 
 		static const MessageType TYPE = MT_SET_FLAG;
@@ -119,14 +113,13 @@ class RemoveExtensionMessage : public Message
 				extDirection dir, SymbolSet ext)
 			: Message(seq), m_dir(dir), m_ext(ext) { }
 
-		size_t getNetworkSize() const
+		static size_t getNetworkSize()
 		{
 			return Message::getNetworkSize()
-				+ sizeof m_dir + sizeof m_ext;
+				+ sizeof (uint8_t) + sizeof (SymbolSet);
 		}
 
-		void handle(int senderID, NetworkSequenceCollection& handler);
-		size_t serialize(char* buffer);
+		size_t serialize(char* buffer) const;
 		size_t unserialize(const char* buffer);
 
 		static const MessageType TYPE = MT_REMOVE_EXT;
@@ -142,14 +135,13 @@ class SeqDataRequest : public Message
 		SeqDataRequest(const V& seq, IDType group, IDType id)
 			: Message(seq), m_group(group), m_id(id) { }
 
-		size_t getNetworkSize() const
+		static size_t getNetworkSize()
 		{
 			return Message::getNetworkSize()
-				+ sizeof m_group + sizeof m_id;
+				+ 2 * sizeof (IDType);
 		}
 
-		void handle(int senderID, NetworkSequenceCollection& handler);
-		size_t serialize(char* buffer);
+		size_t serialize(char* buffer) const;
 		size_t unserialize(const char* buffer);
 
 		static const MessageType TYPE = MT_SEQ_DATA_REQUEST;
@@ -167,15 +159,14 @@ class SeqDataResponse : public Message
 			Message(seq), m_group(group), m_id(id),
 			m_extRecord(extRecord), m_multiplicity(multiplicity) { }
 
-		size_t getNetworkSize() const
+		static size_t getNetworkSize()
 		{
 			return Message::getNetworkSize()
-				+ sizeof m_group + sizeof m_id
-				+ sizeof m_extRecord + sizeof m_multiplicity;
+				+ 2 * sizeof (IDType)
+				+ sizeof (SymbolSetPair) + sizeof (uint16_t);
 		}
 
-		void handle(int senderID, NetworkSequenceCollection& handler);
-		size_t serialize(char* buffer);
+		size_t serialize(char* buffer) const;
 		size_t unserialize(const char* buffer);
 
 		static const MessageType TYPE = MT_SEQ_DATA_RESPONSE;
@@ -194,14 +185,13 @@ class SetBaseMessage : public Message
 				extDirection dir, Symbol base)
 			: Message(seq), m_dir(dir), m_base(base) { }
 
-		size_t getNetworkSize() const
+		static size_t getNetworkSize()
 		{
 			return Message::getNetworkSize()
-				+ sizeof m_dir + sizeof m_base;
+				+ sizeof (uint8_t) + sizeof (Symbol);
 		}
 
-		void handle(int senderID, NetworkSequenceCollection& handler);
-		size_t serialize(char* buffer);
+		size_t serialize(char* buffer) const;
 		size_t unserialize(const char* buffer);
 
 		static const MessageType TYPE = MT_SET_BASE;
@@ -2,14 +2,22 @@
 #include "Assembly/AssemblyAlgorithms.h"
 #include "Assembly/Options.h"
 #include "Common/Histogram.h"
+#include "Common/IOUtil.h"
 #include "Common/Log.h"
 #include "Common/Options.h"
 #include "Common/StringUtil.h"
 #include "DataLayer/FastaWriter.h"
-#include <climits> // for UINT_MAX
+#include <algorithm>
+#include <cerrno>
+#include <climits> // for INT_MAX, UINT_MAX
+#include <cstdio> // for rename
 #include <cstdlib>
+#include <cstring> // for strerror
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <unistd.h> // for unlink
 #include <utility>
 
 using namespace std;
@@ -33,9 +41,17 @@ const int DEDICATE_CONTROL_AT = 1000;
 void NetworkSequenceCollection::loadSequences()
 {
 	Timer timer("LoadSequences");
-	for (unsigned i = opt::rank; i < opt::inFiles.size();
-			i += opt::numProc)
-		AssemblyAlgorithms::loadSequences(this, opt::inFiles[i]);
+	// Every process reads its own section of a file that may be
+	// split. The files that may not be split are dealt out to the
+	// processes.
+	for (unsigned i = 0; i < opt::inFiles.size(); i++) {
+		const string& path = opt::inFiles[i];
+		if (FastaReader::isSplittable(path.c_str()))
+			AssemblyAlgorithms::loadSequenceSection(this, path,
+					opt::rank + 1, opt::numProc);
+		else if ((int)i % opt::numProc == opt::rank)
+			AssemblyAlgorithms::loadSequences(this, path);
+	}
 }
 
 /** Receive, process, send, and synchronize.
@@ -72,7 +88,11 @@ void NetworkSequenceCollection::run()
 
 	ofstream bubbleFile;
 
-	SetState(NAS_LOADING);
+	if (opt::resume) {
+		resume();
+		SetState(NAS_WAITING);
+	} else
+		SetState(NAS_LOADING);
 	while (m_state != NAS_DONE) {
 		switch (m_state) {
 			case NAS_LOADING:
@@ -98,6 +118,7 @@ void NetworkSequenceCollection::run()
 					= AssemblyAlgorithms::coverageHistogram(m_data);
 				Histogram h(m_comm.reduce(myh.toVector()));
 				AssemblyAlgorithms::setCoverageParameters(h);
+				reportLoadBalance("loading");
 				EndState();
 				SetState(NAS_WAITING);
 				break;
@@ -116,6 +137,7 @@ void NetworkSequenceCollection::run()
 				logger(0) << "Added " << m_numBasesAdjSet
 					<< " edges.\n";
 				m_comm.reduce(m_numBasesAdjSet);
+				reportLoadBalance("finding adjacency");
 				EndState();
 				SetState(NAS_WAITING);
 				break;
@@ -130,7 +152,7 @@ void NetworkSequenceCollection::run()
 				break;
 			}
 			case NAS_ERODE_WAITING:
-				pumpNetwork();
+				pumpNetworkWaiting();
 				break;
 			case NAS_ERODE_COMPLETE:
 				completeOperation();
@@ -138,6 +160,7 @@ void NetworkSequenceCollection::run()
 
 				m_comm.reduce(m_data.cleanup());
 				m_comm.barrier();
+				reportLoadBalance("eroding");
 
 				SetState(NAS_WAITING);
 				break;
@@ -179,6 +202,7 @@ void NetworkSequenceCollection::run()
 				m_comm.reduce(numAssembled.second);
 				m_comm.reduce(m_lowCoverageContigs);
 				m_comm.reduce(m_lowCoverageKmer);
+				reportLoadBalance("removing low-coverage contigs");
 				opt::coverage = 0;
 				EndState();
 				SetState(NAS_WAITING);
@@ -250,11 +274,17 @@ void NetworkSequenceCollection::run()
 			case NAS_ASSEMBLE_COMPLETE:
 				m_comm.reduce(numAssembled.first);
 				m_comm.reduce(numAssembled.second);
+				reportLoadBalance("assembling");
 				EndState();
 				SetState(NAS_DONE);
 				break;
+			case NAS_SNAPSHOT:
+				writeSnapshot(NULL);
+				EndState();
+				SetState(NAS_WAITING);
+				break;
 			case NAS_WAITING:
-				pumpNetwork();
+				pumpNetworkWaiting();
 				break;
 			case NAS_DONE:
 				break;
@@ -277,7 +307,7 @@ size_t NetworkSequenceCollection::controlErode()
 
 	m_numReachedCheckpoint++;
 	while (!checkpointReached())
-		pumpNetwork();
+		pumpNetworkWaiting();
 	numEroded += m_checkpointSum;
 	EndState();
 
@@ -298,6 +328,7 @@ size_t NetworkSequenceCollection::controlErode()
 	m_comm.barrier();
 	assert(removed == numEroded);
 	(void)removed;
+	reportLoadBalance("eroding");
 
 	SetState(NAS_WAITING);
 	return numEroded;
@@ -319,7 +350,7 @@ size_t NetworkSequenceCollection::controlRemoveMarked()
 
 	m_numReachedCheckpoint++;
 	while (!checkpointReached())
-		pumpNetwork();
+		pumpNetworkWaiting();
 	return m_checkpointSum;
 }
 
@@ -337,7 +368,7 @@ size_t NetworkSequenceCollection::controlTrimRound(unsigned trimLen)
 
 	m_numReachedCheckpoint++;
 	while (!checkpointReached())
-		pumpNetwork();
+		pumpNetworkWaiting();
 	numRemoved += m_checkpointSum;
 
 	size_t numSweeped = controlRemoveMarked();
@@ -391,7 +422,7 @@ void NetworkSequenceCollection::controlCoverage()
 
 	m_numReachedCheckpoint++;
 	while (!checkpointReached())
-		pumpNetwork();
+		pumpNetworkWaiting();
 
 	// Count the number of low-coverage contigs.
 	SetState(NAS_COVERAGE_COMPLETE);
@@ -409,6 +440,7 @@ void NetworkSequenceCollection::controlCoverage()
 	size_t lowCoverageKmer = m_comm.reduce(m_lowCoverageKmer);
 	cout << "Removed " << lowCoverageKmer << " k-mer in "
 		<< lowCoverageContigs << " low-coverage contigs.\n";
+	reportLoadBalance("removing low-coverage contigs");
 
 	if (!opt::db.empty()) {
 		AssemblyAlgorithms::addToDb ("totalLowCovCntg", lowCoverageContigs);
@@ -432,13 +464,36 @@ void NetworkSequenceCollection::controlCoverage()
 	opt::coverage = 0;
 }
 
+/** Return the state that follows the specified phase, after which
+ * a snapshot may be written.
+ */
+static NetworkAssemblyState stateAfter(const string& phase)
+{
+	if (phase == "load")
+		return NAS_GEN_ADJ;
+	else if (phase == "adjacency")
+		return opt::erode > 0 ? NAS_ERODE : NAS_TRIM;
+	else if (phase == "trim")
+		return opt::coverage > 0 ? NAS_COVERAGE
+			: opt::bubbleLen > 0 ? NAS_POPBUBBLE
+			: NAS_MARK_AMBIGUOUS;
+	cerr << "error: unknown snapshot phase: `" << phase << "'\n";
+	exit(EXIT_FAILURE);
+}
+
 /** Run the assembly state machine for the controller (rank = 0). */
 void NetworkSequenceCollection::runControl()
 {
 	unsigned prunedSum = 0;
 	unsigned erosionSum = 0;
 	unsigned finalAmbg = 0;
-	SetState(NAS_LOADING);
+	if (opt::resume) {
+		SnapshotManifest manifest = resume();
+		erosionSum = manifest.erosionSum;
+		prunedSum = manifest.prunedSum;
+		SetState(stateAfter(manifest.phase));
+	} else
+		SetState(NAS_LOADING);
 	size_t temp;
 	while (m_state != NAS_DONE) {
 		switch (m_state) {
@@ -449,7 +504,7 @@ void NetworkSequenceCollection::runControl()
 
 				m_numReachedCheckpoint++;
 				while (!checkpointReached())
-					pumpNetwork();
+					pumpNetworkWaiting();
 
 				SetState(NAS_LOAD_COMPLETE);
 				m_comm.sendControlMessage(APC_SET_STATE,
@@ -474,7 +529,9 @@ void NetworkSequenceCollection::runControl()
 					= AssemblyAlgorithms::coverageHistogram(m_data);
 				Histogram h(m_comm.reduce(myh.toVector()));
 				AssemblyAlgorithms::setCoverageParameters(h);
+				reportLoadBalance("loading");
 				EndState();
+				controlSnapshot("load", erosionSum, prunedSum);
 
 				SetState(m_data.isAdjacencyLoaded()
 						? NAS_ERODE : NAS_GEN_ADJ);
@@ -490,7 +547,7 @@ void NetworkSequenceCollection::runControl()
 
 				m_numReachedCheckpoint++;
 				while (!checkpointReached())
-					pumpNetwork();
+					pumpNetworkWaiting();
 
 				SetState(NAS_ADJ_COMPLETE);
 				m_comm.sendControlMessage(APC_SET_STATE,
@@ -505,8 +562,10 @@ void NetworkSequenceCollection::runControl()
 				if (!opt::db.empty())
 					AssemblyAlgorithms::addToDb ("EdgesGenerated", temp);
 
+				reportLoadBalance("finding adjacency");
 				EndState();
-				SetState(opt::erode > 0 ? NAS_ERODE : NAS_TRIM);
+				controlSnapshot("adjacency", erosionSum, prunedSum);
+				SetState(stateAfter("adjacency"));
 				break;
 			case NAS_ERODE:
 				assert(opt::erode > 0);
@@ -528,6 +587,7 @@ void NetworkSequenceCollection::runControl()
 			case NAS_CLEAR_FLAGS:
 			case NAS_DISCOVER_BUBBLES:
 			case NAS_ASSEMBLE_COMPLETE:
+			case NAS_SNAPSHOT:
 			case NAS_WAITING:
 				// These states are used only by the slaves.
 				assert(false);
@@ -535,9 +595,8 @@ void NetworkSequenceCollection::runControl()
 
 			case NAS_TRIM:
 				controlTrim(prunedSum);
-				SetState(opt::coverage > 0 ? NAS_COVERAGE
-						: opt::bubbleLen > 0 ? NAS_POPBUBBLE
-						: NAS_MARK_AMBIGUOUS);
+				controlSnapshot("trim", erosionSum, prunedSum);
+				SetState(stateAfter("trim"));
 				break;
 
 			case NAS_COVERAGE:
@@ -585,7 +644,7 @@ void NetworkSequenceCollection::runControl()
 
 				m_numReachedCheckpoint++;
 				while (!checkpointReached())
-					pumpNetwork();
+					pumpNetworkWaiting();
 
 				SetState(NAS_ASSEMBLE_COMPLETE);
 				m_comm.sendControlMessage(APC_SET_STATE,
@@ -598,6 +657,7 @@ void NetworkSequenceCollection::runControl()
 				cout << "Assembled " << numAssembled.second
 					<< " k-mer in " << numAssembled.first
 					<< " contigs.\n";
+				reportLoadBalance("assembling");
 
 				if (!opt::db.empty()) {
 					AssemblyAlgorithms::addToDb ("assembledKmerNum", numAssembled.second);
@@ -645,10 +705,95 @@ void NetworkSequenceCollection::SetState(
 	m_checkpointSum = 0;
 }
 
-/** Receive and dispatch packets.
+/** Receive and dispatch packets. If another thread is using the
+ * network, return immediately.
  * @return the number of packets received
  */
 size_t NetworkSequenceCollection::pumpNetwork()
+{
+	if (!tryLockComm())
+		return 0;
+	m_comm.flushStale();
+	size_t count = receiveMessages();
+	unlockComm();
+	return count;
+}
+
+/** Receive and dispatch packets while waiting for other processes.
+ * Count the time during which no packets are received as idle.
+ * @return the number of packets received
+ */
+size_t NetworkSequenceCollection::pumpNetworkWaiting()
+{
+	double t = MPI_Wtime();
+	size_t count = pumpNetwork();
+	if (count == 0)
+		m_comm.addIdleTime(MPI_Wtime() - t);
+	return count;
+}
+
+/** Print the minimum, mean, maximum and distribution of the values
+ * of each process.
+ */
+static void printDistribution(const char* name,
+		const vector<long unsigned>& v)
+{
+	Histogram h;
+	long unsigned sum = 0;
+	for (vector<long unsigned>::const_iterator it = v.begin();
+			it != v.end(); ++it) {
+		h.insert(min(*it, (long unsigned)INT_MAX));
+		sum += *it;
+	}
+	double mean = (double)sum / v.size();
+	long unsigned max = *max_element(v.begin(), v.end());
+	ostringstream ss;
+	ss << "  " << name
+		<< ": min " << *min_element(v.begin(), v.end())
+		<< " mean " << (long unsigned)mean
+		<< " max " << max
+		<< " max/mean " << fixed << setprecision(2)
+		<< (mean > 0 ? max / mean : 1) << '\n'
+		<< "  " << h.barplot(40) << '\n';
+	cout << ss.str();
+}
+
+/** Print the distribution among the processes of the k-mer, the
+ * messages sent and the time spent idle since the previous report.
+ * Every process must call this function.
+ */
+void NetworkSequenceCollection::reportLoadBalance(const char* phase)
+{
+	enum { KMER, MESSAGES, IDLE, NUM_FIELDS };
+	vector<long unsigned> v(NUM_FIELDS * opt::numProc);
+	long unsigned* p = &v[NUM_FIELDS * opt::rank];
+	p[KMER] = m_data.size();
+	p[MESSAGES] = m_comm.txMessages() - m_reportedMessages;
+	p[IDLE] = (long unsigned)(1000
+			* (m_comm.idleTime() - m_reportedIdleTime));
+	v = m_comm.reduce(v);
+	m_reportedMessages = m_comm.txMessages();
+	m_reportedIdleTime = m_comm.idleTime();
+	if (opt::rank != 0)
+		return;
+
+	vector<long unsigned> kmer, messages, idle;
+	for (int i = 0; i < opt::numProc; i++) {
+		kmer.push_back(v[NUM_FIELDS * i + KMER]);
+		messages.push_back(v[NUM_FIELDS * i + MESSAGES]);
+		idle.push_back(v[NUM_FIELDS * i + IDLE]);
+	}
+	cout << "Load balance of " << opt::numProc
+		<< " processes after " << phase << ":\n";
+	printDistribution("k-mer", kmer);
+	printDistribution("messages sent", messages);
+	printDistribution("idle ms", idle);
+}
+
+/** Receive and dispatch packets.
+ * @return the number of packets received
+ */
+size_t NetworkSequenceCollection::receiveMessages()
 {
 	for (size_t count = 0; ; count++) {
 		int senderID;
@@ -662,17 +807,9 @@ size_t NetworkSequenceCollection::pumpNetwork()
 				return ++count;
 			case APM_BUFFERED:
 				{
-					MessagePtrVector msgs;
-					m_comm.receiveBufferedMessage(msgs);
-					for (MessagePtrVector::iterator
-							iter = msgs.begin();
-							iter != msgs.end(); iter++) {
-						// Handle each message based on its type
-						(*iter)->handle(senderID, *this);
-						// Delete the message
-						delete (*iter);
-						*iter = 0;
-					}
+					const char* buffer;
+					size_t size = m_comm.receiveBufferedMessage(buffer);
+					handle(senderID, buffer, size);
 					break;
 				}
 			case APM_NONE:
@@ -697,6 +834,58 @@ void NetworkSequenceCollection::notify(const V& key)
 	}
 }
 
+/** Unserialize a message of type M and handle it.
+ * @return the size of the message
+ */
+template <typename M>
+static size_t dispatch(NetworkSequenceCollection& handler,
+		int senderID, const char* buffer)
+{
+	M message;
+	size_t size = message.unserialize(buffer);
+	handler.handle(senderID, message);
+	return size;
+}
+
+/** Handle a packet of messages. */
+void NetworkSequenceCollection::handle(
+		int senderID, const char* buffer, size_t size)
+{
+	for (size_t offset = 0; offset < size;) {
+		const char* p = buffer + offset;
+		switch (Message::readMessageType(p))
+		{
+			case MT_ADD:
+				offset += dispatch<SeqAddMessage>(*this, senderID, p);
+				break;
+			case MT_REMOVE:
+				offset += dispatch<SeqRemoveMessage>(
+						*this, senderID, p);
+				break;
+			case MT_SET_FLAG:
+				offset += dispatch<SetFlagMessage>(*this, senderID, p);
+				break;
+			case MT_REMOVE_EXT:
+				offset += dispatch<RemoveExtensionMessage>(
+						*this, senderID, p);
+				break;
+			case MT_SEQ_DATA_REQUEST:
+				offset += dispatch<SeqDataRequest>(*this, senderID, p);
+				break;
+			case MT_SEQ_DATA_RESPONSE:
+				offset += dispatch<SeqDataResponse>(
+						*this, senderID, p);
+				break;
+			case MT_SET_BASE:
+				offset += dispatch<SetBaseMessage>(*this, senderID, p);
+				break;
+			default:
+				assert(false);
+				abort();
+		}
+	}
+}
+
 void NetworkSequenceCollection::handle(
 		int /*senderID*/, const SeqAddMessage& message)
 {
@@ -1046,7 +1235,7 @@ size_t NetworkSequenceCollection::controlDiscoverBubbles()
 
 	m_numReachedCheckpoint++;
 	while (!checkpointReached())
-		pumpNetwork();
+		pumpNetworkWaiting();
 	numDiscovered += m_checkpointSum;
 	if (numDiscovered > 0 && opt::verbose > 0)
 		cout << "Discovered " << numDiscovered << " bubbles.\n";
@@ -1074,7 +1263,7 @@ size_t NetworkSequenceCollection::controlPopBubbles(ostream& out)
 		m_comm.sendControlMessageToNode(i, APC_POPBUBBLE,
 				m_numPopped + m_checkpointSum);
 		while (!checkpointReached(1))
-			pumpNetwork();
+			pumpNetworkWaiting();
 	}
 
 	size_t numPopped = m_checkpointSum;
@@ -1096,7 +1285,7 @@ size_t NetworkSequenceCollection::controlMarkAmbiguous()
 	EndState();
 	m_numReachedCheckpoint++;
 	while (!checkpointReached())
-		pumpNetwork();
+		pumpNetworkWaiting();
 	cout << "Marked " << m_checkpointSum << " ambiguous branches.\n";
 	return m_checkpointSum;
 }
@@ -1114,7 +1303,7 @@ size_t NetworkSequenceCollection::controlSplitAmbiguous()
 	EndState();
 	m_numReachedCheckpoint++;
 	while (!checkpointReached())
-		pumpNetwork();
+		pumpNetworkWaiting();
 	cout << "Split " << m_checkpointSum << " ambiguous branches.\n";
 
 	if (!opt::db.empty())
@@ -1384,17 +1573,23 @@ void NetworkSequenceCollection::add(const V& seq,
 		m_data.add(seq, coverage);
 	} else {
 		assert(coverage == 1);
+		lockComm();
 		m_comm.sendSeqAddMessage(computeNodeID(seq), seq);
+		unlockComm();
 	}
 }
 
-/** Remove a k-mer from this collection. */
-void NetworkSequenceCollection::remove(const V& seq)
+/** Remove a k-mer from this collection.
+ * @return false if the local k-mer was already removed
+ */
+bool NetworkSequenceCollection::remove(const V& seq)
 {
 	if (isLocal(seq))
-		m_data.remove(seq);
-	else
-		m_comm.sendSeqRemoveMessage(computeNodeID(seq), seq);
+		return m_data.remove(seq);
+	lockComm();
+	m_comm.sendSeqRemoveMessage(computeNodeID(seq), seq);
+	unlockComm();
+	return true;
 }
 
 bool NetworkSequenceCollection::checkpointReached() const
@@ -1410,21 +1605,28 @@ checkpointReached(unsigned numRequired) const
 
 void NetworkSequenceCollection::setFlag(const V& seq, SeqFlag flag)
 {
-	if (isLocal(seq))
+	if (isLocal(seq)) {
 		m_data.setFlag(seq, flag);
-	else
+	} else {
+		lockComm();
 		m_comm.sendSetFlagMessage(computeNodeID(seq), seq, flag);
+		unlockComm();
+	}
 }
 
 bool NetworkSequenceCollection::setBaseExtension(
 		const V& seq, extDirection dir, Symbol base)
 {
 	if (isLocal(seq)) {
-		if (m_data.setBaseExtension(seq, dir, base))
+		if (m_data.setBaseExtension(seq, dir, base)) {
+#pragma omp atomic
 			m_numBasesAdjSet++;
+		}
 	} else {
 		int nodeID = computeNodeID(seq);
+		lockComm();
 		m_comm.sendSetBaseExtension(nodeID, seq, dir, base);
+		unlockComm();
 	}
 
 	// As this call delegates, the return value is meaningless.
@@ -1440,7 +1642,9 @@ void NetworkSequenceCollection::removeExtension(
 		notify(seq);
 	} else {
 		int nodeID = computeNodeID(seq);
+		lockComm();
 		m_comm.sendRemoveExtension(nodeID, seq, dir, ext);
+		unlockComm();
 	}
 }
 
@@ -1450,12 +1654,227 @@ bool NetworkSequenceCollection::isLocal(const V& seq) const
 	return computeNodeID(seq) == opt::rank;
 }
 
+/** The number of buckets of k-mer. The buckets are divided evenly
+ * among the processes, so that the bucket of a k-mer does not depend
+ * on the number of processes.
+ */
+static const unsigned NUM_BUCKETS = 1 << 16;
+
+/** Return the process ID to which the specified bucket belongs
+ * when there are numProc processes.
+ */
+static int bucketNodeID(uint64_t bucket, int numProc)
+{
+	if (numProc < DEDICATE_CONTROL_AT) {
+		return bucket * numProc / NUM_BUCKETS;
+	} else {
+		return bucket * (numProc - 1) / NUM_BUCKETS + 1;
+	}
+}
+
 /** Return the process ID to which the specified kmer belongs. */
 int NetworkSequenceCollection::computeNodeID(const V& seq) const
 {
-	if (opt::numProc < DEDICATE_CONTROL_AT) {
-		return seq.getCode() % (unsigned)opt::numProc;
-	} else {
-		return seq.getCode() % (unsigned)(opt::numProc - 1) + 1;
+	return bucketNodeID(seq.getCode() % NUM_BUCKETS, opt::numProc);
+}
+
+/** Return the path of the manifest of the snapshot files. */
+static string snapshotManifestPath()
+{
+	return opt::snapshotPrefix + ".snapshot";
+}
+
+/** Return the path of the snapshot file of the specified process. */
+static string snapshotPath(unsigned set, int rank)
+{
+	ostringstream s;
+	s << opt::snapshotPrefix << '-' << set
+		<< '-' << setfill('0') << setw(3) << rank << ".snapshot";
+	return s.str();
+}
+
+/** Write a snapshot of the assembly after the specified phase, if
+ * requested by the user.
+ */
+void NetworkSequenceCollection::controlSnapshot(const string& phase,
+		unsigned erosionSum, unsigned prunedSum)
+{
+	if (find(opt::snapshotPhases.begin(), opt::snapshotPhases.end(),
+				phase) == opt::snapshotPhases.end())
+		return;
+	cout << "Writing a snapshot after " << phase << "...\n";
+	SetState(NAS_SNAPSHOT);
+	m_comm.sendControlMessage(APC_SET_STATE, NAS_SNAPSHOT);
+
+	SnapshotManifest manifest;
+	manifest.phase = phase;
+	manifest.numProc = opt::numProc;
+	manifest.kmerSize = opt::kmerSize;
+	manifest.singleKmerSize = opt::singleKmerSize;
+	manifest.colourSpace = opt::colourSpace;
+	manifest.erode = opt::erode;
+	manifest.erodeStrand = opt::erodeStrand;
+	manifest.coverage = opt::coverage;
+	manifest.erosionSum = erosionSum;
+	manifest.prunedSum = prunedSum;
+	writeSnapshot(&manifest);
+	EndState();
+}
+
+/** Write the k-mer of this process to a new set of snapshot files.
+ * Once every process has written its file, the control process
+ * replaces the manifest, and the previous set of files is removed.
+ * Every process must call this function.
+ * @param manifest the state of the control process, or NULL
+ */
+void NetworkSequenceCollection::writeSnapshot(
+		SnapshotManifest* manifest)
+{
+	Timer timer("WriteSnapshot");
+	unsigned set = m_snapshotSet + 1;
+	writeSnapshotPartition(snapshotPath(set, opt::rank));
+	m_comm.barrier();
+
+	if (manifest != NULL) {
+		manifest->set = set;
+		string path = snapshotManifestPath();
+		string tmpPath = path + ".tmp";
+		ofstream out(tmpPath.c_str());
+		assert_good(out, tmpPath);
+		out << *manifest;
+		out.close();
+		assert_good(out, tmpPath);
+		if (rename(tmpPath.c_str(), path.c_str()) == -1) {
+			cerr << "error: renaming `" << tmpPath << "': "
+				<< strerror(errno) << endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	m_comm.barrier();
+
+	if (m_snapshotSet > 0) {
+		for (int i = opt::rank; i < m_snapshotNumProc;
+				i += opt::numProc)
+			unlink(snapshotPath(m_snapshotSet, i).c_str());
+	}
+	m_snapshotSet = set;
+	m_snapshotNumProc = opt::numProc;
+}
+
+/** Write the k-mer of this process to the specified file. */
+void NetworkSequenceCollection::writeSnapshotPartition(
+		const string& path) const
+{
+	size_t n = 0;
+	for (const_iterator it = m_data.begin(); it != m_data.end(); ++it)
+		if (!it->second.deleted())
+			n++;
+
+	ofstream out(path.c_str(), ios::binary);
+	assert_good(out, path);
+	out << "ABySS-P partition " << SNAPSHOT_VERSION << '\n'
+		<< V::serialSize() << ' ' << sizeof (mapped_type)
+		<< ' ' << n << '\n';
+	vector<char> key(V::serialSize());
+	for (const_iterator it = m_data.begin(); it != m_data.end(); ++it) {
+		if (it->second.deleted())
+			continue;
+		it->first.serialize(&key[0]);
+		out.write(&key[0], key.size());
+		out.write(reinterpret_cast<const char*>(&it->second),
+				sizeof it->second);
+	}
+	out.close();
+	assert_good(out, path);
+}
+
+/** Add the k-mer of the specified snapshot file that belong to this
+ * process.
+ */
+void NetworkSequenceCollection::readSnapshotPartition(
+		const string& path)
+{
+	ifstream in(path.c_str(), ios::binary);
+	assert_good(in, path);
+	unsigned version = 0, keySize = 0, dataSize = 0;
+	size_t n = 0;
+	in >> expect("ABySS-P partition ") >> version
+		>> keySize >> dataSize >> n >> expect("\n");
+	assert_good(in, path);
+	if (version != SNAPSHOT_VERSION || keySize != V::serialSize()
+			|| dataSize != sizeof (mapped_type)) {
+		cerr << "error: `" << path << "': the snapshot was written "
+			"by an incompatible version of " PACKAGE_NAME "\n";
+		exit(EXIT_FAILURE);
+	}
+
+	vector<char> key(keySize);
+	for (size_t i = 0; i < n; i++) {
+		V seq;
+		mapped_type data;
+		in.read(&key[0], key.size());
+		in.read(reinterpret_cast<char*>(&data), sizeof data);
+		assert_good(in, path);
+		seq.unserialize(&key[0]);
+		if (isLocal(seq))
+			m_data.insert(value_type(seq, data));
+	}
+}
+
+/** Load the latest complete set of snapshot files. The k-mer are
+ * divided among the processes afresh, so the number of processes
+ * may differ from that which wrote the snapshot.
+ * Every process must call this function.
+ * @return the state of the control process
+ */
+SnapshotManifest NetworkSequenceCollection::resume()
+{
+	Timer timer("Resume");
+	SnapshotManifest manifest;
+	string path = snapshotManifestPath();
+	ifstream in(path.c_str());
+	assert_good(in, path);
+	in >> manifest;
+	if (!in) {
+		cerr << "error: `" << path << "': the snapshot was written "
+			"by an incompatible version of " PACKAGE_NAME "\n";
+		exit(EXIT_FAILURE);
+	}
+	if (manifest.kmerSize != opt::kmerSize
+			|| manifest.singleKmerSize != opt::singleKmerSize) {
+		cerr << "error: `" << path << "': the snapshot was written "
+			"with a different k-mer size\n";
+		exit(EXIT_FAILURE);
 	}
+	if (opt::rank == 0)
+		cout << "Resuming from the snapshot written by "
+			<< manifest.numProc << " processes after "
+			<< manifest.phase << "...\n";
+
+	m_data.setColourSpace(manifest.colourSpace);
+	opt::erode = manifest.erode;
+	opt::erodeStrand = manifest.erodeStrand;
+	opt::coverage = manifest.coverage;
+
+	// Read the files of the processes that owned a bucket that this
+	// process now owns.
+	vector<bool> owners(manifest.numProc);
+	for (unsigned bucket = 0; bucket < NUM_BUCKETS; bucket++)
+		if (bucketNodeID(bucket, opt::numProc) == opt::rank)
+			owners[bucketNodeID(bucket, manifest.numProc)] = true;
+	for (int i = 0; i < manifest.numProc; i++)
+		if (owners[i])
+			readSnapshotPartition(snapshotPath(manifest.set, i));
+
+	logger(0) << "Loaded " << m_data.size() << " k-mer.\n";
+	m_data.setDeletedKey();
+	m_data.shrink();
+	size_t numLoaded = m_comm.reduce(m_data.size());
+	if (opt::rank == 0)
+		cout << "Loaded " << numLoaded << " k-mer.\n";
+	reportLoadBalance("resuming");
+
+	m_snapshotSet = manifest.set;
+	m_snapshotNumProc = manifest.numProc;
+	return manifest;
 }
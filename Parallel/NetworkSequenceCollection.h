@@ -4,6 +4,7 @@
 #include "CommLayer.h"
 #include "MessageBuffer.h"
 #include "SequenceCollection.h"
+#include "Snapshot.h"
 #include "Assembly/BranchGroup.h"
 #include "Common/Timer.h"
 #include "DataLayer/FastaWriter.h"
@@ -12,6 +13,10 @@
 #include <utility>
 #include "Common/InsOrderedMap.h"
 
+#if _OPENMP
+# include <omp.h>
+#endif
+
 namespace NSC
 {
 	typedef InsOrderedMap<std::string, int> dbMap;
@@ -38,6 +43,7 @@ enum NetworkAssemblyState
 	NAS_CLEAR_FLAGS, // clear the flags
 	NAS_ASSEMBLE, // assembling the data
 	NAS_ASSEMBLE_COMPLETE, // assembling is complete
+	NAS_SNAPSHOT, // write a snapshot of the assembly
 	NAS_WAITING, // non-control process is waiting
 	NAS_DONE // finished, clean up and exit
 };
@@ -65,7 +71,21 @@ class NetworkSequenceCollection
 
 		NetworkSequenceCollection()
 			: m_state(NAS_WAITING), m_trimStep(0),
-			m_numPopped(0), m_numAssembled(0) { }
+			m_numPopped(0), m_numAssembled(0),
+			m_reportedMessages(0), m_reportedIdleTime(0),
+			m_snapshotSet(0), m_snapshotNumProc(0)
+		{
+#if _OPENMP
+			omp_init_nest_lock(&m_commLock);
+#endif
+		}
+
+		~NetworkSequenceCollection()
+		{
+#if _OPENMP
+			omp_destroy_nest_lock(&m_commLock);
+#endif
+		}
 
 		size_t performNetworkTrim();
 
@@ -88,7 +108,7 @@ class NetworkSequenceCollection
 				FastaWriter* fileWriter = NULL);
 
 		void add(const V& seq, unsigned coverage = 1);
-		void remove(const V& seq);
+		bool remove(const V& seq);
 		void setFlag(const V& seq, SeqFlag flag);
 
 		/** Mark the specified sequence in both directions. */
@@ -122,6 +142,7 @@ class NetworkSequenceCollection
 
 		// Receive and dispatch packets.
 		size_t pumpNetwork();
+		size_t pumpNetworkWaiting();
 		size_t pumpFlushReduce();
 
 		void completeOperation();
@@ -143,6 +164,7 @@ class NetworkSequenceCollection
 		void handle(int senderID, const RemoveExtensionMessage& m);
 		void handle(int senderID, const SeqDataRequest& message);
 		void handle(int senderID, const SeqDataResponse& message);
+		void handle(int senderID, const char* buffer, size_t size);
 
 		/** The observer callback function. */
 		typedef void (*SeqObserver)(SequenceCollectionHash* c,
@@ -207,12 +229,51 @@ class NetworkSequenceCollection
 		bool isBranchRedundant(const BranchRecord& branch);
 
 		void parseControlMessage(int source);
+		size_t receiveMessages();
+
+		/** Acquire exclusive use of m_comm. The worker threads of
+		 * this process share one communication layer. */
+		void lockComm()
+		{
+#if _OPENMP
+			omp_set_nest_lock(&m_commLock);
+#endif
+		}
+
+		/** Try to acquire exclusive use of m_comm.
+		 * @return false if another thread is using it
+		 */
+		bool tryLockComm()
+		{
+#if _OPENMP
+			return omp_test_nest_lock(&m_commLock);
+#else
+			return true;
+#endif
+		}
+
+		/** Release m_comm. */
+		void unlockComm()
+		{
+#if _OPENMP
+			omp_unset_nest_lock(&m_commLock);
+#endif
+		}
 
 		bool isLocal(const V& seq) const;
 		int computeNodeID(const V& seq) const;
 
 		void EndState();
 
+		void reportLoadBalance(const char* phase);
+
+		void controlSnapshot(const std::string& phase,
+				unsigned erosionSum, unsigned prunedSum);
+		void writeSnapshot(SnapshotManifest* manifest);
+		void writeSnapshotPartition(const std::string& path) const;
+		void readSnapshotPartition(const std::string& path);
+		SnapshotManifest resume();
+
 		// Set the state of the network assembly
 		void SetState(NetworkAssemblyState newState);
 
@@ -222,6 +283,11 @@ class NetworkSequenceCollection
 		// network.
 		MessageBuffer m_comm;
 
+#if _OPENMP
+		/** Serializes the use of m_comm by multiple threads. */
+		omp_nest_lock_t m_commLock;
+#endif
+
 		// The number of nodes in the network
 		unsigned m_numDataNodes;
 
@@ -256,6 +322,20 @@ class NetworkSequenceCollection
 		// the number of sequences assembled so far
 		size_t m_numAssembled;
 
+		/** The number of messages sent as of the last load balance
+		 * report. */
+		uint64_t m_reportedMessages;
+
+		/** The idle time as of the last load balance report. */
+		double m_reportedIdleTime;
+
+		/** The serial number of the latest set of snapshot files. */
+		unsigned m_snapshotSet;
+
+		/** The number of processes that wrote the latest set of
+		 * snapshot files. */
+		int m_snapshotNumProc;
+
 		// The current branches that are active
 		BranchGroupMap m_activeBranchGroups;
 
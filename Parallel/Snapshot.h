@@ -0,0 +1,88 @@
+#ifndef PARALLEL_SNAPSHOT_H
+#define PARALLEL_SNAPSHOT_H 1
+
+#include "Common/IOUtil.h"
+#include <cassert>
+#include <istream>
+#include <ostream>
+#include <string>
+
+/** The version of the snapshot file format. */
+static const unsigned SNAPSHOT_VERSION = 1;
+
+/** The state of the assembly recorded by a set of snapshot files.
+ * The control process writes this manifest once every process has
+ * written its snapshot file, so the manifest names the latest
+ * complete set of snapshot files.
+ */
+struct SnapshotManifest
+{
+	/** The serial number of the set of snapshot files. */
+	unsigned set;
+
+	/** The phase of the assembly after which the snapshot was
+	 * written. */
+	std::string phase;
+
+	/** The number of processes that wrote the snapshot. */
+	int numProc;
+
+	unsigned kmerSize;
+	unsigned singleKmerSize;
+	bool colourSpace;
+
+	/** The parameters determined from the coverage histogram. */
+	unsigned erode;
+	unsigned erodeStrand;
+	float coverage;
+
+	/** The number of tips eroded and pruned so far. */
+	unsigned erosionSum;
+	unsigned prunedSum;
+
+	SnapshotManifest()
+		: set(0), numProc(0), kmerSize(0), singleKmerSize(0),
+		colourSpace(false), erode(0), erodeStrand(0), coverage(0),
+		erosionSum(0), prunedSum(0) { }
+
+	friend std::ostream& operator<<(std::ostream& out,
+			const SnapshotManifest& o)
+	{
+		return out << "ABySS-P snapshot " << SNAPSHOT_VERSION << '\n'
+			<< "set " << o.set << '\n'
+			<< "phase " << o.phase << '\n'
+			<< "numProc " << o.numProc << '\n'
+			<< "kmerSize " << o.kmerSize << '\n'
+			<< "singleKmerSize " << o.singleKmerSize << '\n'
+			<< "colourSpace " << o.colourSpace << '\n'
+			<< "erode " << o.erode << '\n'
+			<< "erodeStrand " << o.erodeStrand << '\n'
+			<< "coverage " << o.coverage << '\n'
+			<< "erosionSum " << o.erosionSum << '\n'
+			<< "prunedSum " << o.prunedSum << '\n';
+	}
+
+	friend std::istream& operator>>(std::istream& in,
+			SnapshotManifest& o)
+	{
+		unsigned version = 0;
+		in >> expect("ABySS-P snapshot ") >> version;
+		if (in && version != SNAPSHOT_VERSION) {
+			in.setstate(std::ios::failbit);
+			return in;
+		}
+		return in >> expect(" set ") >> o.set
+			>> expect(" phase ") >> o.phase
+			>> expect(" numProc ") >> o.numProc
+			>> expect(" kmerSize ") >> o.kmerSize
+			>> expect(" singleKmerSize ") >> o.singleKmerSize
+			>> expect(" colourSpace ") >> o.colourSpace
+			>> expect(" erode ") >> o.erode
+			>> expect(" erodeStrand ") >> o.erodeStrand
+			>> expect(" coverage ") >> o.coverage
+			>> expect(" erosionSum ") >> o.erosionSum
+			>> expect(" prunedSum ") >> o.prunedSum;
+	}
+};
+
+#endif
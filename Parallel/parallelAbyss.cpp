@@ -74,7 +74,10 @@ int main(int argc, char** argv)
 	// Set stdout to be line buffered.
 	setvbuf(stdout, NULL, _IOLBF, 0);
 
-	MPI_Init(&argc,&argv);
+	// The worker threads of a process take turns calling MPI.
+	int threadSupport;
+	MPI_Init_thread(&argc, &argv,
+			MPI_THREAD_SERIALIZED, &threadSupport);
 	MPI_Comm_rank(MPI_COMM_WORLD, &opt::rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &opt::numProc);
 
@@ -86,6 +89,12 @@ int main(int argc, char** argv)
 	opt::singleKmerSize = -1;
 #endif
 	opt::parse(argc, argv);
+	if (opt::threads > 1 && threadSupport < MPI_THREAD_SERIALIZED) {
+		if (opt::rank == 0)
+			cerr << "warning: the MPI library does not support "
+				"threads; ignoring -j,--threads\n";
+		opt::threads = 1;
+	}
 	if (opt::rank == 0)
 		cout << "Running on " << opt::numProc << " processors\n";
 
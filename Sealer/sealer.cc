@@ -8,7 +8,9 @@
 #include "Konnector/konnector.h"
 #include "Konnector/DBGBloom.h"
 #include "Konnector/DBGBloomAlgorithms.h"
+#include "Bloom/BlockedBloomFilter.h"
 #include "Bloom/CascadingBloomFilter.h"
+#include "Bloom/MappedBloomFilter.h"
 
 #include "Align/alignGlobal.h"
 #include "Common/IOUtil.h"
@@ -30,6 +32,7 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <vector>
 
 
 #if _OPENMP
@@ -82,6 +85,9 @@ static const char USAGE_MESSAGE[] =
 "  -f, --min-frag=N             min fragment size in base pairs [0]\n"
 "  -F, --max-frag=N             max fragment size in base pairs [1000]\n"
 "  -i, --input-bloom=FILE       load bloom filter from FILE\n"
+"      --single-pass            build the bloom filters of all k values\n"
+"                               in one pass over the reads, which needs\n"
+"                               the memory of all of them at once\n"
 "      --mask                   mask new and changed bases as lower case\n"
 "      --no-mask                do not mask bases [default]\n"
 "      --chastity               discard unchaste reads [default]\n"
@@ -197,6 +203,9 @@ namespace opt {
 
 	/** Output detailed stats */
 	static int detailedStats = 0;
+
+	/** Build the bloom filters of all k values in one pass */
+	static int singlePass = 0;
 }
 
 /** Counters */
@@ -216,6 +225,33 @@ struct Counters {
 	size_t readPairsProcessed;
 	size_t readPairsMerged;
 	size_t skipped;
+
+	Counters()
+		: noStartOrGoalKmer(0), noPath(0), uniquePath(0),
+		multiplePaths(0), tooManyPaths(0), tooManyBranches(0),
+		tooManyMismatches(0), tooManyReadMismatches(0),
+		containsCycle(0), exceededMemLimit(0),
+		traversalMemExceeded(0), readPairsProcessed(0),
+		readPairsMerged(0), skipped(0) { }
+
+	Counters& operator+=(const Counters& o)
+	{
+		noStartOrGoalKmer += o.noStartOrGoalKmer;
+		noPath += o.noPath;
+		uniquePath += o.uniquePath;
+		multiplePaths += o.multiplePaths;
+		tooManyPaths += o.tooManyPaths;
+		tooManyBranches += o.tooManyBranches;
+		tooManyMismatches += o.tooManyMismatches;
+		tooManyReadMismatches += o.tooManyReadMismatches;
+		containsCycle += o.containsCycle;
+		exceededMemLimit += o.exceededMemLimit;
+		traversalMemExceeded += o.traversalMemExceeded;
+		readPairsProcessed += o.readPairsProcessed;
+		readPairsMerged += o.readPairsMerged;
+		skipped += o.skipped;
+		return *this;
+	}
 };
 
 static const char shortopts[] = "S:L:D:b:B:d:ef:F:i:Ij:k:lm:M:no:P:q:r:s:t:v";
@@ -225,6 +261,7 @@ enum { OPT_HELP = 1, OPT_VERSION };
 static const struct option longopts[] = {
 	{ "detailed-stats",   no_argument, &opt::detailedStats, 1},
 	{ "print-flanks",     no_argument, &opt::printFlanks, 1},
+	{ "single-pass",      no_argument, &opt::singlePass, 1},
 	{ "input-scaffold",   required_argument, NULL, 'S' },
 	{ "flank-length",     required_argument, NULL, 'L' },
 	{ "flank-distance",   required_argument, NULL, 'D' },
@@ -393,6 +430,8 @@ string IntToString (int a)
 }
 
 // returns merged sequence resulting from Konnector
+// g_count and context are the counters and search state of the
+// calling thread
 template <typename Graph>
 string merge(const Graph& g,
 	unsigned k,
@@ -401,9 +440,11 @@ string merge(const Graph& g,
 	FastaRecord &read2,
 	const ConnectPairsParams& params,
 	Counters& g_count,
+	BidiBFSContext<Graph>& context,
 	ofstream& traceStream)
 {
-	ConnectPairsResult result = connectPairs(k, read1, read2, g, params);
+	ConnectPairsResult result = connectPairs(k, read1, read2, g, params,
+			context);
 	ostringstream ss;
 	ss << result.readNamePrefix << '_' << gap.gapStart() << '_' << gap.gapSize();
 	result.readNamePrefix = ss.str();
@@ -421,10 +462,8 @@ string merge(const Graph& g,
 		case NO_PATH:
 			assert(paths.empty());
 			if (result.foundStartKmer && result.foundGoalKmer)
-#pragma omp atomic
 				++g_count.noPath;
 			else {
-#pragma omp atomic
 				++g_count.noStartOrGoalKmer;
 			}
 			break;
@@ -434,39 +473,31 @@ string merge(const Graph& g,
 			if (result.pathMismatches > params.maxPathMismatches ||
 					result.readMismatches > params.maxReadMismatches) {
 				if (result.pathMismatches > params.maxPathMismatches)
-#pragma omp atomic
 					++g_count.tooManyMismatches;
 				else
-#pragma omp atomic
 					++g_count.tooManyReadMismatches;
 			}
 			else if (paths.size() > 1) {
-#pragma omp atomic
 				++g_count.multiplePaths;
 			}
 			else {
-#pragma omp atomic
 				++g_count.uniquePath;
 			}
 			break;
 
 		case TOO_MANY_PATHS:
-#pragma omp atomic
 			++g_count.tooManyPaths;
 			break;
 
 		case TOO_MANY_BRANCHES:
-#pragma omp atomic
 			++g_count.tooManyBranches;
 			break;
 
 		case PATH_CONTAINS_CYCLE:
-#pragma omp atomic
 			++g_count.containsCycle;
 			break;
 
 		case EXCEEDED_MEM_LIMIT:
-#pragma omp atomic
 			++g_count.exceededMemLimit;
 			break;
 	}
@@ -556,54 +587,62 @@ void kRun(const ConnectPairsParams& params,
 	ofstream &logStream,
 	ofstream &traceStream)
 {
-	map<FastaRecord, map<FastaRecord, Gap> >::iterator read1_it;
-	map<FastaRecord, Gap>::iterator read2_it;
+	typedef map<FastaRecord, map<FastaRecord, Gap> >::iterator
+		Read1Iterator;
+	typedef map<FastaRecord, Gap>::const_iterator Read2Iterator;
 	unsigned uniqueGapsClosed = 0;
-	bool success;
 
 	Counters g_count;
-	g_count.noStartOrGoalKmer = 0;
-	g_count.noPath = 0;
-	g_count.uniquePath = 0;
-	g_count.multiplePaths = 0;
-	g_count.tooManyPaths = 0;
-	g_count.tooManyBranches = 0;
-	g_count.tooManyMismatches = 0;
-	g_count.tooManyReadMismatches = 0;
-	g_count.containsCycle = 0;
-	g_count.exceededMemLimit = 0;
-	g_count.traversalMemExceeded = 0;
-	g_count.readPairsProcessed = 0;
-	g_count.readPairsMerged = 0;
-	g_count.skipped = 0;
 
 	printLog(logStream, "Flanks inserted into k run = " + IntToString(flanks.size()) + "\n");
 
-	for (read1_it = flanks.begin(); read1_it != flanks.end();) {
-		success = false;
-		FastaRecord read1 = read1_it->first;
-		for (read2_it = flanks[read1].begin(); read2_it != flanks[read1].end(); read2_it++) {
-			FastaRecord read2 = read2_it->first;
-
-			int startposition = read2_it->second.gapStart();
-			string tempSeq = merge(g, k, read2_it->second, read1, read2, params, g_count, traceStream);
-			if (!tempSeq.empty()) {
-				success = true;
-				allmerged[read1.id.substr(0,read1.id.length()-2)][startposition]
-					= ClosedGap(read2_it->second, tempSeq);
-//#pragma omp atomic
-				gapsclosed++;
-//#pragma omp atomic
-				uniqueGapsClosed++;
-				if (gapsclosed % 100 == 0)
-					printLog(logStream, IntToString(gapsclosed) + " gaps closed so far\n");
-			}
+	// List the gaps in order, so that the results may be collected
+	// in the same order regardless of the number of threads.
+	vector<pair<Read1Iterator, Read2Iterator> > gaps;
+	for (Read1Iterator read1_it = flanks.begin();
+			read1_it != flanks.end(); ++read1_it)
+		for (Read2Iterator read2_it = read1_it->second.begin();
+				read2_it != read1_it->second.end(); ++read2_it)
+			gaps.push_back(make_pair(read1_it, read2_it));
+
+	// Close the gaps. The time to close a gap varies widely, so
+	// distribute them dynamically.
+	vector<string> mergedSeqs(gaps.size());
+#pragma omp parallel
+	{
+		Counters count;
+		BidiBFSContext<Graph> context(g);
+#pragma omp for schedule(dynamic)
+		for (ptrdiff_t i = 0; i < (ptrdiff_t)gaps.size(); i++) {
+			FastaRecord read1 = gaps[i].first->first;
+			FastaRecord read2 = gaps[i].second->first;
+			mergedSeqs[i] = merge(g, k, gaps[i].second->second,
+					read1, read2, params, count, context, traceStream);
 		}
-		if (success) {
-			flanks.erase(read1_it++);
+#pragma omp critical(g_count)
+		g_count += count;
+	}
+
+	// Collect the closed gaps in order.
+	for (size_t i = 0; i < gaps.size();) {
+		Read1Iterator read1_it = gaps[i].first;
+		bool success = false;
+		for (; i < gaps.size() && gaps[i].first == read1_it; i++) {
+			const string& tempSeq = mergedSeqs[i];
+			if (tempSeq.empty())
+				continue;
+			const FastaRecord& read1 = read1_it->first;
+			const Gap& gap = gaps[i].second->second;
+			success = true;
+			allmerged[read1.id.substr(0,read1.id.length()-2)][gap.gapStart()]
+				= ClosedGap(gap, tempSeq);
+			gapsclosed++;
+			uniqueGapsClosed++;
+			if (gapsclosed % 100 == 0)
+				printLog(logStream, IntToString(gapsclosed) + " gaps closed so far\n");
 		}
-		else
-			read1_it++;
+		if (success)
+			flanks.erase(read1_it);
 	}
 
 	printLog(logStream, IntToString(uniqueGapsClosed) + " unique gaps closed for k" + IntToString(k) + "\n");
@@ -927,33 +966,86 @@ int main(int argc, char** argv)
 	map<string, map<int, ClosedGap> > allmerged;
 	unsigned gapsclosed=0;
 
+	/** bloom filters built in one pass, indexed like kvector */
+	vector<CascadingBloomFilter*> builtBlooms(opt::kvector.size());
+	if (opt::singlePass
+			&& opt::bloomFilterPaths.size() < opt::kvector.size()) {
+		vector<unsigned> ks;
+		vector<CascadingBloomFilter*> blooms;
+		size_t bits = opt::bloomSize * 8 / 2;
+		for (unsigned i = opt::bloomFilterPaths.size();
+				i < opt::kvector.size(); i++) {
+			ks.push_back(opt::kvector[i]);
+			builtBlooms[i] = new CascadingBloomFilter(bits, opt::max_count);
+			blooms.push_back(builtBlooms[i]);
+		}
+
+		temp = "Building bloom filters for " + IntToString(ks.size())
+			+ " k values in one pass\n";
+		printLog(logStream, temp);
+#ifdef _OPENMP
+		vector<ConcurrentBloomFilter<CascadingBloomFilter>*> cbfs;
+		for (unsigned i = 0; i < blooms.size(); i++)
+			cbfs.push_back(
+				new ConcurrentBloomFilter<CascadingBloomFilter>(*blooms[i]));
+		for (int i = optind; i < argc; i++)
+			Bloom::loadFileMultiK(cbfs, ks, argv[i], 0 /*opt::verbose*/);
+		for (unsigned i = 0; i < cbfs.size(); i++)
+			delete cbfs[i];
+#else
+		for (int i = optind; i < argc; i++)
+			Bloom::loadFileMultiK(blooms, ks, argv[i], 0 /*opt::verbose*/);
+#endif
+	}
+
 	for (unsigned i = 0; i<opt::kvector.size(); i++) {
 		opt::k = opt::kvector.at(i);
 		Kmer::setLength(opt::k);
 
-		BloomFilter* bloom;
+		BloomFilter* bloom = NULL;
 		CascadingBloomFilter* cascadingBloom = NULL;
+		MappedBloomFilter mappedBloom;
 
-		if (!opt::bloomFilterPaths.empty() && i <= opt::bloomFilterPaths.size()) {
+		BloomFilter* loadedBloom = NULL;
+		BlockedBloomFilter* blockedBloom = NULL;
 
-			temp = "Loading bloom filter from `" + opt::bloomFilterPaths.at(i) + "'...\n";
+		if (i < opt::bloomFilterPaths.size()
+				&& MappedBloomFilter::isMappable(opt::bloomFilterPaths.at(i))) {
+
+			temp = "Mapping bloom filter from `" + opt::bloomFilterPaths.at(i) + "'...\n";
 			printLog(logStream, temp);
 
-			bloom = new BloomFilter();
+			mappedBloom.open(opt::bloomFilterPaths.at(i));
+		} else if (i < opt::bloomFilterPaths.size()) {
+
+			temp = "Loading bloom filter from `" + opt::bloomFilterPaths.at(i) + "'...\n";
+			printLog(logStream, temp);
 
 			const char* inputPath = opt::bloomFilterPaths.at(i).c_str();
-			ifstream inputBloom(inputPath, ios_base::in | ios_base::binary);
+			// Uncompress hooks only the opening of a file for reading in
+			// text mode, which on POSIX is the same as binary mode.
+			ifstream inputBloom(inputPath);
 			assert_good(inputBloom, inputPath);
-			inputBloom >> *bloom;
+			if (inputBloom.peek()
+					== '0' + (int)Bloom::BLOCKED_BLOOM_VERSION) {
+				blockedBloom = new BlockedBloomFilter();
+				inputBloom >> *blockedBloom;
+			} else {
+				bloom = loadedBloom = new BloomFilter();
+				inputBloom >> *bloom;
+			}
 			assert_good(inputBloom, inputPath);
 			inputBloom.close();
+		} else if (builtBlooms[i] != NULL) {
+			cascadingBloom = builtBlooms[i];
+			bloom = &cascadingBloom->getBloomFilter(opt::max_count - 1);
 		} else {
 			printLog(logStream, "Building bloom filter\n");
 
 			size_t bits = opt::bloomSize * 8 / 2;
 			cascadingBloom = new CascadingBloomFilter(bits, opt::max_count);
 #ifdef _OPENMP
-			ConcurrentBloomFilter<CascadingBloomFilter> cbf(*cascadingBloom, 1000);
+			ConcurrentBloomFilter<CascadingBloomFilter> cbf(*cascadingBloom);
 			for (int i = optind; i < argc; i++)
 				Bloom::loadFile(cbf, opt::k, argv[i], 0 /*opt::verbose*/);
 #else
@@ -963,21 +1055,27 @@ int main(int argc, char** argv)
 			bloom = &cascadingBloom->getBloomFilter(opt::max_count - 1);
 		}
 
-		DBGBloom<BloomFilter> g(*bloom);
-
 		temp = "Starting K run with k = " + IntToString(opt::k) + "\n";
 		printLog(logStream, temp);
 
-		kRun(params, opt::k, g, allmerged, flanks, gapsclosed, logStream, traceStream);
+		if (bloom != NULL) {
+			DBGBloom<BloomFilter> g(*bloom);
+			kRun(params, opt::k, g, allmerged, flanks, gapsclosed, logStream, traceStream);
+		} else if (blockedBloom != NULL) {
+			DBGBloom<BlockedBloomFilter> g(*blockedBloom);
+			kRun(params, opt::k, g, allmerged, flanks, gapsclosed, logStream, traceStream);
+		} else {
+			DBGBloom<MappedBloomFilter> g(mappedBloom);
+			kRun(params, opt::k, g, allmerged, flanks, gapsclosed, logStream, traceStream);
+		}
 
 		temp = "k" + IntToString(opt::k) + " run complete\n"
 				+ "Total gaps closed so far = " + IntToString(gapsclosed) + "\n\n";
 		printLog(logStream, temp);
 
-		if (!opt::inputBloomPath.empty())
-			delete bloom;
-		else
-			delete cascadingBloom;
+		delete loadedBloom;
+		delete blockedBloom;
+		delete cascadingBloom;
 	}
 
 	printLog(logStream, "K sweep complete\nCreating new scaffold with gaps closed...\n");
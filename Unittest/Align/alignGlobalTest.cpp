@@ -0,0 +1,164 @@
+#include "Align/alignGlobal.h"
+#include "Align/smith_waterman.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+static const int MATCH = 5, MISMATCH = -4;
+static const int GAP_OPEN = -12, GAP_EXTEND = -4;
+
+/** Return a pseudo-random sequence of the specified length. */
+static string randomSeq(unsigned n, unsigned seed)
+{
+	string s;
+	for (unsigned i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		s += "ACGT"[(seed >> 16) & 3];
+	}
+	return s;
+}
+
+/** Return the score of the alignment of two sequences of ACGT. */
+static int scoreAlignment(const NWAlignment& aln)
+{
+	const string& a = aln.query_align;
+	const string& b = aln.target_align;
+	int score = 0;
+	for (unsigned i = 0; i < a.size(); i++) {
+		if (a[i] == '*' || b[i] == '*') {
+			bool extend = i > 0 && (a[i] == '*'
+				? a[i-1] == '*' : b[i-1] == '*');
+			score += extend ? GAP_EXTEND : GAP_OPEN;
+		} else
+			score += a[i] == b[i] ? MATCH : MISMATCH;
+	}
+	return score;
+}
+
+/** Return the score of the best global alignment of two sequences
+ * of ACGT, calculated over the entire matrix. */
+static int bestScore(const string& a, const string& b)
+{
+	const int NEG = INT_MIN/2;
+	unsigned n = a.size(), m = b.size();
+	vector< vector<int> > f(n + 1, vector<int>(m + 1)),
+		g(f), h(f);
+	for (unsigned i = 0; i <= n; i++) {
+		f[i][0] = i == 0 ? 0 : GAP_OPEN + GAP_EXTEND * ((int)i - 1);
+		h[i][0] = NEG;
+	}
+	for (unsigned j = 0; j <= m; j++) {
+		f[0][j] = j == 0 ? 0 : GAP_OPEN + GAP_EXTEND * ((int)j - 1);
+		g[0][j] = NEG;
+	}
+	for (unsigned i = 1; i <= n; i++) {
+		for (unsigned j = 1; j <= m; j++) {
+			g[i][j] = max(f[i-1][j] + GAP_OPEN,
+					g[i-1][j] + GAP_EXTEND);
+			h[i][j] = max(f[i][j-1] + GAP_OPEN,
+					h[i][j-1] + GAP_EXTEND);
+			f[i][j] = max(f[i-1][j-1]
+					+ (a[i-1] == b[j-1] ? MATCH : MISMATCH),
+					max(g[i][j], h[i][j]));
+		}
+	}
+	return f[n][m];
+}
+
+/** Remove the gaps from an aligned sequence. */
+static string ungap(string s)
+{
+	s.erase(remove(s.begin(), s.end(), '*'), s.end());
+	return s;
+}
+
+TEST(alignGlobal, identical)
+{
+	NWAlignment aln;
+	EXPECT_EQ(8U, alignGlobal("ACGTACGT", "ACGTACGT", aln));
+	EXPECT_EQ("ACGTACGT", aln.match_align);
+}
+
+TEST(alignGlobal, ambiguity)
+{
+	NWAlignment aln;
+	EXPECT_EQ(8U, alignGlobal("ACGTACGT", "ACGTRCGT", aln));
+	EXPECT_EQ("ACGTRCGT", aln.match_align);
+
+	EXPECT_EQ(7U, alignGlobal("ACGTACGT", "ACGTTCGT", aln));
+	EXPECT_EQ("ACGTWCGT", aln.match_align);
+}
+
+/** A gap within a run of a repeated base is placed at the start of
+ * the run. */
+TEST(alignGlobal, gap)
+{
+	NWAlignment aln;
+	EXPECT_EQ(16U, alignGlobal("ACGTACGTTTGCATGCAA",
+				"ACGTACGTGCATGCAA", aln));
+	EXPECT_EQ("ACGTACGTTTGCATGCAA", aln.query_align);
+	EXPECT_EQ("ACGTACG**TGCATGCAA", aln.target_align);
+	EXPECT_EQ("ACGTACGttTGCATGCAA", aln.match_align);
+}
+
+TEST(alignGlobal, empty)
+{
+	NWAlignment aln;
+	EXPECT_EQ(0U, alignGlobal("", "ACG", aln));
+	EXPECT_EQ("***", aln.query_align);
+	EXPECT_EQ("acg", aln.match_align);
+	EXPECT_EQ(0U, alignGlobal("AC", "", aln));
+	EXPECT_EQ("ac", aln.match_align);
+}
+
+/** A deletion followed by an insertion of the same length leaves
+ * the end of the alignment on the main diagonal, but its path
+ * leaves the initial band. */
+TEST(alignGlobal, wideBand)
+{
+	string a = randomSeq(400, 1);
+	string b = a.substr(0, 100) + a.substr(160, 140)
+		+ randomSeq(60, 2) + a.substr(300);
+	NWAlignment aln;
+	alignGlobal(a, b, aln);
+	EXPECT_EQ(a, ungap(aln.query_align));
+	EXPECT_EQ(b, ungap(aln.target_align));
+	EXPECT_EQ(bestScore(a, b), scoreAlignment(aln));
+}
+
+TEST(alignGlobal, unrelated)
+{
+	string a = randomSeq(150, 3), b = randomSeq(120, 4);
+	NWAlignment aln;
+	alignGlobal(a, b, aln);
+	EXPECT_EQ(a, ungap(aln.query_align));
+	EXPECT_EQ(b, ungap(aln.target_align));
+	EXPECT_EQ(bestScore(a, b), scoreAlignment(aln));
+}
+
+TEST(alignOverlap, overlap)
+{
+	vector<overlap_align> overlaps;
+	alignOverlap("AAAACCCCGGGG", "CCGGGGTTTT", 0, overlaps,
+			false, false);
+	ASSERT_EQ(1U, overlaps.size());
+	EXPECT_EQ(6U, overlaps[0].overlap_t_pos);
+	EXPECT_EQ(5U, overlaps[0].overlap_h_pos);
+	EXPECT_EQ("CCGGGG", overlaps[0].overlap_str);
+	EXPECT_EQ(6U, overlaps[0].overlap_match);
+}
+
+TEST(alignOverlap, none)
+{
+	vector<overlap_align> overlaps;
+	alignOverlap("AAAAAAAA", "TTTTTTTT", 0, overlaps, true, false);
+	EXPECT_TRUE(overlaps.empty());
+}
+
+}
@@ -0,0 +1,102 @@
+/**
+ * Compare the throughput of extracting the k-mer of reads by copying
+ * and packing each k-mer with that of rolling from one k-mer to the
+ * next using KmerIterator.
+ * Usage: common_KmerIteratorBench [k] [numReads] [readLength]
+ */
+#include "Common/KmerIterator.h"
+#include "Common/Kmer.h"
+#include "Common/Sequence.h"
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Return pseudo-random reads of the specified length. */
+static vector<Sequence> randomReads(unsigned n, unsigned length)
+{
+	unsigned seed = 1;
+	vector<Sequence> reads(n);
+	for (unsigned i = 0; i < n; i++) {
+		for (unsigned j = 0; j < length; j++) {
+			seed = seed * 1103515245 + 12345;
+			reads[i] += "ACGT"[(seed >> 16) & 3];
+		}
+		// A few reads contain an ambiguous base.
+		if (i % 16 == 0)
+			reads[i][length / 2] = 'N';
+	}
+	return reads;
+}
+
+/** Extract each k-mer by copying it into a new string and packing it.
+ * @return the number of k-mer
+ */
+static size_t copyKmers(const vector<Sequence>& reads, unsigned k,
+		unsigned& checksum)
+{
+	size_t n = 0;
+	for (vector<Sequence>::const_iterator it = reads.begin();
+			it != reads.end(); ++it) {
+		for (unsigned i = 0; i + k <= it->size(); i++) {
+			Sequence kmer(*it, i, k);
+			if (kmer.find_first_not_of("ACGT") != string::npos)
+				continue;
+			Kmer u(kmer);
+			Kmer v = reverseComplement(u);
+			checksum += (v < u ? v : u).getCode();
+			n++;
+		}
+	}
+	return n;
+}
+
+/** Extract each k-mer by rolling from one k-mer to the next.
+ * @return the number of k-mer
+ */
+static size_t rollKmers(const vector<Sequence>& reads, unsigned k,
+		unsigned& checksum)
+{
+	size_t n = 0;
+	for (vector<Sequence>::const_iterator it = reads.begin();
+			it != reads.end(); ++it) {
+		for (KmerIterator kit(*it, k);
+				kit != KmerIterator::end(); ++kit) {
+			checksum += kit.canonical().getCode();
+			n++;
+		}
+	}
+	return n;
+}
+
+/** Print the throughput of the specified method. */
+static void report(const char* method, size_t n, clock_t start,
+		unsigned checksum)
+{
+	double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+	cout << method << '\t' << n << " k-mer\t" << seconds << " s\t"
+		<< n / seconds / 1e6 << " M k-mer/s\t" << checksum << '\n';
+}
+
+int main(int argc, char** argv)
+{
+	unsigned k = argc > 1 ? atoi(argv[1]) : 25;
+	unsigned numReads = argc > 2 ? atoi(argv[2]) : 100000;
+	unsigned length = argc > 3 ? atoi(argv[3]) : 100;
+	Kmer::setLength(k);
+	vector<Sequence> reads = randomReads(numReads, length);
+
+	unsigned checksum = 0;
+	clock_t start = clock();
+	size_t n = copyKmers(reads, k, checksum);
+	report("copy", n, start, checksum);
+
+	checksum = 0;
+	start = clock();
+	n = rollKmers(reads, k, checksum);
+	report("roll", n, start, checksum);
+	return 0;
+}
@@ -46,3 +46,40 @@ TEST(KmerIteratorTest, SeqLengthMuchLessThanK)
 	KmerIterator i("AG", k);
 	ASSERT_EQ(KmerIterator::end(), i);
 }
+
+TEST(KmerIteratorTest, ReverseComplement)
+{
+	unsigned k = 5;
+	Kmer::setLength(k);
+	Sequence seq("ACGGTNACCTAGCAT");
+	KmerIterator it(seq, k), rc(seq, k, true);
+	for (; it != KmerIterator::end(); ++it, ++rc) {
+		ASSERT_NE(KmerIterator::end(), rc);
+		Sequence s = seq.substr(it.pos(), k);
+		EXPECT_EQ(Kmer(s), *it);
+		EXPECT_EQ(Kmer(reverseComplement(s)), *rc);
+		Kmer canonical(s);
+		canonical.canonicalize();
+		EXPECT_EQ(canonical, it.canonical());
+	}
+	EXPECT_EQ(KmerIterator::end(), rc);
+}
+
+TEST(KmerIteratorTest, Masked)
+{
+	unsigned k = 3;
+	Kmer::setLength(k);
+	KmerIterator it("ACgTAC", k);
+	EXPECT_TRUE(it.masked());
+	EXPECT_EQ(Kmer("ACG"), *it);
+	++it;
+	EXPECT_TRUE(it.masked());
+	++it;
+	EXPECT_TRUE(it.masked());
+	++it;
+	EXPECT_FALSE(it.masked());
+	EXPECT_EQ(Kmer("TAC"), *it);
+	EXPECT_EQ((size_t)3, it.pos());
+	++it;
+	EXPECT_EQ(KmerIterator::end(), it);
+}
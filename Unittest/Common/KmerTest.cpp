@@ -1,5 +1,6 @@
 #include "Common/Kmer.h"
 #include <gtest/gtest.h>
+#include <cstdlib>
 #include <iostream>
 
 TEST(Kmer, canonicalize)
@@ -30,3 +31,62 @@ TEST(Kmer, canonicalize)
 	EXPECT_EQ(oddLengthCanonical, kmer);
 }
 
+TEST(Kmer, getCode)
+{
+	Kmer::setLength(19);
+	Kmer kmer("ACGTTGCAAGCTAGCCTAG");
+	Kmer rc = kmer;
+	rc.reverseComplement();
+	EXPECT_EQ(kmer.getCode(), rc.getCode());
+
+	// The low bits of the code are uniformly distributed.
+	srand(1);
+	unsigned counts[4] = { 0, 0, 0, 0 };
+	const unsigned n = 40000;
+	for (unsigned i = 0; i < n; i++) {
+		Sequence s;
+		for (unsigned j = 0; j < Kmer::length(); j++)
+			s += "ACGT"[rand() % 4];
+		counts[Kmer(s).getCode() % 4]++;
+	}
+	for (unsigned i = 0; i < 4; i++) {
+		EXPECT_GT(counts[i], n / 4 * 95 / 100);
+		EXPECT_LT(counts[i], n / 4 * 105 / 100);
+	}
+}
+
+/** Compare shifting and reverse complementing against the string
+ * operations for every k up to MAX_KMER, which spans the boundaries
+ * of the 64-bit words of a k-mer. */
+TEST(Kmer, shift_reverseComplement)
+{
+	srand(1);
+	for (unsigned k = 1; k <= MAX_KMER; k++) {
+		Kmer::setLength(k);
+		Sequence s;
+		for (unsigned j = 0; j < k; j++)
+			s += "ACGT"[rand() % 4];
+		Kmer kmer(s);
+		ASSERT_EQ(s, kmer.str());
+
+		Kmer rc = kmer;
+		rc.reverseComplement();
+		ASSERT_EQ(reverseComplement(s), rc.str());
+		rc.reverseComplement();
+		ASSERT_EQ(kmer, rc);
+
+		for (unsigned i = 0; i < 8; i++) {
+			uint8_t base = rand() % 4;
+			uint8_t out = kmer.shift(SENSE, base);
+			ASSERT_EQ(baseToCode(s[0]), out);
+			s = s.substr(1) + codeToBase(base);
+			ASSERT_EQ(Kmer(s), kmer);
+
+			base = rand() % 4;
+			out = kmer.shift(ANTISENSE, base);
+			ASSERT_EQ(baseToCode(s[k - 1]), out);
+			s = codeToBase(base) + s.substr(0, k - 1);
+			ASSERT_EQ(Kmer(s), kmer);
+		}
+	}
+}
@@ -0,0 +1,131 @@
+#include "Common/OpenHashMap.h"
+#include "Common/Kmer.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <map>
+
+/** A hash function with many collisions. */
+struct BadHash {
+	size_t operator()(unsigned x) const { return x % 3; }
+};
+
+TEST(OpenHashMap, insert_find)
+{
+	OpenHashMap<unsigned, unsigned> m;
+	EXPECT_TRUE(m.empty());
+	EXPECT_TRUE(m.find(1) == m.end());
+
+	for (unsigned i = 0; i < 1000; i++)
+		EXPECT_TRUE(m.insert(std::make_pair(i, 2 * i)).second);
+	EXPECT_FALSE(m.insert(std::make_pair(7u, 0u)).second);
+	EXPECT_EQ(1000U, m.size());
+	EXPECT_LE(m.load_factor(), m.max_load_factor());
+
+	for (unsigned i = 0; i < 1000; i++) {
+		OpenHashMap<unsigned, unsigned>::const_iterator it = m.find(i);
+		ASSERT_TRUE(it != m.end());
+		EXPECT_EQ(2 * i, it->second);
+	}
+	EXPECT_TRUE(m.find(1000) == m.end());
+
+	size_t n = 0;
+	for (OpenHashMap<unsigned, unsigned>::iterator it = m.begin();
+			it != m.end(); ++it)
+		n++;
+	EXPECT_EQ(m.size(), n);
+}
+
+TEST(OpenHashMap, erase_while_iterating)
+{
+	typedef OpenHashMap<unsigned, unsigned, BadHash> Map;
+	Map m;
+	std::map<unsigned, unsigned> expected;
+	srand(1);
+	for (unsigned i = 0; i < 500; i++) {
+		unsigned x = rand();
+		m.insert(std::make_pair(x, i));
+		expected.insert(std::make_pair(x, i));
+	}
+
+	// Erase the odd keys, as SequenceCollectionHash::cleanup does.
+	for (Map::iterator it = m.begin(); it != m.end();) {
+		if (it->first % 2)
+			it = m.erase(it);
+		else
+			++it;
+	}
+	for (std::map<unsigned, unsigned>::iterator it = expected.begin();
+			it != expected.end();) {
+		if (it->first % 2)
+			expected.erase(it++);
+		else
+			++it;
+	}
+
+	ASSERT_EQ(expected.size(), m.size());
+	for (std::map<unsigned, unsigned>::const_iterator
+			it = expected.begin(); it != expected.end(); ++it) {
+		Map::const_iterator found = m.find(it->first);
+		ASSERT_TRUE(found != m.end());
+		EXPECT_EQ(it->second, found->second);
+	}
+}
+
+TEST(OpenHashMap, rehash)
+{
+	OpenHashMap<Kmer, unsigned> m;
+	Kmer::setLength(4);
+	m.insert(std::make_pair(Kmer("ACGT"), 1u));
+	m.insert(std::make_pair(Kmer("TTTT"), 2u));
+	m.rehash(1000);
+	EXPECT_LE(1000 / m.max_load_factor(), m.bucket_count());
+	EXPECT_EQ(1U, m.find(Kmer("ACGT"))->second);
+
+	EXPECT_EQ(1U, m.erase(Kmer("ACGT")));
+	EXPECT_EQ(0U, m.erase(Kmer("ACGT")));
+	m.rehash(0);
+	EXPECT_GT(1000U, m.bucket_count());
+	EXPECT_EQ(1U, m.size());
+	EXPECT_EQ(2U, m.find(Kmer("TTTT"))->second);
+}
+
+TEST(OpenHashMap, insert_present_does_not_grow)
+{
+	OpenHashMap<unsigned, unsigned> m;
+	unsigned i = 0;
+	for (; m.size() + 1 <= m.max_load_factor() * m.bucket_count()
+			|| m.empty(); i++)
+		m.insert(std::make_pair(i, i));
+	size_t buckets = m.bucket_count();
+	OpenHashMap<unsigned, unsigned>::iterator it = m.find(0);
+	std::pair<OpenHashMap<unsigned, unsigned>::iterator, bool>
+		inserted = m.insert(std::make_pair(0u, 1u));
+	EXPECT_FALSE(inserted.second);
+	EXPECT_EQ(buckets, m.bucket_count());
+	EXPECT_TRUE(it == inserted.first);
+	EXPECT_EQ(0U, it->second);
+}
+
+TEST(OpenHashMap, clear)
+{
+	OpenHashMap<unsigned, unsigned> m;
+	m.rehash(100000);
+	size_t buckets = m.bucket_count();
+
+	// Clear a few entries of a large table, and then many entries.
+	unsigned sizes[] = { 10, 50000 };
+	for (unsigned n = 0; n < 2; n++) {
+		for (unsigned i = 0; i < sizes[n]; i++)
+			m.insert(std::make_pair(i, i));
+		m.clear();
+		EXPECT_TRUE(m.empty());
+		EXPECT_EQ(buckets, m.bucket_count());
+		EXPECT_TRUE(m.begin() == m.end());
+		for (unsigned i = 0; i < sizes[n]; i++)
+			ASSERT_TRUE(m.find(i) == m.end());
+	}
+
+	EXPECT_TRUE(m.insert(std::make_pair(3u, 4u)).second);
+	EXPECT_EQ(4U, m.find(3)->second);
+	EXPECT_EQ(1U, m.size());
+}
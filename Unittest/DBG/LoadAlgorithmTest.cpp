@@ -41,3 +41,33 @@ cerr << "visiting Kmer: " << kmer << "\n";
 
 	ASSERT_TRUE(expectedKmers.empty());
 }
+
+TEST(LoadAlgorithmTest, adjacency_threads)
+{
+	typedef SequenceCollectionHash Graph;
+
+	opt::kmerSize = 5;
+	Kmer::setLength(5);
+	Sequence seq("TAATGCCATGGGATGTTACCGTAAGCTTAGCAT");
+
+	Graph g1, g4;
+	AssemblyAlgorithms::loadSequence(&g1, seq);
+	AssemblyAlgorithms::loadSequence(&g4, seq);
+
+	opt::threads = 1;
+	size_t edges = AssemblyAlgorithms::generateAdjacency(&g1);
+	opt::threads = 4;
+	EXPECT_EQ(edges, AssemblyAlgorithms::generateAdjacency(&g4));
+	opt::threads = 1;
+
+	for (Graph::const_iterator it = g1.begin(); it != g1.end(); ++it) {
+		SequenceCollectionHash::SymbolSetPair ext1, ext4;
+		int mult1, mult4;
+		ASSERT_TRUE(g1.getSeqData(it->first, ext1, mult1));
+		ASSERT_TRUE(g4.getSeqData(it->first, ext4, mult4));
+		for (extDirection dir = SENSE; dir <= ANTISENSE; ++dir)
+			for (uint8_t x = 0; x < NUM_BASES; ++x)
+				EXPECT_EQ(ext1.dir[dir].checkBase(x),
+						ext4.dir[dir].checkBase(x));
+	}
+}
@@ -0,0 +1,52 @@
+#include "DataLayer/FastaIndex.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+TEST(FastaIndex, open)
+{
+	char faPath[] = "/tmp/FastaIndexXXXXXX";
+	int fd = mkstemp(faPath);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	ofstream fa(faPath);
+	fa << ">1\nACGT\n>2 comment\nAACCGGTT\n>3\nA\n";
+	fa.close();
+	ASSERT_TRUE(fa.good());
+
+	FastaIndex expected;
+	expected.index(faPath);
+	unlink(faPath);
+
+	char path[] = "/tmp/FastaIndexXXXXXX";
+	fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	ofstream out(path);
+	out << expected;
+	out.close();
+	ASSERT_TRUE(out.good());
+
+	FastaIndex faIndex;
+	faIndex.open(path);
+	unlink(path);
+
+	ASSERT_EQ(expected.size(), faIndex.size());
+	EXPECT_EQ(expected.fileSize(), faIndex.fileSize());
+	FastaIndex::const_iterator it = faIndex.begin();
+	for (FastaIndex::const_iterator e = expected.begin();
+			e != expected.end(); ++e, ++it) {
+		EXPECT_EQ(e->id, it->id);
+		EXPECT_EQ(e->offset, it->offset);
+		EXPECT_EQ(e->size, it->size);
+	}
+
+	FastaIndex::SeqPos seqPos = faIndex[expected.begin()[1].offset + 3];
+	EXPECT_EQ("2", seqPos.get<0>().id);
+	EXPECT_EQ(3U, seqPos.get<1>());
+}
@@ -0,0 +1,138 @@
+#include "DataLayer/FastaReader.h"
+#include "DataLayer/Bgzf.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#if HAVE_ZLIB_H && HAVE_LIBZ
+# include <zlib.h>
+#endif
+
+using namespace std;
+
+/** Return the text of a FASTA or FASTQ file of n records. */
+static string makeReads(unsigned n, bool fastq)
+{
+	const char bases[] = "ACGT";
+	ostringstream ss;
+	for (unsigned i = 0; i < n; i++) {
+		string seq;
+		for (unsigned j = 0; j < 20 + i % 37; j++)
+			seq += bases[(i * 7 + j * 3) % 4];
+		if (fastq) {
+			// Quality lines that start with `@' look like headers.
+			string qual(seq.size(), i % 3 == 0 ? '@' : 'I');
+			ss << '@' << i << '\n' << seq << "\n+\n" << qual << '\n';
+		} else
+			ss << '>' << i << '\n' << seq << '\n';
+	}
+	return ss.str();
+}
+
+/** Read every section of the file and return the IDs read. */
+static vector<string> readSections(const string& path,
+		unsigned nsections)
+{
+	vector<string> ids;
+	for (unsigned i = 1; i <= nsections; i++) {
+		FastaReader in(path.c_str(), FastaReader::FOLD_CASE,
+				i, nsections);
+		for (FastqRecord rec; in >> rec;)
+			ids.push_back(rec.id);
+		EXPECT_TRUE(in.eof());
+	}
+	return ids;
+}
+
+static void expectSplit(const string& path, unsigned n)
+{
+	vector<string> expected;
+	for (unsigned i = 0; i < n; i++) {
+		ostringstream ss;
+		ss << i;
+		expected.push_back(ss.str());
+	}
+	EXPECT_TRUE(FastaReader::isSplittable(path.c_str()));
+	const unsigned nsections[] = { 1, 2, 3, 7, 16, 64 };
+	for (unsigned i = 0; i < sizeof nsections / sizeof *nsections; i++)
+		EXPECT_EQ(expected, readSections(path, nsections[i]));
+}
+
+static string tempPath(const char* suffix)
+{
+	ostringstream ss;
+	ss << "FastaReaderTest-" << getpid() << suffix;
+	return ss.str();
+}
+
+TEST(FastaReader, split_fasta)
+{
+	string path = tempPath(".fa");
+	ofstream(path.c_str()) << makeReads(1000, false);
+	expectSplit(path, 1000);
+	unlink(path.c_str());
+}
+
+TEST(FastaReader, split_fastq)
+{
+	string path = tempPath(".fq");
+	ofstream(path.c_str()) << makeReads(1000, true);
+	expectSplit(path, 1000);
+	unlink(path.c_str());
+}
+
+#if HAVE_ZLIB_H && HAVE_LIBZ
+/** Compress the data to a BGZF file using blocks of at most
+ * blockSize bytes of data. */
+static void writeBgzf(const string& path, const string& data,
+		size_t blockSize)
+{
+	ofstream out(path.c_str(), ios::binary);
+	for (size_t pos = 0; pos <= data.size(); pos += blockSize) {
+		// The last block is the empty end-of-file marker.
+		size_t n = min(blockSize, data.size() - pos);
+		vector<unsigned char> buf(compressBound(n) + 64);
+		z_stream zs;
+		memset(&zs, 0, sizeof zs);
+		ASSERT_EQ(Z_OK, deflateInit2(&zs, Z_DEFAULT_COMPRESSION,
+					Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY));
+		zs.next_in = (Bytef*)data.data() + pos;
+		zs.avail_in = n;
+		zs.next_out = &buf[18];
+		zs.avail_out = buf.size() - 26;
+		ASSERT_EQ(Z_STREAM_END, deflate(&zs, Z_FINISH));
+		size_t size = 18 + zs.total_out + 8;
+		deflateEnd(&zs);
+
+		const unsigned char header[16] = { 31, 139, 8, 4, 0, 0, 0, 0,
+			0, 255, 6, 0, 'B', 'C', 2, 0 };
+		copy(header, header + 16, buf.begin());
+		buf[16] = (size - 1) & 0xff;
+		buf[17] = (size - 1) >> 8;
+		uint32_t crc = crc32(0, (const Bytef*)data.data() + pos, n);
+		unsigned char* p = &buf[size - 8];
+		for (unsigned i = 0; i < 4; i++) {
+			p[i] = crc >> (8 * i);
+			p[4 + i] = n >> (8 * i);
+		}
+		out.write((const char*)&buf[0], size);
+		if (n == 0)
+			break;
+	}
+	ASSERT_TRUE(out.good());
+}
+
+TEST(FastaReader, split_bgzf)
+{
+	string path = tempPath(".fq.gz");
+	writeBgzf(path, makeReads(1000, true), 997);
+	EXPECT_TRUE(Bgzf::isBgzf(path.c_str()));
+	expectSplit(path, 1000);
+	unlink(path.c_str());
+}
+#endif
@@ -0,0 +1,219 @@
+#include "FMIndex/FMIndex.h"
+#include "FMIndex/OccTable.h"
+#include "FMIndex/PackedArray.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
+
+using namespace std;
+
+TEST(PackedArray, set_at)
+{
+	EXPECT_EQ(1U, PackedArray::bitsFor(0));
+	EXPECT_EQ(1U, PackedArray::bitsFor(1));
+	EXPECT_EQ(10U, PackedArray::bitsFor(1023));
+	EXPECT_EQ(11U, PackedArray::bitsFor(1024));
+
+	// A width of 13 bits crosses word boundaries.
+	PackedArray a(1000, 13);
+	for (size_t i = 0; i < a.size(); i++)
+		a.set(i, i * 37 % 8192);
+	a.set(10, 0);
+	a.set(10, 8191);
+	for (size_t i = 0; i < a.size(); i++)
+		EXPECT_EQ(i == 10 ? 8191 : i * 37 % 8192, a[i]);
+
+	stringstream ss;
+	ss << a;
+	PackedArray b;
+	ss >> b;
+	ASSERT_FALSE(ss.fail());
+	EXPECT_EQ(a.size(), b.size());
+	EXPECT_EQ(a.bits(), b.bits());
+	for (size_t i = 0; i < a.size(); i++)
+		EXPECT_EQ(a[i], b[i]);
+
+	b.truncate(100);
+	EXPECT_EQ(100U, b.size());
+	EXPECT_EQ(a[99], b[99]);
+}
+
+/** Check the occurrence table against a naive count. */
+static void checkOccTable(const vector<uint8_t>& s, const OccTable& occ)
+{
+	ASSERT_EQ(s.size(), occ.size());
+	const uint8_t SENTINEL = 0xff;
+	vector<size_t> counts(6);
+	for (size_t i = 0; i <= s.size(); i++) {
+		for (uint8_t c = 0; c < counts.size(); c++)
+			ASSERT_EQ(counts[c], occ.rank(c, i)) << i;
+		if (i == s.size())
+			break;
+		ASSERT_EQ(s[i], occ.at(i));
+		if (s[i] != SENTINEL)
+			counts[s[i]]++;
+	}
+	for (uint8_t c = 0; c < counts.size(); c++)
+		EXPECT_EQ(counts[c], occ.count(c));
+}
+
+TEST(OccTable, rank)
+{
+	// Span several superblocks with four and five symbols.
+	for (unsigned sigma = 4; sigma <= 5; sigma++) {
+		vector<uint8_t> s(200000);
+		srand(sigma);
+		for (size_t i = 0; i < s.size(); i++)
+			s[i] = rand() % sigma;
+		s[123457] = 0xff;
+
+		OccTable occ;
+		occ.assign(s.begin(), s.end());
+		checkOccTable(s, occ);
+
+		stringstream ss;
+		ss << occ;
+		OccTable loaded;
+		ss >> loaded;
+		ASSERT_FALSE(ss.fail());
+		checkOccTable(s, loaded);
+
+		OccTable copy(loaded);
+		checkOccTable(s, copy);
+	}
+}
+
+TEST(FMIndex, findExact)
+{
+	string text;
+	srand(1);
+	for (unsigned i = 0; i < 5000; i++)
+		text += "ACGT"[rand() % 4];
+	text += '\n';
+
+	FMIndex fm;
+	fm.setAlphabet("-ACGT");
+	vector<uint8_t> s(text.begin(), text.end());
+	fm.assign(s.begin(), s.end());
+	fm.sampleSA(4);
+	EXPECT_EQ(text.size(), fm.size());
+
+	stringstream ss;
+	ss << fm;
+	FMIndex loaded;
+	ss >> loaded;
+	ASSERT_FALSE(ss.fail());
+
+	for (unsigned i = 0; i < 100; i++) {
+		size_t pos = rand() % (text.size() - 20);
+		string q = text.substr(pos, 20);
+		vector<uint8_t> encoded(q.begin(), q.end());
+		loaded.encode(encoded.begin(), encoded.end());
+		FMIndex::SAInterval sai = loaded.findExact(
+				encoded.begin(), encoded.end(),
+				FMIndex::SAInterval(loaded));
+		ASSERT_FALSE(sai.empty());
+		bool found = false;
+		for (size_t j = sai.l; j < sai.u; j++) {
+			size_t p = loaded[j];
+			EXPECT_EQ(q, text.substr(p, 20));
+			if (p == pos)
+				found = true;
+		}
+		EXPECT_TRUE(found);
+	}
+}
+
+TEST(FMIndex, constructSuffixArray)
+{
+	// Lines separated by '\n', which is encoded as the symbol 0,
+	// including a line at the start of the text.
+	string text = "\n";
+	srand(2);
+	for (unsigned i = 0; i < 200; i++) {
+		unsigned n = rand() % 80;
+		for (unsigned j = 0; j < n; j++)
+			text += "ACGT"[rand() % 4];
+		text += '\n';
+	}
+
+	FMIndex expected;
+	expected.setAlphabet("-ACGT");
+	vector<uint8_t> s(text.begin(), text.end());
+	expected.assign(s.begin(), s.end());
+
+	for (unsigned threads = 1; threads <= 4; threads *= 2) {
+#if _OPENMP
+		omp_set_num_threads(threads);
+#endif
+		FMIndex fm;
+		fm.setAlphabet("-ACGT");
+		vector<uint8_t> bwt(text.begin(), text.end());
+		bwt.push_back(0);
+		fm.buildBWT(bwt.begin(), bwt.end() - 1);
+		fm.sampleSA(3);
+		fm.assignBWT(bwt.begin(), bwt.end());
+		ASSERT_EQ(text.size(), fm.size());
+		for (size_t i = 0; i <= text.size(); i++)
+			ASSERT_EQ(expected[i], fm[i]) << threads << ' ' << i;
+	}
+}
+
+TEST(FMIndex, open)
+{
+	string text;
+	srand(3);
+	for (unsigned i = 0; i < 20000; i++)
+		text += i % 70 == 69 ? '\n' : "ACGT"[rand() % 4];
+
+	FMIndex fm;
+	fm.setAlphabet("-ACGT");
+	vector<uint8_t> s(text.begin(), text.end());
+	fm.assign(s.begin(), s.end());
+
+	char path[] = "/tmp/FMIndexXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	std::ofstream out(path);
+	out << fm;
+	out.close();
+	ASSERT_TRUE(out.good());
+
+	// Map the index, and read it from a stream.
+	FMIndex mapped;
+	mapped.open(path);
+	FMIndex loaded;
+	std::ifstream in(path);
+	in >> loaded;
+	ASSERT_FALSE(in.fail());
+	unlink(path);
+
+	EXPECT_EQ(fm.size(), mapped.size());
+	EXPECT_EQ(fm.size(), loaded.size());
+	for (size_t i = 0; i <= fm.size(); i++) {
+		ASSERT_EQ(fm[i], mapped[i]) << i;
+		ASSERT_EQ(fm[i], loaded[i]) << i;
+	}
+
+	string q = text.substr(1000, 30);
+	vector<uint8_t> encoded(q.begin(), q.end());
+	mapped.encode(encoded.begin(), encoded.end());
+	FMIndex::SAInterval sai = mapped.findExact(
+			encoded.begin(), encoded.end(),
+			FMIndex::SAInterval(mapped));
+	ASSERT_EQ(1U, sai.size());
+	EXPECT_EQ(1000U, mapped[sai.l]);
+
+	// Sampling copies the mapped suffix array.
+	mapped.sampleSA(4);
+	for (size_t i = 0; i <= fm.size(); i++)
+		ASSERT_EQ(fm[i], mapped[i]) << i;
+}
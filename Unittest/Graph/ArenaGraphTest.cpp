@@ -0,0 +1,112 @@
+#include "Graph/ArenaGraph.h"
+#include "Graph/AllPathsSearch.h"
+#include <gtest/gtest.h>
+
+using namespace std;
+
+namespace {
+
+class ArenaGraphTest : public ::testing::Test {
+
+protected:
+
+	typedef ArenaGraph<int> Graph;
+	typedef boost::graph_traits<Graph>::edge_descriptor edge_descriptor;
+	typedef boost::graph_traits<Graph>::out_edge_iterator out_edge_iterator;
+	typedef boost::graph_traits<Graph>::adjacency_iterator adjacency_iterator;
+	typedef boost::graph_traits<Graph>::vertex_iterator vertex_iterator;
+
+	Graph simpleCyclicGraph;
+
+	ArenaGraphTest() {
+		add_edge(1, 2, simpleCyclicGraph);
+		add_edge(1, 3, simpleCyclicGraph);
+		add_edge(2, 4, simpleCyclicGraph);
+		add_edge(3, 4, simpleCyclicGraph);
+	}
+};
+
+TEST_F(ArenaGraphTest, add_edge)
+{
+	EXPECT_EQ(4U, num_vertices(simpleCyclicGraph));
+	EXPECT_EQ(4U, simpleCyclicGraph.num_edges());
+	EXPECT_FALSE(add_edge(1, 2, simpleCyclicGraph).second);
+	EXPECT_EQ(4U, simpleCyclicGraph.num_edges());
+	EXPECT_EQ(2U, out_degree(1, simpleCyclicGraph));
+	EXPECT_EQ(0U, out_degree(4, simpleCyclicGraph));
+	EXPECT_EQ(0U, out_degree(5, simpleCyclicGraph));
+}
+
+TEST_F(ArenaGraphTest, out_edge_iterator)
+{
+	out_edge_iterator ei, ei_end;
+	boost::tie(ei, ei_end) = out_edges(1, simpleCyclicGraph);
+
+	// The successors are in the order that they were added.
+	ASSERT_TRUE(ei != ei_end);
+	EXPECT_EQ(edge_descriptor(1, 2), *ei);
+	ei++;
+	ASSERT_TRUE(ei != ei_end);
+	EXPECT_EQ(edge_descriptor(1, 3), *ei);
+	ei++;
+	EXPECT_TRUE(ei == ei_end);
+
+	boost::tie(ei, ei_end) = out_edges(4, simpleCyclicGraph);
+	EXPECT_TRUE(ei == ei_end);
+}
+
+TEST_F(ArenaGraphTest, adjacency_iterator)
+{
+	adjacency_iterator ai, ai_end;
+	boost::tie(ai, ai_end) = adjacent_vertices(2, simpleCyclicGraph);
+	ASSERT_TRUE(ai != ai_end);
+	EXPECT_EQ(4, *ai);
+	++ai;
+	EXPECT_TRUE(ai == ai_end);
+}
+
+TEST_F(ArenaGraphTest, vertex_iterator)
+{
+	vertex_iterator vi, vi_end;
+	boost::tie(vi, vi_end) = vertices(simpleCyclicGraph);
+	int expected[] = { 1, 2, 3, 4 };
+	unsigned count = 0;
+	for (; vi != vi_end; ++vi, ++count) {
+		ASSERT_LT(count, 4U);
+		EXPECT_EQ(expected[count], *vi);
+	}
+	EXPECT_EQ(4U, count);
+}
+
+TEST_F(ArenaGraphTest, clear)
+{
+	size_t memSize = simpleCyclicGraph.approxMemSize();
+	EXPECT_GT(memSize, 0U);
+	simpleCyclicGraph.clear();
+	EXPECT_EQ(0U, num_vertices(simpleCyclicGraph));
+	EXPECT_EQ(0U, simpleCyclicGraph.num_edges());
+	// The memory kept for reuse is counted.
+	EXPECT_EQ(memSize, simpleCyclicGraph.approxMemSize());
+
+	add_edge(4, 1, simpleCyclicGraph);
+	EXPECT_EQ(2U, num_vertices(simpleCyclicGraph));
+	EXPECT_EQ(1U, out_degree(4, simpleCyclicGraph));
+	EXPECT_EQ(0U, out_degree(2, simpleCyclicGraph));
+
+	simpleCyclicGraph.release();
+	EXPECT_EQ(0U, num_vertices(simpleCyclicGraph));
+	EXPECT_EQ(0U, simpleCyclicGraph.approxMemSize());
+}
+
+TEST_F(ArenaGraphTest, allPathsSearch)
+{
+	vector< Path<int> > paths;
+	EXPECT_EQ(FOUND_PATH,
+		allPathsSearch(simpleCyclicGraph, 1, 4, paths));
+	ASSERT_EQ(2U, paths.size());
+	EXPECT_EQ(3U, paths[0].size());
+	EXPECT_EQ(2, paths[0][1]);
+	EXPECT_EQ(3, paths[1][1]);
+}
+
+}
@@ -0,0 +1,69 @@
+#include "KAligner/BatchQueue.h"
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <vector>
+
+using namespace std;
+
+TEST(BatchQueue, fifo)
+{
+	BatchQueue<int> q(4);
+	for (int i = 0; i < 4; i++) {
+		int x = i;
+		q.push(x);
+	}
+	for (int i = 0; i < 4; i++) {
+		int x = -1;
+		ASSERT_TRUE(q.pop(x));
+		EXPECT_EQ(i, x);
+	}
+	q.close();
+	int x;
+	EXPECT_FALSE(q.pop(x));
+	EXPECT_FALSE(q.pop(x));
+}
+
+static const unsigned N = 100000;
+
+static BatchQueue<unsigned>* g_queue;
+
+static void* produce(void*)
+{
+	for (unsigned i = 1; i <= N; i++) {
+		unsigned x = i;
+		g_queue->push(x);
+	}
+	return NULL;
+}
+
+/** Add the popped values to the sum at arg. */
+static void* consume(void* arg)
+{
+	unsigned long long& sum = *static_cast<unsigned long long*>(arg);
+	for (unsigned x; g_queue->pop(x);)
+		sum += x;
+	return NULL;
+}
+
+TEST(BatchQueue, threads)
+{
+	const unsigned producers = 3, consumers = 4;
+	BatchQueue<unsigned> q(8);
+	g_queue = &q;
+
+	vector<pthread_t> in(producers), out(consumers);
+	vector<unsigned long long> sums(consumers);
+	for (unsigned i = 0; i < consumers; i++)
+		pthread_create(&out[i], NULL, consume, &sums[i]);
+	for (unsigned i = 0; i < producers; i++)
+		pthread_create(&in[i], NULL, produce, NULL);
+	for (unsigned i = 0; i < producers; i++)
+		pthread_join(in[i], NULL);
+	q.close();
+	unsigned long long sum = 0;
+	for (unsigned i = 0; i < consumers; i++) {
+		pthread_join(out[i], NULL);
+		sum += sums[i];
+	}
+	EXPECT_EQ((unsigned long long)producers * N * (N + 1) / 2, sum);
+}
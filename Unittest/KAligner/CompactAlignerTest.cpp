@@ -0,0 +1,209 @@
+#include "KAligner/Aligner.h"
+#include "KAligner/CompactAligner.h"
+#include "Iterator.h"
+#include <gtest/gtest.h>
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+static const unsigned K = 11;
+
+/** Return a pseudo-random sequence of the specified length. */
+static string randomSeq(unsigned n, unsigned seed)
+{
+	string s;
+	for (unsigned i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		s += "ACGT"[(seed >> 16) & 3];
+	}
+	return s;
+}
+
+/** Return the alignments of the query in the format of KAligner. */
+template <class AlignerType>
+static string align(AlignerType& aligner,
+		const string& qid, const Sequence& seq)
+{
+	ostringstream ss;
+	aligner.alignRead(qid, seq,
+			affix_ostream_iterator<Alignment>(ss, "\t"));
+	return ss.str();
+}
+
+class CompactAlignerTest : public testing::Test
+{
+  protected:
+	CompactAlignerTest() : m_multimap(opt::multimap)
+	{
+		Kmer::setLength(K);
+		opt::multimap = opt::ERROR;
+	}
+
+	~CompactAlignerTest() { opt::multimap = m_multimap; }
+
+  private:
+	int m_multimap;
+};
+
+/** With a window of one k-mer, every k-mer is indexed, and the
+ * alignments are those of the hash table index. */
+TEST_F(CompactAlignerTest, matchesAligner)
+{
+	vector<string> targets;
+	targets.push_back(randomSeq(300, 1));
+	targets.push_back(randomSeq(200, 2));
+
+	Aligner<SeqPosHashUniqueMap> aligner(K, 1000);
+	CompactAligner compact(K, 1);
+	for (unsigned i = 0; i < targets.size(); i++) {
+		ostringstream id;
+		id << i;
+		aligner.addReferenceSequence(id.str(), targets[i]);
+		compact.addReferenceSequence(id.str(), targets[i]);
+	}
+	compact.build();
+	EXPECT_EQ(aligner.size(), compact.size());
+
+	vector<string> queries;
+	// An exact match.
+	queries.push_back(targets[0].substr(20, 60));
+	// A reverse complement.
+	queries.push_back(reverseComplement(targets[1].substr(50, 80)));
+	// A mismatch.
+	string q = targets[0].substr(100, 70);
+	q[35] = q[35] == 'A' ? 'C' : 'A';
+	queries.push_back(q);
+	// A match to each target.
+	queries.push_back(targets[0].substr(250, 30)
+			+ targets[1].substr(0, 40));
+	// No match.
+	queries.push_back(randomSeq(50, 3));
+	// A query as short as a k-mer.
+	queries.push_back(targets[1].substr(150, K));
+
+	for (unsigned i = 0; i < queries.size(); i++) {
+		string expected = align(aligner, "q", queries[i]);
+		EXPECT_EQ(expected, align(compact, "q", queries[i])) << i;
+	}
+	EXPECT_EQ("\t0 20 0 60 60 0", align(compact, "q", queries[0]));
+}
+
+/** A sequence shorter than k+w-1 has one minimizer, and a sequence
+ * shorter than k has none. */
+TEST_F(CompactAlignerTest, shortSequence)
+{
+	const unsigned w = 4;
+	string target = randomSeq(K + w - 2, 4);
+	CompactAligner compact(K, w);
+	compact.addReferenceSequence("0", target);
+	compact.addReferenceSequence("1", target.substr(0, K - 1));
+	compact.build();
+	EXPECT_EQ(1U, compact.size());
+
+	ostringstream expected;
+	expected << "\t0 0 0 " << target.size() << ' '
+		<< target.size() << " 0";
+	EXPECT_EQ(expected.str(), align(compact, "q", target));
+	EXPECT_EQ("", align(compact, "q", target.substr(0, K - 1)));
+}
+
+/** A k-mer that contains an N is not a candidate minimizer, and the
+ * match ends at the N. */
+TEST_F(CompactAlignerTest, ambiguousBase)
+{
+	string target = randomSeq(100, 5);
+	target[50] = 'N';
+	CompactAligner compact(K, 1);
+	compact.addReferenceSequence("0", target);
+	compact.build();
+	EXPECT_EQ(79U, compact.size());
+
+	EXPECT_EQ("\t0 0 0 50 100 0\t0 51 51 49 100 0",
+			align(compact, "q", target));
+
+	string query = target.substr(10, 60);
+	query[10] = 'N';
+	EXPECT_EQ("\t0 21 11 29 60 0\t0 51 41 19 60 0",
+			align(compact, "q", query));
+}
+
+/** A k-mer that contains a masked base is not indexed, and the match
+ * ends at the masked base, as with the hash table index. */
+TEST_F(CompactAlignerTest, maskedBase)
+{
+	string target = randomSeq(100, 6);
+	for (unsigned i = 40; i < 60; i++)
+		target[i] = tolower(target[i]);
+	Aligner<SeqPosHashUniqueMap> aligner(K, 100);
+	aligner.addReferenceSequence("0", target);
+	CompactAligner compact(K, 1);
+	compact.addReferenceSequence("0", target);
+	compact.build();
+	EXPECT_EQ(60U, compact.size());
+
+	string upper = randomSeq(100, 6);
+	EXPECT_EQ("\t0 0 0 40 100 0\t0 60 60 40 100 0",
+			align(compact, "q", upper));
+	EXPECT_EQ(align(aligner, "q", upper), align(compact, "q", upper));
+	EXPECT_EQ("", align(compact, "q", upper.substr(35, 30)));
+
+	string query = upper;
+	query[20] = tolower(query[20]);
+	EXPECT_EQ("\t0 0 0 20 100 0\t0 21 21 19 100 0"
+			"\t0 60 60 40 100 0",
+			align(compact, "q", query));
+	EXPECT_EQ(align(aligner, "q", query), align(compact, "q", query));
+}
+
+/** Return a target whose two sequences share one k-mer, and a query
+ * that contains only that k-mer. */
+static void addDuplicate(CompactAligner& compact, string& query)
+{
+	string a = randomSeq(60, 7), b = randomSeq(60, 8);
+	b.replace(30, K, a, 20, K);
+	compact.addReferenceSequence("a", a);
+	compact.addReferenceSequence("b", b);
+	compact.build();
+	query = a.substr(20, K);
+}
+
+TEST_F(CompactAlignerTest, duplicateIgnore)
+{
+	opt::multimap = opt::IGNORE;
+	CompactAligner compact(K, 1);
+	string query;
+	addDuplicate(compact, query);
+	EXPECT_EQ(1U, compact.countDuplicates());
+	EXPECT_EQ(98U, compact.size());
+	EXPECT_EQ("", align(compact, "q", query));
+}
+
+TEST_F(CompactAlignerTest, duplicateMultimap)
+{
+	opt::multimap = opt::MULTIMAP;
+	CompactAligner compact(K, 1);
+	string query;
+	addDuplicate(compact, query);
+	EXPECT_EQ(100U, compact.size());
+	ostringstream expected;
+	expected << "\ta 20 0 " << K << ' ' << K << " 0"
+		<< "\tb 30 0 " << K << ' ' << K << " 0";
+	EXPECT_EQ(expected.str(), align(compact, "q", query));
+}
+
+TEST_F(CompactAlignerTest, duplicateError)
+{
+	opt::multimap = opt::ERROR;
+	CompactAligner compact(K, 1);
+	string query;
+	EXPECT_EXIT(addDuplicate(compact, query),
+			::testing::ExitedWithCode(EXIT_FAILURE),
+			"error: duplicate k-mer in a also in b");
+}
+
+}
@@ -1,12 +1,19 @@
 #include "Bloom/Bloom.h"
 #include "Bloom/BloomFilter.h"
+#include "Bloom/BlockedBloomFilter.h"
+#include "Bloom/RollingHash.h"
 #include "Bloom/CascadingBloomFilter.h"
 #include "Bloom/BloomFilterWindow.h"
 #include "Bloom/CascadingBloomFilterWindow.h"
+#include "Bloom/ConcurrentBloomFilter.h"
+#include "Bloom/MappedBloomFilter.h"
 #include "Common/BitUtil.h"
 
 #include <gtest/gtest.h>
+#include <fstream>
 #include <string>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 
@@ -298,3 +305,314 @@ TEST(CascadingBloomFilter, window)
 	EXPECT_TRUE(unionBloom[pos2]);
 	EXPECT_FALSE(unionBloom[pos3]);
 }
+
+TEST(ConcurrentBloomFilter, insert)
+{
+	size_t bits = 10000;
+	BloomFilter serial(bits);
+	BloomFilter bloom(bits);
+	CascadingBloomFilter serialCascading(bits, 2);
+	CascadingBloomFilter cascading(bits, 2);
+	ConcurrentBloomFilter<BloomFilter> cbf(bloom);
+	ConcurrentBloomFilter<CascadingBloomFilter> ccbf(cascading);
+
+	for (size_t i = 0; i < 20000; i++) {
+		size_t index = i * 7919 % 6007;
+		serial.insert(index);
+		serialCascading.insert(index);
+	}
+#pragma omp parallel for num_threads(4)
+	for (long i = 0; i < 20000; i++) {
+		size_t index = i * 7919 % 6007;
+		cbf.insert(index);
+		ccbf.insert(index);
+	}
+
+	EXPECT_EQ(serial.popcount(), bloom.popcount());
+	EXPECT_EQ(serialCascading.popcount(), cascading.popcount());
+	for (size_t i = 0; i < bits; i++) {
+		ASSERT_EQ(serial[i], cbf[i]);
+		ASSERT_EQ(serialCascading[i], ccbf[i]);
+	}
+
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+	BloomFilter empty(bits);
+	ConcurrentBloomFilter<BloomFilter> cempty(empty);
+	EXPECT_FALSE(cempty[a]);
+	cempty.insert(a);
+	EXPECT_TRUE(cempty[a]);
+	EXPECT_TRUE(empty[a]);
+}
+
+TEST(MappedBloomFilter, open)
+{
+	size_t bits = 1001;
+	BloomFilter bloom(bits);
+
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+	Kmer b("TGGACAGCGTTACCTC");
+	bloom.insert(a);
+	bloom.insert(b);
+	bloom.insert(bits - 1);
+
+	char path[] = "/tmp/MappedBloomFilterXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	std::ofstream out(path);
+	out << bloom;
+	out.close();
+	ASSERT_TRUE(out.good());
+
+	MappedBloomFilter mapped(path);
+	unlink(path);
+	EXPECT_EQ(bloom.size(), mapped.size());
+	EXPECT_EQ(bloom.popcount(), mapped.popcount());
+	EXPECT_TRUE(mapped[a]);
+	EXPECT_TRUE(mapped[b]);
+	for (size_t i = 0; i < bits; i++)
+		ASSERT_EQ(bloom[i], mapped[i]);
+}
+
+TEST(MappedBloomFilter, isMappable)
+{
+	char path[] = "/tmp/MappedBloomFilterXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	EXPECT_TRUE(MappedBloomFilter::isMappable(path));
+	unlink(path);
+	EXPECT_FALSE(MappedBloomFilter::isMappable(path));
+	EXPECT_FALSE(MappedBloomFilter::isMappable("/tmp"));
+	EXPECT_FALSE(MappedBloomFilter::isMappable("/tmp/x.bloom.gz"));
+
+	// A blocked bloom filter is read by its own stream loader.
+	char blockedPath[] = "/tmp/MappedBloomFilterXXXXXX";
+	fd = mkstemp(blockedPath);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	std::ofstream out(blockedPath);
+	out << BlockedBloomFilter(1000);
+	out.close();
+	ASSERT_TRUE(out.good());
+	EXPECT_FALSE(MappedBloomFilter::isMappable(blockedPath));
+	unlink(blockedPath);
+}
+
+TEST(MappedBloomFilterDeathTest, truncated)
+{
+	Kmer::setLength(16);
+	char path[] = "/tmp/MappedBloomFilterXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	std::ofstream out(path);
+	out << "2\n16\n1001\t0\t1000\n";
+	out.close();
+	ASSERT_TRUE(out.good());
+	EXPECT_EXIT(MappedBloomFilter mapped(path),
+			::testing::ExitedWithCode(EXIT_FAILURE), "truncated");
+
+	out.open(path);
+	out << "2\n16\n1001";
+	out.close();
+	EXPECT_EXIT(MappedBloomFilter mapped(path),
+			::testing::ExitedWithCode(EXIT_FAILURE), "error");
+	unlink(path);
+}
+
+TEST(Bloom, loadFileMultiK)
+{
+	char path[] = "/tmp/loadFileMultiKXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	std::ofstream out(path);
+	out << ">1\nAGATGTGCTGCCGCCTTGGACAGCGTTACCTC\n"
+		">2\nTAATAACAGTCCCTATNACGTTGCAAGGTCCA\n"
+		">3\nACG\n";
+	// Enough reads for each thread to read several batches.
+	unsigned seed = 1;
+	for (unsigned i = 0; i < 1000; i++) {
+		out << '>' << i + 4 << '\n';
+		for (unsigned j = 0; j < 50; j++) {
+			seed = seed * 1103515245 + 12345;
+			out << "ACGT"[(seed >> 16) & 3];
+		}
+		out << '\n';
+	}
+	out.close();
+	ASSERT_TRUE(out.good());
+
+	size_t bits = 100003;
+	std::vector<unsigned> ks;
+	ks.push_back(8);
+	ks.push_back(12);
+	std::vector<BloomFilter*> expected;
+	for (unsigned i = 0; i < ks.size(); i++) {
+		Kmer::setLength(ks[i]);
+		expected.push_back(new BloomFilter(bits));
+		Bloom::loadFile(*expected[i], ks[i], path);
+		EXPECT_LT(0U, expected[i]->popcount());
+	}
+
+#if _OPENMP
+	int maxThreads = omp_get_max_threads();
+#endif
+	for (int nthreads = 1; nthreads <= 3; nthreads += 2) {
+#if _OPENMP
+		omp_set_num_threads(nthreads);
+#endif
+		std::vector<BloomFilter*> blooms;
+		std::vector<ConcurrentBloomFilter<BloomFilter>*> cbfs;
+		for (unsigned i = 0; i < ks.size(); i++) {
+			blooms.push_back(new BloomFilter(bits));
+			cbfs.push_back(
+					new ConcurrentBloomFilter<BloomFilter>(*blooms[i]));
+		}
+		Kmer::setLength(16);
+		Bloom::loadFileMultiK(cbfs, ks, path, false, 1000);
+		EXPECT_EQ(16U, Kmer::length());
+
+		for (unsigned i = 0; i < ks.size(); i++) {
+			for (size_t j = 0; j < bits; j++)
+				ASSERT_EQ((*expected[i])[j], (*blooms[i])[j])
+					<< nthreads;
+			delete cbfs[i];
+			delete blooms[i];
+		}
+	}
+#if _OPENMP
+	omp_set_num_threads(maxThreads);
+#endif
+
+	for (unsigned i = 0; i < ks.size(); i++)
+		delete expected[i];
+	unlink(path);
+}
+
+TEST(RollingHash, rolling)
+{
+	const unsigned k = 5;
+	std::string seq("ACGTTGCANNACGTACCGTAGGCTNA");
+	std::string rc = reverseComplement(Sequence(seq));
+
+	size_t n = 0;
+	for (RollingHashIterator it(seq, k);
+			it != RollingHashIterator::end(); ++it, n++) {
+		size_t pos = it.pos();
+		ASSERT_LE(pos + k, seq.size());
+		EXPECT_EQ(std::string::npos,
+				seq.substr(pos, k).find_first_not_of("ACGT"));
+		EXPECT_EQ(RollingHash::hash(seq.data() + pos, k), *it);
+		EXPECT_EQ(RollingHash::hash(rc.data() + rc.size() - pos - k, k),
+				*it);
+	}
+	// ACGTTGCA has 4 k-mers, ACGTACCGTAGGCT has 10
+	EXPECT_EQ(14U, n);
+
+	std::string shortSeq("ACGNT");
+	EXPECT_TRUE(RollingHashIterator(shortSeq, k)
+			== RollingHashIterator::end());
+}
+
+TEST(BlockedBloomFilter, base)
+{
+	BlockedBloomFilter x(1000, 3);
+	EXPECT_EQ(1024U, x.size());
+	EXPECT_EQ(3U, x.numHashes());
+
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+	Kmer b("TGGACAGCGTTACCTC");
+	Kmer c("TAATAACAGTCCCTAT");
+
+	x.insert(a);
+	EXPECT_GE(3U, x.popcount());
+	EXPECT_TRUE(x[a]);
+	EXPECT_TRUE(x[reverseComplement(a)]);
+	x.insert(b);
+	EXPECT_TRUE(x[b]);
+	EXPECT_FALSE(x[c]);
+
+	std::string seq("AGATGTGCTGCCGCCTTGGACAGCGTTACCTC");
+	BlockedBloomFilter y(100000);
+	Bloom::loadSeq(y, 16, seq);
+	for (size_t i = 0; i + 16 <= seq.size(); i++)
+		EXPECT_TRUE(y[Kmer(seq.substr(i, 16))]);
+	EXPECT_FALSE(y[c]);
+}
+
+TEST(BlockedBloomFilter, serialization)
+{
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+	Kmer b("TGGACAGCGTTACCTC");
+
+	BlockedBloomFilter origBloom(2000, 5);
+	origBloom.insert(a);
+	origBloom.insert(b);
+
+	stringstream ss;
+	ss << origBloom;
+	ASSERT_TRUE(ss.good());
+
+	BlockedBloomFilter copyBloom;
+	ss >> copyBloom;
+	ASSERT_TRUE(ss.good());
+
+	EXPECT_EQ(origBloom.size(), copyBloom.size());
+	EXPECT_EQ(origBloom.numHashes(), copyBloom.numHashes());
+	EXPECT_EQ(origBloom.popcount(), copyBloom.popcount());
+	EXPECT_TRUE(copyBloom[a]);
+	EXPECT_TRUE(copyBloom[b]);
+}
+
+TEST(BlockedBloomFilter, union_)
+{
+	Kmer::setLength(16);
+	Kmer a("AGATGTGCTGCCGCCT");
+	Kmer b("TGGACAGCGTTACCTC");
+
+	BlockedBloomFilter bloom1(2000, 3);
+	BlockedBloomFilter bloom2(2000, 3);
+	bloom1.insert(a);
+	bloom2.insert(b);
+
+	stringstream ss;
+	ss << bloom1 << bloom2;
+	ASSERT_TRUE(ss.good());
+
+	BlockedBloomFilter unionBloom;
+	ss >> unionBloom;
+	ASSERT_TRUE(ss.good());
+	unionBloom.read(ss, BITWISE_OR);
+	ASSERT_TRUE(ss.good());
+
+	EXPECT_EQ(bloom1.size(), unionBloom.size());
+	EXPECT_EQ(3U, unionBloom.numHashes());
+	EXPECT_TRUE(unionBloom[a]);
+	EXPECT_TRUE(unionBloom[b]);
+
+	ss << bloom2;
+	unionBloom.read(ss, BITWISE_AND);
+	ASSERT_TRUE(ss.good());
+	EXPECT_FALSE(unionBloom[a]);
+	EXPECT_TRUE(unionBloom[b]);
+}
+
+TEST(BlockedBloomFilterDeathTest, unionNumHashes)
+{
+	Kmer::setLength(16);
+	BlockedBloomFilter bloom1(2000, 3);
+	BlockedBloomFilter bloom2(2000, 4);
+	stringstream ss;
+	ss << bloom1 << bloom2;
+	BlockedBloomFilter unionBloom;
+	ss >> unionBloom;
+	EXPECT_EXIT(unionBloom.read(ss, BITWISE_OR),
+			::testing::ExitedWithCode(EXIT_FAILURE),
+			"error: can't union/intersect blocked bloom filters");
+}
@@ -1,6 +1,7 @@
 #include "Konnector/DBGBloom.h"
 #include "Bloom/CascadingBloomFilter.h"
 #include "Bloom/BloomFilter.h"
+#include "Bloom/BlockedBloomFilter.h"
 
 #include <gtest/gtest.h>
 #include <string>
@@ -61,3 +62,96 @@ TEST(DBGBloom, BloomFilterPolymorphism)
 	ei2++;
 	EXPECT_TRUE(ei2 == ei_end2);
 }
+
+TEST(DBGBloom, BlockedBloomFilter)
+{
+	Kmer::setLength(3);
+
+	Kmer kmer1("GAC");
+	Kmer kmer2("ACC");
+
+	BlockedBloomFilter bloom(100000);
+	bloom.insert(kmer1);
+	bloom.insert(kmer2);
+
+	DBGBloom<BlockedBloomFilter> graph(bloom);
+
+	boost::graph_traits< DBGBloom<BlockedBloomFilter> >::out_edge_iterator
+		ei, ei_end;
+	boost::tie(ei, ei_end) = out_edges(kmer1, graph);
+	ASSERT_TRUE(ei != ei_end);
+	EXPECT_TRUE(target(*ei, graph) == kmer2);
+	ei++;
+	EXPECT_TRUE(ei == ei_end);
+}
+
+/** Return the bases that extend u to a k-mer in the bloom filter,
+ * testing each neighbour in turn. */
+template <typename BF>
+static unsigned adjacentBasesOneByOne(const BF& bloom,
+		const Kmer& u, extDirection dir)
+{
+	unsigned mask = 0;
+	for (unsigned i = 0; i < NUM_BASES; i++) {
+		Kmer v(u);
+		v.shift(dir, i);
+		if (bloom[v])
+			mask |= 1 << i;
+	}
+	return mask;
+}
+
+/** Check that the neighbours tested together are the neighbours
+ * tested one by one. */
+template <typename BF>
+static void testAdjacentBases(BF& bloom, unsigned k)
+{
+	Kmer::setLength(k);
+	std::string seq;
+	unsigned x = 1;
+	for (unsigned i = 0; i < 2000; i++) {
+		x = x * 1103515245 + 12345;
+		seq += "ACGT"[x >> 16 & 3];
+	}
+	for (unsigned i = 0; i + k <= seq.size(); i += 2)
+		bloom.insert(Kmer(seq.substr(i, k)));
+
+	for (unsigned i = 0; i + k <= seq.size(); i++) {
+		Kmer u(seq.substr(i, k));
+		EXPECT_EQ(adjacentBasesOneByOne(bloom, u, SENSE),
+				Bloom::adjacentBases(bloom, u, SENSE));
+		EXPECT_EQ(adjacentBasesOneByOne(bloom, u, ANTISENSE),
+				Bloom::adjacentBases(bloom, u, ANTISENSE));
+	}
+}
+
+TEST(DBGBloom, AdjacentBases)
+{
+	BloomFilter bloom1(20000), bloom2(20000);
+	testAdjacentBases(bloom1, 25);
+	testAdjacentBases(bloom2, 4);
+
+	BlockedBloomFilter blocked1(20000), blocked2(20000);
+	testAdjacentBases(blocked1, 25);
+	testAdjacentBases(blocked2, 4);
+}
+
+TEST(DBGBloom, Degree)
+{
+	Kmer::setLength(3);
+
+	Kmer kmer1("GAC");
+	Kmer kmer2("ACC");
+	Kmer kmer3("ACG");
+
+	BloomFilter bloom(100000);
+	bloom.insert(kmer1);
+	bloom.insert(kmer2);
+	bloom.insert(kmer3);
+
+	DBGBloom<BloomFilter> graph(bloom);
+	EXPECT_EQ(2U, out_degree(kmer1, graph));
+	EXPECT_EQ(1U, in_degree(kmer2, graph));
+	EXPECT_EQ(0U, out_degree(kmer2, graph));
+	EXPECT_EQ(0U, in_degree(kmer1, graph));
+}